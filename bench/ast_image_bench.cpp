@@ -0,0 +1,78 @@
+#include "workloads.hpp"
+
+#include "AST/AstImage.hpp"
+#include "driver/driver.hpp"
+
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// The image of the parsed program; compare with BM_BufferParser.
+std::string make_image(const bench::Program& program)
+{
+    yy::NumDriver driver(std::string_view(program.source), "bench.pcl");
+    driver.parse();
+    const auto tree = driver.take_ast();
+    std::ostringstream image;
+    ast::write_ast_image(*tree.root(), image);
+    return image.str();
+}
+
+// Validates the image and visits every node through views.
+void BM_AstImageWalk(benchmark::State& state, bench::workload kind)
+{
+    const auto image = make_image(bench::make_program(kind, state.range(0)));
+    const auto file = ast::FileTable::intern("bench.pcl");
+    std::int64_t nodes = 0;
+
+    for (auto _ : state) {
+        const ast::AstImage view(image, file);
+        std::vector<ast::NodeView> stack{ view.root() };
+        nodes = 0;
+        while (!stack.empty()) {
+            const auto node = stack.back();
+            stack.pop_back();
+            ++nodes;
+            for (std::size_t i = 0; i < node.num_children(); ++i) {
+                stack.push_back(node.child(i));
+            }
+        }
+        benchmark::DoNotOptimize(nodes);
+    }
+
+    state.SetBytesProcessed(state.iterations() *
+                            static_cast<std::int64_t>(image.size()));
+    state.SetItemsProcessed(state.iterations() * nodes);
+}
+
+// Validates the image and rebuilds the tree in an arena.
+void BM_AstImageBuild(benchmark::State& state, bench::workload kind)
+{
+    const auto image = make_image(bench::make_program(kind, state.range(0)));
+    const auto file = ast::FileTable::intern("bench.pcl");
+    std::int64_t nodes = 0;
+
+    for (auto _ : state) {
+        auto tree = ast::AstImage(image, file).build();
+        benchmark::DoNotOptimize(tree.root());
+        nodes = bench::count_nodes(tree.root());
+    }
+
+    state.SetBytesProcessed(state.iterations() *
+                            static_cast<std::int64_t>(image.size()));
+    state.SetItemsProcessed(state.iterations() * nodes);
+}
+
+} // namespace
+
+BENCHMARK_CAPTURE(BM_AstImageWalk,
+                  statement_list,
+                  bench::workload::statement_list)
+    ->Apply(bench::sizes<bench::workload::statement_list>);
+BENCHMARK_CAPTURE(BM_AstImageBuild,
+                  statement_list,
+                  bench::workload::statement_list)
+    ->Apply(bench::sizes<bench::workload::statement_list>);
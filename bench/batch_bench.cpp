@@ -0,0 +1,77 @@
+#include "workloads.hpp"
+
+#include "batch/batch_runner.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+constexpr std::size_t kPrograms = 256;
+constexpr std::int64_t kLoopBound = 64;
+
+// kPrograms copies of one nested-loop program, each with its own output
+// file, in a temporary directory that lives for one benchmark run.
+class BatchOnDisk
+{
+public:
+    BatchOnDisk()
+      : dir_(std::filesystem::temp_directory_path() /
+             ("paracl_batch_bench_" + std::to_string(::getpid())))
+    {
+        std::filesystem::create_directories(dir_);
+        const auto program = (dir_ / "loops.pcl").string();
+        std::ofstream(program, std::ios::binary)
+            << bench::make_program(bench::workload::nested_loops, kLoopBound)
+                   .source;
+        for (std::size_t i = 0; i < kPrograms; ++i) {
+            const auto output = dir_ / (std::to_string(i) + ".out");
+            tasks_.push_back({ program, "-", output.string() });
+        }
+    }
+
+    BatchOnDisk(const BatchOnDisk&) = delete;
+    BatchOnDisk& operator=(const BatchOnDisk&) = delete;
+
+    ~BatchOnDisk()
+    {
+        std::filesystem::remove_all(dir_);
+    }
+
+    const std::vector<batch::Task>& tasks() const
+    {
+        return tasks_;
+    }
+
+private:
+    std::filesystem::path dir_;
+    std::vector<batch::Task> tasks_;
+};
+
+// Argument: worker threads. Programs/s should grow with it up to the
+// number of cores.
+void BM_Batch(benchmark::State& state)
+{
+    const BatchOnDisk files;
+    batch::Options options;
+    options.jobs = static_cast<std::size_t>(state.range(0));
+
+    for (auto _ : state) {
+        const auto results = batch::run_batch(files.tasks(), options);
+        if (!results.front().ok) {
+            state.SkipWithError(results.front().diagnostics.c_str());
+            break;
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<std::int64_t>(kPrograms));
+}
+
+} // namespace
+
+BENCHMARK(BM_Batch)->RangeMultiplier(2)->Range(1, 16)->UseRealTime();
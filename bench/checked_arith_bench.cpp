@@ -0,0 +1,59 @@
+#include "Runtime/CheckedArith.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+using CheckedOp = bool (*)(std::int64_t, std::int64_t, std::int64_t&);
+
+// The factors of factorial.pcl for 1..20, repeated: the product grows to
+// 20! and starts over, so no step overflows. The factors come from memory
+// so the compiler cannot fold the checks away.
+std::vector<std::int64_t> factorial_factors(std::int64_t count)
+{
+    std::vector<std::int64_t> factors(static_cast<std::size_t>(count));
+    for (std::size_t i = 0; i < factors.size(); ++i) {
+        factors[i] = static_cast<std::int64_t>(i % 20) + 1;
+    }
+    return factors;
+}
+
+// One checked multiplication and one checked addition per factor, like
+// `p = p * k; k = k + 1;` in factorial.pcl.
+template<CheckedOp Mul, CheckedOp Add>
+void BM_CheckedFactorial(benchmark::State& state)
+{
+    const auto factors = factorial_factors(state.range(0));
+    for (auto _ : state) {
+        std::int64_t product = 1;
+        std::int64_t steps = 0;
+        std::int64_t overflows = 0;
+        for (const auto factor : factors) {
+            if (factor == 1) {
+                product = 1;
+            }
+            overflows += Mul(product, factor, product);
+            overflows += Add(steps, 1, steps);
+        }
+        benchmark::DoNotOptimize(product);
+        benchmark::DoNotOptimize(steps);
+        benchmark::DoNotOptimize(overflows);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+} // namespace
+
+// ast::mul_overflow and friends use __builtin_*_overflow where available;
+// ast::portable is the branchy fallback they replace.
+BENCHMARK_TEMPLATE(BM_CheckedFactorial, ast::mul_overflow, ast::add_overflow)
+    ->Name("BM_CheckedFactorial/builtin")
+    ->Arg(1 << 16);
+BENCHMARK_TEMPLATE(BM_CheckedFactorial,
+                   ast::portable::mul_overflow,
+                   ast::portable::add_overflow)
+    ->Name("BM_CheckedFactorial/portable")
+    ->Arg(1 << 16);
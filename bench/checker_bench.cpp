@@ -0,0 +1,35 @@
+#include "workloads.hpp"
+
+#include "Visitors/SemanticChecker.hpp"
+
+namespace {
+
+void BM_SemanticChecker(benchmark::State& state, bench::workload kind)
+{
+    const auto program = bench::make_program(kind, state.range(0));
+    auto tree = bench::parse_program(program.source);
+    const auto nodes = bench::count_nodes(tree.root());
+
+    for (auto _ : state) {
+        ast::SemanticChecker checker;
+        checker.check(tree.root());
+        if (checker.hasErrors()) {
+            state.SkipWithError("generated program has semantic errors");
+            break;
+        }
+        benchmark::DoNotOptimize(checker.frameSize());
+    }
+
+    state.SetItemsProcessed(state.iterations() * nodes);
+}
+
+} // namespace
+
+BENCHMARK_CAPTURE(BM_SemanticChecker,
+                  deep_expression,
+                  bench::workload::deep_expression)
+    ->Apply(bench::sizes<bench::workload::deep_expression>);
+BENCHMARK_CAPTURE(BM_SemanticChecker,
+                  statement_list,
+                  bench::workload::statement_list)
+    ->Apply(bench::sizes<bench::workload::statement_list>);
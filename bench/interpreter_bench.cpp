@@ -0,0 +1,90 @@
+#include "workloads.hpp"
+
+#include "Bytecode/BytecodeCompiler.hpp"
+#include "Bytecode/VM.hpp"
+#include "Visitors/Interpreter.hpp"
+#include "Visitors/SemanticChecker.hpp"
+
+#include <sstream>
+
+namespace {
+
+// Parsing and checking happen once up front; only execution is timed.
+void BM_Interpreter(benchmark::State& state, bench::workload kind)
+{
+    const auto program = bench::make_program(kind, state.range(0));
+    auto tree = bench::parse_program(program.source);
+    ast::SemanticChecker checker;
+    checker.check(tree.root());
+    std::istringstream input;
+    bench::DiscardCout discard;
+
+    for (auto _ : state) {
+        input.clear();
+        input.str(program.input);
+        auto interpreter = checker.hasFrameLayout()
+                               ? ast::Interpreter(checker.frameSize())
+                               : ast::Interpreter();
+        interpreter.output().set_mode(ast::OutputSink::buffering::block);
+        interpreter.input() = ast::InputSource(input);
+        tree.root()->accept(interpreter);
+    }
+
+    state.SetItemsProcessed(state.iterations() * program.work);
+}
+
+// Same workloads on the bytecode VM that paracl-cli runs by default.
+void BM_VM(benchmark::State& state, bench::workload kind, bool jit = false)
+{
+    const auto program = bench::make_program(kind, state.range(0));
+    auto tree = bench::parse_program(program.source);
+    ast::SemanticChecker checker;
+    checker.check(tree.root());
+    ast::bytecode::BytecodeCompiler compiler;
+    const auto bytecode = compiler.compile(*tree.root());
+    std::istringstream input;
+    bench::DiscardCout discard;
+
+    for (auto _ : state) {
+        input.clear();
+        input.str(program.input);
+        ast::bytecode::VM vm(bytecode);
+        if (jit) {
+            vm.enable_jit();
+        }
+        vm.output().set_mode(ast::OutputSink::buffering::block);
+        vm.input() = ast::InputSource(input);
+        vm.run();
+    }
+
+    state.SetItemsProcessed(state.iterations() * program.work);
+}
+
+// The VM with hot loops compiled by paracl-cli --jit.
+void BM_VMJit(benchmark::State& state, bench::workload kind)
+{
+    BM_VM(state, kind, true);
+}
+
+} // namespace
+
+#define PARACL_RUNTIME_BENCH(fn, kind)                                         \
+    BENCHMARK_CAPTURE(fn, kind, bench::workload::kind)                         \
+        ->Apply(bench::sizes<bench::workload::kind>)
+
+PARACL_RUNTIME_BENCH(BM_Interpreter, deep_expression);
+PARACL_RUNTIME_BENCH(BM_Interpreter, statement_list);
+PARACL_RUNTIME_BENCH(BM_Interpreter, nested_loops);
+PARACL_RUNTIME_BENCH(BM_Interpreter, multiply_loop);
+PARACL_RUNTIME_BENCH(BM_Interpreter, print_heavy);
+PARACL_RUNTIME_BENCH(BM_Interpreter, input_heavy);
+
+PARACL_RUNTIME_BENCH(BM_VM, deep_expression);
+PARACL_RUNTIME_BENCH(BM_VM, statement_list);
+PARACL_RUNTIME_BENCH(BM_VM, nested_loops);
+PARACL_RUNTIME_BENCH(BM_VM, multiply_loop);
+PARACL_RUNTIME_BENCH(BM_VM, print_heavy);
+PARACL_RUNTIME_BENCH(BM_VM, input_heavy);
+
+PARACL_RUNTIME_BENCH(BM_VMJit, nested_loops);
+PARACL_RUNTIME_BENCH(BM_VMJit, print_heavy);
@@ -0,0 +1,60 @@
+#include "workloads.hpp"
+
+#include "driver/buffer_lexer.hpp"
+#include "driver/scanner.hpp"
+#include "grammar.tab.hh"
+
+#include <sstream>
+
+namespace {
+
+void BM_Lexer(benchmark::State& state, bench::workload kind)
+{
+    const auto program = bench::make_program(kind, state.range(0));
+    std::istringstream input;
+    std::int64_t tokens = 0;
+
+    for (auto _ : state) {
+        input.clear();
+        input.str(program.source);
+        yy::Scanner lexer(&input);
+        while (lexer.yylex() != 0)
+            ++tokens;
+    }
+
+    state.SetBytesProcessed(state.iterations() *
+                            static_cast<std::int64_t>(program.source.size()));
+    state.SetItemsProcessed(tokens);
+}
+
+void BM_BufferLexer(benchmark::State& state, bench::workload kind)
+{
+    const auto program = bench::make_program(kind, state.range(0));
+    std::int64_t tokens = 0;
+
+    for (auto _ : state) {
+        yy::BufferLexer lexer(program.source);
+        yy::location loc;
+        while (lexer.next(loc) != 0)
+            ++tokens;
+    }
+
+    state.SetBytesProcessed(state.iterations() *
+                            static_cast<std::int64_t>(program.source.size()));
+    state.SetItemsProcessed(tokens);
+}
+
+} // namespace
+
+BENCHMARK_CAPTURE(BM_Lexer, deep_expression, bench::workload::deep_expression)
+    ->Apply(bench::sizes<bench::workload::deep_expression>);
+BENCHMARK_CAPTURE(BM_Lexer, statement_list, bench::workload::statement_list)
+    ->Apply(bench::sizes<bench::workload::statement_list>);
+BENCHMARK_CAPTURE(BM_BufferLexer,
+                  deep_expression,
+                  bench::workload::deep_expression)
+    ->Apply(bench::sizes<bench::workload::deep_expression>);
+BENCHMARK_CAPTURE(BM_BufferLexer,
+                  statement_list,
+                  bench::workload::statement_list)
+    ->Apply(bench::sizes<bench::workload::statement_list>);
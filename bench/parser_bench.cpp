@@ -0,0 +1,71 @@
+#include "workloads.hpp"
+
+#include "driver/driver.hpp"
+#include "driver/scanner.hpp"
+
+#include <sstream>
+#include <string_view>
+
+namespace {
+
+// Lexing is included: the parser pulls tokens from the scanner on demand.
+void BM_Parser(benchmark::State& state, bench::workload kind)
+{
+    const auto program = bench::make_program(kind, state.range(0));
+    std::istringstream input;
+    std::int64_t nodes = 0;
+
+    for (auto _ : state) {
+        input.clear();
+        input.str(program.source);
+        yy::Scanner lexer(&input);
+        yy::NumDriver driver(&lexer, "bench.pcl");
+        if (!driver.parse()) {
+            state.SkipWithError("generated program does not parse");
+            break;
+        }
+        auto tree = driver.take_ast();
+        benchmark::DoNotOptimize(tree.root());
+        nodes = bench::count_nodes(tree.root());
+    }
+
+    state.SetBytesProcessed(state.iterations() *
+                            static_cast<std::int64_t>(program.source.size()));
+    state.SetItemsProcessed(state.iterations() * nodes);
+}
+
+void BM_BufferParser(benchmark::State& state, bench::workload kind)
+{
+    const auto program = bench::make_program(kind, state.range(0));
+    std::int64_t nodes = 0;
+
+    for (auto _ : state) {
+        yy::NumDriver driver(std::string_view(program.source), "bench.pcl");
+        if (!driver.parse()) {
+            state.SkipWithError("generated program does not parse");
+            break;
+        }
+        auto tree = driver.take_ast();
+        benchmark::DoNotOptimize(tree.root());
+        nodes = bench::count_nodes(tree.root());
+    }
+
+    state.SetBytesProcessed(state.iterations() *
+                            static_cast<std::int64_t>(program.source.size()));
+    state.SetItemsProcessed(state.iterations() * nodes);
+}
+
+} // namespace
+
+BENCHMARK_CAPTURE(BM_Parser, deep_expression, bench::workload::deep_expression)
+    ->Apply(bench::sizes<bench::workload::deep_expression>);
+BENCHMARK_CAPTURE(BM_Parser, statement_list, bench::workload::statement_list)
+    ->Apply(bench::sizes<bench::workload::statement_list>);
+BENCHMARK_CAPTURE(BM_BufferParser,
+                  deep_expression,
+                  bench::workload::deep_expression)
+    ->Apply(bench::sizes<bench::workload::deep_expression>);
+BENCHMARK_CAPTURE(BM_BufferParser,
+                  statement_list,
+                  bench::workload::statement_list)
+    ->Apply(bench::sizes<bench::workload::statement_list>);
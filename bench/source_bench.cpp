@@ -0,0 +1,97 @@
+#include "workloads.hpp"
+
+#include "driver/buffer_lexer.hpp"
+#include "driver/source_file.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+#include <unistd.h>
+
+namespace {
+
+// The generated program, written to a temporary file for the lifetime of
+// one benchmark run.
+class SourceOnDisk
+{
+public:
+    explicit SourceOnDisk(const std::string& text)
+      : path_(std::filesystem::temp_directory_path() /
+              ("paracl_bench_" + std::to_string(::getpid()) + ".pcl"))
+    {
+        std::ofstream(path_, std::ios::binary) << text;
+    }
+
+    SourceOnDisk(const SourceOnDisk&) = delete;
+    SourceOnDisk& operator=(const SourceOnDisk&) = delete;
+
+    ~SourceOnDisk()
+    {
+        std::filesystem::remove(path_);
+    }
+
+    std::string path() const
+    {
+        return path_.string();
+    }
+
+private:
+    std::filesystem::path path_;
+};
+
+std::int64_t count_tokens(std::string_view text)
+{
+    yy::BufferLexer lexer(text);
+    yy::location loc;
+    std::int64_t tokens = 0;
+    while (lexer.next(loc) != 0)
+        ++tokens;
+    return tokens;
+}
+
+// Loading plus one lexer pass, so a lazily faulted mapping pays for its
+// page faults inside the timed region.
+void BM_LoadIfstream(benchmark::State& state)
+{
+    const auto program =
+        bench::make_program(bench::workload::statement_list, state.range(0));
+    const SourceOnDisk file(program.source);
+
+    for (auto _ : state) {
+        std::ifstream input(file.path(), std::ios::binary);
+        const std::string text(std::istreambuf_iterator<char>(input), {});
+        benchmark::DoNotOptimize(count_tokens(text));
+    }
+
+    state.SetBytesProcessed(state.iterations() *
+                            static_cast<std::int64_t>(program.source.size()));
+}
+
+void BM_LoadSourceFile(benchmark::State& state)
+{
+    const auto program =
+        bench::make_program(bench::workload::statement_list, state.range(0));
+    const SourceOnDisk file(program.source);
+
+    for (auto _ : state) {
+        const auto source = yy::SourceFile::open(file.path());
+        if (!source) {
+            state.SkipWithError("cannot open the generated program");
+            break;
+        }
+        benchmark::DoNotOptimize(count_tokens(source->text()));
+    }
+
+    state.SetBytesProcessed(state.iterations() *
+                            static_cast<std::int64_t>(program.source.size()));
+}
+
+} // namespace
+
+BENCHMARK(BM_LoadIfstream)
+    ->Apply(bench::sizes<bench::workload::statement_list>);
+BENCHMARK(BM_LoadSourceFile)
+    ->Apply(bench::sizes<bench::workload::statement_list>);
@@ -0,0 +1,205 @@
+#include "workloads.hpp"
+
+#include "driver/driver.hpp"
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+namespace bench {
+
+namespace {
+
+constexpr int kStatementVars = 16;
+
+std::string var(std::int64_t index)
+{
+    return "v" + std::to_string(index % kStatementVars);
+}
+
+Program deep_expression(std::int64_t depth)
+{
+    // x + (x - (x ^ (x + ( ... 1)))): stays small, so it never overflows.
+    static constexpr char kOps[] = { '+', '-', '^' };
+    Program program;
+    program.source = "x = 1;\ny = ";
+    for (std::int64_t i = 0; i < depth; ++i) {
+        program.source += "(x ";
+        program.source += kOps[i % 3];
+        program.source += ' ';
+    }
+    program.source += '1';
+    program.source.append(static_cast<std::size_t>(depth), ')');
+    program.source += ";\nprint y;\n";
+    program.work = depth;
+    return program;
+}
+
+Program statement_list(std::int64_t count)
+{
+    Program program;
+    for (int i = 0; i < kStatementVars; ++i)
+        program.source += var(i) + " = " + std::to_string(i) + ";\n";
+    for (std::int64_t i = 0; i < count; ++i) {
+        program.source += var(i) + " = (" + var(i + 5) + " + " +
+                          std::to_string(i) + ") % 1000 - " + var(i + 11) +
+                          " / 3;\n";
+    }
+    program.source += "print v0;\n";
+    program.work = count;
+    return program;
+}
+
+Program nested_loops(std::int64_t bound)
+{
+    const auto n = std::to_string(bound);
+    Program program;
+    program.source = "s = 0;\n"
+                     "i = 0;\n"
+                     "while (i < " + n + ") {\n"
+                     "    j = 0;\n"
+                     "    while (j < " + n + ") {\n"
+                     "        s = (s + i * j) % 1000003;\n"
+                     "        j = j + 1;\n"
+                     "    }\n"
+                     "    i = i + 1;\n"
+                     "}\n"
+                     "print s;\n";
+    program.work = bound * bound;
+    return program;
+}
+
+Program multiply_loop(std::int64_t count)
+{
+    // factorial.pcl, restarted before the product leaves int64_t.
+    Program program;
+    program.source = "p = 1;\n"
+                     "k = 1;\n"
+                     "i = 0;\n"
+                     "while (i < " + std::to_string(count) + ") {\n"
+                     "    p = p * k;\n"
+                     "    k = k + 1;\n"
+                     "    if (k > 20) {\n"
+                     "        p = 1;\n"
+                     "        k = 1;\n"
+                     "    }\n"
+                     "    i = i + 1;\n"
+                     "}\n"
+                     "print p;\n";
+    program.work = count;
+    return program;
+}
+
+Program print_heavy(std::int64_t count)
+{
+    Program program;
+    program.source = "i = 0;\n"
+                     "while (i < " + std::to_string(count) + ") {\n"
+                     "    print i;\n"
+                     "    i = i + 1;\n"
+                     "}\n";
+    program.work = count;
+    return program;
+}
+
+Program input_heavy(std::int64_t count)
+{
+    Program program;
+    program.source = "s = 0;\n"
+                     "i = 0;\n"
+                     "while (i < " + std::to_string(count) + ") {\n"
+                     "    s = s + ?;\n"
+                     "    i = i + 1;\n"
+                     "}\n"
+                     "print s;\n";
+    for (std::int64_t i = 0; i < count; ++i)
+        program.input += std::to_string(i % 1000) + '\n';
+    program.work = count;
+    return program;
+}
+
+std::int64_t scale()
+{
+    static const std::int64_t value = [] {
+        const char* env = std::getenv("PARACL_BENCH_SCALE");
+        const auto parsed = env != nullptr ? std::atoll(env) : 1;
+        return parsed > 0 ? static_cast<std::int64_t>(parsed) : 1;
+    }();
+    return value;
+}
+
+} // namespace
+
+Program make_program(workload kind, std::int64_t size)
+{
+    switch (kind) {
+    case workload::deep_expression:
+        return deep_expression(size);
+    case workload::statement_list:
+        return statement_list(size);
+    case workload::nested_loops:
+        return nested_loops(size);
+    case workload::multiply_loop:
+        return multiply_loop(size);
+    case workload::print_heavy:
+        return print_heavy(size);
+    case workload::input_heavy:
+        return input_heavy(size);
+    }
+    return {};
+}
+
+ast::AST parse_program(const std::string& source)
+{
+    std::istringstream input(source);
+    yy::NumDriver driver(input, "bench.pcl");
+    if (!driver.parse() || driver.has_errors()) {
+        std::cerr << "paracl_bench: generated program does not parse\n";
+        std::abort();
+    }
+    return driver.take_ast();
+}
+
+std::int64_t count_nodes(const ast::BaseNode* node)
+{
+    if (node == nullptr)
+        return 0;
+    std::int64_t count = 1;
+    for (const auto& child : node->children())
+        count += count_nodes(child.get());
+    return count;
+}
+
+void apply_sizes(benchmark::internal::Benchmark* bench, workload kind)
+{
+    std::int64_t lo = 0;
+    std::int64_t hi = 0;
+    int multiplier = 8;
+    switch (kind) {
+    case workload::deep_expression:
+        lo = 64;
+        hi = 4096;
+        multiplier = 4;
+        break;
+    case workload::statement_list:
+        lo = 1 << 10;
+        hi = 1 << 16;
+        break;
+    case workload::nested_loops:
+        lo = 32;
+        hi = 512;
+        multiplier = 4;
+        break;
+    case workload::multiply_loop:
+    case workload::print_heavy:
+    case workload::input_heavy:
+        lo = 1 << 10;
+        hi = 1 << 18;
+        break;
+    }
+    bench->RangeMultiplier(multiplier)
+        ->Range(lo, hi * scale())
+        ->Unit(benchmark::kMicrosecond);
+}
+
+} // namespace bench
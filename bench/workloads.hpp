@@ -0,0 +1,89 @@
+#ifndef BENCH_WORKLOADS_HPP
+#define BENCH_WORKLOADS_HPP
+
+#include "AST/AST.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <streambuf>
+#include <string>
+
+namespace bench {
+
+// Shapes of generated programs. The first two grow the source text with the
+// size argument and are used for the front-end phases; the rest keep the
+// source small and grow the amount of work done at run time.
+enum class workload
+{
+    deep_expression, // one assignment nested `size` parentheses deep
+    statement_list,  // `size` independent assignment statements
+    nested_loops,    // two while loops of `size` iterations each
+    multiply_loop,   // `size` checked multiplications, factorial.pcl style
+    print_heavy,     // `size` print calls
+    input_heavy      // `size` reads of `?`
+};
+
+struct Program
+{
+    std::string source;
+    std::string input;
+    // Statements, loop iterations or I/O calls the program performs; used
+    // for the items/s counter of the run-time phases.
+    std::int64_t work = 0;
+};
+
+Program make_program(workload kind, std::int64_t size);
+
+// Parses `source`, aborting the benchmark run on a syntax error.
+ast::AST parse_program(const std::string& source);
+
+std::int64_t count_nodes(const ast::BaseNode* node);
+
+// Size arguments for a workload. PARACL_BENCH_SCALE=<n> multiplies the
+// largest size, so longer runs need no rebuild.
+void apply_sizes(benchmark::internal::Benchmark* bench, workload kind);
+
+template<workload Kind>
+void sizes(benchmark::internal::Benchmark* bench)
+{
+    apply_sizes(bench, Kind);
+}
+
+// Swallows everything printed to std::cout while alive.
+class DiscardCout
+{
+public:
+    DiscardCout()
+      : old_(std::cout.rdbuf(&sink_))
+    {}
+    DiscardCout(const DiscardCout&) = delete;
+    DiscardCout& operator=(const DiscardCout&) = delete;
+    ~DiscardCout()
+    {
+        std::cout.rdbuf(old_);
+    }
+
+private:
+    class NullBuffer : public std::streambuf
+    {
+    protected:
+        int_type overflow(int_type c) override
+        {
+            return traits_type::not_eof(c);
+        }
+        std::streamsize xsputn(const char*, std::streamsize count) override
+        {
+            return count;
+        }
+    };
+
+    NullBuffer sink_;
+    std::streambuf* old_;
+};
+
+} // namespace bench
+
+#endif // BENCH_WORKLOADS_HPP
@@ -0,0 +1,45 @@
+# paracl_add_executable(<name> <source.pcl> [OPTIMIZE] [PARACL <path>])
+#
+# Translates a ParaCL program to C with `paracl-cli --emit-c` and builds it
+# with the C compiler into the executable target <name>. The program is
+# translated again whenever the source or the translator changes.
+#
+#   OPTIMIZE  run the translator with -O1 (constant folding)
+#   PARACL    translator to use; defaults to the paracl_cli target when it
+#             is part of the build, and to paracl-cli from PATH otherwise
+function(paracl_add_executable name source)
+    cmake_parse_arguments(PARSE_ARGV 2 ARG "OPTIMIZE" "PARACL" "")
+    if(ARG_UNPARSED_ARGUMENTS)
+        message(FATAL_ERROR "paracl_add_executable: unknown arguments "
+                            "${ARG_UNPARSED_ARGUMENTS}")
+    endif()
+
+    set(depends "")
+    if(ARG_PARACL)
+        set(paracl "${ARG_PARACL}")
+    elseif(TARGET paracl_cli)
+        set(paracl $<TARGET_FILE:paracl_cli>)
+        set(depends paracl_cli)
+    else()
+        find_program(PARACL_CLI_EXECUTABLE paracl-cli REQUIRED)
+        set(paracl "${PARACL_CLI_EXECUTABLE}")
+    endif()
+
+    set(opt_level -O0)
+    if(ARG_OPTIMIZE)
+        set(opt_level -O1)
+    endif()
+
+    get_filename_component(source "${source}" ABSOLUTE)
+    set(c_file "${CMAKE_CURRENT_BINARY_DIR}/${name}.pcl.c")
+    add_custom_command(
+        OUTPUT "${c_file}"
+        COMMAND "${paracl}" ${opt_level} "--emit-c=${c_file}" "${source}"
+        DEPENDS "${source}" ${depends}
+        COMMENT "Translating ${source} to C"
+        VERBATIM
+    )
+
+    add_executable(${name} "${c_file}")
+    set_source_files_properties("${c_file}" PROPERTIES LANGUAGE C)
+endfunction()
@@ -1,19 +1,25 @@
 #pragma once
 
+#include "AST/NameTable.hpp"
+#include "AST/NodeArena.hpp"
 #include "AST/SourceRange.hpp"
 #include <array>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <cstdio>
-#include <deque>
+#include <limits>
 #include <memory>
+#include <new>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace ast {
 
 struct Visitor;
+class BaseNode;
 
 enum class base_node_type
 {
@@ -33,9 +39,65 @@ enum class base_node_type
     input,
     var_decl,
     err,
-    empty
+    empty,
+    array,
+    index,
+    func,
+    call,
+    return_node
 };
 
+inline const char* node_type_name(base_node_type type)
+{
+    switch (type) {
+        case base_node_type::bin_arith_op:
+            return "bin_arith_op";
+        case base_node_type::bin_logic_op:
+            return "bin_logic_op";
+        case base_node_type::unop:
+            return "unop";
+        case base_node_type::scope:
+            return "scope";
+        case base_node_type::value:
+            return "value";
+        case base_node_type::print:
+            return "print";
+        case base_node_type::assign:
+            return "assign";
+        case base_node_type::var:
+            return "var";
+        case base_node_type::expr:
+            return "expr";
+        case base_node_type::if_node:
+            return "if";
+        case base_node_type::while_node:
+            return "while";
+        case base_node_type::input:
+            return "input";
+        case base_node_type::base:
+            return "base";
+        case base_node_type::var_decl:
+            return "var_decl";
+        case base_node_type::for_node:
+            return "for";
+        case base_node_type::err:
+            return "error";
+        case base_node_type::empty:
+            return "empty";
+        case base_node_type::array:
+            return "array";
+        case base_node_type::index:
+            return "index";
+        case base_node_type::func:
+            return "func";
+        case base_node_type::call:
+            return "call";
+        case base_node_type::return_node:
+            return "return";
+    }
+    return "unknown";
+}
+
 inline void ensure_child_free(bool already_set, const char* msg)
 {
     if (already_set) {
@@ -43,6 +105,98 @@ inline void ensure_child_free(bool already_set, const char* msg)
     }
 }
 
+// Flat variable frame layout assigned by SemanticChecker. Every variable
+// gets an index into the frame; every scope owner records the indices
+// allocated inside it, so they can be released when the scope is left.
+constexpr std::uint32_t kNoFrameIndex =
+    std::numeric_limits<std::uint32_t>::max();
+
+struct FrameRange
+{
+    std::uint32_t begin = 0;
+    std::uint32_t end = 0;
+};
+
+// Closed form of a counted loop, see ClosedFormLoops.
+struct LoopReduction;
+
+// Functions are numbered by SemanticChecker in definition order; every
+// call records the number of the function it resolves to.
+constexpr std::uint32_t kNoFunctionIndex =
+    std::numeric_limits<std::uint32_t>::max();
+
+// Children of a node. Every operator and statement node has at most four
+// fixed slots, which live inline in the node; only ScopeNode grows past
+// them into a heap buffer.
+class ChildList
+{
+public:
+    using NodePtr = std::unique_ptr<BaseNode>;
+    static constexpr std::size_t kInlineSlots = 4;
+
+    ChildList() = default;
+    ChildList(const ChildList&) = delete;
+    ChildList& operator=(const ChildList&) = delete;
+    ChildList(ChildList&& other) noexcept;
+    ChildList& operator=(ChildList&& other) noexcept;
+    ~ChildList();
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    NodePtr* begin()
+    {
+        return data();
+    }
+    NodePtr* end()
+    {
+        return data() + size_;
+    }
+    const NodePtr* begin() const
+    {
+        return data();
+    }
+    const NodePtr* end() const
+    {
+        return data() + size_;
+    }
+
+    NodePtr& operator[](std::size_t idx)
+    {
+        return data()[idx];
+    }
+    const NodePtr& operator[](std::size_t idx) const
+    {
+        return data()[idx];
+    }
+
+    void reserve(std::size_t capacity);
+    void push_back(NodePtr child);
+    void push_front(NodePtr child);
+    void clear();
+
+private:
+    std::array<NodePtr, kInlineSlots> inline_{};
+    std::unique_ptr<NodePtr[]> heap_;
+    std::uint32_t size_ = 0;
+    std::uint32_t capacity_ = kInlineSlots;
+
+    NodePtr* data()
+    {
+        return heap_ ? heap_.get() : inline_.data();
+    }
+    const NodePtr* data() const
+    {
+        return heap_ ? heap_.get() : inline_.data();
+    }
+};
+
 class BaseNode
 {
 public:
@@ -50,10 +204,14 @@ public:
 
 private:
     base_node_type node_type_ = base_node_type::base;
+    bool in_arena_ = false;
     BaseNode* parent_ = nullptr;
-    std::deque<NodePtr> children_{};
+    ChildList children_{};
     SourceRange loc_;
 
+    template<typename NodeT, typename... Args>
+    friend std::unique_ptr<NodeT> make_node(NodeArena* arena, Args&&... args);
+
 protected:
     void set_child_parent(BaseNode* child)
     {
@@ -114,6 +272,36 @@ public:
     }
     virtual ~BaseNode() = default;
 
+    static void* operator new(std::size_t size)
+    {
+        return ::operator new(size);
+    }
+    static void* operator new(std::size_t size, NodeArena& arena)
+    {
+        return arena.allocate(size, alignof(std::max_align_t));
+    }
+    static void operator delete(void* ptr) noexcept
+    {
+        ::operator delete(ptr);
+    }
+    static void operator delete(void*, NodeArena&) noexcept
+    {
+    }
+    // Arena nodes only run their destructor; the arena owns the memory.
+    static void operator delete(BaseNode* node, std::destroying_delete_t)
+    {
+        const bool in_arena = node->in_arena_;
+        node->~BaseNode();
+        if (!in_arena) {
+            ::operator delete(node);
+        }
+    }
+
+    bool in_arena() const
+    {
+        return in_arena_;
+    }
+
     base_node_type node_type() const
     {
         return node_type_;
@@ -145,11 +333,11 @@ public:
         children_.push_front(std::move(child));
     }
 
-    const std::deque<NodePtr>& children() const
+    const ChildList& children() const
     {
         return children_;
     }
-    std::deque<NodePtr>& children()
+    ChildList& children()
     {
         return children_;
     }
@@ -465,20 +653,31 @@ public:
     }
 };
 
+// What a variable holds; set by SemanticChecker.
+enum class value_kind
+{
+    scalar,
+    array,
+};
+
 class VarNode : public BaseNode
 {
-    std::string name_;
+    Name name_;
+    std::uint32_t frame_index_ = kNoFrameIndex;
+    value_kind kind_ = value_kind::scalar;
 
 public:
-    explicit VarNode(std::string name)
+    explicit VarNode(Name name)
       : BaseNode(base_node_type::var)
-      , name_(std::move(name))
+      , name_(name)
     {
     }
 
     VarNode(const VarNode& other)
       : BaseNode(other)
       , name_(other.name_)
+      , frame_index_(other.frame_index_)
+      , kind_(other.kind_)
     {
     }
 
@@ -488,16 +687,37 @@ public:
             return *this;
         BaseNode::operator=(other);
         name_ = other.name_;
+        frame_index_ = other.frame_index_;
+        kind_ = other.kind_;
         return *this;
     }
 
     VarNode(VarNode&& other) noexcept = default;
     VarNode& operator=(VarNode&& other) noexcept = default;
 
-    const std::string& name() const
+    Name name() const
     {
         return name_;
     }
+
+    std::uint32_t frame_index() const
+    {
+        return frame_index_;
+    }
+    void set_frame_index(std::uint32_t index)
+    {
+        frame_index_ = index;
+    }
+
+    value_kind kind() const
+    {
+        return kind_;
+    }
+    void set_kind(value_kind kind)
+    {
+        kind_ = kind;
+    }
+
     void accept(Visitor& v) override;
     NodePtr clone() const override
     {
@@ -517,6 +737,8 @@ class IfNode : public BaseNode
     constexpr static size_t kInvalidIdx = std::numeric_limits<size_t>::max();
     std::array<size_t, 3> slot_idx = { kInvalidIdx, kInvalidIdx, kInvalidIdx };
 
+    FrameRange frame_range_;
+
 public:
     IfNode()
       : BaseNode(base_node_type::if_node)
@@ -535,6 +757,7 @@ public:
 
     IfNode(const IfNode& other)
       : BaseNode(other)
+      , frame_range_(other.frame_range_)
     {
         // slot_idx.fill(kInvalidIdx);
         if (other.get_slot(Slot::condition)) {
@@ -555,6 +778,7 @@ public:
         if (this == &other)
             return *this;
         BaseNode::operator=(other);
+        frame_range_ = other.frame_range_;
         slot_idx.fill(kInvalidIdx);
         if (other.get_slot(Slot::condition)) {
             set_slot(other.get_slot(Slot::condition)->clone(), Slot::condition);
@@ -576,6 +800,7 @@ public:
         if (this == &other)
             return *this;
         slot_idx = other.slot_idx;
+        frame_range_ = other.frame_range_;
         other.slot_idx.fill(kInvalidIdx);
         BaseNode::operator=(std::move(other));
         return *this;
@@ -624,6 +849,15 @@ public:
         return get_slot(Slot::else_branch);
     }
 
+    const FrameRange& frame_range() const
+    {
+        return frame_range_;
+    }
+    void set_frame_range(const FrameRange& range)
+    {
+        frame_range_ = range;
+    }
+
     void accept(Visitor& v) override;
     NodePtr clone() const override
     {
@@ -674,6 +908,9 @@ class WhileNode : public BaseNode
     constexpr static size_t kInvalidIdx = std::numeric_limits<size_t>::max();
     std::array<size_t, 2> slot_idx = { kInvalidIdx, kInvalidIdx };
 
+    FrameRange frame_range_;
+    std::shared_ptr<const LoopReduction> reduction_;
+
 public:
     WhileNode()
       : BaseNode(base_node_type::while_node)
@@ -689,6 +926,8 @@ public:
 
     WhileNode(const WhileNode& other)
       : BaseNode(other)
+      , frame_range_(other.frame_range_)
+      , reduction_(other.reduction_)
     {
         slot_idx.fill(kInvalidIdx);
         if (other.get_slot(Slot::condition)) {
@@ -704,6 +943,8 @@ public:
         if (this == &other)
             return *this;
         BaseNode::operator=(other);
+        frame_range_ = other.frame_range_;
+        reduction_ = other.reduction_;
         slot_idx.fill(kInvalidIdx);
         if (other.get_slot(Slot::condition)) {
             set_slot(other.get_slot(Slot::condition)->clone(), Slot::condition);
@@ -720,6 +961,8 @@ public:
         if (this == &other)
             return *this;
         slot_idx = other.slot_idx;
+        frame_range_ = other.frame_range_;
+        reduction_ = std::move(other.reduction_);
         other.slot_idx.fill(kInvalidIdx);
         BaseNode::operator=(std::move(other));
         return *this;
@@ -754,6 +997,25 @@ public:
         return get_slot(Slot::body);
     }
 
+    const FrameRange& frame_range() const
+    {
+        return frame_range_;
+    }
+    void set_frame_range(const FrameRange& range)
+    {
+        frame_range_ = range;
+    }
+
+    // Set by ClosedFormLoops when the loop can be run without iterating.
+    const LoopReduction* reduction() const
+    {
+        return reduction_.get();
+    }
+    void set_reduction(std::shared_ptr<const LoopReduction> reduction)
+    {
+        reduction_ = std::move(reduction);
+    }
+
     void accept(Visitor& v) override;
     NodePtr clone() const override
     {
@@ -809,6 +1071,9 @@ class ForNode : public BaseNode
                                        kInvalidIdx,
                                        kInvalidIdx };
 
+    FrameRange frame_range_;
+    std::shared_ptr<const LoopReduction> reduction_;
+
 public:
     ForNode()
       : BaseNode(base_node_type::for_node)
@@ -829,6 +1094,8 @@ public:
 
     ForNode(const ForNode& other)
       : BaseNode(other)
+      , frame_range_(other.frame_range_)
+      , reduction_(other.reduction_)
     {
         slot_idx.fill(kInvalidIdx);
 
@@ -847,6 +1114,8 @@ public:
         if (this == &other)
             return *this;
         BaseNode::operator=(other);
+        frame_range_ = other.frame_range_;
+        reduction_ = other.reduction_;
         slot_idx.fill(kInvalidIdx);
 
         if (other.get_slot(Slot::init))
@@ -866,6 +1135,8 @@ public:
         if (this == &other)
             return *this;
         slot_idx = other.slot_idx;
+        frame_range_ = other.frame_range_;
+        reduction_ = std::move(other.reduction_);
         other.slot_idx.fill(kInvalidIdx);
         BaseNode::operator=(std::move(other));
         return *this;
@@ -905,6 +1176,25 @@ public:
         return get_slot(Slot::body);
     }
 
+    const FrameRange& frame_range() const
+    {
+        return frame_range_;
+    }
+    void set_frame_range(const FrameRange& range)
+    {
+        frame_range_ = range;
+    }
+
+    // Set by ClosedFormLoops when the loop can be run without iterating.
+    const LoopReduction* reduction() const
+    {
+        return reduction_.get();
+    }
+    void set_reduction(std::shared_ptr<const LoopReduction> reduction)
+    {
+        reduction_ = std::move(reduction);
+    }
+
     void accept(Visitor& v) override;
     NodePtr clone() const override
     {
@@ -1296,6 +1586,8 @@ public:
 
 class ScopeNode : public BaseNode
 {
+    FrameRange frame_range_;
+
 public:
     ScopeNode()
       : BaseNode(base_node_type::scope)
@@ -1312,6 +1604,7 @@ public:
 
     ScopeNode(const ScopeNode& other)
       : BaseNode(other)
+      , frame_range_(other.frame_range_)
     {
         for (const auto& child : other.children()) {
             add_child(child->clone());
@@ -1323,6 +1616,7 @@ public:
         if (this == &other)
             return *this;
         BaseNode::operator=(other);
+        frame_range_ = other.frame_range_;
         for (const auto& child : other.children()) {
             add_child(child->clone());
         }
@@ -1337,11 +1631,20 @@ public:
         add_child(std::move(statement));
     }
 
-    const std::deque<NodePtr>& statements() const
+    const ChildList& statements() const
     {
         return children();
     }
 
+    const FrameRange& frame_range() const
+    {
+        return frame_range_;
+    }
+    void set_frame_range(const FrameRange& range)
+    {
+        frame_range_ = range;
+    }
+
     void accept(Visitor& v) override;
     NodePtr clone() const override
     {
@@ -1351,13 +1654,14 @@ public:
 
 class VarDeclNode : public BaseNode
 {
-    std::string name_;
+    Name name_;
     bool is_init_set = false;
+    std::uint32_t frame_index_ = kNoFrameIndex;
 
 public:
-    explicit VarDeclNode(std::string name, NodePtr init = nullptr)
+    explicit VarDeclNode(Name name, NodePtr init = nullptr)
       : BaseNode(base_node_type::var_decl)
-      , name_(std::move(name))
+      , name_(name)
     {
         if (init != nullptr)
             set_init_expr(std::move(init));
@@ -1366,6 +1670,7 @@ public:
     VarDeclNode(const VarDeclNode& other)
       : BaseNode(other)
       , name_(other.name_)
+      , frame_index_(other.frame_index_)
     {
         const auto& child = other.init_expr();
         if (child != nullptr)
@@ -1383,6 +1688,7 @@ public:
             set_init_expr(child->clone());
         }
         name_ = other.name_;
+        frame_index_ = other.frame_index_;
         return *this;
     }
 
@@ -1414,11 +1720,20 @@ public:
         }
     }
 
-    const std::string& name() const
+    Name name() const
     {
         return name_;
     }
 
+    std::uint32_t frame_index() const
+    {
+        return frame_index_;
+    }
+    void set_frame_index(std::uint32_t index)
+    {
+        frame_index_ = index;
+    }
+
     void accept(Visitor& v) override;
     NodePtr clone() const override
     {
@@ -1488,19 +1803,501 @@ public:
     }
 };
 
+enum class array_init_type
+{
+    repeat, // repeat(value, size)
+    list,   // array(e1, e2, ...)
+};
+
+// Array constructor. A repeat node has the fill value and the size as its
+// two children, a list node has one child per element.
+class ArrayNode : public BaseNode
+{
+    array_init_type init_;
+
+public:
+    explicit ArrayNode(array_init_type init,
+                       std::vector<NodePtr> items = {})
+      : BaseNode(base_node_type::array)
+      , init_(init)
+    {
+        for (auto& item : items) {
+            add_item(std::move(item));
+        }
+    }
+
+    ArrayNode(const ArrayNode& other)
+      : BaseNode(other)
+      , init_(other.init_)
+    {
+        for (const auto& item : other.items()) {
+            add_item(item->clone());
+        }
+    }
+
+    ArrayNode& operator=(const ArrayNode& other)
+    {
+        if (this == &other)
+            return *this;
+        BaseNode::operator=(other);
+        init_ = other.init_;
+        for (const auto& item : other.items()) {
+            add_item(item->clone());
+        }
+        return *this;
+    }
+
+    ArrayNode(ArrayNode&& other) noexcept = default;
+    ArrayNode& operator=(ArrayNode&& other) noexcept = default;
+
+    void add_item(NodePtr item)
+    {
+        if (init_ == array_init_type::repeat) {
+            ensure_child_free(children().size() >= 2,
+                              "repeat takes a value and a size");
+        }
+        add_child(std::move(item));
+    }
+
+    array_init_type init() const
+    {
+        return init_;
+    }
+
+    const ChildList& items() const
+    {
+        return children();
+    }
+
+    BaseNode* fill_value()
+    {
+        if (init_ == array_init_type::repeat && children().size() > 0) {
+            return children()[0].get();
+        }
+        return nullptr;
+    }
+
+    const BaseNode* fill_value() const
+    {
+        if (init_ == array_init_type::repeat && children().size() > 0) {
+            return children()[0].get();
+        }
+        return nullptr;
+    }
+
+    BaseNode* size_expr()
+    {
+        if (init_ == array_init_type::repeat && children().size() > 1) {
+            return children()[1].get();
+        }
+        return nullptr;
+    }
+
+    const BaseNode* size_expr() const
+    {
+        if (init_ == array_init_type::repeat && children().size() > 1) {
+            return children()[1].get();
+        }
+        return nullptr;
+    }
+
+    void accept(Visitor& v) override;
+    NodePtr clone() const override
+    {
+        return std::make_unique<ArrayNode>(*this);
+    }
+};
+
+// `base[index]`, where base names an array variable.
+class IndexNode : public BaseNode
+{
+    bool is_base_set = false;
+    bool is_index_set = false;
+    // Cleared by SemanticChecker when the index is known to be in range.
+    bool bounds_checked_ = true;
+
+public:
+    explicit IndexNode(NodePtr base = nullptr, NodePtr index = nullptr)
+      : BaseNode(base_node_type::index)
+    {
+        if (base) {
+            set_base(std::move(base));
+        }
+        if (index) {
+            set_index(std::move(index));
+        }
+    }
+
+    IndexNode(const IndexNode& other)
+      : BaseNode(other)
+      , bounds_checked_(other.bounds_checked_)
+    {
+        if (other.base()) {
+            set_base(other.base()->clone());
+        }
+        if (other.index()) {
+            set_index(other.index()->clone());
+        }
+    }
+
+    IndexNode& operator=(const IndexNode& other)
+    {
+        if (this == &other)
+            return *this;
+        BaseNode::operator=(other);
+        is_base_set = false;
+        is_index_set = false;
+        bounds_checked_ = other.bounds_checked_;
+        if (other.base()) {
+            set_base(other.base()->clone());
+        }
+        if (other.index()) {
+            set_index(other.index()->clone());
+        }
+        return *this;
+    }
+
+    IndexNode(IndexNode&& other) noexcept = default;
+    IndexNode& operator=(IndexNode&& other) noexcept = default;
+
+    void set_base(NodePtr base)
+    {
+        ensure_child_free(is_base_set, "base is already set");
+        add_child(std::move(base));
+        is_base_set = true;
+    }
+
+    void set_index(NodePtr index)
+    {
+        ensure_child_free(is_index_set, "index is already set");
+        add_child(std::move(index));
+        is_index_set = true;
+    }
+
+    const BaseNode* base() const
+    {
+        if (children().size() > 0 && is_base_set) {
+            return children()[0].get();
+        }
+        return nullptr;
+    }
+
+    const BaseNode* index() const
+    {
+        if (children().size() > 1 && is_index_set) {
+            return children()[1].get();
+        }
+        return nullptr;
+    }
+
+    BaseNode* base()
+    {
+        if (children().size() > 0 && is_base_set) {
+            return children()[0].get();
+        }
+        return nullptr;
+    }
+
+    BaseNode* index()
+    {
+        if (children().size() > 1 && is_index_set) {
+            return children()[1].get();
+        }
+        return nullptr;
+    }
+
+    bool bounds_checked() const
+    {
+        return bounds_checked_;
+    }
+    void set_bounds_checked(bool checked)
+    {
+        bounds_checked_ = checked;
+    }
+
+    void accept(Visitor& v) override;
+    NodePtr clone() const override
+    {
+        return std::make_unique<IndexNode>(*this);
+    }
+};
+
+// `func name(params) { body }`. Functions are only defined at the top level
+// and run in a frame of their own: the parameters take its first
+// `params().size()` indices, the body's variables follow.
+class FuncNode : public BaseNode
+{
+    Name name_;
+    std::vector<Name> params_;
+    bool is_body_set = false;
+    std::uint32_t function_index_ = kNoFunctionIndex;
+    std::uint32_t frame_size_ = 0;
+
+public:
+    FuncNode(Name name, std::vector<Name> params, NodePtr body = nullptr)
+      : BaseNode(base_node_type::func)
+      , name_(name)
+      , params_(std::move(params))
+    {
+        if (body) {
+            set_body(std::move(body));
+        }
+    }
+
+    FuncNode(const FuncNode& other)
+      : BaseNode(other)
+      , name_(other.name_)
+      , params_(other.params_)
+      , function_index_(other.function_index_)
+      , frame_size_(other.frame_size_)
+    {
+        if (other.body()) {
+            set_body(other.body()->clone());
+        }
+    }
+
+    FuncNode& operator=(const FuncNode& other)
+    {
+        if (this == &other)
+            return *this;
+        BaseNode::operator=(other);
+        name_ = other.name_;
+        params_ = other.params_;
+        is_body_set = false;
+        function_index_ = other.function_index_;
+        frame_size_ = other.frame_size_;
+        if (other.body()) {
+            set_body(other.body()->clone());
+        }
+        return *this;
+    }
+
+    FuncNode(FuncNode&& other) noexcept = default;
+    FuncNode& operator=(FuncNode&& other) noexcept = default;
+
+    void set_body(NodePtr body)
+    {
+        ensure_child_free(is_body_set, "body is already set");
+        add_child(std::move(body));
+        is_body_set = true;
+    }
+
+    const BaseNode* body() const
+    {
+        if (is_body_set && children().size() > 0) {
+            return children()[0].get();
+        }
+        return nullptr;
+    }
+
+    BaseNode* body()
+    {
+        if (is_body_set && children().size() > 0) {
+            return children()[0].get();
+        }
+        return nullptr;
+    }
+
+    Name name() const
+    {
+        return name_;
+    }
+
+    const std::vector<Name>& params() const
+    {
+        return params_;
+    }
+
+    std::uint32_t function_index() const
+    {
+        return function_index_;
+    }
+    void set_function_index(std::uint32_t index)
+    {
+        function_index_ = index;
+    }
+
+    std::uint32_t frame_size() const
+    {
+        return frame_size_;
+    }
+    void set_frame_size(std::uint32_t size)
+    {
+        frame_size_ = size;
+    }
+
+    void accept(Visitor& v) override;
+    NodePtr clone() const override
+    {
+        return std::make_unique<FuncNode>(*this);
+    }
+};
+
+// `name(args)`. A call that is the whole value of a return statement is
+// marked as a tail call: it replaces the caller's frame instead of
+// nesting a new one.
+class CallNode : public BaseNode
+{
+    Name name_;
+    std::uint32_t function_index_ = kNoFunctionIndex;
+    bool tail_ = false;
+
+public:
+    explicit CallNode(Name name, std::vector<NodePtr> args = {})
+      : BaseNode(base_node_type::call)
+      , name_(name)
+    {
+        for (auto& arg : args) {
+            add_arg(std::move(arg));
+        }
+    }
+
+    CallNode(const CallNode& other)
+      : BaseNode(other)
+      , name_(other.name_)
+      , function_index_(other.function_index_)
+      , tail_(other.tail_)
+    {
+        for (const auto& arg : other.args()) {
+            add_arg(arg->clone());
+        }
+    }
+
+    CallNode& operator=(const CallNode& other)
+    {
+        if (this == &other)
+            return *this;
+        BaseNode::operator=(other);
+        name_ = other.name_;
+        function_index_ = other.function_index_;
+        tail_ = other.tail_;
+        for (const auto& arg : other.args()) {
+            add_arg(arg->clone());
+        }
+        return *this;
+    }
+
+    CallNode(CallNode&& other) noexcept = default;
+    CallNode& operator=(CallNode&& other) noexcept = default;
+
+    void add_arg(NodePtr arg)
+    {
+        add_child(std::move(arg));
+    }
+
+    const ChildList& args() const
+    {
+        return children();
+    }
+
+    Name name() const
+    {
+        return name_;
+    }
+
+    std::uint32_t function_index() const
+    {
+        return function_index_;
+    }
+    void set_function_index(std::uint32_t index)
+    {
+        function_index_ = index;
+    }
+
+    bool is_tail() const
+    {
+        return tail_;
+    }
+    void set_tail(bool tail)
+    {
+        tail_ = tail;
+    }
+
+    void accept(Visitor& v) override;
+    NodePtr clone() const override
+    {
+        return std::make_unique<CallNode>(*this);
+    }
+};
+
+class ReturnNode : public BaseNode
+{
+public:
+    explicit ReturnNode(NodePtr expr = nullptr)
+      : BaseNode(base_node_type::return_node)
+    {
+        if (expr) {
+            set_expr(std::move(expr));
+        }
+    }
+
+    ReturnNode(const ReturnNode& other)
+      : BaseNode(other)
+    {
+        if (other.expr()) {
+            set_expr(other.expr()->clone());
+        }
+    }
+
+    ReturnNode& operator=(const ReturnNode& other)
+    {
+        if (this == &other)
+            return *this;
+        BaseNode::operator=(other);
+        if (other.expr()) {
+            set_expr(other.expr()->clone());
+        }
+        return *this;
+    }
+
+    ReturnNode(ReturnNode&& other) noexcept = default;
+    ReturnNode& operator=(ReturnNode&& other) noexcept = default;
+
+    void set_expr(NodePtr expr)
+    {
+        ensure_child_free(children().size() != 0, "expr is already set");
+        add_child(std::move(expr));
+    }
+
+    const BaseNode* expr() const
+    {
+        if (children().size() > 0) {
+            return children()[0].get();
+        }
+        return nullptr;
+    }
+
+    BaseNode* expr()
+    {
+        if (children().size() > 0) {
+            return children()[0].get();
+        }
+        return nullptr;
+    }
+
+    void accept(Visitor& v) override;
+    NodePtr clone() const override
+    {
+        return std::make_unique<ReturnNode>(*this);
+    }
+};
+
 class AST
 {
 public:
     using NodePtr = BaseNode::NodePtr;
 
 private:
+    // Declared before root_ so arena nodes are destroyed before their memory.
+    std::shared_ptr<NodeArena> arena_{};
     NodePtr root_{};
 
 public:
     AST() = default;
 
-    explicit AST(NodePtr root)
-      : root_(std::move(root))
+    explicit AST(NodePtr root, std::shared_ptr<NodeArena> arena = nullptr)
+      : arena_(std::move(arena))
+      , root_(std::move(root))
     {
     }
 
@@ -1520,11 +2317,19 @@ public:
         } else {
             root_ = nullptr;
         }
+        arena_ = nullptr;
         return *this;
     }
 
     AST(AST&&) noexcept = default;
-    AST& operator=(AST&&) noexcept = default;
+    AST& operator=(AST&& other) noexcept
+    {
+        if (this == &other)
+            return *this;
+        root_ = std::move(other.root_);
+        arena_ = std::move(other.arena_);
+        return *this;
+    }
 
     const BaseNode* root() const
     {
@@ -1535,10 +2340,106 @@ public:
         return root_.get();
     }
 
-    void set_root(NodePtr root)
+    void set_root(NodePtr root, std::shared_ptr<NodeArena> arena = nullptr)
     {
         root_ = std::move(root);
+        arena_ = std::move(arena);
+    }
+
+    const NodeArena* arena() const
+    {
+        return arena_.get();
     }
 };
 
+inline ChildList::ChildList(ChildList&& other) noexcept
+  : heap_(std::move(other.heap_))
+  , size_(other.size_)
+  , capacity_(other.capacity_)
+{
+    if (!heap_) {
+        for (std::size_t i = 0; i < size_; ++i) {
+            inline_[i] = std::move(other.inline_[i]);
+        }
+    }
+    other.size_ = 0;
+    other.capacity_ = kInlineSlots;
+}
+
+inline ChildList& ChildList::operator=(ChildList&& other) noexcept
+{
+    if (this == &other)
+        return *this;
+    clear();
+    heap_ = std::move(other.heap_);
+    size_ = other.size_;
+    capacity_ = other.capacity_;
+    if (!heap_) {
+        for (std::size_t i = 0; i < size_; ++i) {
+            inline_[i] = std::move(other.inline_[i]);
+        }
+    }
+    other.size_ = 0;
+    other.capacity_ = kInlineSlots;
+    return *this;
+}
+
+inline ChildList::~ChildList()
+{
+    clear();
+}
+
+inline void ChildList::reserve(std::size_t capacity)
+{
+    if (capacity <= capacity_) {
+        return;
+    }
+    auto grown = std::make_unique<NodePtr[]>(capacity);
+    for (std::size_t i = 0; i < size_; ++i) {
+        grown[i] = std::move(data()[i]);
+    }
+    heap_ = std::move(grown);
+    capacity_ = static_cast<std::uint32_t>(capacity);
+}
+
+inline void ChildList::push_back(NodePtr child)
+{
+    if (size_ == capacity_) {
+        reserve(std::size_t{ capacity_ } * 2);
+    }
+    data()[size_++] = std::move(child);
+}
+
+inline void ChildList::push_front(NodePtr child)
+{
+    push_back(nullptr);
+    auto* items = data();
+    for (std::size_t i = size_ - 1; i > 0; --i) {
+        items[i] = std::move(items[i - 1]);
+    }
+    items[0] = std::move(child);
+}
+
+inline void ChildList::clear()
+{
+    for (std::size_t i = size_; i-- > 0;) {
+        data()[i].reset();
+    }
+    heap_.reset();
+    size_ = 0;
+    capacity_ = kInlineSlots;
+}
+
+// Allocates a node in `arena`, or on the heap when `arena` is null.
+template<typename NodeT, typename... Args>
+std::unique_ptr<NodeT> make_node(NodeArena* arena, Args&&... args)
+{
+    if (arena == nullptr) {
+        return std::make_unique<NodeT>(std::forward<Args>(args)...);
+    }
+    auto* node = new (*arena) NodeT(std::forward<Args>(args)...);
+    static_cast<BaseNode*>(node)->in_arena_ = true;
+    return std::unique_ptr<NodeT>(node);
+}
+
 } // namespace ast
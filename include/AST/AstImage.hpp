@@ -0,0 +1,184 @@
+#pragma once
+
+#include "AST/AST.hpp"
+#include "AST/FileTable.hpp"
+#include "AST/SourceRange.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string_view>
+
+namespace ast {
+
+// Flat binary form of a syntax tree, for shipping pre-parsed programs.
+//
+//   header   magic, format version, section sizes, checksum of the rest
+//   nodes    one fixed-size record per node, breadth first from the root
+//   params   name indices of function parameters
+//   names    offset and size of every distinct identifier in `spelling`
+//   spelling identifier bytes
+//
+// Breadth-first order puts the children of every node next to each other,
+// so a record names them with a first index and a count. Operators with
+// fixed slots (the then/else of an `if`, the init/cond/step/body of a
+// `for`, ...) also keep a bit per slot that is present. Only what the
+// parser produces is stored; SemanticChecker annotations are recomputed.
+//
+// Bump kAstImageVersion whenever a record or a node type changes meaning.
+inline constexpr std::uint32_t kAstImageVersion = 1;
+
+namespace detail {
+
+// Fields are native-endian and read with memcpy, so an image can be used
+// straight from an mmap'd file at any alignment.
+struct NodeRecord
+{
+    std::uint8_t type = 0;
+    std::uint8_t op = 0;
+    std::uint8_t slots = 0;
+    std::uint8_t has_file = 0;
+    std::uint32_t name = 0;
+    std::uint32_t first_child = 0;
+    std::uint32_t child_count = 0;
+    std::uint32_t first_param = 0;
+    std::uint32_t param_count = 0;
+    std::int64_t value = 0;
+    std::uint32_t begin_line = 0;
+    std::uint32_t begin_column = 0;
+    std::uint32_t end_line = 0;
+    std::uint32_t end_column = 0;
+};
+
+static_assert(sizeof(NodeRecord) == 48);
+
+} // namespace detail
+
+class AstImage;
+
+// One node of an AstImage. A view is two pointers wide and reads its
+// record from the image on demand; nothing is allocated while walking.
+class NodeView
+{
+public:
+    NodeView() = default;
+
+    explicit operator bool() const
+    {
+        return image_ != nullptr;
+    }
+
+    base_node_type type() const
+    {
+        return static_cast<base_node_type>(record().type);
+    }
+
+    SourceRange location() const;
+
+    // ValueNode.
+    std::int64_t value() const
+    {
+        return record().value;
+    }
+
+    // VarNode, VarDeclNode, FuncNode and CallNode.
+    std::string_view name() const;
+
+    // The operator of UnOpNode, BinArithOpNode and BinLogicOpNode, or the
+    // array_init_type of ArrayNode; cast to the node's enum.
+    template <typename Op> Op op() const
+    {
+        return static_cast<Op>(record().op);
+    }
+
+    std::size_t num_children() const
+    {
+        return record().child_count;
+    }
+
+    NodeView child(std::size_t idx) const;
+
+    // Fixed slot `idx` of the node, counting as the node class does (the
+    // else branch of an IfNode is slot 2), or a null view if it is empty.
+    NodeView slot(std::size_t idx) const;
+
+    std::size_t num_params() const
+    {
+        return record().param_count;
+    }
+
+    std::string_view param(std::size_t idx) const;
+
+private:
+    friend class AstImage;
+
+    NodeView(const AstImage* image, const char* record)
+      : image_(image)
+      , record_(record)
+    {
+    }
+
+    detail::NodeRecord record() const
+    {
+        detail::NodeRecord rec;
+        std::memcpy(&rec, record_, sizeof(rec));
+        return rec;
+    }
+
+    const AstImage* image_ = nullptr;
+    const char* record_ = nullptr;
+};
+
+// A validated view of an image written by write_ast_image. It does not own
+// the bytes, which must outlive it and every NodeView taken from it.
+class AstImage
+{
+public:
+    // Checks the header, the checksum and that the records form one tree
+    // with every index in range, so walking it afterwards needs no checks.
+    // Locations that had a file point at `file`, as file ids do not
+    // survive the process that wrote the image. Throws std::runtime_error.
+    AstImage(std::string_view image, FileTable::FileId file);
+
+    static bool is_image(std::string_view bytes);
+
+    NodeView root() const
+    {
+        return node(0);
+    }
+
+    std::size_t size() const
+    {
+        return num_nodes_;
+    }
+
+    // Rebuilds the tree as ordinary nodes in one arena, for the visitors
+    // that work on BaseNode.
+    AST build() const;
+
+private:
+    friend class NodeView;
+
+    std::string_view image_;
+    FileTable::FileId file_ = FileTable::kNoFile;
+    const char* nodes_ = nullptr;
+    const char* params_ = nullptr;
+    const char* names_ = nullptr;
+    const char* spelling_ = nullptr;
+    std::uint32_t num_nodes_ = 0;
+    std::uint32_t num_names_ = 0;
+
+    NodeView node(std::size_t idx) const
+    {
+        return NodeView(this, nodes_ + idx * sizeof(detail::NodeRecord));
+    }
+
+    std::string_view name(std::uint32_t idx) const;
+};
+
+// Writes the tree under `root`. Throws std::runtime_error if it holds a
+// node type the format does not know.
+void write_ast_image(const BaseNode& root, std::ostream& out);
+
+} // namespace ast
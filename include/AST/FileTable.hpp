@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace ast {
+
+// Process-wide table of source file names. Locations store the 32-bit id
+// and the name is only looked up when a diagnostic is printed.
+class FileTable
+{
+public:
+    using FileId = std::uint32_t;
+    static constexpr FileId kNoFile = 0;
+
+    static FileId intern(std::string_view name)
+    {
+        if (name.empty()) {
+            return kNoFile;
+        }
+
+        // The parser interns the same name for every node it builds.
+        thread_local std::string last_name;
+        thread_local FileId last_id = kNoFile;
+        if (last_id != kNoFile && name == last_name) {
+            return last_id;
+        }
+
+        auto& table = instance();
+        std::lock_guard lock(table.mutex_);
+        auto it = table.ids_.find(name);
+        if (it == table.ids_.end()) {
+            const auto& stored = table.names_.emplace_back(name);
+            const auto id = static_cast<FileId>(table.names_.size());
+            it = table.ids_.emplace(stored, id).first;
+        }
+        last_name = name;
+        last_id = it->second;
+        return last_id;
+    }
+
+    static std::string_view name(FileId id)
+    {
+        if (id == kNoFile) {
+            return {};
+        }
+        auto& table = instance();
+        std::lock_guard lock(table.mutex_);
+        return table.names_.at(id - 1);
+    }
+
+private:
+    std::mutex mutex_;
+    std::deque<std::string> names_;
+    std::unordered_map<std::string_view, FileId> ids_;
+
+    static FileTable& instance()
+    {
+        static FileTable table;
+        return table;
+    }
+};
+
+} // namespace ast
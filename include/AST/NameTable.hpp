@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace ast {
+
+// Process-wide table of identifier spellings. The lexer interns every name
+// it scans, and from then on nodes, the checker and the interpreters
+// compare and hash the 32-bit id; the spelling is only looked up for
+// diagnostics and dumps. Spellings live until the process exits.
+class NameTable
+{
+public:
+    using NameId = std::uint32_t;
+    static constexpr NameId kNoName = 0;
+
+    static NameId intern(std::string_view name)
+    {
+        if (name.empty()) {
+            return kNoName;
+        }
+
+        // Keys point into names_, which never moves its strings, so a
+        // thread that has seen a name once finds it again without locking.
+        thread_local std::unordered_map<std::string_view, NameId> seen;
+        if (const auto hit = seen.find(name); hit != seen.end()) {
+            return hit->second;
+        }
+
+        auto& table = instance();
+        std::lock_guard lock(table.mutex_);
+        auto it = table.ids_.find(name);
+        if (it == table.ids_.end()) {
+            const auto& stored = table.names_.emplace_back(name);
+            const auto id = static_cast<NameId>(table.names_.size());
+            it = table.ids_.emplace(stored, id).first;
+        }
+        seen.emplace(it->first, it->second);
+        return it->second;
+    }
+
+    static std::string_view name(NameId id)
+    {
+        if (id == kNoName) {
+            return {};
+        }
+        auto& table = instance();
+        std::lock_guard lock(table.mutex_);
+        return table.names_.at(id - 1);
+    }
+
+private:
+    std::mutex mutex_;
+    std::deque<std::string> names_;
+    std::unordered_map<std::string_view, NameId> ids_;
+
+    static NameTable& instance()
+    {
+        static NameTable table;
+        return table;
+    }
+};
+
+// An interned identifier: equality and hashing are on the id. Converts
+// implicitly from a spelling so nodes can still be built from literals.
+class Name
+{
+public:
+    Name() = default;
+
+    Name(std::string_view spelling)
+      : id_(NameTable::intern(spelling))
+    {
+    }
+
+    Name(const std::string& spelling)
+      : Name(std::string_view(spelling))
+    {
+    }
+
+    Name(const char* spelling)
+      : Name(std::string_view(spelling))
+    {
+    }
+
+    NameTable::NameId id() const
+    {
+        return id_;
+    }
+
+    std::string_view view() const
+    {
+        return NameTable::name(id_);
+    }
+
+    std::string str() const
+    {
+        return std::string(view());
+    }
+
+    friend bool operator==(Name lhs, Name rhs)
+    {
+        return lhs.id_ == rhs.id_;
+    }
+
+    friend bool operator<(Name lhs, Name rhs)
+    {
+        return lhs.id_ < rhs.id_;
+    }
+
+    friend std::ostream& operator<<(std::ostream& out, Name name)
+    {
+        return out << name.view();
+    }
+
+private:
+    NameTable::NameId id_ = NameTable::kNoName;
+};
+
+} // namespace ast
+
+template<>
+struct std::hash<ast::Name>
+{
+    std::size_t operator()(ast::Name name) const noexcept
+    {
+        return name.id();
+    }
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ast {
+
+// Bump allocator for AST nodes. Nodes placed here are still destroyed one
+// by one through their owning NodePtr, but their memory is only returned
+// when the arena itself goes away, so the arena must outlive every node
+// allocated from it (ast::AST keeps it alive next to the root).
+class NodeArena
+{
+    static constexpr std::size_t kBlockSize = 64 * 1024;
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks_;
+    std::byte* cur_ = nullptr;
+    std::size_t left_ = 0;
+    std::size_t bytes_used_ = 0;
+    std::size_t bytes_reserved_ = 0;
+
+public:
+    NodeArena() = default;
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+
+    void* allocate(std::size_t size,
+                   std::size_t align = alignof(std::max_align_t))
+    {
+        const auto padding =
+            (align - reinterpret_cast<std::uintptr_t>(cur_) % align) % align;
+        if (cur_ == nullptr || padding + size > left_) {
+            const auto block = std::max(kBlockSize, size + align);
+            blocks_.push_back(std::make_unique_for_overwrite<std::byte[]>(block));
+            cur_ = blocks_.back().get();
+            left_ = block;
+            bytes_reserved_ += block;
+            return allocate(size, align);
+        }
+
+        std::byte* result = cur_ + padding;
+        cur_ = result + size;
+        left_ -= padding + size;
+        bytes_used_ += size;
+        return result;
+    }
+
+    std::size_t bytes_used() const
+    {
+        return bytes_used_;
+    }
+
+    std::size_t bytes_reserved() const
+    {
+        return bytes_reserved_;
+    }
+};
+
+} // namespace ast
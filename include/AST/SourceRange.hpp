@@ -1,5 +1,7 @@
 #pragma once
 
+#include "AST/FileTable.hpp"
+
 #include <cstdint>
 #include <limits>
 #include <string>
@@ -8,14 +10,14 @@ namespace ast {
 
 struct SourceRange
 {
-    std::string file;
+    FileTable::FileId file = FileTable::kNoFile;
 
-    static constexpr std::uint64_t kInvalidPos =
-        std::numeric_limits<std::uint64_t>::max();
-    std::uint64_t begin_line = kInvalidPos;
-    std::uint64_t begin_column = kInvalidPos;
-    std::uint64_t end_line = kInvalidPos;
-    std::uint64_t end_column = kInvalidPos;
+    static constexpr std::uint32_t kInvalidPos =
+        std::numeric_limits<std::uint32_t>::max();
+    std::uint32_t begin_line = kInvalidPos;
+    std::uint32_t begin_column = kInvalidPos;
+    std::uint32_t end_line = kInvalidPos;
+    std::uint32_t end_column = kInvalidPos;
 
     bool has_valid_point() const
     {
@@ -24,7 +26,12 @@ struct SourceRange
 
     bool has_gcc_location() const
     {
-        return !file.empty() && has_valid_point();
+        return file != FileTable::kNoFile && has_valid_point();
+    }
+
+    std::string file_name() const
+    {
+        return std::string(FileTable::name(file));
     }
 
     std::string make_string() const
@@ -32,9 +39,11 @@ struct SourceRange
         if (!has_gcc_location()) {
             return "";
         }
-        return file + ":" + std::to_string(begin_line) + ":" +
+        return file_name() + ":" + std::to_string(begin_line) + ":" +
                std::to_string(begin_column);
     }
 };
 
+static_assert(sizeof(SourceRange) == 20);
+
 } // namespace ast
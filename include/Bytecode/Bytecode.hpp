@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AST/SourceRange.hpp"
+#include "Runtime/ClosedForm.hpp"
+
+namespace ast::bytecode {
+
+// Register operands index the running frame, see FrameLayout.
+enum class op_code : std::uint8_t
+{
+    halt,
+    mov,      // a = b
+    add,      // a = b + c, checked
+    sub,      // a = b - c, checked
+    mul,      // a = b * c, checked
+    div,      // a = b / c, checked
+    mod,      // a = b % c, checked
+    neg,      // a = -b, checked
+    lnot,     // a = !b
+    lt,       // a = b < c
+    le,       // a = b <= c
+    gt,       // a = b > c
+    ge,       // a = b >= c
+    eq,       // a = b == c
+    ne,       // a = b != c
+    bxor,     // a = b ^ c
+    jmp,      // goto a
+    jz,       // if (a == 0) goto b
+    jnz,      // if (a != 0) goto b
+    jlt,      // if (a < b) goto c
+    jle,      // if (a <= b) goto c
+    jgt,      // if (a > b) goto c
+    jge,      // if (a >= b) goto c
+    jeq,      // if (a == b) goto c
+    jne,      // if (a != b) goto c
+    input,    // a = ?
+    print,    // print a
+    load_var, // a = first defined slot of var_refs[b]
+    store_var, // first defined slot of var_refs[b] = a, else define slot c
+    store_def, // a = b, mark slot a defined
+    declare,  // slot a must be undefined; a = b, mark defined
+    undef,    // mark slot a undefined
+    trap,     // throw messages[a]
+    // Arrays live beside the registers, one per slot, and are reached
+    // through var_refs like load_var/store_var. Storing a whole array
+    // defines var_refs[..].slots.front() if no candidate is defined.
+    arr_fill,     // array a = repeat(b, c)
+    arr_push,     // append a to the pending array literal
+    arr_set,      // array a = pending array literal
+    arr_copy,     // array a = array b
+    arr_load,     // a = array b[c], bounds checked
+    arr_load_nc,  // a = array b[c], index proven in range
+    arr_store,    // array a[b] = c, bounds checked
+    arr_store_nc, // array a[b] = c, index proven in range
+    // A call passes its arguments in consecutive registers starting at c
+    // and runs the callee in a frame right above the caller's.
+    call,      // a = functions[b](c, c + 1, ...)
+    tail_call, // return functions[b](c, c + 1, ...), reusing this frame
+    ret,       // return a to the caller
+    // Falls through to the loop that follows when the closed form does not
+    // apply, so a backend may treat it as a no-op.
+    closed_form, // if closed_forms[a] runs, goto b
+};
+
+struct Instr
+{
+    op_code op = op_code::halt;
+    std::uint32_t a = 0;
+    std::uint32_t b = 0;
+    std::uint32_t c = 0;
+};
+
+// Slots a variable name can resolve to at one program point, innermost
+// scope first. Used only where the compiler cannot prove which one is live.
+struct VarRef
+{
+    std::string name;
+    std::vector<std::uint32_t> slots;
+};
+
+// Registers of one frame, laid out as [variable slots | temporaries |
+// constants]. Slots are numbered from zero, so a slot number is also its
+// register index.
+struct FrameLayout
+{
+    std::vector<std::int64_t> constants;
+    std::vector<std::string> slot_names;
+    std::uint32_t num_temps = 0;
+
+    std::uint32_t num_slots() const
+    {
+        return static_cast<std::uint32_t>(slot_names.size());
+    }
+
+    std::uint32_t const_base() const
+    {
+        return num_slots() + num_temps;
+    }
+
+    std::uint32_t num_regs() const
+    {
+        return const_base() + static_cast<std::uint32_t>(constants.size());
+    }
+};
+
+// A function's code starts at `entry`; its arguments arrive in the first
+// `num_params` slots of its frame.
+struct Function
+{
+    std::string name;
+    std::uint32_t entry = 0;
+    std::uint32_t num_params = 0;
+    FrameLayout frame;
+};
+
+// A loop the VM may skip by running its closed form instead, see
+// ClosedFormLoops. The form's variables are found through var_refs, like
+// load_var finds them.
+struct ClosedFormLoop
+{
+    ClosedForm form;
+    std::vector<std::uint32_t> vars;
+};
+
+// The top-level code runs in the program's own frame, at the bottom of the
+// VM's register stack. Functions follow it in `code`.
+struct Program : FrameLayout
+{
+    std::vector<Instr> code;
+    std::vector<SourceRange> locations;
+    std::vector<VarRef> var_refs;
+    std::vector<std::string> messages;
+    std::vector<Function> functions;
+    std::vector<ClosedFormLoop> closed_forms;
+};
+
+} // namespace ast::bytecode
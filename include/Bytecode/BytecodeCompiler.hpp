@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AST/AST.hpp"
+#include "Bytecode/Bytecode.hpp"
+#include "Visitors/Visitor.hpp"
+
+namespace ast::bytecode {
+
+// Lowers a checked AST to register bytecode with the same observable
+// behaviour as ast::Interpreter, including runtime errors and their order.
+// Statement nodes used in expression position are not supported.
+class BytecodeCompiler : public Visitor
+{
+public:
+    BytecodeCompiler() = default;
+
+    Program compile(BaseNode& root);
+
+    void visit(BinArithOpNode& node) override;
+    void visit(BinLogicOpNode& node) override;
+    void visit(ValueNode& node) override;
+    void visit(UnOpNode& node) override;
+    void visit(AssignNode& node) override;
+    void visit(VarNode& node) override;
+    void visit(IfNode& node) override;
+    void visit(WhileNode& node) override;
+    void visit(ForNode& node) override;
+    void visit(InputNode& node) override;
+    void visit(ExprNode& node) override;
+    void visit(PrintNode& node) override;
+    void visit(ScopeNode& node) override;
+    void visit(VarDeclNode& node) override;
+    void visit(ErrorNode& node) override;
+    void visit(EmptyNode& node) override;
+    void visit(ArrayNode& node) override;
+    void visit(IndexNode& node) override;
+    void visit(FuncNode& node) override;
+    void visit(CallNode& node) override;
+    void visit(ReturnNode& node) override;
+
+private:
+    struct Scope
+    {
+        std::unordered_map<Name, std::uint32_t> slots;
+        std::vector<std::uint32_t> owned;
+    };
+
+    using PatchList = std::vector<std::size_t>;
+
+    static constexpr std::uint32_t kNoReg = UINT32_MAX;
+
+    Program program_;
+    // Layout of the frame being compiled: the program's or a function's.
+    FrameLayout* frame_ = nullptr;
+    std::unordered_map<Name, std::uint32_t> function_ids_;
+    std::vector<FuncNode*> function_nodes_;
+    std::vector<Scope> scopes_;
+    std::vector<std::uint8_t> defined_;
+    std::vector<std::uint32_t> defined_log_;
+    std::vector<std::uint8_t> checked_;
+    std::unordered_map<std::int64_t, std::uint32_t> constants_;
+    std::unordered_map<const BaseNode*, unsigned> effects_memo_;
+    std::uint32_t next_temp_ = 0;
+    std::uint32_t last_reg_ = 0;
+    std::uint32_t dst_hint_ = kNoReg;
+
+    std::size_t emit(op_code op,
+                     const SourceRange& loc,
+                     std::uint32_t a = 0,
+                     std::uint32_t b = 0,
+                     std::uint32_t c = 0);
+    std::size_t here() const;
+    void patch(const PatchList& patches, std::size_t target);
+    void emit_trap(const std::string& formatted, const SourceRange& loc);
+
+    std::uint32_t constant(std::int64_t value);
+    std::uint32_t alloc_temp();
+    std::uint32_t dst_or_temp(std::uint32_t hint);
+    std::uint32_t compile_expr(BaseNode& node, std::uint32_t hint = kNoReg);
+    bool require_expr(const BaseNode* node,
+                      const SourceRange& owner_loc,
+                      const char* error_msg);
+    void compile_stmt(BaseNode* node);
+    void compile_branch(BaseNode& cond, bool when, PatchList& patches);
+    void compile_loop(BaseNode* init,
+                      BaseNode& cond,
+                      BaseNode* body,
+                      BaseNode* step,
+                      const LoopReduction* reduction);
+    void compile_closed_form(const LoopReduction& reduction,
+                             const SourceRange& loc,
+                             PatchList& exit);
+    unsigned effects(const BaseNode* node);
+    bool writes_vars(const BaseNode* node);
+    bool calls_functions(const BaseNode* node);
+    bool is_slot(std::uint32_t reg) const;
+
+    void enter_scope(BaseNode& owner);
+    void leave_scope();
+    void collect_names(const BaseNode* node, Scope& scope);
+    void add_name(Name name, Scope& scope);
+    std::vector<std::uint32_t> candidates(Name name) const;
+    std::size_t defined_mark() const;
+    void restore_defined(std::size_t mark);
+    void mark_defined(std::uint32_t slot);
+
+    std::uint32_t read_var(Name name);
+    std::uint32_t assign_var(Name name, BaseNode& rhs, const SourceRange& loc);
+    std::optional<std::uint32_t> array_ref(Name name, bool store);
+    void assign_array(Name name, BaseNode& rhs, const SourceRange& loc);
+    void store_element(IndexNode& lhs, BaseNode& rhs);
+
+    void begin_frame(FrameLayout& frame);
+    void declare_functions(BaseNode& root);
+    void compile_function(FuncNode& node, Function& function);
+    std::optional<std::uint32_t> resolve_call(CallNode& node);
+    std::uint32_t compile_args(CallNode& node);
+    void finish(std::size_t begin);
+};
+
+} // namespace ast::bytecode
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Bytecode/Bytecode.hpp"
+
+namespace ast::bytecode {
+
+// Translates a Program to a standalone C translation unit that behaves like
+// the VM running it: same output, same runtime errors on stderr, exit code
+// 1 on error. Every instruction becomes a C statement under a label, jumps
+// become gotos, and checked arithmetic uses __builtin_*_overflow, so the
+// result needs GCC or Clang. Calls keep the VM's register stack and depth
+// limit; a return dispatches on the caller's resume pc.
+class CEmitter
+{
+public:
+    explicit CEmitter(const Program& program);
+
+    void emit(std::ostream& out);
+
+private:
+    const Program& program_;
+    // Frame of the instruction being translated.
+    const FrameLayout* frame_ = nullptr;
+    std::vector<std::uint8_t> labelled_;
+
+    void emit_return(std::ostream& out) const;
+    std::string translate(std::size_t pc);
+    std::string reg(std::uint32_t index) const;
+    std::string message(std::size_t pc, const std::string& text) const;
+    std::string jump(std::uint32_t target);
+    std::string arith(std::size_t pc,
+                      const char* builtin,
+                      const char* error) const;
+    std::string divide(std::size_t pc, char op, const char* error) const;
+    std::string find_slot(std::uint32_t ref, const std::string& found) const;
+    std::string array_ref(std::uint32_t ref, bool store) const;
+    std::string call(std::size_t pc, bool tail);
+};
+
+} // namespace ast::bytecode
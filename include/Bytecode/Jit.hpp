@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Bytecode/Bytecode.hpp"
+
+namespace ast::bytecode {
+
+// Compiles hot loops of a Program to x86-64 machine code. The VM reports
+// every taken backward jump; once a loop's back edge has been taken
+// kHotLoopThreshold times, the code from its head to its last back edge is
+// compiled if it needs nothing but arithmetic, comparisons, jumps and
+// scalar variables. `?`, `print` and traps leave the native code and run
+// in the VM; loops that touch arrays, call functions or declare variables
+// stay in the VM entirely.
+//
+// Native code reads and writes the frame's registers in memory, so the VM
+// sees the same state at every exit. A checked operation that would fail
+// exits before writing its result, and the VM re-runs it to report the
+// error with its usual message and location.
+class Jit
+{
+public:
+    // Runs a compiled loop on the running frame and returns the pc the VM
+    // resumes at.
+    using Entry = std::uint32_t (*)(std::int64_t* regs, std::uint8_t* defined);
+
+    static constexpr std::uint32_t kHotLoopThreshold = 64;
+
+    explicit Jit(const Program& program);
+    ~Jit();
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+
+    // The code generator targets x86-64 Linux only.
+    static bool supported();
+
+    // Called on a taken jump back to `loop`. Returns the loop's native code
+    // once it is hot and compiled, nullptr otherwise.
+    Entry back_edge(std::uint32_t loop)
+    {
+        if (const auto entry = entries_[loop]) {
+            return entry;
+        }
+        // A loop that failed to compile keeps its count at the threshold.
+        if (counts_[loop] == kHotLoopThreshold ||
+            ++counts_[loop] < kHotLoopThreshold) {
+            return nullptr;
+        }
+        return compile(loop);
+    }
+
+    std::size_t compiled_loops() const
+    {
+        return mappings_.size();
+    }
+
+private:
+    Entry compile(std::uint32_t loop);
+
+    const Program& program_;
+    std::vector<std::uint32_t> counts_;
+    std::vector<Entry> entries_;
+    std::vector<std::pair<void*, std::size_t>> mappings_;
+};
+
+} // namespace ast::bytecode
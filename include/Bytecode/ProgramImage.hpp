@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+#include "AST/FileTable.hpp"
+#include "Bytecode/Bytecode.hpp"
+
+namespace ast::bytecode {
+
+// Flat binary form of a Program: a header with a magic, the format version
+// and a checksum of the payload, then every table of the Program as counted
+// arrays of fixed-width native-endian fields. Instructions and locations
+// are read back with a bounds check per array instead of per field.
+//
+// Bump kImageVersion whenever Program, Instr or op_code change meaning.
+inline constexpr std::uint32_t kImageVersion = 2;
+
+// FNV-style multiply-xor hash of `bytes`, eight bytes at a step. Guards
+// image payloads against corruption and keys the on-disk program cache by
+// source text; not meant to resist deliberate collisions.
+std::uint64_t content_hash(std::string_view bytes);
+
+void write_image(const Program& program, std::ostream& out);
+
+// File ids are only meaningful inside the process that interned them, so
+// an image records whether each location had a file and read_image points
+// all of those at `file`. Throws std::runtime_error if `image` is
+// truncated, corrupt, or written by another format version.
+Program read_image(std::string_view image, FileTable::FileId file);
+
+} // namespace ast::bytecode
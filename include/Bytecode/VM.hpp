@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Bytecode/Bytecode.hpp"
+#include "Bytecode/Jit.hpp"
+#include "Runtime/Arrays.hpp"
+#include "Runtime/InputSource.hpp"
+#include "Runtime/OutputSink.hpp"
+
+namespace ast::bytecode {
+
+class VM
+{
+    // Where a call returns to once the callee's `ret` runs.
+    struct CallFrame
+    {
+        std::size_t return_pc;
+        std::uint32_t dst;
+        std::size_t base;
+        const FrameLayout* frame;
+    };
+
+    const Program& program_;
+    // One stack of frames shared by the three vectors, indexed by register:
+    // the program's frame at the bottom, one frame per active call above
+    // it. The running frame spans [base_, top_).
+    std::vector<std::int64_t> regs_;
+    std::vector<std::uint8_t> defined_;
+    std::vector<ArrayStorage> arrays_;
+    std::size_t base_ = 0;
+    std::size_t top_ = 0;
+    const FrameLayout* frame_;
+    std::vector<CallFrame> calls_;
+    ArrayStorage pending_;
+    std::unique_ptr<Jit> jit_;
+    OutputSink out_;
+    InputSource in_;
+
+public:
+    explicit VM(const Program& program);
+
+    // Runs the program and flushes its output, also when it traps.
+    void run();
+
+    // Lets hot loops run as native code where Jit::supported(); a no-op
+    // elsewhere.
+    void enable_jit();
+
+    std::size_t jit_compiled_loops() const
+    {
+        return jit_ ? jit_->compiled_loops() : 0;
+    }
+
+    OutputSink& output()
+    {
+        return out_;
+    }
+    InputSource& input()
+    {
+        return in_;
+    }
+
+private:
+    void execute();
+    [[noreturn]] void fail(std::size_t pc, const char* msg) const;
+    std::int64_t load_var(std::uint32_t ref) const;
+    void store_var(std::uint32_t ref, std::uint32_t create, std::int64_t value);
+    void declare(std::size_t pc, std::uint32_t slot, std::int64_t value);
+    bool run_closed_form(std::uint32_t loop);
+    void enter(const Function& function, std::size_t base, std::size_t args);
+    ArrayStorage& load_array(std::uint32_t ref);
+    ArrayStorage& store_array(std::uint32_t ref);
+    std::size_t checked_index(std::size_t pc,
+                              std::int64_t index,
+                              const ArrayStorage& array) const;
+};
+
+} // namespace ast::bytecode
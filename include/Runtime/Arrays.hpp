@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace ast {
+
+// Every array variable owns one contiguous buffer of int64 elements. The
+// interpreter and the VM keep it alive across scope re-entries, so a loop
+// that rebuilds an array reuses the previous allocation.
+using ArrayStorage = std::vector<std::int64_t>;
+
+// Upper bound on the element count of a single array (2 GiB of storage).
+constexpr std::int64_t kMaxArraySize = std::int64_t{ 1 } << 28;
+
+inline bool array_index_in_range(std::int64_t index, std::size_t size)
+{
+    return static_cast<std::uint64_t>(index) < size;
+}
+
+// Error message for an array of `size` elements, or nullopt if the size is
+// valid.
+std::optional<std::string> array_size_error(std::int64_t size);
+
+std::string array_index_error(std::int64_t index, std::size_t size);
+
+} // namespace ast
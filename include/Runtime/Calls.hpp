@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace ast {
+
+// Deepest nesting of function calls either backend runs before it stops
+// with a runtime error. The tree-walker recurses on the C++ stack for every
+// nested call, so the limit keeps it well inside a default 8 MiB stack,
+// sanitizer builds included. Tail calls replace the caller's frame and do
+// not count.
+constexpr std::size_t kMaxCallDepth = 1000;
+
+inline constexpr const char* kCallDepthError = "Call stack overflow";
+
+std::string call_arity_error(const std::string& name,
+                             std::size_t expected,
+                             std::size_t given);
+
+} // namespace ast
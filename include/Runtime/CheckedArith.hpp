@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+// GCC and Clang lower __builtin_*_overflow to the operation followed by a
+// branch on the overflow flag. Define PARACL_HAS_OVERFLOW_BUILTINS=0 to
+// build with the portable checks instead.
+#ifndef PARACL_HAS_OVERFLOW_BUILTINS
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_add_overflow) &&                                   \
+    __has_builtin(__builtin_sub_overflow) &&                                   \
+    __has_builtin(__builtin_mul_overflow)
+#define PARACL_HAS_OVERFLOW_BUILTINS 1
+#endif
+#elif defined(__GNUC__) && __GNUC__ >= 5
+#define PARACL_HAS_OVERFLOW_BUILTINS 1
+#endif
+#endif
+#ifndef PARACL_HAS_OVERFLOW_BUILTINS
+#define PARACL_HAS_OVERFLOW_BUILTINS 0
+#endif
+
+namespace ast {
+
+// Plain C++ versions of the checks below, for compilers without the
+// builtins and for constant evaluation. Like the builtins they return true
+// on overflow; `out` is only written when they return false.
+namespace portable {
+
+constexpr bool add_overflow(std::int64_t lhs,
+                            std::int64_t rhs,
+                            std::int64_t& out)
+{
+    constexpr auto kMax = std::numeric_limits<std::int64_t>::max();
+    constexpr auto kMin = std::numeric_limits<std::int64_t>::min();
+    if ((rhs > 0 && lhs > kMax - rhs) || (rhs < 0 && lhs < kMin - rhs)) {
+        return true;
+    }
+    out = lhs + rhs;
+    return false;
+}
+
+constexpr bool sub_overflow(std::int64_t lhs,
+                            std::int64_t rhs,
+                            std::int64_t& out)
+{
+    constexpr auto kMax = std::numeric_limits<std::int64_t>::max();
+    constexpr auto kMin = std::numeric_limits<std::int64_t>::min();
+    if ((rhs < 0 && lhs > kMax + rhs) || (rhs > 0 && lhs < kMin + rhs)) {
+        return true;
+    }
+    out = lhs - rhs;
+    return false;
+}
+
+constexpr bool mul_overflow(std::int64_t lhs,
+                            std::int64_t rhs,
+                            std::int64_t& out)
+{
+    constexpr auto kMax = std::numeric_limits<std::int64_t>::max();
+    constexpr auto kMin = std::numeric_limits<std::int64_t>::min();
+
+    if (lhs == 0 || rhs == 0) {
+        out = 0;
+        return false;
+    }
+    if ((lhs == -1 && rhs == kMin) || (rhs == -1 && lhs == kMin)) {
+        return true;
+    }
+
+    if (lhs > 0) {
+        if (rhs > 0 ? lhs > kMax / rhs : rhs < kMin / lhs) {
+            return true;
+        }
+    } else if (rhs > 0 ? lhs < kMin / rhs : lhs < kMax / rhs) {
+        return true;
+    }
+
+    out = lhs * rhs;
+    return false;
+}
+
+} // namespace portable
+
+// Checked int64 arithmetic shared by the interpreter, the VM and the
+// constant folder. Each returns true if the exact result does not fit; in
+// that case `out` may hold the wrapped result and must not be used.
+constexpr bool add_overflow(std::int64_t lhs,
+                            std::int64_t rhs,
+                            std::int64_t& out)
+{
+#if PARACL_HAS_OVERFLOW_BUILTINS
+    if (!std::is_constant_evaluated()) {
+        return __builtin_add_overflow(lhs, rhs, &out);
+    }
+#endif
+    return portable::add_overflow(lhs, rhs, out);
+}
+
+constexpr bool sub_overflow(std::int64_t lhs,
+                            std::int64_t rhs,
+                            std::int64_t& out)
+{
+#if PARACL_HAS_OVERFLOW_BUILTINS
+    if (!std::is_constant_evaluated()) {
+        return __builtin_sub_overflow(lhs, rhs, &out);
+    }
+#endif
+    return portable::sub_overflow(lhs, rhs, out);
+}
+
+constexpr bool mul_overflow(std::int64_t lhs,
+                            std::int64_t rhs,
+                            std::int64_t& out)
+{
+#if PARACL_HAS_OVERFLOW_BUILTINS
+    if (!std::is_constant_evaluated()) {
+        return __builtin_mul_overflow(lhs, rhs, &out);
+    }
+#endif
+    return portable::mul_overflow(lhs, rhs, out);
+}
+
+} // namespace ast
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace ast {
+
+// A counted loop described well enough to compute its effect without
+// iterating, see ClosedFormLoops. The loop tests `counter <cmp> bound`
+// and then runs `updates` in order, each `var = var + delta` or
+// `var = var - delta`. Variables are numbered from zero; the caller owns
+// their values.
+struct ClosedForm
+{
+    enum class relation : std::uint8_t
+    {
+        lt,
+        le,
+        gt,
+        ge,
+        eq,
+        ne,
+    };
+
+    enum class term_kind : std::uint8_t
+    {
+        constant,
+        var,
+        add,
+        sub,
+        mul,
+        neg,
+    };
+
+    // One node of a delta expression. A delta is a run of terms in
+    // postfix order: operands come before their operator.
+    struct Term
+    {
+        term_kind kind = term_kind::constant;
+        // The constant, or the variable number.
+        std::int64_t value = 0;
+    };
+
+    struct Update
+    {
+        std::uint32_t var = 0;
+        bool subtract = false;
+        // The delta is terms[first, last).
+        std::uint32_t first = 0;
+        std::uint32_t last = 0;
+    };
+
+    std::uint32_t num_vars = 0;
+    std::uint32_t counter = 0;
+    relation cmp = relation::lt;
+    // A constant or a variable the updates leave alone.
+    Term bound;
+    std::vector<Term> terms;
+    std::vector<Update> updates;
+};
+
+// Computes what the loop `form` describes does to `values`, indexed by
+// variable number. Returns true and leaves the values after the loop in
+// `values` if the loop ends and nothing in it overflows. Otherwise returns
+// false with `values` untouched, and the caller runs the loop itself, so
+// an overflow is still reported by the operation and iteration that hit
+// it.
+bool run_closed_form(const ClosedForm& form, std::int64_t* values);
+
+} // namespace ast
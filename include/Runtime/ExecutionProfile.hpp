@@ -0,0 +1,79 @@
+#pragma once
+
+#include "AST/AST.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace ast {
+
+// Visit counts and wall time per executed AST node, filled in by
+// ProfilingInterpreter and reported per source line.
+class ExecutionProfile
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct NodeStats
+    {
+        std::uint64_t visits = 0;
+        clock::duration total{};    // including the node's children
+        clock::duration children{}; // time spent in nested visits
+        clock::duration self() const
+        {
+            return total - children;
+        }
+    };
+
+    // Times one visit of `node`; nests with the visits it makes.
+    class Scope
+    {
+    public:
+        Scope(ExecutionProfile& profile, const BaseNode& node)
+          : profile_(profile)
+        {
+            profile_.enter(node);
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope()
+        {
+            profile_.leave();
+        }
+
+    private:
+        ExecutionProfile& profile_;
+    };
+
+    void enter(const BaseNode& node);
+    void leave();
+
+    const std::unordered_map<const BaseNode*, NodeStats>& nodes() const
+    {
+        return stats_;
+    }
+    clock::duration total() const;
+
+    // Source lines sorted by self time, at most `limit` rows.
+    void write_hot_lines(std::ostream& os, std::size_t limit = 20) const;
+    // One "frame;frame;frame <self ns>" line per executed node, where the
+    // frames are the node's AST ancestors; the format flamegraph.pl and
+    // similar tools read.
+    void write_collapsed(std::ostream& os) const;
+
+private:
+    struct Frame
+    {
+        NodeStats* stats;
+        clock::time_point start;
+    };
+
+    std::unordered_map<const BaseNode*, NodeStats> stats_;
+    std::vector<Frame> stack_;
+};
+
+} // namespace ast
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+
+namespace ast {
+
+// Reads the integers consumed by `?`. Values are parsed by hand instead of
+// going through iostream formatting; stdin is read in large blocks, or
+// mapped whole when it is a regular file.
+class InputSource
+{
+public:
+    // Reads character by character from whatever buffer the stream has at
+    // the moment; used by default so redirected std::cin keeps working.
+    explicit InputSource(std::istream& in = std::cin);
+    // Reads the descriptor directly, mapping it when it is a regular file.
+    static InputSource from_fd(int fd);
+    static InputSource from_stdin();
+
+    InputSource(const InputSource&) = delete;
+    InputSource& operator=(const InputSource&) = delete;
+    InputSource(InputSource&& other) noexcept;
+    InputSource& operator=(InputSource&& other) noexcept;
+    ~InputSource();
+
+    // Parses the next whitespace-separated int64_t. On malformed input,
+    // overflow or end of input returns false and drops the rest of the
+    // current line, like `std::cin >> value` followed by ignore().
+    bool read(std::int64_t& value);
+
+private:
+    static constexpr std::size_t kBlockSize = 64 * 1024;
+
+    std::istream* stream_ = nullptr;
+    int fd_ = -1;
+    std::unique_ptr<char[]> buffer_;
+    char* mapped_ = nullptr;
+    std::size_t mapped_size_ = 0;
+    const char* pos_ = nullptr;
+    const char* end_ = nullptr;
+
+    explicit InputSource(int fd)
+      : fd_(fd)
+    {
+    }
+
+    static constexpr int kEof = -1;
+
+    bool refill();
+    int peek()
+    {
+        if (stream_ != nullptr) {
+            const auto c = stream_->rdbuf()->sgetc();
+            return c == std::char_traits<char>::eof() ? kEof : c;
+        }
+        if (pos_ == end_ && !refill()) {
+            return kEof;
+        }
+        return static_cast<unsigned char>(*pos_);
+    }
+    void advance()
+    {
+        if (stream_ != nullptr) {
+            stream_->rdbuf()->sbumpc();
+        } else {
+            ++pos_;
+        }
+    }
+    void skip_line();
+    void release();
+};
+
+} // namespace ast
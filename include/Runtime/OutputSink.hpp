@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+
+namespace ast {
+
+// Collects printed values in a user-space buffer and hands them to the
+// stream in large chunks instead of flushing after every line.
+class OutputSink
+{
+public:
+    enum class buffering
+    {
+        line,  // flush after every value, for interactive use
+        block, // flush when the buffer fills up, before input and on exit
+    };
+
+    static constexpr std::size_t kBufferSize = 64 * 1024;
+
+    explicit OutputSink(std::ostream& out = std::cout,
+                        buffering mode = buffering::line);
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+    OutputSink(OutputSink&& other) noexcept;
+    OutputSink& operator=(OutputSink&& other) = delete;
+    ~OutputSink();
+
+    void print(std::int64_t value);
+    void flush();
+
+    buffering mode() const
+    {
+        return mode_;
+    }
+    void set_mode(buffering mode);
+
+    // Flushes what is buffered to the current stream, then writes to `out`.
+    void set_stream(std::ostream& out);
+
+private:
+    std::ostream* out_;
+    buffering mode_;
+    std::unique_ptr<char[]> buffer_;
+    std::size_t used_ = 0;
+
+    void write_buffer();
+};
+
+} // namespace ast
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "AST/AST.hpp"
+#include "Runtime/ClosedForm.hpp"
+#include "Visitors/Visitor.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ast {
+
+struct LoopReduction
+{
+    ClosedForm form;
+
+    // The variable behind each of the form's numbers.
+    struct Var
+    {
+        Name name;
+        std::uint32_t frame_index = kNoFrameIndex;
+    };
+    std::vector<Var> vars;
+};
+
+// Finds counted loops that only step scalar variables, such as
+//
+//     while (i <= n) { s = s + i; i = i + 1; }
+//
+// and attaches their closed form, which the interpreter and the VM run
+// instead of the loop on entry. The condition compares a counter with a
+// constant or a variable the loop leaves alone, and every statement is
+// `v = v + d`, `v = d + v` or `v = v - d` for a different v. Each d is
+// built from constants and variables with +, - and unary or binary *, and
+// is either the same on every iteration or moves by the same amount on
+// each one, so the counter and the other variables step linearly and the
+// sums of linear steps grow quadratically.
+//
+// The closed form is exact: it is used only when no operation of the loop
+// would overflow on any iteration, and the loop runs as written otherwise,
+// reporting the overflow at its usual place.
+//
+// Runs last, on a checked tree with a frame layout: the reductions name
+// frame indices and describe the loop bodies as they are.
+class ClosedFormLoops : public Visitor
+{
+public:
+    void reduce(BaseNode* root);
+
+    // Number of loops reduce() attached a closed form to.
+    std::size_t reduced_count() const
+    {
+        return reduced_count_;
+    }
+
+    void visit(BinArithOpNode& node) override;
+    void visit(BinLogicOpNode& node) override;
+    void visit(ValueNode& node) override;
+    void visit(UnOpNode& node) override;
+    void visit(AssignNode& node) override;
+    void visit(VarNode& node) override;
+    void visit(IfNode& node) override;
+    void visit(WhileNode& node) override;
+    void visit(ForNode& node) override;
+    void visit(InputNode& node) override;
+    void visit(ExprNode& node) override;
+    void visit(PrintNode& node) override;
+    void visit(ScopeNode& node) override;
+    void visit(VarDeclNode& node) override;
+    void visit(ErrorNode& node) override;
+    void visit(EmptyNode& node) override;
+    void visit(ArrayNode& node) override;
+    void visit(IndexNode& node) override;
+    void visit(FuncNode& node) override;
+    void visit(CallNode& node) override;
+    void visit(ReturnNode& node) override;
+
+private:
+    std::size_t reduced_count_ = 0;
+
+    void visit_children(BaseNode& node);
+};
+
+} // namespace ast
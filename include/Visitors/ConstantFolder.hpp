@@ -0,0 +1,58 @@
+#pragma once
+
+#include "AST/AST.hpp"
+#include "Visitors/Visitor.hpp"
+#include <cstddef>
+
+namespace ast {
+
+// Rewrites the checked tree in place: operators whose operands are all
+// constants become a single ValueNode, and identities like `x + 0`,
+// `x * 1` or `!!x` in a condition drop the redundant operation. A constant
+// expression that would trap at runtime (overflow, division by zero) is
+// left untouched so the error is still raised with its own location.
+class ConstantFolder : public Visitor
+{
+public:
+    void fold(BaseNode* root);
+
+    // Number of nodes rewritten by fold().
+    std::size_t folded_count() const
+    {
+        return folded_count_;
+    }
+
+    void visit(BinArithOpNode& node) override;
+    void visit(BinLogicOpNode& node) override;
+    void visit(ValueNode& node) override;
+    void visit(UnOpNode& node) override;
+    void visit(AssignNode& node) override;
+    void visit(VarNode& node) override;
+    void visit(IfNode& node) override;
+    void visit(WhileNode& node) override;
+    void visit(ForNode& node) override;
+    void visit(InputNode& node) override;
+    void visit(ExprNode& node) override;
+    void visit(PrintNode& node) override;
+    void visit(ScopeNode& node) override;
+    void visit(VarDeclNode& node) override;
+    void visit(ErrorNode& node) override;
+    void visit(EmptyNode& node) override;
+    void visit(ArrayNode& node) override;
+    void visit(IndexNode& node) override;
+    void visit(FuncNode& node) override;
+    void visit(CallNode& node) override;
+    void visit(ReturnNode& node) override;
+
+private:
+    // Set by a visit() when the visited node should be replaced.
+    BaseNode::NodePtr replacement_;
+    std::size_t folded_count_ = 0;
+
+    void fold_children(BaseNode& node);
+    void replace_with_value(const BaseNode& node, int64_t value);
+    void replace_with_child(BaseNode& node, std::size_t index);
+    void strip_double_not(BaseNode& node, const BaseNode* operand);
+};
+
+} // namespace ast
@@ -61,7 +61,7 @@ public:
 
     void visit(VarNode& node) override
     {
-        emit_node(node, node.name());
+        emit_node(node, node.name().str());
     }
 
     void visit(IfNode& node) override
@@ -128,7 +128,7 @@ public:
 
     void visit(VarDeclNode& node) override
     {
-        emit_node(node, "var_decl " + node.name());
+        emit_node(node, "var_decl " + node.name().str());
         emit_edges(node);
         const auto& init_expr = node.init_expr();
         if (init_expr != nullptr)
@@ -153,6 +153,57 @@ public:
         }
     }
 
+    void visit(ArrayNode& node) override
+    {
+        emit_node(node,
+                  node.init() == array_init_type::repeat ? "repeat" : "array");
+        emit_edges(node);
+        for (const auto& child : node.children()) {
+            child->accept(*this);
+        }
+    }
+
+    void visit(IndexNode& node) override
+    {
+        emit_node(node, node.bounds_checked() ? "[]" : "[] unchecked");
+        emit_edges(node);
+        for (const auto& child : node.children()) {
+            child->accept(*this);
+        }
+    }
+
+    void visit(FuncNode& node) override
+    {
+        std::string signature = node.name().str() + "(";
+        for (std::size_t i = 0; i < node.params().size(); ++i) {
+            signature += (i == 0 ? "" : ", ") + node.params()[i].str();
+        }
+        emit_node(node, signature + ")");
+        emit_edges(node);
+        for (const auto& child : node.children()) {
+            child->accept(*this);
+        }
+    }
+
+    void visit(CallNode& node) override
+    {
+        const auto name = node.name().str();
+        emit_node(node, node.is_tail() ? name + " (tail)" : name);
+        emit_edges(node);
+        for (const auto& child : node.children()) {
+            child->accept(*this);
+        }
+    }
+
+    void visit(ReturnNode& node) override
+    {
+        emit_node(node, "return");
+        emit_edges(node);
+        for (const auto& child : node.children()) {
+            child->accept(*this);
+        }
+    }
+
     void create_dot(ast::AST& ast)
     {
         begin_graph();
@@ -205,47 +256,6 @@ private:
         }
     }
 
-    static std::string node_type_name(base_node_type type)
-    {
-        switch (type) {
-            case base_node_type::bin_arith_op:
-                return "bin_arith_op";
-            case base_node_type::bin_logic_op:
-                return "bin_logic_op";
-            case base_node_type::unop:
-                return "unop";
-            case base_node_type::scope:
-                return "scope";
-            case base_node_type::value:
-                return "value";
-            case base_node_type::print:
-                return "print";
-            case base_node_type::assign:
-                return "assign";
-            case base_node_type::var:
-                return "var";
-            case base_node_type::expr:
-                return "expr";
-            case base_node_type::if_node:
-                return "if";
-            case base_node_type::while_node:
-                return "while";
-            case base_node_type::input:
-                return "input";
-            case base_node_type::base:
-                return "base";
-            case base_node_type::var_decl:
-                return "var_decl";
-            case base_node_type::for_node:
-                return "for";
-            case base_node_type::err:
-                return "error";
-            case base_node_type::empty:
-                return "empty";
-        }
-        return "unknown";
-    }
-
     template<typename NodeT>
     static std::string addr_of(const NodeT& node)
     {
@@ -1,10 +1,16 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <optional>
 #include <string>
+#include <vector>
 
 #include "AST/AST.hpp"
+#include "Runtime/Arrays.hpp"
+#include "Runtime/Calls.hpp"
+#include "Runtime/InputSource.hpp"
+#include "Runtime/OutputSink.hpp"
 #include "Visitors/Visitor.hpp"
 #include "Visitors/detail/VarTable.hpp"
 
@@ -15,9 +21,38 @@ class Interpreter : public Visitor
 
     VarTable table_;
     int64_t last_value_;
+    OutputSink out_;
+    InputSource in_;
+    // Elements of an array(...) literal, collected before the target is
+    // overwritten since they may read it.
+    ArrayStorage scratch_;
+
+    // Top-level functions by FuncNode::function_index().
+    std::vector<FuncNode*> functions_;
+    // Arguments of the calls being set up; a call's arguments sit on top
+    // until its frame is entered.
+    std::vector<int64_t> args_;
+    std::size_t call_depth_ = 0;
+    // Set by a return statement until the enclosing call takes over;
+    // statements and loops stop as soon as it is set.
+    bool returning_ = false;
+    // Callee of a `return f(...)` whose frame replaces the returning one.
+    FuncNode* tail_call_ = nullptr;
 
 public:
     Interpreter();
+    // Addresses variables through the frame indices SemanticChecker
+    // assigned instead of looking them up by name.
+    explicit Interpreter(std::size_t frame_size);
+
+    OutputSink& output()
+    {
+        return out_;
+    }
+    InputSource& input()
+    {
+        return in_;
+    }
 
     void visit(BinArithOpNode& node) override;
     void visit(BinLogicOpNode& node) override;
@@ -35,25 +70,29 @@ public:
     void visit(VarDeclNode& node) override;
     void visit(ErrorNode& node) override;
     void visit(EmptyNode& node) override;
+    void visit(ArrayNode& node) override;
+    void visit(IndexNode& node) override;
+    void visit(FuncNode& node) override;
+    void visit(CallNode& node) override;
+    void visit(ReturnNode& node) override;
 
 private:
-    enum class evaluable_context
-    {
-        general,
-        condition,
-    };
-
-    static bool add_overflow(int64_t lhs, int64_t rhs, int64_t& out);
-    static bool sub_overflow(int64_t lhs, int64_t rhs, int64_t& out);
-    static bool mul_overflow(int64_t lhs, int64_t rhs, int64_t& out);
+    int64_t read_var(Name name, std::uint32_t frame_index);
+    ArrayStorage& read_array(const VarNode& var);
+    ArrayStorage& write_array(const VarNode& var);
+    void assign_array(const VarNode& var, BaseNode& rhs);
+    void assign_element(IndexNode& lhs, BaseNode& rhs);
+    std::size_t checked_index(IndexNode& node, const ArrayStorage& array);
+    void collect_functions(ScopeNode& root);
+    FuncNode& callee(const CallNode& node);
+    void push_args(CallNode& node, const FuncNode& func);
+    void invoke(FuncNode& func, std::size_t args_begin, const SourceRange& loc);
+    bool run_reduced(const LoopReduction* reduction);
     void evaluate_loop_condition(
         BaseNode& condition,
-        const std::optional<std::string>& tracked_var_name,
+        std::optional<Name> tracked_var_name,
+        std::uint32_t tracked_var_index,
         bool initialize_tracked_var);
-    static std::optional<std::string> validate_evaluable_node(
-        const BaseNode& node,
-        const char* error_msg,
-        evaluable_context context = evaluable_context::general);
 };
 
 } // namespace ast
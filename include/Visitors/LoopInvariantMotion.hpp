@@ -0,0 +1,68 @@
+#pragma once
+
+#include "AST/AST.hpp"
+#include "Visitors/Visitor.hpp"
+#include <cstddef>
+#include <vector>
+
+namespace ast {
+
+// Moves expressions a loop recomputes with the same value on every
+// iteration into temporaries assigned right before the loop. An expression
+// is invariant when it only reads scalar variables that nothing in the
+// loop assigns or declares; element reads, calls and input never are.
+//
+// An invariant expression that cannot trap is hoisted wherever it appears
+// in the loop. One that can (overflow, division by zero) is only hoisted
+// when the loop evaluates it on its first iteration before anything else
+// that could trap or be observed, and is then computed behind a copy of
+// the loop condition, so it fails exactly when and where the loop would.
+//
+// Runs on a checked tree with a frame layout. The temporaries are new
+// variables, so the tree must be checked again if hoisted_count() > 0.
+class LoopInvariantMotion : public Visitor
+{
+public:
+    void hoist(BaseNode* root);
+
+    // Number of distinct expressions moved out of loops by hoist().
+    std::size_t hoisted_count() const
+    {
+        return hoisted_count_;
+    }
+
+    void visit(BinArithOpNode& node) override;
+    void visit(BinLogicOpNode& node) override;
+    void visit(ValueNode& node) override;
+    void visit(UnOpNode& node) override;
+    void visit(AssignNode& node) override;
+    void visit(VarNode& node) override;
+    void visit(IfNode& node) override;
+    void visit(WhileNode& node) override;
+    void visit(ForNode& node) override;
+    void visit(InputNode& node) override;
+    void visit(ExprNode& node) override;
+    void visit(PrintNode& node) override;
+    void visit(ScopeNode& node) override;
+    void visit(VarDeclNode& node) override;
+    void visit(ErrorNode& node) override;
+    void visit(EmptyNode& node) override;
+    void visit(ArrayNode& node) override;
+    void visit(IndexNode& node) override;
+    void visit(FuncNode& node) override;
+    void visit(CallNode& node) override;
+    void visit(ReturnNode& node) override;
+
+private:
+    // Statements to run before the loop just visited; the ScopeNode that
+    // holds the loop inserts them.
+    std::vector<BaseNode::NodePtr> hoisted_;
+    std::size_t hoisted_count_ = 0;
+    std::size_t next_temp_ = 0;
+
+    void visit_children(BaseNode& node);
+    void visit_loop(BaseNode& loop);
+    std::vector<BaseNode::NodePtr> hoist_from(BaseNode& loop);
+};
+
+} // namespace ast
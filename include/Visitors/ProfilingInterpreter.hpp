@@ -0,0 +1,120 @@
+#pragma once
+
+#include "Runtime/ExecutionProfile.hpp"
+#include "Visitors/Interpreter.hpp"
+
+namespace ast {
+
+// Wraps every visit of `Base` in an ExecutionProfile::Scope. Children are
+// visited through `accept(*this)`, so nested nodes are timed as well. The
+// plain interpreter is a separate class and carries no profiling code.
+template<typename Base>
+class Profiled : public Base
+{
+public:
+    using Base::Base;
+
+    const ExecutionProfile& profile() const
+    {
+        return profile_;
+    }
+
+    void visit(BinArithOpNode& node) override
+    {
+        timed(node);
+    }
+    void visit(BinLogicOpNode& node) override
+    {
+        timed(node);
+    }
+    void visit(ValueNode& node) override
+    {
+        timed(node);
+    }
+    void visit(UnOpNode& node) override
+    {
+        timed(node);
+    }
+    void visit(AssignNode& node) override
+    {
+        timed(node);
+    }
+    void visit(VarNode& node) override
+    {
+        timed(node);
+    }
+    void visit(IfNode& node) override
+    {
+        timed(node);
+    }
+    void visit(WhileNode& node) override
+    {
+        timed(node);
+    }
+    void visit(ForNode& node) override
+    {
+        timed(node);
+    }
+    void visit(InputNode& node) override
+    {
+        timed(node);
+    }
+    void visit(ExprNode& node) override
+    {
+        timed(node);
+    }
+    void visit(PrintNode& node) override
+    {
+        timed(node);
+    }
+    void visit(ScopeNode& node) override
+    {
+        timed(node);
+    }
+    void visit(VarDeclNode& node) override
+    {
+        timed(node);
+    }
+    void visit(ErrorNode& node) override
+    {
+        timed(node);
+    }
+    void visit(EmptyNode& node) override
+    {
+        timed(node);
+    }
+    void visit(ArrayNode& node) override
+    {
+        timed(node);
+    }
+    void visit(IndexNode& node) override
+    {
+        timed(node);
+    }
+    void visit(FuncNode& node) override
+    {
+        timed(node);
+    }
+    void visit(CallNode& node) override
+    {
+        timed(node);
+    }
+    void visit(ReturnNode& node) override
+    {
+        timed(node);
+    }
+
+private:
+    template<typename NodeT>
+    void timed(NodeT& node)
+    {
+        ExecutionProfile::Scope scope(profile_, node);
+        Base::visit(node);
+    }
+
+    ExecutionProfile profile_;
+};
+
+using ProfilingInterpreter = Profiled<Interpreter>;
+
+} // namespace ast
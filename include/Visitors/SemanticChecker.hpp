@@ -1,9 +1,13 @@
 #pragma once
 
+#include "AST/AST.hpp"
 #include "AST/SourceRange.hpp"
 #include "Visitors/Visitor.hpp"
-#include <set>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace ast {
@@ -22,6 +26,21 @@ public:
 
     void printErrors(std::ostream& out) const;
 
+    // Number of frame indices assigned to the program's variables during
+    // check(). Each function numbers its own frame, see FuncNode.
+    std::size_t frameSize() const
+    {
+        return frame_size_;
+    }
+
+    // False when some variable may be created on a path that does not
+    // always run (a short-circuited operand, an unbraced if branch), so
+    // the interpreter must resolve variables by name at runtime instead.
+    bool hasFrameLayout() const
+    {
+        return frame_layout_valid_ && !hasErrors();
+    }
+
     void visit(BinArithOpNode& node) override;
     void visit(BinLogicOpNode& node) override;
     void visit(ValueNode& node) override;
@@ -38,15 +57,84 @@ public:
     void visit(VarDeclNode& node) override;
     void visit(ErrorNode& node) override;
     void visit(EmptyNode& node) override;
+    void visit(ArrayNode& node) override;
+    void visit(IndexNode& node) override;
+    void visit(FuncNode& node) override;
+    void visit(CallNode& node) override;
+    void visit(ReturnNode& node) override;
 
 private:
+    // An element access whose index is known to stay in [lo, hi]. If every
+    // array the base variable can hold is longer than `hi`, the access
+    // needs no bounds check.
+    struct IndexAccess
+    {
+        IndexNode* node;
+        std::uint32_t array;
+        int64_t lo;
+        int64_t hi;
+        // Counted loop variable the range comes from, if any.
+        std::uint32_t loop_var;
+    };
+
+    struct CountedLoop
+    {
+        std::uint32_t var;
+        int64_t lo;
+        int64_t hi;
+    };
+
+    using ScopeMap = std::unordered_map<Name, std::uint32_t>;
+
+    // Everything numbered per frame; a function body swaps in a fresh one.
+    struct FrameState
+    {
+        std::vector<ScopeMap> scopes;
+        std::uint32_t frame_size = 0;
+        unsigned conditional_depth = 0;
+        std::vector<unsigned> saved_depths;
+        std::vector<value_kind> var_kinds;
+        std::vector<unsigned> write_counts;
+        std::vector<int64_t> min_array_sizes;
+        std::vector<CountedLoop> counted_loops;
+        std::vector<IndexAccess> index_accesses;
+    };
+
     std::vector<std::string> errors_;
-    std::vector<std::set<std::string>> scopes_;
+    std::vector<ScopeMap> scopes_;
+    std::uint32_t frame_size_ = 0;
+    unsigned conditional_depth_ = 0;
+    std::vector<unsigned> saved_depths_;
+    bool frame_layout_valid_ = true;
+
+    // Indexed by frame index.
+    std::vector<value_kind> var_kinds_;
+    std::vector<unsigned> write_counts_;
+    // Shortest array ever assigned to the variable, -1 if some assignment
+    // has a length only known at runtime.
+    std::vector<int64_t> min_array_sizes_;
+    std::vector<CountedLoop> counted_loops_;
+    std::vector<IndexAccess> index_accesses_;
+    // Accesses proven in range so far, in every frame.
+    std::vector<IndexNode*> elidable_;
+
+    std::unordered_map<Name, FuncNode*> functions_;
+    bool in_function_ = false;
 
-    void enterScope();
-    void leaveScope(const SourceRange& loc);
-    void declareVariable(const std::string& name, const SourceRange& loc);
-    bool isDeclared(const std::string& name) const;
+    std::uint32_t enterScope();
+    FrameRange leaveScope(std::uint32_t frame_begin, const SourceRange& loc);
+    std::uint32_t declareVariable(Name name,
+                                  const SourceRange& loc,
+                                  value_kind kind = value_kind::scalar);
+    std::optional<std::uint32_t> resolve(Name name) const;
+    void visitConditional(BaseNode* node);
+    value_kind kindOf(const BaseNode& node) const;
+    void assignArray(AssignNode& node, std::uint32_t index);
+    std::optional<CountedLoop> countedLoop(const ForNode& node) const;
+    void collectElidable();
+    void declareFunctions(BaseNode& root);
+    FrameState saveFrame();
+    void restoreFrame(FrameState&& frame);
     void addError(const SourceRange& loc, const std::string& msg);
 };
 
@@ -24,6 +24,11 @@ struct Visitor
     virtual void visit(ForNode& node) = 0;
     virtual void visit(ErrorNode& node) = 0;
     virtual void visit(EmptyNode& node) = 0;
+    virtual void visit(ArrayNode& node) = 0;
+    virtual void visit(IndexNode& node) = 0;
+    virtual void visit(FuncNode& node) = 0;
+    virtual void visit(CallNode& node) = 0;
+    virtual void visit(ReturnNode& node) = 0;
 };
 
 inline void BinArithOpNode::accept(Visitor& v)
@@ -90,5 +95,25 @@ inline void EmptyNode::accept(Visitor& v)
 {
     v.visit(*this);
 }
+inline void ArrayNode::accept(Visitor& v)
+{
+    v.visit(*this);
+}
+inline void IndexNode::accept(Visitor& v)
+{
+    v.visit(*this);
+}
+inline void FuncNode::accept(Visitor& v)
+{
+    v.visit(*this);
+}
+inline void CallNode::accept(Visitor& v)
+{
+    v.visit(*this);
+}
+inline void ReturnNode::accept(Visitor& v)
+{
+    v.visit(*this);
+}
 
 } // namespace ast
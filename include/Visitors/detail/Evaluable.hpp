@@ -0,0 +1,23 @@
+#pragma once
+
+#include <optional>
+
+#include "AST/AST.hpp"
+
+namespace ast::detail {
+
+enum class evaluable_context
+{
+    general,
+    condition,
+};
+
+// Throws if `node` cannot be evaluated for a value in the given context.
+// Returns the name of the variable an assignment/declaration writes to,
+// which loop conditions re-read instead of re-evaluating the node.
+std::optional<Name> validate_evaluable_node(
+    const BaseNode& node,
+    const char* error_msg,
+    evaluable_context context = evaluable_context::general);
+
+} // namespace ast::detail
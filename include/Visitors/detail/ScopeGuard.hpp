@@ -1,5 +1,6 @@
 #pragma once
 
+#include "AST/AST.hpp"
 #include "AST/SourceRange.hpp"
 #include "Visitors/detail/VarTable.hpp"
 
@@ -9,9 +10,12 @@ class ScopeGuard
 {
     VarTable& table_;
     SourceRange location_;
+    FrameRange frame_range_;
 
 public:
-    explicit ScopeGuard(VarTable& table, const SourceRange& location = {});
+    explicit ScopeGuard(VarTable& table,
+                        const SourceRange& location = {},
+                        const FrameRange& frame_range = {});
     ScopeGuard(const ScopeGuard&) = delete;
     ScopeGuard& operator=(const ScopeGuard&) = delete;
     ~ScopeGuard() noexcept;
@@ -1,31 +1,128 @@
 #pragma once
 
 #include <cstdint>
-#include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "AST/AST.hpp"
 #include "AST/SourceRange.hpp"
+#include "Runtime/Arrays.hpp"
 
 namespace ast {
 
 class VarTable
 {
-    using scope = std::unordered_map<std::string, int64_t>;
+    using scope = std::unordered_map<Name, int64_t>;
+    using array_scope = std::unordered_map<Name, ArrayStorage>;
     std::vector<scope> scopes_;
+    std::vector<array_scope> array_scopes_;
+    // First scope of the running function; lookups stop there.
+    std::size_t call_scope_ = 0;
+
+    // Frame mode: variables are addressed by the indices SemanticChecker
+    // assigned, `defined_` tracks which of them currently exist. An array
+    // variable keeps its elements in `arrays_` at its frame index.
+    //
+    // The three vectors are one stack of frames: the program's frame at the
+    // bottom, one frame per active call above it. Indices are relative to
+    // the running frame, which spans [base_, top_).
+    std::vector<int64_t> frame_;
+    std::vector<ArrayStorage> arrays_;
+    std::vector<std::uint8_t> defined_;
+    std::size_t base_ = 0;
+    std::size_t top_ = 0;
+    bool has_frame_ = false;
 
 public:
     VarTable();
+    explicit VarTable(std::size_t frame_size);
+
+    bool has_frame() const
+    {
+        return has_frame_;
+    }
 
     void enter_scope();
     void leave_scope(const SourceRange& loc = {});
 
-    void declare_in_cur_scope(const std::string& name,
+    void declare_in_cur_scope(Name name,
                               int64_t value = 0,
                               const SourceRange& loc = {});
 
-    int64_t lookup(const std::string& name, const SourceRange& loc = {});
-    void assign_or_create(const std::string& name, int64_t value);
+    int64_t lookup(Name name, const SourceRange& loc = {});
+    void assign_or_create(Name name, int64_t value);
+
+    ArrayStorage& lookup_array(Name name, const SourceRange& loc = {});
+    ArrayStorage& assign_or_create_array(Name name);
+
+    void release(const FrameRange& range);
+
+    // Starts a function's frame of `frame_size` slots (or, without a
+    // frame, a fresh scope that hides the caller's variables) and returns
+    // what leave_call() needs to get back to the caller.
+    std::size_t enter_call(std::size_t frame_size);
+    void leave_call(std::size_t caller);
+
+    void declare_at(std::uint32_t index,
+                    Name name,
+                    int64_t value = 0,
+                    const SourceRange& loc = {})
+    {
+        const auto slot = base_ + index;
+        if (defined_[slot]) {
+            throw_already_declared(name, loc);
+        }
+        frame_[slot] = value;
+        defined_[slot] = 1;
+    }
+
+    bool is_defined(std::uint32_t index) const
+    {
+        return defined_[base_ + index] != 0;
+    }
+
+    int64_t load(std::uint32_t index,
+                 Name name,
+                 const SourceRange& loc = {}) const
+    {
+        const auto slot = base_ + index;
+        if (!defined_[slot]) {
+            throw_undefined(name, loc);
+        }
+        return frame_[slot];
+    }
+
+    void store(std::uint32_t index, int64_t value)
+    {
+        const auto slot = base_ + index;
+        frame_[slot] = value;
+        defined_[slot] = 1;
+    }
+
+    ArrayStorage& load_array(std::uint32_t index,
+                             Name name,
+                             const SourceRange& loc = {})
+    {
+        const auto slot = base_ + index;
+        if (!defined_[slot]) {
+            throw_undefined(name, loc);
+        }
+        return arrays_[slot];
+    }
+
+    // Defines the array at `index`; its old elements are left for the
+    // caller to overwrite, so the buffer is reused.
+    ArrayStorage& store_array(std::uint32_t index)
+    {
+        const auto slot = base_ + index;
+        defined_[slot] = 1;
+        return arrays_[slot];
+    }
+
+private:
+    [[noreturn]] static void throw_already_declared(Name name,
+                                                    const SourceRange& loc);
+    [[noreturn]] static void throw_undefined(Name name, const SourceRange& loc);
 };
 
 } // namespace ast
@@ -0,0 +1,52 @@
+#ifndef BATCH_RUNNER_HPP
+#define BATCH_RUNNER_HPP
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace batch {
+
+// One program of a batch: the source file, the file its `?` reads come
+// from ("-" for no input) and the file its output is written to.
+struct Task
+{
+    std::string program;
+    std::string input;
+    std::string output;
+};
+
+struct Options
+{
+    bool tree_walk = false;
+    int opt_level = 0;
+    // Worker threads; zero means one per hardware thread.
+    std::size_t jobs = 0;
+};
+
+struct Result
+{
+    bool ok = false;
+    // What paracl-cli would have written to stderr for this program.
+    std::string diagnostics;
+};
+
+// Reads a manifest with one task per line: three whitespace-separated
+// paths, program, stdin and stdout. Blank lines and lines starting with
+// '#' are skipped. Throws std::runtime_error on a malformed line; `name`
+// is the manifest's file name for the message.
+std::vector<Task> read_manifest(std::istream& in, const std::string& name);
+
+// Runs one task on the calling thread. The task gets its own driver,
+// checker and interpreter, and touches no stream shared with other tasks.
+Result run_task(const Task& task, const Options& options);
+
+// Runs every task on a WorkStealingPool of `options.jobs` workers. The
+// results are in the order of `tasks`.
+std::vector<Result> run_batch(const std::vector<Task>& tasks,
+                              const Options& options);
+
+} // namespace batch
+
+#endif // BATCH_RUNNER_HPP
@@ -0,0 +1,68 @@
+#ifndef WORK_STEALING_POOL_HPP
+#define WORK_STEALING_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace batch {
+
+// Fixed set of worker threads that run indexed jobs. Every worker owns a
+// queue of indices, takes work from its back and, once it runs dry, steals
+// from the front of the other queues, so a few long jobs do not leave the
+// rest of the pool idle.
+class WorkStealingPool
+{
+public:
+    // Zero means one worker per hardware thread.
+    explicit WorkStealingPool(std::size_t workers = 0);
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+    ~WorkStealingPool();
+
+    std::size_t size() const
+    {
+        return threads_.size();
+    }
+
+    // Calls `job(i)` once for every i in [0, count) and returns when all
+    // calls have finished. The first exception a job throws is rethrown
+    // here once the rest of the jobs are done.
+    void run(std::size_t count, const std::function<void(std::size_t)>& job);
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::size_t> indices;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(std::size_t)>* job_ = nullptr;
+    std::uint64_t generation_ = 0;
+    std::size_t pending_ = 0;
+    // Workers between waking up for a run and going back to sleep; run()
+    // waits for them too, so none is left holding the previous job.
+    std::size_t busy_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+
+    void work(std::size_t self);
+    bool take(std::size_t self, std::size_t& index);
+};
+
+} // namespace batch
+
+#endif // WORK_STEALING_POOL_HPP
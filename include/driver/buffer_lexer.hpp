@@ -0,0 +1,43 @@
+#ifndef BUFFER_LEXER_HPP
+#define BUFFER_LEXER_HPP
+
+#include "grammar.tab.hh"
+
+#include <cstddef>
+#include <string_view>
+
+namespace yy {
+
+// Hand-written scanner for the same language as grammar.l. It reads a
+// contiguous buffer in place instead of going through yyFlexLexer and an
+// istream, and dispatches on the first byte of each token through
+// character-class and token tables, and moves `loc` the same way
+// Scanner::next() does. The buffer must outlive the lexer and every text()
+// it hands out.
+class BufferLexer
+{
+public:
+    explicit BufferLexer(std::string_view source);
+
+    // Scans the next token and returns its type, or YYEOF at the end of
+    // the buffer. Skipped whitespace and comments advance `loc` the same
+    // way the Flex scanner does; on return `loc` spans the token.
+    parser::token_type next(parser::location_type& loc);
+
+    // Spelling of the last token returned by next().
+    std::string_view text() const
+    {
+        return text_;
+    }
+
+private:
+    const char* pos_;
+    const char* end_;
+    std::string_view text_;
+
+    parser::token_type scan_token();
+};
+
+} // namespace yy
+
+#endif // BUFFER_LEXER_HPP
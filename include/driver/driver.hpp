@@ -2,60 +2,120 @@
 #define DRIVER_HPP
 
 #include "grammar.tab.hh"
-#include <FlexLexer.h>
 
+#include <charconv>
 #include <cstddef>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <streambuf>
 #include <string>
+#include <string_view>
+#include <system_error>
 #include <utility>
 
 #include "AST/AST.hpp"
+#include "driver/buffer_lexer.hpp"
 #include "driver/location_utils.hpp"
-#include "driver/scanner_location_bridge.hpp"
+#include "driver/scanner.hpp"
 #include "errors-output/error-formatter.hpp"
 
+// Scanner used by the string_view and istream constructors of NumDriver:
+// BufferLexer when nonzero, the Flex scanner otherwise. CMake sets it from
+// the option of the same name.
+#ifndef PARACL_BUFFER_LEXER
+#define PARACL_BUFFER_LEXER 1
+#endif
+
 namespace yy {
 
 class NumDriver
 {
 private:
-    FlexLexer* plex_;
+    // Read-only get area over a source buffer, so Flex can scan it without
+    // a copy.
+    class ViewBuf : public std::streambuf
+    {
+    public:
+        explicit ViewBuf(std::string_view view)
+        {
+            char* begin = const_cast<char*>(view.data());
+            setg(begin, begin, begin + view.size());
+        }
+    };
+
+    Scanner* plex_ = nullptr;
+    std::unique_ptr<Scanner> owned_plex_;
+    std::optional<ViewBuf> view_buf_;
+    std::optional<std::istream> view_stream_;
+    std::string source_;
+    std::optional<BufferLexer> blex_;
     std::string filename_;
+    std::ostream* errors_ = &std::cerr;
     location loc_;
+    std::shared_ptr<ast::NodeArena> arena_ = std::make_shared<ast::NodeArena>();
     ast::AST ast_;
     int error_cnt_ = 0;
 
 public:
-    explicit NumDriver(FlexLexer* plex, std::string fn = "")
+    explicit NumDriver(Scanner* plex, std::string fn = "")
       : plex_(plex)
       , filename_(std::move(fn))
     {
         loc_.initialize(&filename_);
     }
 
+    // Scans `source` in place with the scanner selected by
+    // PARACL_BUFFER_LEXER. The buffer must outlive parse().
+    explicit NumDriver(std::string_view source, std::string fn = "")
+      : NumDriver(static_cast<Scanner*>(nullptr), std::move(fn))
+    {
+#if PARACL_BUFFER_LEXER
+        blex_.emplace(source);
+#else
+        view_buf_.emplace(source);
+        view_stream_.emplace(&*view_buf_);
+        owned_plex_ = std::make_unique<Scanner>(&*view_stream_);
+        plex_ = owned_plex_.get();
+#endif
+    }
+
+    // Reads `input` with the scanner selected by PARACL_BUFFER_LEXER. The
+    // buffer lexer needs the whole source up front, so it is read here.
+    explicit NumDriver(std::istream& input, std::string fn = "")
+      : NumDriver(static_cast<Scanner*>(nullptr), std::move(fn))
+    {
+#if PARACL_BUFFER_LEXER
+        source_.assign(std::istreambuf_iterator<char>(input), {});
+        blex_.emplace(source_);
+#else
+        owned_plex_ = std::make_unique<Scanner>(&input);
+        plex_ = owned_plex_.get();
+#endif
+    }
+
     parser::token_type yylex(parser::semantic_type* yylval,
                              parser::location_type* yylloc)
     {
-        loc_.step();
-
-        auto* prev = scanner_active_driver();
-        scanner_set_active_driver(this);
         parser::token_type tt;
-        try {
-            tt = static_cast<parser::token_type>(plex_->yylex());
-        } catch (...) {
-            scanner_set_active_driver(prev);
-            throw;
+        std::string_view text;
+        if (blex_) {
+            tt = blex_->next(loc_);
+            text = blex_->text();
+        } else {
+            tt = plex_->next(loc_);
+            text = std::string_view(plex_->YYText(),
+                                    static_cast<std::size_t>(plex_->YYLeng()));
         }
-        scanner_set_active_driver(prev);
-
-        loc_.columns(plex_->YYLeng());
         *yylloc = loc_;
 
         if (tt == parser::token_type::NUMBER)
-            yylval->emplace<int64_t>(std::stoll(plex_->YYText()));
+            yylval->emplace<int64_t>(number_value(text));
+        // Identifiers are interned here, so the parser and everything
+        // after it see only the id.
         if (tt == parser::token_type::VAR)
-            yylval->emplace<std::string>(plex_->YYText());
+            yylval->emplace<ast::Name>(text);
 
         return tt;
     }
@@ -63,10 +123,16 @@ public:
     void add_error(const location& loc, const std::string& msg)
     {
         auto range = to_source_range(loc);
-        std::cerr << err::format_error(range, msg) << std::endl;
+        *errors_ << err::format_error(range, msg) << std::endl;
         error_cnt_++;
     }
 
+    // Syntax errors are written here, std::cerr by default.
+    void set_error_stream(std::ostream& errors)
+    {
+        errors_ = &errors;
+    }
+
     bool has_errors() const
     {
         return error_cnt_ > 0;
@@ -90,9 +156,22 @@ public:
         return loc_;
     }
 
+    // Nodes built by the parser go to this arena; null builds them on the
+    // heap one by one.
+    void set_arena(std::shared_ptr<ast::NodeArena> arena)
+    {
+        arena_ = std::move(arena);
+    }
+
+    template<typename NodeT, typename... Args>
+    std::unique_ptr<NodeT> make_node(Args&&... args)
+    {
+        return ast::make_node<NodeT>(arena_.get(), std::forward<Args>(args)...);
+    }
+
     void set_ast_root(std::unique_ptr<ast::BaseNode> root)
     {
-        ast_.set_root(std::move(root));
+        ast_.set_root(std::move(root), arena_);
     }
 
     const ast::AST& get_ast() const
@@ -100,22 +179,26 @@ public:
         return ast_;
     }
 
-    void advance_columns(std::size_t count)
+    // Hands the parsed tree (and its arena) to the caller without copying;
+    // the driver is left with an empty AST.
+    ast::AST take_ast()
     {
-        if (count == 0)
-            return;
-
-        loc_.columns(static_cast<int>(count));
-        loc_.step();
+        return std::exchange(ast_, ast::AST());
     }
 
-    void advance_newlines(std::size_t count)
+private:
+    // Literals are plain digit strings, so the only failure is one that does
+    // not fit in int64; it is reported as a syntax error.
+    std::int64_t number_value(std::string_view text)
     {
-        if (count == 0)
-            return;
-
-        loc_.lines(static_cast<int>(count));
-        loc_.step();
+        std::int64_t value = 0;
+        const auto [end, ec] =
+            std::from_chars(text.data(), text.data() + text.size(), value);
+        if (ec == std::errc::result_out_of_range) {
+            add_error(loc_, "Integer literal is out of range");
+            return 0;
+        }
+        return value;
     }
 };
 
@@ -12,7 +12,7 @@ inline ast::SourceRange to_source_range(const yy::parser::location_type& loc)
     range.end_line = static_cast<std::uint32_t>(loc.end.line);
     range.end_column = static_cast<std::uint32_t>(loc.end.column);
     if (loc.begin.filename) {
-        range.file = *loc.begin.filename;
+        range.file = ast::FileTable::intern(*loc.begin.filename);
     }
     return range;
 }
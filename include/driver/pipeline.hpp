@@ -0,0 +1,30 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include "AST/AST.hpp"
+#include "Visitors/SemanticChecker.hpp"
+
+#include <optional>
+#include <ostream>
+
+namespace yy {
+
+// A program that passed the semantic checker, together with the checker
+// that describes its frame layout.
+struct CheckedProgram
+{
+    ast::AST tree;
+    ast::SemanticChecker checker;
+};
+
+// The steps paracl-cli and paracl-batch share between parsing and a
+// backend: checks `tree` and, at `opt_level` 1 and above, runs the
+// optimizer passes on it. Null once the errors have been written to
+// `diagnostics`.
+std::optional<CheckedProgram> check_program(ast::AST tree,
+                                            int opt_level,
+                                            std::ostream& diagnostics);
+
+} // namespace yy
+
+#endif // PIPELINE_HPP
@@ -0,0 +1,45 @@
+#ifndef PROGRAM_CACHE_HPP
+#define PROGRAM_CACHE_HPP
+
+#include "Bytecode/Bytecode.hpp"
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace yy {
+
+// Compiled programs kept on disk between runs, one file per entry under
+// `dir`. An entry is keyed by the source text, the optimization level and
+// the compiler version, so editing a program, changing -O or upgrading
+// ParaCL all miss. Only programs that passed the semantic checker are
+// stored; a hit skips the parser and the checker and maps the entry with
+// mmap. The cache is best effort: unreadable, stale or corrupt entries
+// are misses, and failures to write one are ignored.
+class ProgramCache
+{
+public:
+    explicit ProgramCache(std::string dir);
+
+    // The program compiled from `source` at `opt_level`, with its locations
+    // pointing at `path`, or null on a miss.
+    std::optional<ast::bytecode::Program> load(std::string_view source,
+                                               int opt_level,
+                                               const std::string& path) const;
+
+    // Writes the entry through a temporary file and a rename, so concurrent
+    // runs never see half of one. Returns false if it could not.
+    bool store(std::string_view source,
+               int opt_level,
+               const ast::bytecode::Program& program) const;
+
+    // Where the entry for `source` at `opt_level` lives.
+    std::string entry_path(std::string_view source, int opt_level) const;
+
+private:
+    std::string dir_;
+};
+
+} // namespace yy
+
+#endif // PROGRAM_CACHE_HPP
@@ -0,0 +1,69 @@
+#ifndef SCANNER_HPP
+#define SCANNER_HPP
+
+#include "grammar.tab.hh"
+
+#if !defined(yyFlexLexerOnce)
+#include <FlexLexer.h>
+#endif
+
+#include <cstddef>
+#include <istream>
+
+namespace yy {
+
+// The Flex scanner generated from grammar.l (`%option yyclass`). The rules
+// for whitespace, newlines and comments record what they skip in the
+// scanner itself, and next() applies it to the caller's location, so any
+// number of scanners can run at once on different threads.
+class Scanner : public yyFlexLexer
+{
+public:
+    explicit Scanner(std::istream* in = nullptr)
+      : yyFlexLexer(in)
+    {
+    }
+
+    // Generated by Flex. Returns the next token and leaves the skipped
+    // input for next() to account for.
+    int yylex() override;
+
+    // Scans the next token and returns its type, or YYEOF at the end of
+    // the input. Skipped whitespace, newlines and comments advance `loc`;
+    // on return `loc` spans the token.
+    parser::token_type next(parser::location_type& loc)
+    {
+        loc.step();
+        skipped_lines_ = 0;
+        skipped_columns_ = 0;
+        const auto type = static_cast<parser::token_type>(yylex());
+        if (skipped_lines_ != 0) {
+            loc.lines(static_cast<int>(skipped_lines_));
+        }
+        loc.columns(static_cast<int>(skipped_columns_));
+        loc.step();
+        loc.columns(YYLeng());
+        return type;
+    }
+
+private:
+    // Input skipped by the current yylex() call: newlines, then the
+    // columns after the last of them.
+    std::size_t skipped_lines_ = 0;
+    std::size_t skipped_columns_ = 0;
+
+    void skip_columns(int count)
+    {
+        skipped_columns_ += static_cast<std::size_t>(count);
+    }
+
+    void skip_lines(int count)
+    {
+        skipped_lines_ += static_cast<std::size_t>(count);
+        skipped_columns_ = 0;
+    }
+};
+
+} // namespace yy
+
+#endif // SCANNER_HPP
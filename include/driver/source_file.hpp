@@ -0,0 +1,50 @@
+#ifndef SOURCE_FILE_HPP
+#define SOURCE_FILE_HPP
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace yy {
+
+// Read-only contents of a program file, handed to the lexer as one
+// string_view. Regular files are mapped with mmap, so neither the loader
+// nor the lexer copies them; anything that cannot be mapped (pipes,
+// character devices, empty files) is read into an owned buffer instead.
+class SourceFile
+{
+public:
+    // Null if the file cannot be opened or read.
+    static std::optional<SourceFile> open(const std::string& path);
+
+    SourceFile(SourceFile&& other) noexcept;
+    SourceFile& operator=(SourceFile&& other) noexcept;
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+    ~SourceFile();
+
+    std::string_view text() const
+    {
+        return mapping_ != nullptr ? std::string_view(mapping_, size_)
+                                   : std::string_view(buffer_);
+    }
+
+    bool is_mapped() const
+    {
+        return mapping_ != nullptr;
+    }
+
+private:
+    SourceFile() = default;
+
+    void unmap();
+
+    const char* mapping_ = nullptr;
+    std::size_t size_ = 0;
+    std::string buffer_;
+};
+
+} // namespace yy
+
+#endif // SOURCE_FILE_HPP
@@ -0,0 +1,664 @@
+#include "AST/AstImage.hpp"
+#include "Bytecode/ProgramImage.hpp"
+
+#include <array>
+#include <bit>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ast {
+
+namespace {
+
+constexpr char kMagic[8] = { 'P', 'C', 'L', 'A', 'S', 'T', '\0', '\0' };
+constexpr std::uint32_t kByteOrder = 0x01020304;
+constexpr std::uint32_t kNoName = 0xffffffff;
+
+struct Header
+{
+    char magic[8] = {};
+    std::uint32_t version = 0;
+    std::uint32_t byte_order = 0;
+    std::uint32_t num_nodes = 0;
+    std::uint32_t num_params = 0;
+    std::uint32_t num_names = 0;
+    std::uint32_t spelling_size = 0;
+    std::uint64_t checksum = 0;
+};
+
+static_assert(sizeof(Header) == 40);
+
+struct NameEntry
+{
+    std::uint32_t offset = 0;
+    std::uint32_t size = 0;
+};
+
+// How a node keeps its children: in named slots that may be empty, or as
+// a list.
+struct Shape
+{
+    std::size_t slots = 0;
+    bool list = false;
+};
+
+Shape shape_of(base_node_type type)
+{
+    switch (type) {
+        case base_node_type::unop:
+        case base_node_type::print:
+        case base_node_type::expr:
+        case base_node_type::var_decl:
+        case base_node_type::func:
+        case base_node_type::return_node:
+            return { 1, false };
+        case base_node_type::bin_arith_op:
+        case base_node_type::bin_logic_op:
+        case base_node_type::assign:
+        case base_node_type::while_node:
+        case base_node_type::index:
+            return { 2, false };
+        case base_node_type::if_node:
+            return { 3, false };
+        case base_node_type::for_node:
+            return { 4, false };
+        case base_node_type::scope:
+        case base_node_type::array:
+        case base_node_type::call:
+            return { 0, true };
+        case base_node_type::value:
+        case base_node_type::var:
+        case base_node_type::input:
+        case base_node_type::err:
+        case base_node_type::empty:
+        case base_node_type::base:
+            return {};
+    }
+    return {};
+}
+
+// Number of values of the enum a node keeps in its `op` byte.
+std::uint32_t num_ops(base_node_type type)
+{
+    switch (type) {
+        case base_node_type::unop:
+            return 3;
+        case base_node_type::bin_arith_op:
+            return 5;
+        case base_node_type::bin_logic_op:
+            return 9;
+        case base_node_type::array:
+            return 2;
+        case base_node_type::base:
+        case base_node_type::scope:
+        case base_node_type::value:
+        case base_node_type::print:
+        case base_node_type::assign:
+        case base_node_type::var:
+        case base_node_type::expr:
+        case base_node_type::if_node:
+        case base_node_type::while_node:
+        case base_node_type::for_node:
+        case base_node_type::input:
+        case base_node_type::var_decl:
+        case base_node_type::err:
+        case base_node_type::empty:
+        case base_node_type::index:
+        case base_node_type::func:
+        case base_node_type::call:
+        case base_node_type::return_node:
+            return 1;
+    }
+    return 1;
+}
+
+bool has_name(base_node_type type)
+{
+    return type == base_node_type::var || type == base_node_type::var_decl ||
+           type == base_node_type::func || type == base_node_type::call;
+}
+
+using SlotArray = std::array<const BaseNode*, 4>;
+
+SlotArray slots_of(const BaseNode& node)
+{
+    switch (node.node_type()) {
+        case base_node_type::unop:
+            return { static_cast<const UnOpNode&>(node).operand() };
+        case base_node_type::print:
+            return { static_cast<const PrintNode&>(node).expr() };
+        case base_node_type::expr:
+            return { static_cast<const ExprNode&>(node).expr() };
+        case base_node_type::var_decl:
+            return { static_cast<const VarDeclNode&>(node).init_expr() };
+        case base_node_type::func:
+            return { static_cast<const FuncNode&>(node).body() };
+        case base_node_type::return_node:
+            return { static_cast<const ReturnNode&>(node).expr() };
+        case base_node_type::bin_arith_op: {
+            const auto& op = static_cast<const BinArithOpNode&>(node);
+            return { op.left(), op.right() };
+        }
+        case base_node_type::bin_logic_op: {
+            const auto& op = static_cast<const BinLogicOpNode&>(node);
+            return { op.left(), op.right() };
+        }
+        case base_node_type::assign: {
+            const auto& assign = static_cast<const AssignNode&>(node);
+            return { assign.lhs(), assign.rhs() };
+        }
+        case base_node_type::while_node: {
+            const auto& loop = static_cast<const WhileNode&>(node);
+            return { loop.condition(), loop.body() };
+        }
+        case base_node_type::index: {
+            const auto& index = static_cast<const IndexNode&>(node);
+            return { index.base(), index.index() };
+        }
+        case base_node_type::if_node: {
+            const auto& branch = static_cast<const IfNode&>(node);
+            return { branch.condition(),
+                     branch.then_branch(),
+                     branch.else_branch() };
+        }
+        case base_node_type::for_node: {
+            const auto& loop = static_cast<const ForNode&>(node);
+            return { loop.get_init(),
+                     loop.get_cond(),
+                     loop.get_step(),
+                     loop.get_body() };
+        }
+        case base_node_type::base:
+        case base_node_type::scope:
+        case base_node_type::value:
+        case base_node_type::var:
+        case base_node_type::input:
+        case base_node_type::err:
+        case base_node_type::empty:
+        case base_node_type::array:
+        case base_node_type::call:
+            return {};
+    }
+    return {};
+}
+
+std::uint8_t op_of(const BaseNode& node)
+{
+    switch (node.node_type()) {
+        case base_node_type::unop:
+            return static_cast<std::uint8_t>(
+                static_cast<const UnOpNode&>(node).op());
+        case base_node_type::bin_arith_op:
+            return static_cast<std::uint8_t>(
+                static_cast<const BinArithOpNode&>(node).op());
+        case base_node_type::bin_logic_op:
+            return static_cast<std::uint8_t>(
+                static_cast<const BinLogicOpNode&>(node).op());
+        case base_node_type::array:
+            return static_cast<std::uint8_t>(
+                static_cast<const ArrayNode&>(node).init());
+        case base_node_type::base:
+        case base_node_type::scope:
+        case base_node_type::value:
+        case base_node_type::print:
+        case base_node_type::assign:
+        case base_node_type::var:
+        case base_node_type::expr:
+        case base_node_type::if_node:
+        case base_node_type::while_node:
+        case base_node_type::for_node:
+        case base_node_type::input:
+        case base_node_type::var_decl:
+        case base_node_type::err:
+        case base_node_type::empty:
+        case base_node_type::index:
+        case base_node_type::func:
+        case base_node_type::call:
+        case base_node_type::return_node:
+            return 0;
+    }
+    return 0;
+}
+
+Name name_of(const BaseNode& node)
+{
+    switch (node.node_type()) {
+        case base_node_type::var:
+            return static_cast<const VarNode&>(node).name();
+        case base_node_type::var_decl:
+            return static_cast<const VarDeclNode&>(node).name();
+        case base_node_type::func:
+            return static_cast<const FuncNode&>(node).name();
+        case base_node_type::call:
+            return static_cast<const CallNode&>(node).name();
+        case base_node_type::base:
+        case base_node_type::bin_arith_op:
+        case base_node_type::bin_logic_op:
+        case base_node_type::unop:
+        case base_node_type::scope:
+        case base_node_type::value:
+        case base_node_type::print:
+        case base_node_type::assign:
+        case base_node_type::expr:
+        case base_node_type::if_node:
+        case base_node_type::while_node:
+        case base_node_type::for_node:
+        case base_node_type::input:
+        case base_node_type::err:
+        case base_node_type::empty:
+        case base_node_type::array:
+        case base_node_type::index:
+        case base_node_type::return_node:
+            return Name();
+    }
+    return Name();
+}
+
+template <typename T> void append(std::string& out, const T& value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T> T load(const char* bytes)
+{
+    T value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+[[noreturn]] void corrupt()
+{
+    throw std::runtime_error("Corrupt AST image");
+}
+
+class ImageWriter
+{
+public:
+    void write(const BaseNode& root, std::ostream& out)
+    {
+        // The node list doubles as the breadth-first queue.
+        nodes_.push_back(&root);
+        for (std::size_t i = 0; i < nodes_.size(); ++i) {
+            add_record(*nodes_[i]);
+        }
+
+        std::string body = records_;
+        for (const auto param : params_) {
+            append(body, param);
+        }
+        for (const auto& entry : names_) {
+            append(body, entry);
+        }
+        body += spelling_;
+
+        Header header;
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kAstImageVersion;
+        header.byte_order = kByteOrder;
+        header.num_nodes = static_cast<std::uint32_t>(nodes_.size());
+        header.num_params = static_cast<std::uint32_t>(params_.size());
+        header.num_names = static_cast<std::uint32_t>(names_.size());
+        header.spelling_size = static_cast<std::uint32_t>(spelling_.size());
+        header.checksum = bytecode::content_hash(body);
+
+        std::string head;
+        append(head, header);
+        out << head << body;
+    }
+
+private:
+    std::vector<const BaseNode*> nodes_;
+    std::string records_;
+    std::vector<std::uint32_t> params_;
+    std::vector<NameEntry> names_;
+    std::string spelling_;
+    std::unordered_map<NameTable::NameId, std::uint32_t> name_index_;
+
+    std::uint32_t intern(Name name)
+    {
+        const auto [it, inserted] = name_index_.emplace(
+            name.id(), static_cast<std::uint32_t>(names_.size()));
+        if (inserted) {
+            const auto spelling = name.view();
+            names_.push_back({ static_cast<std::uint32_t>(spelling_.size()),
+                               static_cast<std::uint32_t>(spelling.size()) });
+            spelling_ += spelling;
+        }
+        return it->second;
+    }
+
+    void add_record(const BaseNode& node)
+    {
+        const auto type = node.node_type();
+        if (type == base_node_type::base) {
+            throw std::runtime_error("Cannot write a base node to an image");
+        }
+
+        detail::NodeRecord rec;
+        rec.type = static_cast<std::uint8_t>(type);
+        rec.op = op_of(node);
+        rec.name = has_name(type) ? intern(name_of(node)) : kNoName;
+        rec.first_child = static_cast<std::uint32_t>(nodes_.size());
+
+        const auto shape = shape_of(type);
+        if (shape.list) {
+            for (const auto& child : node.children()) {
+                nodes_.push_back(child.get());
+            }
+        } else {
+            const auto slots = slots_of(node);
+            for (std::size_t s = 0; s < shape.slots; ++s) {
+                if (slots[s] != nullptr) {
+                    rec.slots = static_cast<std::uint8_t>(rec.slots | 1u << s);
+                    nodes_.push_back(slots[s]);
+                }
+            }
+        }
+        rec.child_count =
+            static_cast<std::uint32_t>(nodes_.size()) - rec.first_child;
+
+        if (type == base_node_type::value) {
+            rec.value = static_cast<const ValueNode&>(node).value();
+        }
+        if (type == base_node_type::func) {
+            const auto& params = static_cast<const FuncNode&>(node).params();
+            rec.first_param = static_cast<std::uint32_t>(params_.size());
+            rec.param_count = static_cast<std::uint32_t>(params.size());
+            for (const auto param : params) {
+                params_.push_back(intern(param));
+            }
+        }
+
+        const auto& loc = node.location();
+        rec.has_file = loc.file != FileTable::kNoFile;
+        rec.begin_line = loc.begin_line;
+        rec.begin_column = loc.begin_column;
+        rec.end_line = loc.end_line;
+        rec.end_column = loc.end_column;
+        append(records_, rec);
+    }
+};
+
+} // namespace
+
+SourceRange NodeView::location() const
+{
+    const auto rec = record();
+    SourceRange loc;
+    loc.file = rec.has_file != 0 ? image_->file_ : FileTable::kNoFile;
+    loc.begin_line = rec.begin_line;
+    loc.begin_column = rec.begin_column;
+    loc.end_line = rec.end_line;
+    loc.end_column = rec.end_column;
+    return loc;
+}
+
+std::string_view NodeView::name() const
+{
+    return image_->name(record().name);
+}
+
+NodeView NodeView::child(std::size_t idx) const
+{
+    return image_->node(record().first_child + idx);
+}
+
+NodeView NodeView::slot(std::size_t idx) const
+{
+    const auto rec = record();
+    if ((rec.slots >> idx & 1u) == 0) {
+        return NodeView();
+    }
+    const auto below = rec.slots & ((1u << idx) - 1u);
+    return image_->node(rec.first_child +
+                        static_cast<std::size_t>(std::popcount(below)));
+}
+
+std::string_view NodeView::param(std::size_t idx) const
+{
+    const auto* at =
+        image_->params_ + (record().first_param + idx) * sizeof(std::uint32_t);
+    return image_->name(load<std::uint32_t>(at));
+}
+
+AstImage::AstImage(std::string_view image, FileTable::FileId file)
+  : image_(image)
+  , file_(file)
+{
+    if (!is_image(image)) {
+        throw std::runtime_error("Not an AST image");
+    }
+    const auto header = load<Header>(image.data());
+    if (header.version != kAstImageVersion ||
+        header.byte_order != kByteOrder) {
+        throw std::runtime_error("Unsupported AST image version");
+    }
+
+    const auto body = image.substr(sizeof(Header));
+    const auto expected =
+        std::uint64_t{ header.num_nodes } * sizeof(detail::NodeRecord) +
+        std::uint64_t{ header.num_params } * sizeof(std::uint32_t) +
+        std::uint64_t{ header.num_names } * sizeof(NameEntry) +
+        header.spelling_size;
+    if (header.num_nodes == 0 || expected != body.size() ||
+        bytecode::content_hash(body) != header.checksum) {
+        corrupt();
+    }
+
+    num_nodes_ = header.num_nodes;
+    num_names_ = header.num_names;
+    nodes_ = body.data();
+    params_ = nodes_ + std::size_t{ num_nodes_ } * sizeof(detail::NodeRecord);
+    names_ = params_ + std::size_t{ header.num_params } * sizeof(std::uint32_t);
+    spelling_ = names_ + std::size_t{ header.num_names } * sizeof(NameEntry);
+
+    for (std::uint32_t i = 0; i < header.num_names; ++i) {
+        const auto entry = load<NameEntry>(names_ + i * sizeof(NameEntry));
+        if (entry.offset > header.spelling_size ||
+            entry.size > header.spelling_size - entry.offset) {
+            corrupt();
+        }
+    }
+    for (std::uint32_t i = 0; i < header.num_params; ++i) {
+        if (load<std::uint32_t>(params_ + i * sizeof(std::uint32_t)) >=
+            header.num_names) {
+            corrupt();
+        }
+    }
+
+    // Breadth first, the children of node i start right after those of
+    // node i - 1; checking that makes the records exactly one tree.
+    std::uint64_t next_child = 1;
+    for (std::uint32_t i = 0; i < num_nodes_; ++i) {
+        const auto rec = node(i).record();
+        const auto type = static_cast<base_node_type>(rec.type);
+        if (rec.type > static_cast<std::uint8_t>(base_node_type::return_node) ||
+            type == base_node_type::base || rec.op >= num_ops(type) ||
+            rec.has_file > 1 || rec.first_child != next_child ||
+            (has_name(type) ? rec.name >= header.num_names
+                            : rec.name != kNoName)) {
+            corrupt();
+        }
+        next_child += rec.child_count;
+        if (next_child > num_nodes_) {
+            corrupt();
+        }
+
+        const auto shape = shape_of(type);
+        if (shape.list) {
+            if (rec.slots != 0 ||
+                (type == base_node_type::array &&
+                 static_cast<array_init_type>(rec.op) ==
+                     array_init_type::repeat &&
+                 rec.child_count > 2)) {
+                corrupt();
+            }
+        } else if (rec.slots >> shape.slots != 0 ||
+                   static_cast<std::uint32_t>(std::popcount(rec.slots)) !=
+                       rec.child_count) {
+            corrupt();
+        }
+
+        const bool func = type == base_node_type::func;
+        if ((func ? std::uint64_t{ rec.first_param } + rec.param_count >
+                        header.num_params
+                  : rec.first_param != 0 || rec.param_count != 0) ||
+            (type != base_node_type::value && rec.value != 0)) {
+            corrupt();
+        }
+    }
+    if (next_child != num_nodes_) {
+        corrupt();
+    }
+}
+
+bool AstImage::is_image(std::string_view bytes)
+{
+    return bytes.size() >= sizeof(Header) &&
+           std::memcmp(bytes.data(), kMagic, sizeof(kMagic)) == 0;
+}
+
+std::string_view AstImage::name(std::uint32_t idx) const
+{
+    if (idx == kNoName) {
+        return {};
+    }
+    const auto entry = load<NameEntry>(names_ + idx * sizeof(NameEntry));
+    return std::string_view(spelling_ + entry.offset, entry.size);
+}
+
+AST AstImage::build() const
+{
+    auto arena = std::make_shared<NodeArena>();
+    auto* a = arena.get();
+
+    // Interning takes a lock, so do it once per distinct name.
+    std::vector<Name> names;
+    names.reserve(num_names_);
+    for (std::uint32_t i = 0; i < num_names_; ++i) {
+        names.emplace_back(name(i));
+    }
+
+    // Children always come after their parent, so building from the last
+    // record back finds every child already built.
+    std::vector<BaseNode::NodePtr> built(num_nodes_);
+    for (std::size_t i = num_nodes_; i-- > 0;) {
+        const auto view = node(i);
+        const auto rec = view.record();
+        const auto type = view.type();
+        auto slot = [&](std::size_t s) -> BaseNode::NodePtr {
+            const auto child = view.slot(s);
+            if (!child) {
+                return nullptr;
+            }
+            const auto idx = static_cast<std::size_t>(
+                child.record_ - nodes_) / sizeof(detail::NodeRecord);
+            return std::move(built[idx]);
+        };
+        auto list = [&] {
+            std::vector<BaseNode::NodePtr> children;
+            children.reserve(rec.child_count);
+            for (std::size_t c = 0; c < rec.child_count; ++c) {
+                children.push_back(std::move(built[rec.first_child + c]));
+            }
+            return children;
+        };
+
+        BaseNode::NodePtr made;
+        switch (type) {
+            case base_node_type::value:
+                made = make_node<ValueNode>(a, rec.value);
+                break;
+            case base_node_type::var:
+                made = make_node<VarNode>(a, names[rec.name]);
+                break;
+            case base_node_type::input:
+                made = make_node<InputNode>(a);
+                break;
+            case base_node_type::err:
+                made = make_node<ErrorNode>(a);
+                break;
+            case base_node_type::empty:
+                made = make_node<EmptyNode>(a);
+                break;
+            case base_node_type::unop:
+                made = make_node<UnOpNode>(
+                    a, view.op<unop_node_type>(), slot(0));
+                break;
+            case base_node_type::print:
+                made = make_node<PrintNode>(a, slot(0));
+                break;
+            case base_node_type::expr:
+                made = make_node<ExprNode>(a, slot(0));
+                break;
+            case base_node_type::return_node:
+                made = make_node<ReturnNode>(a, slot(0));
+                break;
+            case base_node_type::var_decl:
+                made = make_node<VarDeclNode>(a, names[rec.name], slot(0));
+                break;
+            case base_node_type::func: {
+                std::vector<Name> params;
+                params.reserve(view.num_params());
+                for (std::size_t p = 0; p < view.num_params(); ++p) {
+                    params.push_back(names[load<std::uint32_t>(
+                        params_ + (rec.first_param + p) *
+                                      sizeof(std::uint32_t))]);
+                }
+                made = make_node<FuncNode>(
+                    a, names[rec.name], std::move(params), slot(0));
+                break;
+            }
+            case base_node_type::bin_arith_op:
+                made = make_node<BinArithOpNode>(
+                    a, view.op<bin_arith_op_type>(), slot(0), slot(1));
+                break;
+            case base_node_type::bin_logic_op:
+                made = make_node<BinLogicOpNode>(
+                    a, view.op<bin_logic_op_type>(), slot(0), slot(1));
+                break;
+            case base_node_type::assign:
+                made = make_node<AssignNode>(a, slot(0), slot(1));
+                break;
+            case base_node_type::while_node:
+                made = make_node<WhileNode>(a, slot(0), slot(1));
+                break;
+            case base_node_type::index:
+                made = make_node<IndexNode>(a, slot(0), slot(1));
+                break;
+            case base_node_type::if_node:
+                made = make_node<IfNode>(a, slot(0), slot(1), slot(2));
+                break;
+            case base_node_type::for_node:
+                made = make_node<ForNode>(
+                    a, slot(0), slot(1), slot(2), slot(3));
+                break;
+            case base_node_type::scope:
+                made = make_node<ScopeNode>(a, list());
+                break;
+            case base_node_type::array:
+                made = make_node<ArrayNode>(
+                    a, view.op<array_init_type>(), list());
+                break;
+            case base_node_type::call:
+                made = make_node<CallNode>(a, names[rec.name], list());
+                break;
+            case base_node_type::base:
+                corrupt();
+        }
+        made->set_location(view.location());
+        built[i] = std::move(made);
+    }
+    return AST(std::move(built.front()), std::move(arena));
+}
+
+void write_ast_image(const BaseNode& root, std::ostream& out)
+{
+    ImageWriter().write(root, out);
+}
+
+} // namespace ast
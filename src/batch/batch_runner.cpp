@@ -0,0 +1,179 @@
+#include "batch/batch_runner.hpp"
+
+#include "Bytecode/BytecodeCompiler.hpp"
+#include "Bytecode/VM.hpp"
+#include "Visitors/Interpreter.hpp"
+#include "batch/work_stealing_pool.hpp"
+#include "driver/driver.hpp"
+#include "driver/pipeline.hpp"
+#include "driver/source_file.hpp"
+#include "errors-output/error-formatter.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace batch {
+
+namespace {
+
+// A task's stdin: the file read through its descriptor, or an empty
+// stream for "-".
+class TaskInput
+{
+public:
+    TaskInput() = default;
+    TaskInput(const TaskInput&) = delete;
+    TaskInput& operator=(const TaskInput&) = delete;
+
+    ~TaskInput()
+    {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    bool open(const std::string& path)
+    {
+        if (path == "-") {
+            return true;
+        }
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        return fd_ >= 0;
+    }
+
+    ast::InputSource source()
+    {
+        return fd_ >= 0 ? ast::InputSource::from_fd(fd_)
+                        : ast::InputSource(empty_);
+    }
+
+private:
+    int fd_ = -1;
+    std::istringstream empty_;
+};
+
+std::string open_error(const std::string& path)
+{
+    return err::format_error(ast::SourceRange(),
+                             "Failed to open file: " + path);
+}
+
+// The same steps as paracl-cli, with every stream the task's own. Returns
+// false after writing the reason to `diagnostics`.
+bool execute(const Task& task,
+             const Options& options,
+             std::ostream& diagnostics)
+{
+    // Both files are opened up front, as a shell redirection would, so a
+    // program that fails to compile still leaves an empty output behind.
+    std::ofstream out(task.output, std::ios::binary);
+    if (!out.is_open()) {
+        diagnostics << open_error(task.output) << '\n';
+        return false;
+    }
+    TaskInput input;
+    if (!input.open(task.input)) {
+        diagnostics << open_error(task.input) << '\n';
+        return false;
+    }
+
+    const auto source = yy::SourceFile::open(task.program);
+    if (!source) {
+        diagnostics << open_error(task.program) << '\n';
+        return false;
+    }
+
+    yy::NumDriver driver(source->text(), task.program);
+    driver.set_error_stream(diagnostics);
+    if (!driver.parse() || driver.has_errors()) {
+        return false;
+    }
+
+    auto checked =
+        yy::check_program(driver.take_ast(), options.opt_level, diagnostics);
+    if (!checked) {
+        return false;
+    }
+    auto& tree = checked->tree;
+    const auto& checker = checked->checker;
+
+    if (options.tree_walk) {
+        auto interpreter = checker.hasFrameLayout()
+                               ? ast::Interpreter(checker.frameSize())
+                               : ast::Interpreter();
+        interpreter.output().set_stream(out);
+        interpreter.output().set_mode(ast::OutputSink::buffering::block);
+        interpreter.input() = input.source();
+        tree.root()->accept(interpreter);
+    } else {
+        ast::bytecode::BytecodeCompiler compiler;
+        const auto program = compiler.compile(*tree.root());
+        ast::bytecode::VM vm(program);
+        vm.output().set_stream(out);
+        vm.output().set_mode(ast::OutputSink::buffering::block);
+        vm.input() = input.source();
+        vm.run();
+    }
+    return true;
+}
+
+} // namespace
+
+std::vector<Task> read_manifest(std::istream& in, const std::string& name)
+{
+    std::vector<Task> tasks;
+    std::string line;
+    std::uint32_t line_no = 0;
+    while (std::getline(in, line)) {
+        ++line_no;
+        std::istringstream fields(line);
+        Task task;
+        if (!(fields >> task.program) || task.program.front() == '#') {
+            continue;
+        }
+
+        std::string extra;
+        if (!(fields >> task.input >> task.output) || (fields >> extra)) {
+            ast::SourceRange loc;
+            loc.file = ast::FileTable::intern(name);
+            loc.begin_line = loc.end_line = line_no;
+            loc.begin_column = loc.end_column = 1;
+            throw std::runtime_error(err::format_error(
+                loc, "Expected <program> <stdin> <stdout>"));
+        }
+        tasks.push_back(std::move(task));
+    }
+    return tasks;
+}
+
+Result run_task(const Task& task, const Options& options)
+{
+    Result result;
+    std::ostringstream diagnostics;
+    try {
+        result.ok = execute(task, options, diagnostics);
+    } catch (const std::runtime_error& ex) {
+        diagnostics << ex.what() << '\n';
+    }
+    result.diagnostics = diagnostics.str();
+    return result;
+}
+
+std::vector<Result> run_batch(const std::vector<Task>& tasks,
+                              const Options& options)
+{
+    std::vector<Result> results(tasks.size());
+    WorkStealingPool pool(options.jobs);
+    pool.run(tasks.size(), [&](std::size_t i) {
+        results[i] = run_task(tasks[i], options);
+    });
+    return results;
+}
+
+} // namespace batch
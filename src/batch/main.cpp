@@ -0,0 +1,100 @@
+#include "batch/batch_runner.hpp"
+#include "errors-output/error-formatter.hpp"
+
+#include <charconv>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+struct CliOptions
+{
+    const char* manifest = nullptr;
+    batch::Options batch;
+};
+
+bool parse_jobs(const std::string& text, std::size_t& jobs)
+{
+    const auto* end = text.data() + text.size();
+    const auto [ptr, ec] = std::from_chars(text.data(), end, jobs);
+    return ec == std::errc() && ptr == end && jobs != 0;
+}
+
+bool parse_options(int argc, char* argv[], CliOptions& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--tree-walk") {
+            options.batch.tree_walk = true;
+        } else if (arg == "-O0" || arg == "-O1") {
+            options.batch.opt_level = arg[2] - '0';
+        } else if (arg.rfind("-j", 0) == 0) {
+            if (!parse_jobs(arg.substr(2), options.batch.jobs)) {
+                return false;
+            }
+        } else if (arg == "-" || arg.empty() || arg[0] != '-') {
+            if (options.manifest != nullptr) {
+                return false;
+            }
+            options.manifest = argv[i];
+        } else {
+            return false;
+        }
+    }
+    return options.manifest != nullptr;
+}
+
+std::vector<batch::Task> load_manifest(const std::string& path)
+{
+    if (path == "-") {
+        return batch::read_manifest(std::cin, "<stdin>");
+    }
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        throw std::runtime_error(err::format_error(
+            ast::SourceRange(), "Failed to open file: " + path));
+    }
+    return batch::read_manifest(in, path);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    CliOptions options;
+    if (!parse_options(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [-j<workers>] [-O0|-O1] [--tree-walk] <manifest>\n";
+        return 1;
+    }
+
+    std::vector<batch::Task> tasks;
+    try {
+        tasks = load_manifest(options.manifest);
+    } catch (const std::runtime_error& ex) {
+        std::cerr << ex.what() << '\n';
+        return 1;
+    }
+
+    const auto results = batch::run_batch(tasks, options.batch);
+
+    std::size_t failed = 0;
+    for (const auto& result : results) {
+        std::cerr << result.diagnostics;
+        failed += result.ok ? 0 : 1;
+    }
+    if (failed != 0) {
+        std::cerr << err::format_error(ast::SourceRange(),
+                                       std::to_string(failed) + " of " +
+                                           std::to_string(results.size()) +
+                                           " programs failed")
+                  << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include "batch/work_stealing_pool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace batch {
+
+WorkStealingPool::WorkStealingPool(std::size_t workers)
+{
+    if (workers == 0) {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    queues_.reserve(workers);
+    for (std::size_t i = 0; i < workers; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    threads_.reserve(workers);
+    for (std::size_t i = 0; i < workers; ++i) {
+        threads_.emplace_back([this, i] { work(i); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::run(std::size_t count,
+                           const std::function<void(std::size_t)>& job)
+{
+    if (count == 0) {
+        return;
+    }
+
+    std::unique_lock lock(mutex_);
+    job_ = &job;
+    pending_ = count;
+    error_ = nullptr;
+    // Neighbouring indices go to different workers, so jobs of similar
+    // cost are spread out before any stealing happens.
+    for (std::size_t i = 0; i < count; ++i) {
+        auto& queue = *queues_[i % queues_.size()];
+        std::lock_guard queue_lock(queue.mutex);
+        queue.indices.push_back(i);
+    }
+    ++generation_;
+    wake_.notify_all();
+    done_.wait(lock, [this] { return pending_ == 0 && busy_ == 0; });
+    job_ = nullptr;
+
+    if (error_) {
+        std::rethrow_exception(std::exchange(error_, nullptr));
+    }
+}
+
+void WorkStealingPool::work(std::size_t self)
+{
+    std::uint64_t seen = 0;
+    for (;;) {
+        const std::function<void(std::size_t)>* job = nullptr;
+        {
+            std::unique_lock lock(mutex_);
+            wake_.wait(lock,
+                       [&] { return stopping_ || generation_ != seen; });
+            if (stopping_) {
+                return;
+            }
+            seen = generation_;
+            job = job_;
+            ++busy_;
+        }
+
+        std::size_t index = 0;
+        while (job != nullptr && take(self, index)) {
+            try {
+                (*job)(index);
+            } catch (...) {
+                std::lock_guard lock(mutex_);
+                if (!error_) {
+                    error_ = std::current_exception();
+                }
+            }
+            std::lock_guard lock(mutex_);
+            --pending_;
+        }
+
+        std::lock_guard lock(mutex_);
+        --busy_;
+        if (pending_ == 0 && busy_ == 0) {
+            done_.notify_all();
+        }
+    }
+}
+
+bool WorkStealingPool::take(std::size_t self, std::size_t& index)
+{
+    {
+        auto& own = *queues_[self];
+        std::lock_guard lock(own.mutex);
+        if (!own.indices.empty()) {
+            index = own.indices.back();
+            own.indices.pop_back();
+            return true;
+        }
+    }
+
+    for (std::size_t step = 1; step < queues_.size(); ++step) {
+        auto& victim = *queues_[(self + step) % queues_.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.indices.empty()) {
+            index = victim.indices.front();
+            victim.indices.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace batch
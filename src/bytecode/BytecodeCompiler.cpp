@@ -0,0 +1,1315 @@
+#include "Bytecode/BytecodeCompiler.hpp"
+#include "Runtime/Calls.hpp"
+#include "Visitors/ClosedFormLoops.hpp"
+#include "Visitors/detail/Evaluable.hpp"
+#include "errors-output/error-formatter.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+using ast::bytecode::op_code;
+
+constexpr std::uint32_t kTempTag = 1u << 30;
+constexpr std::uint32_t kConstTag = 2u << 30;
+constexpr std::uint32_t kTagMask = 3u << 30;
+
+constexpr unsigned kRegA = 1;
+constexpr unsigned kRegB = 2;
+constexpr unsigned kRegC = 4;
+
+// What evaluating a subtree may do besides computing its value.
+constexpr unsigned kWritesVars = 1;
+constexpr unsigned kCallsFunctions = 2;
+
+inline bool has_expr_node(const ast::BaseNode* node)
+{
+    return node != nullptr && node->node_type() != ast::base_node_type::empty;
+}
+
+bool holds_array(const ast::BaseNode& node)
+{
+    if (node.node_type() == ast::base_node_type::array) {
+        return true;
+    }
+    return node.node_type() == ast::base_node_type::var &&
+           static_cast<const ast::VarNode&>(node).kind() ==
+               ast::value_kind::array;
+}
+
+unsigned reg_operands(op_code op)
+{
+    switch (op) {
+        case op_code::add:
+        case op_code::sub:
+        case op_code::mul:
+        case op_code::div:
+        case op_code::mod:
+        case op_code::lt:
+        case op_code::le:
+        case op_code::gt:
+        case op_code::ge:
+        case op_code::eq:
+        case op_code::ne:
+        case op_code::bxor:
+            return kRegA | kRegB | kRegC;
+        case op_code::arr_fill:
+        case op_code::arr_store:
+        case op_code::arr_store_nc:
+            return kRegB | kRegC;
+        case op_code::arr_load:
+        case op_code::arr_load_nc:
+        case op_code::call:
+            return kRegA | kRegC;
+        case op_code::tail_call:
+            return kRegC;
+        case op_code::mov:
+        case op_code::neg:
+        case op_code::lnot:
+        case op_code::jlt:
+        case op_code::jle:
+        case op_code::jgt:
+        case op_code::jge:
+        case op_code::jeq:
+        case op_code::jne:
+        case op_code::store_def:
+        case op_code::declare:
+            return kRegA | kRegB;
+        case op_code::jz:
+        case op_code::jnz:
+        case op_code::input:
+        case op_code::print:
+        case op_code::load_var:
+        case op_code::store_var:
+        case op_code::arr_push:
+        case op_code::ret:
+            return kRegA;
+        case op_code::halt:
+        case op_code::jmp:
+        case op_code::undef:
+        case op_code::trap:
+        case op_code::arr_set:
+        case op_code::arr_copy:
+        case op_code::closed_form:
+            return 0;
+    }
+    return 0;
+}
+
+op_code arith_op(ast::bin_arith_op_type op)
+{
+    switch (op) {
+        case ast::bin_arith_op_type::add:
+            return op_code::add;
+        case ast::bin_arith_op_type::sub:
+            return op_code::sub;
+        case ast::bin_arith_op_type::mul:
+            return op_code::mul;
+        case ast::bin_arith_op_type::div:
+            return op_code::div;
+        case ast::bin_arith_op_type::mod:
+            return op_code::mod;
+    }
+    throw std::logic_error("Unknown binary arithmetic operator");
+}
+
+std::optional<op_code> compare_op(ast::bin_logic_op_type op)
+{
+    switch (op) {
+        case ast::bin_logic_op_type::less:
+            return op_code::lt;
+        case ast::bin_logic_op_type::less_equal:
+            return op_code::le;
+        case ast::bin_logic_op_type::greater:
+            return op_code::gt;
+        case ast::bin_logic_op_type::greater_equal:
+            return op_code::ge;
+        case ast::bin_logic_op_type::equal:
+            return op_code::eq;
+        case ast::bin_logic_op_type::not_equal:
+            return op_code::ne;
+        case ast::bin_logic_op_type::bitwise_xor:
+            return op_code::bxor;
+        case ast::bin_logic_op_type::logical_and:
+        case ast::bin_logic_op_type::logical_or:
+            return std::nullopt;
+    }
+    return std::nullopt;
+}
+
+std::optional<op_code> jump_op(ast::bin_logic_op_type op, bool when)
+{
+    switch (op) {
+        case ast::bin_logic_op_type::less:
+            return when ? op_code::jlt : op_code::jge;
+        case ast::bin_logic_op_type::less_equal:
+            return when ? op_code::jle : op_code::jgt;
+        case ast::bin_logic_op_type::greater:
+            return when ? op_code::jgt : op_code::jle;
+        case ast::bin_logic_op_type::greater_equal:
+            return when ? op_code::jge : op_code::jlt;
+        case ast::bin_logic_op_type::equal:
+            return when ? op_code::jeq : op_code::jne;
+        case ast::bin_logic_op_type::not_equal:
+            return when ? op_code::jne : op_code::jeq;
+        case ast::bin_logic_op_type::bitwise_xor:
+        case ast::bin_logic_op_type::logical_and:
+        case ast::bin_logic_op_type::logical_or:
+            return std::nullopt;
+    }
+    return std::nullopt;
+}
+
+} // namespace
+
+namespace ast::bytecode {
+
+Program BytecodeCompiler::compile(BaseNode& root)
+{
+    program_ = Program();
+    function_ids_.clear();
+    function_nodes_.clear();
+    effects_memo_.clear();
+    declare_functions(root);
+    begin_frame(program_);
+
+    scopes_.emplace_back();
+    if (root.node_type() == base_node_type::scope && root.parent() == nullptr) {
+        for (const auto& child : root.children()) {
+            collect_names(child.get(), scopes_.back());
+        }
+    } else {
+        collect_names(&root, scopes_.back());
+    }
+
+    compile_stmt(&root);
+    emit(op_code::halt, SourceRange());
+    finish(0);
+
+    for (std::size_t i = 0; i < function_nodes_.size(); ++i) {
+        compile_function(*function_nodes_[i], program_.functions[i]);
+    }
+    frame_ = nullptr;
+    return std::move(program_);
+}
+
+void BytecodeCompiler::begin_frame(FrameLayout& frame)
+{
+    frame_ = &frame;
+    scopes_.clear();
+    defined_.clear();
+    defined_log_.clear();
+    checked_.clear();
+    constants_.clear();
+    next_temp_ = 0;
+    dst_hint_ = kNoReg;
+}
+
+// Every top-level function gets its index up front, so calls compiled
+// before a definition already know it.
+void BytecodeCompiler::declare_functions(BaseNode& root)
+{
+    if (root.node_type() != base_node_type::scope) {
+        return;
+    }
+    for (const auto& stmt : root.children()) {
+        if (stmt->node_type() != base_node_type::func) {
+            continue;
+        }
+        auto* func = static_cast<FuncNode*>(stmt.get());
+        const auto index = static_cast<std::uint32_t>(function_nodes_.size());
+        if (!function_ids_.emplace(func->name(), index).second) {
+            continue;
+        }
+        function_nodes_.push_back(func);
+        Function function;
+        function.name = func->name().str();
+        function.num_params = static_cast<std::uint32_t>(func->params().size());
+        program_.functions.push_back(std::move(function));
+    }
+}
+
+void BytecodeCompiler::compile_function(FuncNode& node, Function& function)
+{
+    begin_frame(function.frame);
+    function.entry = static_cast<std::uint32_t>(here());
+
+    // The parameters are the first slots and are defined on entry.
+    scopes_.emplace_back();
+    for (const auto& param : node.params()) {
+        add_name(param, scopes_.back());
+        mark_defined(scopes_.back().slots.at(param));
+    }
+    compile_stmt(node.body());
+    emit(op_code::ret, node.location(), constant(0));
+    finish(function.entry);
+}
+
+std::size_t BytecodeCompiler::emit(op_code op,
+                                   const SourceRange& loc,
+                                   std::uint32_t a,
+                                   std::uint32_t b,
+                                   std::uint32_t c)
+{
+    program_.code.push_back(Instr{ op, a, b, c });
+    program_.locations.push_back(loc);
+    return program_.code.size() - 1;
+}
+
+std::size_t BytecodeCompiler::here() const
+{
+    return program_.code.size();
+}
+
+void BytecodeCompiler::patch(const PatchList& patches, std::size_t target)
+{
+    const auto pc = static_cast<std::uint32_t>(target);
+    for (const auto idx : patches) {
+        auto& instr = program_.code[idx];
+        if (instr.op == op_code::jmp) {
+            instr.a = pc;
+        } else if (instr.op == op_code::jz || instr.op == op_code::jnz ||
+                   instr.op == op_code::closed_form) {
+            instr.b = pc;
+        } else {
+            instr.c = pc;
+        }
+    }
+}
+
+void BytecodeCompiler::emit_trap(const std::string& formatted,
+                                 const SourceRange& loc)
+{
+    program_.messages.push_back(formatted);
+    emit(op_code::trap,
+         loc,
+         static_cast<std::uint32_t>(program_.messages.size() - 1));
+}
+
+std::uint32_t BytecodeCompiler::constant(std::int64_t value)
+{
+    const auto iter = constants_.find(value);
+    if (iter != constants_.end()) {
+        return iter->second;
+    }
+    const auto reg =
+        kConstTag | static_cast<std::uint32_t>(frame_->constants.size());
+    frame_->constants.push_back(value);
+    constants_.emplace(value, reg);
+    return reg;
+}
+
+std::uint32_t BytecodeCompiler::alloc_temp()
+{
+    const std::uint32_t reg = kTempTag | next_temp_;
+    ++next_temp_;
+    frame_->num_temps = std::max(frame_->num_temps, next_temp_);
+    return reg;
+}
+
+std::uint32_t BytecodeCompiler::dst_or_temp(std::uint32_t hint)
+{
+    return hint != kNoReg ? hint : alloc_temp();
+}
+
+std::uint32_t BytecodeCompiler::compile_expr(BaseNode& node, std::uint32_t hint)
+{
+    dst_hint_ = hint;
+    node.accept(*this);
+    dst_hint_ = kNoReg;
+    return last_reg_;
+}
+
+bool BytecodeCompiler::require_expr(const BaseNode* node,
+                                    const SourceRange& owner_loc,
+                                    const char* error_msg)
+{
+    if (has_expr_node(node)) {
+        return true;
+    }
+    emit_trap(err::format_error(owner_loc, error_msg), owner_loc);
+    last_reg_ = constant(0);
+    return false;
+}
+
+void BytecodeCompiler::compile_stmt(BaseNode* node)
+{
+    if (!has_expr_node(node)) {
+        return;
+    }
+    const auto mark = next_temp_;
+    dst_hint_ = kNoReg;
+    node->accept(*this);
+    next_temp_ = mark;
+}
+
+bool BytecodeCompiler::is_slot(std::uint32_t reg) const
+{
+    return (reg & kTagMask) == 0;
+}
+
+unsigned BytecodeCompiler::effects(const BaseNode* node)
+{
+    if (node == nullptr) {
+        return 0;
+    }
+    const auto iter = effects_memo_.find(node);
+    if (iter != effects_memo_.end()) {
+        return iter->second;
+    }
+    unsigned found = 0;
+    if (node->node_type() == base_node_type::assign ||
+        node->node_type() == base_node_type::var_decl) {
+        found |= kWritesVars;
+    }
+    // A callee has its own frame, so a call never writes the caller's
+    // variables.
+    if (node->node_type() == base_node_type::call) {
+        found |= kCallsFunctions;
+    }
+    for (const auto& child : node->children()) {
+        if (found == (kWritesVars | kCallsFunctions)) {
+            break;
+        }
+        found |= effects(child.get());
+    }
+    effects_memo_.emplace(node, found);
+    return found;
+}
+
+bool BytecodeCompiler::writes_vars(const BaseNode* node)
+{
+    return (effects(node) & kWritesVars) != 0;
+}
+
+bool BytecodeCompiler::calls_functions(const BaseNode* node)
+{
+    return (effects(node) & kCallsFunctions) != 0;
+}
+
+void BytecodeCompiler::compile_branch(BaseNode& cond,
+                                      bool when,
+                                      PatchList& patches)
+{
+    const auto mark = next_temp_;
+
+    if (cond.node_type() == base_node_type::bin_logic_op) {
+        auto& node = static_cast<BinLogicOpNode&>(cond);
+        auto* left = node.left();
+        auto* right = node.right();
+        if (!require_expr(
+                left, node.location(), "BinLogicOpNode missing operand") ||
+            !require_expr(
+                right, node.location(), "BinLogicOpNode missing operand")) {
+            return;
+        }
+
+        const bool is_and = node.op() == bin_logic_op_type::logical_and;
+        const bool is_or = node.op() == bin_logic_op_type::logical_or;
+        if (is_and || is_or) {
+            // Jump when `when` holds; `skip` short-circuits the other way.
+            const bool left_decides = is_or;
+            PatchList skip;
+            PatchList& left_patches = (when == left_decides) ? patches : skip;
+            compile_branch(*left, left_decides, left_patches);
+            const auto defined = defined_mark();
+            compile_branch(*right, when, patches);
+            restore_defined(defined);
+            patch(skip, here());
+            next_temp_ = mark;
+            return;
+        }
+
+        if (const auto jump = jump_op(node.op(), when)) {
+            auto lhs = compile_expr(*left);
+            if (is_slot(lhs) && writes_vars(right)) {
+                const auto copy = alloc_temp();
+                emit(op_code::mov, node.location(), copy, lhs);
+                lhs = copy;
+            }
+            const auto rhs = compile_expr(*right);
+            patches.push_back(emit(*jump, node.location(), lhs, rhs));
+            next_temp_ = mark;
+            return;
+        }
+    }
+
+    if (cond.node_type() == base_node_type::unop) {
+        auto& node = static_cast<UnOpNode&>(cond);
+        if (node.op() == unop_node_type::logical_not) {
+            if (require_expr(
+                    node.operand(), node.location(), "UnOpNode missing operand")) {
+                compile_branch(*node.operand(), !when, patches);
+            }
+            next_temp_ = mark;
+            return;
+        }
+    }
+
+    if (cond.node_type() == base_node_type::value) {
+        const bool truth = static_cast<ValueNode&>(cond).value() != 0;
+        if (truth == when) {
+            patches.push_back(emit(op_code::jmp, cond.location()));
+        }
+        return;
+    }
+
+    if (cond.node_type() == base_node_type::expr) {
+        auto& node = static_cast<ExprNode&>(cond);
+        if (require_expr(
+                node.expr(), node.location(), "Expression is not valid")) {
+            compile_branch(*node.expr(), when, patches);
+        }
+        next_temp_ = mark;
+        return;
+    }
+
+    const auto reg = compile_expr(cond);
+    patches.push_back(
+        emit(when ? op_code::jnz : op_code::jz, cond.location(), reg));
+    next_temp_ = mark;
+}
+
+void BytecodeCompiler::compile_loop(BaseNode* init,
+                                    BaseNode& cond,
+                                    BaseNode* body,
+                                    BaseNode* step,
+                                    const LoopReduction* reduction)
+{
+    compile_stmt(init);
+
+    std::optional<Name> tracked;
+    try {
+        tracked = detail::validate_evaluable_node(
+            cond, "Invalid condition", detail::evaluable_context::condition);
+    } catch (const std::runtime_error& ex) {
+        emit_trap(ex.what(), cond.location());
+        return;
+    }
+
+    // Rotated loop: the condition is tested once before entry and then at
+    // the bottom of every iteration, so the body needs a single jump back.
+    PatchList exit;
+    if (reduction != nullptr) {
+        compile_closed_form(*reduction, cond.location(), exit);
+    }
+    if (tracked) {
+        const auto mark = next_temp_;
+        compile_expr(cond);
+        exit.push_back(
+            emit(op_code::jz, cond.location(), read_var(*tracked)));
+        next_temp_ = mark;
+    } else {
+        compile_branch(cond, false, exit);
+    }
+
+    const auto top = here();
+    const auto defined = defined_mark();
+    compile_stmt(body);
+    compile_stmt(step);
+
+    PatchList again;
+    if (tracked) {
+        const auto mark = next_temp_;
+        again.push_back(
+            emit(op_code::jnz, cond.location(), read_var(*tracked)));
+        next_temp_ = mark;
+    } else {
+        compile_branch(cond, true, again);
+    }
+    patch(again, top);
+    restore_defined(defined);
+    patch(exit, here());
+}
+
+// The variables are looked up when the loop is entered, as load_var would,
+// so that the closed form sees exactly what the loop would.
+void BytecodeCompiler::compile_closed_form(const LoopReduction& reduction,
+                                           const SourceRange& loc,
+                                           PatchList& exit)
+{
+    std::vector<std::vector<std::uint32_t>> slots;
+    for (const auto& var : reduction.vars) {
+        slots.push_back(candidates(var.name));
+        if (slots.back().empty()) {
+            return;
+        }
+    }
+    ClosedFormLoop loop{ reduction.form, {} };
+    for (std::size_t i = 0; i < slots.size(); ++i) {
+        for (const auto slot : slots[i]) {
+            checked_[slot] = 1;
+        }
+        program_.var_refs.push_back(
+            VarRef{ reduction.vars[i].name.str(), std::move(slots[i]) });
+        loop.vars.push_back(
+            static_cast<std::uint32_t>(program_.var_refs.size() - 1));
+    }
+    program_.closed_forms.push_back(std::move(loop));
+    exit.push_back(emit(
+        op_code::closed_form,
+        loc,
+        static_cast<std::uint32_t>(program_.closed_forms.size() - 1)));
+}
+
+void BytecodeCompiler::enter_scope(BaseNode& owner)
+{
+    scopes_.emplace_back();
+    for (const auto& child : owner.children()) {
+        collect_names(child.get(), scopes_.back());
+    }
+}
+
+void BytecodeCompiler::leave_scope()
+{
+    for (const auto slot : scopes_.back().owned) {
+        if (checked_[slot]) {
+            emit(op_code::undef, SourceRange(), slot);
+        }
+        defined_[slot] = 0;
+    }
+    scopes_.pop_back();
+}
+
+void BytecodeCompiler::collect_names(const BaseNode* node, Scope& scope)
+{
+    if (node == nullptr) {
+        return;
+    }
+
+    switch (node->node_type()) {
+        case base_node_type::scope:
+        case base_node_type::if_node:
+        case base_node_type::while_node:
+        case base_node_type::for_node:
+        case base_node_type::func:
+            return;
+        case base_node_type::assign: {
+            const auto* lhs = static_cast<const AssignNode*>(node)->lhs();
+            if (lhs != nullptr && lhs->node_type() == base_node_type::var) {
+                add_name(static_cast<const VarNode*>(lhs)->name(), scope);
+            }
+            break;
+        }
+        case base_node_type::var_decl:
+            add_name(static_cast<const VarDeclNode*>(node)->name(), scope);
+            break;
+        case base_node_type::base:
+        case base_node_type::bin_arith_op:
+        case base_node_type::bin_logic_op:
+        case base_node_type::unop:
+        case base_node_type::value:
+        case base_node_type::print:
+        case base_node_type::var:
+        case base_node_type::expr:
+        case base_node_type::input:
+        case base_node_type::err:
+        case base_node_type::empty:
+        case base_node_type::array:
+        case base_node_type::index:
+        case base_node_type::call:
+        case base_node_type::return_node:
+            break;
+    }
+
+    for (const auto& child : node->children()) {
+        collect_names(child.get(), scope);
+    }
+}
+
+void BytecodeCompiler::add_name(Name name, Scope& scope)
+{
+    if (scope.slots.count(name) != 0) {
+        return;
+    }
+    const auto slot = frame_->num_slots();
+    frame_->slot_names.push_back(name.str());
+    defined_.push_back(0);
+    checked_.push_back(0);
+    scope.slots.emplace(name, slot);
+    scope.owned.push_back(slot);
+}
+
+std::vector<std::uint32_t> BytecodeCompiler::candidates(Name name) const
+{
+    std::vector<std::uint32_t> slots;
+    for (auto it = scopes_.rbegin(); it != scopes_.rend(); ++it) {
+        const auto iter = it->slots.find(name);
+        if (iter != it->slots.end()) {
+            slots.push_back(iter->second);
+        }
+    }
+    return slots;
+}
+
+std::size_t BytecodeCompiler::defined_mark() const
+{
+    return defined_log_.size();
+}
+
+void BytecodeCompiler::restore_defined(std::size_t mark)
+{
+    while (defined_log_.size() > mark) {
+        defined_[defined_log_.back()] = 0;
+        defined_log_.pop_back();
+    }
+}
+
+void BytecodeCompiler::mark_defined(std::uint32_t slot)
+{
+    if (!defined_[slot]) {
+        defined_[slot] = 1;
+        defined_log_.push_back(slot);
+    }
+}
+
+std::uint32_t BytecodeCompiler::read_var(Name name)
+{
+    auto slots = candidates(name);
+    if (slots.empty()) {
+        emit_trap(err::format_error(SourceRange(),
+                                    "Undefined variable: " + name.str()),
+                  SourceRange());
+        return constant(0);
+    }
+    if (defined_[slots.front()]) {
+        return slots.front();
+    }
+
+    for (const auto slot : slots) {
+        checked_[slot] = 1;
+    }
+    if (slots.size() == 1) {
+        mark_defined(slots.front());
+    }
+    program_.var_refs.push_back(VarRef{ name.str(), std::move(slots) });
+    const auto dst = alloc_temp();
+    emit(op_code::load_var,
+         SourceRange(),
+         dst,
+         static_cast<std::uint32_t>(program_.var_refs.size() - 1));
+    return dst;
+}
+
+std::uint32_t BytecodeCompiler::assign_var(Name name,
+                                           BaseNode& rhs,
+                                           const SourceRange& loc)
+{
+    add_name(name, scopes_.back());
+    auto slots = candidates(name);
+    const auto target = slots.front();
+
+    if (defined_[target]) {
+        const auto value = compile_expr(rhs, target);
+        if (value != target) {
+            emit(op_code::mov, loc, target, value);
+        }
+        return target;
+    }
+
+    if (slots.size() == 1) {
+        const auto value = compile_expr(rhs, target);
+        emit(op_code::store_def, loc, target, value);
+        mark_defined(target);
+        return target;
+    }
+
+    const auto value = compile_expr(rhs);
+    for (const auto slot : slots) {
+        checked_[slot] = 1;
+    }
+    program_.var_refs.push_back(VarRef{ name.str(), std::move(slots) });
+    emit(op_code::store_var,
+         loc,
+         value,
+         static_cast<std::uint32_t>(program_.var_refs.size() - 1),
+         target);
+    return value;
+}
+
+// Arrays are always resolved by the VM: the reference names every slot the
+// variable may live in, and a store defines the innermost one.
+std::optional<std::uint32_t> BytecodeCompiler::array_ref(Name name,
+                                                         bool store)
+{
+    if (store) {
+        add_name(name, scopes_.back());
+    }
+    auto slots = candidates(name);
+    if (slots.empty()) {
+        emit_trap(err::format_error(SourceRange(),
+                                    "Undefined variable: " + name.str()),
+                  SourceRange());
+        return std::nullopt;
+    }
+    for (const auto slot : slots) {
+        checked_[slot] = 1;
+    }
+    program_.var_refs.push_back(VarRef{ name.str(), std::move(slots) });
+    return static_cast<std::uint32_t>(program_.var_refs.size() - 1);
+}
+
+void BytecodeCompiler::assign_array(Name name,
+                                    BaseNode& rhs,
+                                    const SourceRange& loc)
+{
+    last_reg_ = constant(0);
+    if (rhs.node_type() == base_node_type::var) {
+        const auto src = array_ref(static_cast<VarNode&>(rhs).name(), false);
+        if (!src) {
+            return;
+        }
+        emit(op_code::arr_copy, loc, *array_ref(name, true), *src);
+        return;
+    }
+
+    auto& array = static_cast<ArrayNode&>(rhs);
+    if (array.init() == array_init_type::list) {
+        for (const auto& item : array.items()) {
+            if (!require_expr(
+                    item.get(), array.location(), "Array element is missing")) {
+                return;
+            }
+        }
+        if (calls_functions(&array)) {
+            // The callee may build a literal of its own in the VM's pending
+            // buffer, so every element is evaluated before the first push.
+            const auto mark = next_temp_;
+            std::vector<std::uint32_t> values(array.items().size());
+            for (auto& value : values) {
+                value = alloc_temp();
+            }
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                const auto value = compile_expr(*array.items()[i], values[i]);
+                if (value != values[i]) {
+                    emit(op_code::mov, array.location(), values[i], value);
+                }
+            }
+            for (const auto value : values) {
+                emit(op_code::arr_push, array.location(), value);
+            }
+            next_temp_ = mark;
+        } else {
+            for (const auto& item : array.items()) {
+                const auto mark = next_temp_;
+                emit(op_code::arr_push, array.location(), compile_expr(*item));
+                next_temp_ = mark;
+            }
+        }
+        emit(op_code::arr_set, loc, *array_ref(name, true));
+        last_reg_ = constant(0);
+        return;
+    }
+
+    auto* fill = array.fill_value();
+    auto* size = array.size_expr();
+    if (!require_expr(fill, array.location(), "repeat is missing its value") ||
+        !require_expr(size, array.location(), "repeat is missing its size")) {
+        return;
+    }
+    auto value = compile_expr(*fill);
+    if (is_slot(value) && writes_vars(size)) {
+        const auto copy = alloc_temp();
+        emit(op_code::mov, array.location(), copy, value);
+        value = copy;
+    }
+    const auto count = compile_expr(*size);
+    emit(op_code::arr_fill,
+         array.location(),
+         *array_ref(name, true),
+         value,
+         count);
+    last_reg_ = constant(0);
+}
+
+void BytecodeCompiler::store_element(IndexNode& lhs, BaseNode& rhs)
+{
+    auto* base = lhs.base();
+    auto* index = lhs.index();
+    if (!require_expr(base, lhs.location(), "IndexNode missing array") ||
+        !require_expr(index, lhs.location(), "IndexNode missing index")) {
+        return;
+    }
+
+    auto position = compile_expr(*index);
+    if (is_slot(position) && writes_vars(&rhs)) {
+        const auto copy = alloc_temp();
+        emit(op_code::mov, lhs.location(), copy, position);
+        position = copy;
+    }
+    const auto value = compile_expr(rhs);
+    const auto ref = array_ref(static_cast<VarNode*>(base)->name(), false);
+    last_reg_ = value;
+    if (!ref) {
+        return;
+    }
+    emit(lhs.bounds_checked() ? op_code::arr_store : op_code::arr_store_nc,
+         lhs.location(),
+         *ref,
+         position,
+         value);
+}
+
+// Relocates the code of the current frame, from `begin` to the end.
+void BytecodeCompiler::finish(std::size_t begin)
+{
+    const auto temp_base = frame_->num_slots();
+    const auto const_base = frame_->const_base();
+    const auto relocate = [&](std::uint32_t& reg) {
+        switch (reg & kTagMask) {
+            case kTempTag:
+                reg = temp_base + (reg & ~kTagMask);
+                break;
+            case kConstTag:
+                reg = const_base + (reg & ~kTagMask);
+                break;
+            default:
+                break;
+        }
+    };
+
+    for (auto i = begin; i < program_.code.size(); ++i) {
+        auto& instr = program_.code[i];
+        const auto regs = reg_operands(instr.op);
+        if (regs & kRegA) {
+            relocate(instr.a);
+        }
+        if (regs & kRegB) {
+            relocate(instr.b);
+        }
+        if (regs & kRegC) {
+            relocate(instr.c);
+        }
+    }
+}
+
+void BytecodeCompiler::visit(BinArithOpNode& node)
+{
+    const auto hint = std::exchange(dst_hint_, kNoReg);
+    auto* left = node.left();
+    auto* right = node.right();
+    if (!require_expr(left, node.location(), "BinArithOpNode missing operand") ||
+        !require_expr(
+            right, node.location(), "BinArithOpNode missing operand")) {
+        return;
+    }
+
+    const auto mark = next_temp_;
+    auto lhs = compile_expr(*left);
+    if (is_slot(lhs) && writes_vars(right)) {
+        const auto copy = alloc_temp();
+        emit(op_code::mov, node.location(), copy, lhs);
+        lhs = copy;
+    }
+    const auto rhs = compile_expr(*right);
+    next_temp_ = mark;
+    last_reg_ = dst_or_temp(hint);
+    emit(arith_op(node.op()), node.location(), last_reg_, lhs, rhs);
+}
+
+void BytecodeCompiler::visit(BinLogicOpNode& node)
+{
+    const auto hint = std::exchange(dst_hint_, kNoReg);
+    const auto mark = next_temp_;
+
+    const auto op = compare_op(node.op());
+    if (!op) {
+        PatchList is_false;
+        compile_branch(node, false, is_false);
+        next_temp_ = mark;
+        last_reg_ = dst_or_temp(hint);
+        emit(op_code::mov, node.location(), last_reg_, constant(1));
+        const auto done = emit(op_code::jmp, node.location());
+        patch(is_false, here());
+        emit(op_code::mov, node.location(), last_reg_, constant(0));
+        patch({ done }, here());
+        return;
+    }
+
+    auto* left = node.left();
+    auto* right = node.right();
+    if (!require_expr(left, node.location(), "BinLogicOpNode missing operand") ||
+        !require_expr(
+            right, node.location(), "BinLogicOpNode missing operand")) {
+        return;
+    }
+
+    auto lhs = compile_expr(*left);
+    if (is_slot(lhs) && writes_vars(right)) {
+        const auto copy = alloc_temp();
+        emit(op_code::mov, node.location(), copy, lhs);
+        lhs = copy;
+    }
+    const auto rhs = compile_expr(*right);
+    next_temp_ = mark;
+    last_reg_ = dst_or_temp(hint);
+    emit(*op, node.location(), last_reg_, lhs, rhs);
+}
+
+void BytecodeCompiler::visit(ValueNode& node)
+{
+    last_reg_ = constant(node.value());
+}
+
+void BytecodeCompiler::visit(UnOpNode& node)
+{
+    const auto hint = std::exchange(dst_hint_, kNoReg);
+    auto* operand = node.operand();
+    if (!require_expr(operand, node.location(), "UnOpNode missing operand")) {
+        return;
+    }
+
+    const auto mark = next_temp_;
+    const auto value = compile_expr(*operand);
+    switch (node.op()) {
+        case unop_node_type::pos:
+            last_reg_ = value;
+            return;
+        case unop_node_type::neg:
+            next_temp_ = mark;
+            last_reg_ = dst_or_temp(hint);
+            emit(op_code::neg, node.location(), last_reg_, value);
+            return;
+        case unop_node_type::logical_not:
+            next_temp_ = mark;
+            last_reg_ = dst_or_temp(hint);
+            emit(op_code::lnot, node.location(), last_reg_, value);
+            return;
+    }
+}
+
+void BytecodeCompiler::visit(AssignNode& node)
+{
+    dst_hint_ = kNoReg;
+    auto* lhs = node.lhs();
+    if (!require_expr(lhs, node.location(), "AssignNode's lhs is missing")) {
+        return;
+    }
+    if (lhs->node_type() == base_node_type::index) {
+        auto* rhs = node.rhs();
+        if (require_expr(rhs, node.location(), "AssignNode missing operand")) {
+            store_element(static_cast<IndexNode&>(*lhs), *rhs);
+        }
+        return;
+    }
+    if (lhs->node_type() != base_node_type::var) {
+        emit_trap(
+            err::format_error(node.location(), "AssignNode lhs must be var"),
+            node.location());
+        last_reg_ = constant(0);
+        return;
+    }
+    auto* rhs = node.rhs();
+    if (!require_expr(rhs, node.location(), "AssignNode missing operand")) {
+        return;
+    }
+
+    if (holds_array(*rhs)) {
+        assign_array(static_cast<VarNode*>(lhs)->name(), *rhs, node.location());
+        return;
+    }
+    last_reg_ = assign_var(
+        static_cast<VarNode*>(lhs)->name(), *rhs, node.location());
+}
+
+void BytecodeCompiler::visit(VarNode& node)
+{
+    last_reg_ = read_var(node.name());
+}
+
+void BytecodeCompiler::visit(IfNode& node)
+{
+    auto* cond = node.condition();
+    if (!require_expr(cond, node.location(), "Missing condition")) {
+        return;
+    }
+
+    enter_scope(node);
+    try {
+        detail::validate_evaluable_node(
+            *cond, "Invalid condition", detail::evaluable_context::condition);
+    } catch (const std::runtime_error& ex) {
+        emit_trap(ex.what(), cond->location());
+        leave_scope();
+        return;
+    }
+
+    PatchList is_false;
+    compile_branch(*cond, false, is_false);
+
+    const auto defined = defined_mark();
+    compile_stmt(node.then_branch());
+    restore_defined(defined);
+    if (has_expr_node(node.else_branch())) {
+        const auto done = emit(op_code::jmp, node.location());
+        patch(is_false, here());
+        compile_stmt(node.else_branch());
+        restore_defined(defined);
+        patch({ done }, here());
+    } else {
+        patch(is_false, here());
+    }
+    leave_scope();
+}
+
+void BytecodeCompiler::visit(WhileNode& node)
+{
+    auto* cond = node.condition();
+    if (!require_expr(cond, node.location(), "Missing condition")) {
+        return;
+    }
+
+    enter_scope(node);
+    compile_loop(nullptr, *cond, node.body(), nullptr, node.reduction());
+    leave_scope();
+}
+
+void BytecodeCompiler::visit(ForNode& node)
+{
+    auto* cond = node.get_cond();
+    if (!require_expr(cond, node.location(), "Missing condition")) {
+        return;
+    }
+
+    enter_scope(node);
+    compile_loop(node.get_init(),
+                 *cond,
+                 node.get_body(),
+                 node.get_step(),
+                 node.reduction());
+    leave_scope();
+}
+
+void BytecodeCompiler::visit(InputNode& node)
+{
+    const auto hint = std::exchange(dst_hint_, kNoReg);
+    last_reg_ = dst_or_temp(hint);
+    emit(op_code::input, node.location(), last_reg_);
+}
+
+void BytecodeCompiler::visit(ExprNode& node)
+{
+    const auto hint = std::exchange(dst_hint_, kNoReg);
+    auto* expr = node.expr();
+    if (!require_expr(expr, node.location(), "Expression is not valid")) {
+        return;
+    }
+    last_reg_ = compile_expr(*expr, hint);
+}
+
+void BytecodeCompiler::visit(PrintNode& node)
+{
+    auto* expr = node.expr();
+    if (!require_expr(
+            expr, node.location(), "Missing expression for printing")) {
+        return;
+    }
+
+    try {
+        detail::validate_evaluable_node(*expr, "Invalid print expression");
+    } catch (const std::runtime_error& ex) {
+        emit_trap(ex.what(), expr->location());
+        return;
+    }
+
+    emit(op_code::print, node.location(), compile_expr(*expr));
+}
+
+void BytecodeCompiler::visit(ScopeNode& node)
+{
+    const bool need_scope = node.parent() != nullptr;
+    if (need_scope) {
+        enter_scope(node);
+    }
+    for (const auto& stmt : node.statements()) {
+        compile_stmt(stmt.get());
+    }
+    if (need_scope) {
+        leave_scope();
+    }
+}
+
+void BytecodeCompiler::visit(VarDeclNode& node)
+{
+    dst_hint_ = kNoReg;
+    auto* init = node.init_expr();
+    const auto value = has_expr_node(init) ? compile_expr(*init) : constant(0);
+
+    add_name(node.name(), scopes_.back());
+    const auto slot = scopes_.back().slots.at(node.name());
+    checked_[slot] = 1;
+    emit(op_code::declare, node.location(), slot, value);
+    mark_defined(slot);
+    last_reg_ = value;
+}
+
+void BytecodeCompiler::visit(ErrorNode& node)
+{
+    emit_trap(err::format_error(node.location(), "Cannot execute error node"),
+              node.location());
+    last_reg_ = constant(0);
+}
+
+void BytecodeCompiler::visit(EmptyNode&)
+{
+    last_reg_ = constant(0);
+}
+
+void BytecodeCompiler::visit(ArrayNode& node)
+{
+    emit_trap(err::format_error(
+                  node.location(),
+                  "Array expression can only be assigned to a variable"),
+              node.location());
+    last_reg_ = constant(0);
+}
+
+void BytecodeCompiler::visit(IndexNode& node)
+{
+    const auto hint = std::exchange(dst_hint_, kNoReg);
+    auto* base = node.base();
+    auto* index = node.index();
+    if (!require_expr(base, node.location(), "IndexNode missing array") ||
+        !require_expr(index, node.location(), "IndexNode missing index")) {
+        return;
+    }
+    if (base->node_type() != base_node_type::var) {
+        emit_trap(err::format_error(node.location(),
+                                    "Indexed expression must be a variable"),
+                  node.location());
+        last_reg_ = constant(0);
+        return;
+    }
+
+    const auto mark = next_temp_;
+    const auto position = compile_expr(*index);
+    const auto ref = array_ref(static_cast<VarNode*>(base)->name(), false);
+    if (!ref) {
+        last_reg_ = constant(0);
+        return;
+    }
+    next_temp_ = mark;
+    last_reg_ = dst_or_temp(hint);
+    emit(node.bounds_checked() ? op_code::arr_load : op_code::arr_load_nc,
+         node.location(),
+         last_reg_,
+         *ref,
+         position);
+}
+
+// Functions are compiled after the program, see compile().
+void BytecodeCompiler::visit(FuncNode&)
+{
+    last_reg_ = constant(0);
+}
+
+void BytecodeCompiler::visit(CallNode& node)
+{
+    const auto hint = std::exchange(dst_hint_, kNoReg);
+    const auto function = resolve_call(node);
+    if (!function) {
+        last_reg_ = constant(0);
+        return;
+    }
+
+    const auto mark = next_temp_;
+    const auto args = compile_args(node);
+    next_temp_ = mark;
+    last_reg_ = dst_or_temp(hint);
+    emit(op_code::call, node.location(), last_reg_, *function, args);
+}
+
+void BytecodeCompiler::visit(ReturnNode& node)
+{
+    if (frame_ == &program_) {
+        emit_trap(
+            err::format_error(node.location(), "Return outside of a function"),
+            node.location());
+        last_reg_ = constant(0);
+        return;
+    }
+    auto* expr = node.expr();
+    if (!require_expr(expr, node.location(), "Missing return value")) {
+        return;
+    }
+
+    if (expr->node_type() == base_node_type::call &&
+        static_cast<CallNode*>(expr)->is_tail()) {
+        auto& call = static_cast<CallNode&>(*expr);
+        const auto function = resolve_call(call);
+        if (function) {
+            const auto mark = next_temp_;
+            emit(op_code::tail_call,
+                 call.location(),
+                 0,
+                 *function,
+                 compile_args(call));
+            next_temp_ = mark;
+        }
+        last_reg_ = constant(0);
+        return;
+    }
+
+    try {
+        detail::validate_evaluable_node(*expr, "Invalid return value");
+    } catch (const std::runtime_error& ex) {
+        emit_trap(ex.what(), expr->location());
+        last_reg_ = constant(0);
+        return;
+    }
+    last_reg_ = compile_expr(*expr);
+    emit(op_code::ret, node.location(), last_reg_);
+}
+
+// Emits a trap and returns nullopt if the call cannot be made, with the
+// same message the tree-walker raises when it reaches the call.
+std::optional<std::uint32_t> BytecodeCompiler::resolve_call(CallNode& node)
+{
+    const auto iter = function_ids_.find(node.name());
+    if (iter == function_ids_.end()) {
+        emit_trap(err::format_error(node.location(),
+                                    "Undefined function: " + node.name().str()),
+                  node.location());
+        return std::nullopt;
+    }
+    const auto& function = program_.functions[iter->second];
+    if (function.num_params != node.args().size()) {
+        emit_trap(
+            err::format_error(node.location(),
+                              call_arity_error(function.name,
+                                               function.num_params,
+                                               node.args().size())),
+            node.location());
+        return std::nullopt;
+    }
+    for (const auto& arg : node.args()) {
+        if (!require_expr(
+                arg.get(), node.location(), "Call argument is missing")) {
+            return std::nullopt;
+        }
+    }
+    return iter->second;
+}
+
+// Evaluates the arguments into consecutive temporaries and returns the
+// first one.
+std::uint32_t BytecodeCompiler::compile_args(CallNode& node)
+{
+    std::vector<std::uint32_t> regs;
+    regs.reserve(node.args().size());
+    for (std::size_t i = 0; i < node.args().size(); ++i) {
+        regs.push_back(alloc_temp());
+    }
+    for (std::size_t i = 0; i < regs.size(); ++i) {
+        const auto value = compile_expr(*node.args()[i], regs[i]);
+        if (value != regs[i]) {
+            emit(op_code::mov, node.location(), regs[i], value);
+        }
+    }
+    return regs.empty() ? 0 : regs.front();
+}
+
+} // namespace ast::bytecode
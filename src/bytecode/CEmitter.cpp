@@ -0,0 +1,659 @@
+#include "Bytecode/CEmitter.hpp"
+#include "Runtime/Arrays.hpp"
+#include "Runtime/Calls.hpp"
+#include "Runtime/OutputSink.hpp"
+#include "errors-output/error-formatter.hpp"
+
+#include <cstdio>
+#include <limits>
+
+namespace ast::bytecode {
+
+namespace {
+
+// Everything the generated code needs besides its own statements. Errors
+// arrive fully formatted, or as the "<location>: error: " prefix when the
+// message depends on runtime values.
+constexpr const char* kRuntime = R"(#include <inttypes.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PCL_RT static __attribute__((unused))
+#define PCL_NORETURN __attribute__((noreturn))
+
+typedef struct
+{
+    int64_t* data;
+    size_t size;
+    size_t capacity;
+} pcl_array;
+
+typedef struct
+{
+    unsigned resume;
+    uint32_t dst;
+    size_t base;
+    size_t top;
+} pcl_call;
+
+/* The register stack: the program's frame at the bottom, one frame per
+   active call above it. */
+static int64_t* pcl_regs;
+static unsigned char* pcl_defined;
+static pcl_array* pcl_arrays;
+static size_t pcl_size;
+static pcl_array pcl_pending;
+PCL_RT pcl_call pcl_calls[PCL_MAX_CALL_DEPTH];
+PCL_RT size_t pcl_depth;
+
+static char pcl_out[PCL_OUT_SIZE];
+static size_t pcl_used;
+
+PCL_RT void pcl_flush(void)
+{
+    fwrite(pcl_out, 1, pcl_used, stdout);
+    fflush(stdout);
+    pcl_used = 0;
+}
+
+PCL_RT PCL_NORETURN void pcl_fail(const char* message)
+{
+    pcl_flush();
+    fprintf(stderr, "%s\n", message);
+    exit(1);
+}
+
+PCL_RT PCL_NORETURN void pcl_failf(const char* format, ...)
+{
+    va_list args;
+    pcl_flush();
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+    exit(1);
+}
+
+PCL_RT void* pcl_realloc(void* ptr, size_t size)
+{
+    void* result = realloc(ptr, size != 0 ? size : 1);
+    if (result == NULL) {
+        pcl_fail("error: Out of memory");
+    }
+    return result;
+}
+
+PCL_RT void pcl_print(int64_t value)
+{
+    char digits[20];
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    size_t n = 0;
+    do {
+        digits[n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (sizeof pcl_out - pcl_used < sizeof digits + 2) {
+        pcl_flush();
+    }
+    if (value < 0) {
+        pcl_out[pcl_used++] = '-';
+    }
+    while (n != 0) {
+        pcl_out[pcl_used++] = digits[--n];
+    }
+    pcl_out[pcl_used++] = '\n';
+}
+
+PCL_RT int64_t pcl_input(const char* error)
+{
+    uint64_t limit = (uint64_t)INT64_MAX;
+    uint64_t magnitude = 0;
+    int negative = 0;
+    int c;
+    pcl_flush();
+    do {
+        c = getchar();
+    } while (c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' ||
+             c == '\f');
+    if (c == '-' || c == '+') {
+        negative = c == '-';
+        c = getchar();
+    }
+    if (c < '0' || c > '9') {
+        pcl_fail(error);
+    }
+    if (negative) {
+        ++limit;
+    }
+    do {
+        const uint64_t digit = (uint64_t)(c - '0');
+        if (magnitude > (limit - digit) / 10) {
+            pcl_fail(error);
+        }
+        magnitude = magnitude * 10 + digit;
+        c = getchar();
+    } while (c >= '0' && c <= '9');
+    if (c != EOF) {
+        ungetc(c, stdin);
+    }
+    if (negative && magnitude != 0) {
+        return -(int64_t)(magnitude - 1) - 1;
+    }
+    return (int64_t)magnitude;
+}
+
+/* Makes room for a frame ending at `top`; frames that returned keep their
+   slots and array buffers for the next call. */
+PCL_RT void pcl_enter(size_t top)
+{
+    size_t size;
+    if (top <= pcl_size) {
+        return;
+    }
+    size = pcl_size * 2 > top ? pcl_size * 2 : top;
+    pcl_regs = pcl_realloc(pcl_regs, size * sizeof *pcl_regs);
+    pcl_defined = pcl_realloc(pcl_defined, size);
+    pcl_arrays = pcl_realloc(pcl_arrays, size * sizeof *pcl_arrays);
+    memset(pcl_regs + pcl_size, 0, (size - pcl_size) * sizeof *pcl_regs);
+    memset(pcl_defined + pcl_size, 0, size - pcl_size);
+    memset(pcl_arrays + pcl_size, 0, (size - pcl_size) * sizeof *pcl_arrays);
+    pcl_size = size;
+}
+
+PCL_RT PCL_NORETURN pcl_array* pcl_undefined(const char* message)
+{
+    pcl_fail(message);
+}
+
+PCL_RT pcl_array* pcl_define(unsigned char* defined, pcl_array* array)
+{
+    *defined = 1;
+    return array;
+}
+
+PCL_RT void pcl_reserve(pcl_array* array, size_t size)
+{
+    if (size > array->capacity) {
+        const size_t capacity =
+            array->capacity * 2 > size ? array->capacity * 2 : size;
+        array->data =
+            pcl_realloc(array->data, capacity * sizeof *array->data);
+        array->capacity = capacity;
+    }
+}
+
+PCL_RT void pcl_fill(pcl_array* array,
+                     int64_t value,
+                     int64_t size,
+                     const char* where)
+{
+    size_t i;
+    if (size < 0) {
+        pcl_failf("%sInvalid array size: %" PRId64, where, size);
+    }
+    if (size > PCL_MAX_ARRAY_SIZE) {
+        pcl_failf("%sArray size %" PRId64 " is too large", where, size);
+    }
+    pcl_reserve(array, (size_t)size);
+    for (i = 0; i < (size_t)size; ++i) {
+        array->data[i] = value;
+    }
+    array->size = (size_t)size;
+}
+
+PCL_RT void pcl_push(int64_t value)
+{
+    pcl_reserve(&pcl_pending, pcl_pending.size + 1);
+    pcl_pending.data[pcl_pending.size++] = value;
+}
+
+PCL_RT void pcl_set(pcl_array* array)
+{
+    const pcl_array old = *array;
+    *array = pcl_pending;
+    pcl_pending = old;
+    pcl_pending.size = 0;
+}
+
+PCL_RT void pcl_copy(pcl_array* dst, const pcl_array* src)
+{
+    if (dst == src) {
+        return;
+    }
+    pcl_reserve(dst, src->size);
+    if (src->size != 0) {
+        memcpy(dst->data, src->data, src->size * sizeof *src->data);
+    }
+    dst->size = src->size;
+}
+
+PCL_RT size_t pcl_index(const pcl_array* array,
+                        int64_t index,
+                        const char* where)
+{
+    if ((uint64_t)index >= array->size) {
+        pcl_failf("%sArray index %" PRId64
+                  " is out of range for array of size %zu",
+                  where,
+                  index,
+                  array->size);
+    }
+    return (size_t)index;
+}
+
+#define PCL_FRAME() \
+    (r = pcl_regs + base, d = pcl_defined + base, arr = pcl_arrays + base)
+)";
+
+std::string c_string(const std::string& text)
+{
+    std::string out = "\"";
+    for (const char ch : text) {
+        const auto c = static_cast<unsigned char>(ch);
+        if (c == '"' || c == '\\' || c == '?') {
+            // `?` too, so that no trigraph can form.
+            out += '\\';
+            out += ch;
+        } else if (c < 0x20 || c >= 0x7f) {
+            char octal[5];
+            std::snprintf(octal, sizeof(octal), "\\%03o", unsigned{ c });
+            out += octal;
+        } else {
+            out += ch;
+        }
+    }
+    return out + "\"";
+}
+
+std::string c_int(std::int64_t value)
+{
+    if (value == std::numeric_limits<std::int64_t>::min()) {
+        return "INT64_MIN";
+    }
+    return "INT64_C(" + std::to_string(value) + ")";
+}
+
+std::string label(std::size_t pc)
+{
+    return "L" + std::to_string(pc);
+}
+
+std::string slot(std::uint32_t index)
+{
+    return "r[" + std::to_string(index) + "]";
+}
+
+std::string flag(std::uint32_t index)
+{
+    return "d[" + std::to_string(index) + "]";
+}
+
+} // namespace
+
+CEmitter::CEmitter(const Program& program)
+  : program_(program)
+{
+}
+
+void CEmitter::emit(std::ostream& out)
+{
+    const auto& code = program_.code;
+    labelled_.assign(code.size() + 1, 0);
+
+    // Statements are translated first: jumps and calls decide which
+    // instructions need a label.
+    std::vector<std::string> statements(code.size());
+    std::size_t next_function = 0;
+    frame_ = &program_;
+    for (std::size_t pc = 0; pc < code.size(); ++pc) {
+        if (next_function < program_.functions.size() &&
+            program_.functions[next_function].entry == pc) {
+            frame_ = &program_.functions[next_function++].frame;
+        }
+        statements[pc] = translate(pc);
+    }
+
+    out << "/* Generated by paracl --emit-c. */\n"
+        << "#define PCL_MAX_CALL_DEPTH " << kMaxCallDepth << "\n"
+        << "#define PCL_MAX_ARRAY_SIZE " << c_int(kMaxArraySize) << "\n"
+        << "#define PCL_OUT_SIZE " << OutputSink::kBufferSize << "\n"
+        << kRuntime << "\n"
+        << "static void pcl_run(void)\n"
+        << "{\n"
+        << "    size_t base = 0;\n"
+        << "    size_t top = " << program_.const_base() << ";\n"
+        << "    int64_t* r;\n"
+        << "    unsigned char* d;\n"
+        << "    pcl_array* arr;\n"
+        << "    int64_t value = 0;\n"
+        << "    pcl_enter(top);\n"
+        << "    PCL_FRAME();\n"
+        << "    (void)d;\n"
+        << "    (void)arr;\n"
+        << "    (void)value;\n";
+    for (std::size_t pc = 0; pc < code.size(); ++pc) {
+        if (labelled_[pc]) {
+            out << label(pc) << ":\n";
+        }
+        out << statements[pc];
+    }
+
+    if (!program_.functions.empty()) {
+        emit_return(out);
+    }
+    out << "}\n\n"
+        << "int main(void)\n"
+        << "{\n"
+        << "    pcl_run();\n"
+        << "    pcl_flush();\n"
+        << "    return 0;\n"
+        << "}\n";
+}
+
+// Every `ret` stores its value and jumps here; the caller's frame comes
+// back and execution resumes after its call.
+void CEmitter::emit_return(std::ostream& out) const
+{
+    out << "pcl_return:\n"
+        << "    {\n"
+        << "        const pcl_call caller = pcl_calls[--pcl_depth];\n"
+        << "        base = caller.base;\n"
+        << "        top = caller.top;\n"
+        << "        PCL_FRAME();\n"
+        << "        r[caller.dst] = value;\n"
+        << "        switch (caller.resume) {\n";
+    const auto& code = program_.code;
+    for (std::size_t pc = 0; pc < code.size(); ++pc) {
+        if (code[pc].op == op_code::call) {
+            out << "            case " << pc + 1 << ":\n"
+                << "                goto " << label(pc + 1) << ";\n";
+        }
+    }
+    out << "        }\n"
+        << "        abort();\n"
+        << "    }\n";
+}
+
+std::string CEmitter::translate(std::size_t pc)
+{
+    const Instr& in = program_.code[pc];
+    const auto a = slot(in.a);
+    switch (in.op) {
+        case op_code::halt:
+            return "    return;\n";
+        case op_code::mov:
+            return "    " + a + " = " + reg(in.b) + ";\n";
+        case op_code::add:
+            return arith(pc, "add", "Integer overflow in addition");
+        case op_code::sub:
+            return arith(pc, "sub", "Integer overflow in subtraction");
+        case op_code::mul:
+            return arith(pc, "mul", "Integer overflow in multiplication");
+        case op_code::div:
+            return divide(pc, '/', "Integer overflow in division");
+        case op_code::mod:
+            return divide(pc, '%', "Integer overflow in modulus");
+        case op_code::neg:
+            return "    if (" + reg(in.b) +
+                   " == INT64_MIN)\n        pcl_fail(" +
+                   message(pc, "Integer overflow in unary minus") +
+                   ");\n    " + a + " = -" + reg(in.b) + ";\n";
+        case op_code::lnot:
+            return "    " + a + " = !" + reg(in.b) + ";\n";
+        case op_code::lt:
+            return "    " + a + " = " + reg(in.b) + " < " + reg(in.c) + ";\n";
+        case op_code::le:
+            return "    " + a + " = " + reg(in.b) + " <= " + reg(in.c) + ";\n";
+        case op_code::gt:
+            return "    " + a + " = " + reg(in.b) + " > " + reg(in.c) + ";\n";
+        case op_code::ge:
+            return "    " + a + " = " + reg(in.b) + " >= " + reg(in.c) + ";\n";
+        case op_code::eq:
+            return "    " + a + " = " + reg(in.b) + " == " + reg(in.c) + ";\n";
+        case op_code::ne:
+            return "    " + a + " = " + reg(in.b) + " != " + reg(in.c) + ";\n";
+        case op_code::bxor:
+            return "    " + a + " = " + reg(in.b) + " ^ " + reg(in.c) + ";\n";
+        case op_code::jmp:
+            return "    " + jump(in.a) + "\n";
+        case op_code::jz:
+            return "    if (" + reg(in.a) + " == 0)\n        " + jump(in.b) +
+                   "\n";
+        case op_code::jnz:
+            return "    if (" + reg(in.a) + " != 0)\n        " + jump(in.b) +
+                   "\n";
+        case op_code::jlt:
+            return "    if (" + reg(in.a) + " < " + reg(in.b) + ")\n        " +
+                   jump(in.c) + "\n";
+        case op_code::jle:
+            return "    if (" + reg(in.a) + " <= " + reg(in.b) + ")\n        " +
+                   jump(in.c) + "\n";
+        case op_code::jgt:
+            return "    if (" + reg(in.a) + " > " + reg(in.b) + ")\n        " +
+                   jump(in.c) + "\n";
+        case op_code::jge:
+            return "    if (" + reg(in.a) + " >= " + reg(in.b) + ")\n        " +
+                   jump(in.c) + "\n";
+        case op_code::jeq:
+            return "    if (" + reg(in.a) + " == " + reg(in.b) + ")\n        " +
+                   jump(in.c) + "\n";
+        case op_code::jne:
+            return "    if (" + reg(in.a) + " != " + reg(in.b) + ")\n        " +
+                   jump(in.c) + "\n";
+        case op_code::input:
+            return "    " + a + " = pcl_input(" +
+                   message(pc, "Input error: expected int64_t") + ");\n";
+        case op_code::print:
+            return "    pcl_print(" + reg(in.a) + ");\n";
+        case op_code::load_var:
+            return find_slot(in.b, a + " = r[%]");
+        case op_code::store_var: {
+            const auto& slots = program_.var_refs[in.b].slots;
+            std::string out = "    ";
+            for (const auto candidate : slots) {
+                out += "if (" + flag(candidate) + ")\n        " +
+                       slot(candidate) + " = " + reg(in.a) + ";\n    else ";
+            }
+            return out + "{\n        " + slot(in.c) + " = " + reg(in.a) +
+                   ";\n        " + flag(in.c) + " = 1;\n    }\n";
+        }
+        case op_code::store_def:
+            return "    " + a + " = " + reg(in.b) + ";\n    " + flag(in.a) +
+                   " = 1;\n";
+        case op_code::declare:
+            return "    if (" + flag(in.a) + ")\n        pcl_fail(" +
+                   message(pc,
+                           "Variable " + frame_->slot_names[in.a] +
+                               " already declared") +
+                   ");\n    " + a + " = " + reg(in.b) + ";\n    " +
+                   flag(in.a) + " = 1;\n";
+        case op_code::undef:
+            return "    " + flag(in.a) + " = 0;\n";
+        case op_code::trap:
+            return "    pcl_fail(" + c_string(program_.messages[in.a]) +
+                   ");\n";
+        case op_code::arr_fill:
+            return "    pcl_fill(" + array_ref(in.a, true) + ", " +
+                   reg(in.b) + ", " + reg(in.c) + ", " + message(pc, "") +
+                   ");\n";
+        case op_code::arr_push:
+            return "    pcl_push(" + reg(in.a) + ");\n";
+        case op_code::arr_set:
+            return "    pcl_set(" + array_ref(in.a, true) + ");\n";
+        case op_code::arr_copy:
+            return "    {\n        const pcl_array* src = " +
+                   array_ref(in.b, false) + ";\n        pcl_copy(" +
+                   array_ref(in.a, true) + ", src);\n    }\n";
+        case op_code::arr_load:
+            return "    {\n        const pcl_array* array = " +
+                   array_ref(in.b, false) + ";\n        " + a +
+                   " = array->data[pcl_index(array, " + reg(in.c) + ", " +
+                   message(pc, "") + ")];\n    }\n";
+        case op_code::arr_load_nc:
+            return "    " + a + " = " + array_ref(in.b, false) + "->data[" +
+                   reg(in.c) + "];\n";
+        case op_code::arr_store:
+            return "    {\n        pcl_array* array = " +
+                   array_ref(in.a, false) +
+                   ";\n        array->data[pcl_index(array, " + reg(in.b) +
+                   ", " + message(pc, "") + ")] = " + reg(in.c) +
+                   ";\n    }\n";
+        case op_code::arr_store_nc:
+            return "    " + array_ref(in.a, false) + "->data[" + reg(in.b) +
+                   "] = " + reg(in.c) + ";\n";
+        case op_code::call:
+            return call(pc, false);
+        case op_code::tail_call:
+            return call(pc, true);
+        case op_code::ret:
+            return "    value = " + reg(in.a) + ";\n    goto pcl_return;\n";
+        case op_code::closed_form:
+            // The loop itself follows and is left to the C compiler.
+            return {};
+    }
+    return {};
+}
+
+// Constants are folded into the C source; everything else lives in the
+// frame.
+std::string CEmitter::reg(std::uint32_t index) const
+{
+    if (index >= frame_->const_base()) {
+        return c_int(frame_->constants[index - frame_->const_base()]);
+    }
+    return slot(index);
+}
+
+std::string CEmitter::message(std::size_t pc, const std::string& text) const
+{
+    return c_string(err::format_error(program_.locations[pc], text));
+}
+
+std::string CEmitter::jump(std::uint32_t target)
+{
+    labelled_[target] = 1;
+    return "goto " + label(target) + ";";
+}
+
+std::string CEmitter::arith(std::size_t pc,
+                            const char* builtin,
+                            const char* error) const
+{
+    const Instr& in = program_.code[pc];
+    return "    if (__builtin_" + std::string(builtin) + "_overflow(" +
+           reg(in.b) + ", " + reg(in.c) + ", &" + slot(in.a) +
+           "))\n        pcl_fail(" + message(pc, error) + ");\n";
+}
+
+// A constant divisor keeps only the checks it can fail, which also keeps
+// the C compiler from warning about a guarded division by zero.
+std::string CEmitter::divide(std::size_t pc, char op, const char* error) const
+{
+    const Instr& in = program_.code[pc];
+    const auto lhs = reg(in.b);
+    const auto rhs = reg(in.c);
+    const bool constant = in.c >= frame_->const_base();
+    const auto divisor =
+        constant ? frame_->constants[in.c - frame_->const_base()] : 0;
+    if (constant && divisor == 0) {
+        return "    pcl_fail(" + message(pc, "Division by zero") + ");\n";
+    }
+
+    std::string out;
+    if (!constant) {
+        out += "    if (" + rhs + " == 0)\n        pcl_fail(" +
+               message(pc, "Division by zero") + ");\n";
+    }
+    if (!constant || divisor == -1) {
+        out += "    if (" + lhs + " == INT64_MIN && " + rhs +
+               " == -1)\n        pcl_fail(" + message(pc, error) + ");\n";
+    }
+    return out + "    " + slot(in.a) + " = " + lhs + " " + op + " " + rhs +
+           ";\n";
+}
+
+// Runs `found` with `%` replaced by the first defined candidate of
+// var_refs[ref], or stops with the VM's error when none is defined.
+std::string CEmitter::find_slot(std::uint32_t ref,
+                                const std::string& found) const
+{
+    const auto& var = program_.var_refs[ref];
+    std::string out = "    ";
+    for (const auto candidate : var.slots) {
+        auto statement = found;
+        statement.replace(found.find('%'), 1, std::to_string(candidate));
+        out += "if (" + flag(candidate) + ")\n        " + statement +
+               ";\n    else ";
+    }
+    return out + "pcl_fail(" +
+           c_string(err::format_error(SourceRange(),
+                                      "Undefined variable: " + var.name)) +
+           ");\n";
+}
+
+// An expression for the array of var_refs[ref]. Storing a whole array
+// defines the innermost candidate when none is defined; anything else
+// stops with the VM's error.
+std::string CEmitter::array_ref(std::uint32_t ref, bool store) const
+{
+    const auto& var = program_.var_refs[ref];
+    std::string out = "(";
+    for (const auto candidate : var.slots) {
+        out += flag(candidate) + " ? &arr[" + std::to_string(candidate) +
+               "] : ";
+    }
+    if (store) {
+        const auto first = std::to_string(var.slots.front());
+        out += "pcl_define(&d[" + first + "], &arr[" + first + "])";
+    } else {
+        out += "pcl_undefined(" +
+               c_string(err::format_error(SourceRange(),
+                                          "Undefined variable: " +
+                                              var.name)) +
+               ")";
+    }
+    return out + ")";
+}
+
+// Arguments are read before the callee's frame replaces or follows the
+// caller's; a tail call reuses the frame and does not count towards the
+// depth limit.
+std::string CEmitter::call(std::size_t pc, bool tail)
+{
+    const Instr& in = program_.code[pc];
+    const auto& function = program_.functions[in.b];
+    const auto params = function.num_params;
+    std::string out;
+    if (!tail) {
+        out += "    if (pcl_depth == PCL_MAX_CALL_DEPTH)\n        pcl_fail(" +
+               message(pc, kCallDepthError) + ");\n";
+    }
+    out += "    {\n";
+    for (std::uint32_t i = 0; i < params; ++i) {
+        out += "        const int64_t p" + std::to_string(i) + " = " +
+               reg(in.c + i) + ";\n";
+    }
+    if (!tail) {
+        labelled_[pc + 1] = 1;
+        out += "        pcl_calls[pcl_depth++] = (pcl_call){ " +
+               std::to_string(pc + 1) + ", " + std::to_string(in.a) +
+               ", base, top };\n        base = top;\n";
+    }
+    out += "        top = base + " +
+           std::to_string(function.frame.const_base()) +
+           ";\n        pcl_enter(top);\n        PCL_FRAME();\n";
+    for (std::uint32_t i = 0; i < params; ++i) {
+        out += "        " + slot(i) + " = p" + std::to_string(i) + ";\n";
+    }
+    out += "        memset(d, 1, " + std::to_string(params) +
+           ");\n        memset(d + " + std::to_string(params) + ", 0, " +
+           std::to_string(function.frame.num_slots() - params) +
+           ");\n        " + jump(function.entry) + "\n    }\n";
+    return out;
+}
+
+} // namespace ast::bytecode
@@ -0,0 +1,593 @@
+#include "Bytecode/Jit.hpp"
+
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <map>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define PARACL_JIT_X86_64 1
+#else
+#define PARACL_JIT_X86_64 0
+#endif
+
+namespace ast::bytecode {
+
+namespace {
+
+constexpr std::uint32_t kNoTarget = std::numeric_limits<std::uint32_t>::max();
+
+std::uint32_t jump_target(const Instr& in)
+{
+    switch (in.op) {
+        case op_code::jmp:
+            return in.a;
+        case op_code::jz:
+        case op_code::jnz:
+            return in.b;
+        case op_code::jlt:
+        case op_code::jle:
+        case op_code::jgt:
+        case op_code::jge:
+        case op_code::jeq:
+        case op_code::jne:
+            return in.c;
+        case op_code::closed_form:
+            return in.b;
+        case op_code::halt:
+        case op_code::mov:
+        case op_code::add:
+        case op_code::sub:
+        case op_code::mul:
+        case op_code::div:
+        case op_code::mod:
+        case op_code::neg:
+        case op_code::lnot:
+        case op_code::lt:
+        case op_code::le:
+        case op_code::gt:
+        case op_code::ge:
+        case op_code::eq:
+        case op_code::ne:
+        case op_code::bxor:
+        case op_code::input:
+        case op_code::print:
+        case op_code::load_var:
+        case op_code::store_var:
+        case op_code::store_def:
+        case op_code::declare:
+        case op_code::undef:
+        case op_code::trap:
+        case op_code::arr_fill:
+        case op_code::arr_push:
+        case op_code::arr_set:
+        case op_code::arr_copy:
+        case op_code::arr_load:
+        case op_code::arr_load_nc:
+        case op_code::arr_store:
+        case op_code::arr_store_nc:
+        case op_code::call:
+        case op_code::tail_call:
+        case op_code::ret:
+            break;
+    }
+    return kNoTarget;
+}
+
+enum class lowering
+{
+    native,
+    exit, // leave native code and let the VM run the instruction
+    reject,
+};
+
+lowering lowering_of(op_code op)
+{
+    switch (op) {
+        case op_code::mov:
+        case op_code::add:
+        case op_code::sub:
+        case op_code::mul:
+        case op_code::div:
+        case op_code::mod:
+        case op_code::neg:
+        case op_code::lnot:
+        case op_code::lt:
+        case op_code::le:
+        case op_code::gt:
+        case op_code::ge:
+        case op_code::eq:
+        case op_code::ne:
+        case op_code::bxor:
+        case op_code::jmp:
+        case op_code::jz:
+        case op_code::jnz:
+        case op_code::jlt:
+        case op_code::jle:
+        case op_code::jgt:
+        case op_code::jge:
+        case op_code::jeq:
+        case op_code::jne:
+        case op_code::load_var:
+        case op_code::store_var:
+        case op_code::store_def:
+        case op_code::undef:
+            return lowering::native;
+        case op_code::halt:
+        case op_code::input:
+        case op_code::print:
+        case op_code::trap:
+        case op_code::closed_form:
+            return lowering::exit;
+        case op_code::declare:
+        case op_code::arr_fill:
+        case op_code::arr_push:
+        case op_code::arr_set:
+        case op_code::arr_copy:
+        case op_code::arr_load:
+        case op_code::arr_load_nc:
+        case op_code::arr_store:
+        case op_code::arr_store_nc:
+        case op_code::call:
+        case op_code::tail_call:
+        case op_code::ret:
+            break;
+    }
+    return lowering::reject;
+}
+
+// Register displacements are 32-bit.
+constexpr std::uint32_t kMaxRegister = 1u << 28;
+
+enum class reg : std::uint8_t
+{
+    rax = 0,
+    rcx = 1,
+    rdx = 2,
+    rbx = 3,
+};
+
+// x86 condition codes, as the low nibble of jcc/setcc.
+enum class cond : std::uint8_t
+{
+    o = 0x0,
+    e = 0x4,
+    ne = 0x5,
+    l = 0xC,
+    ge = 0xD,
+    le = 0xE,
+    g = 0xF,
+};
+
+std::uint8_t opcode(std::uint8_t base, cond cc)
+{
+    return static_cast<std::uint8_t>(base | static_cast<unsigned>(cc));
+}
+
+// The handful of encodings the loop compiler needs. rbx holds the frame's
+// registers and r12 its defined flags; rax, rcx and rdx are scratch.
+class Assembler
+{
+    std::vector<std::uint8_t> code_;
+
+public:
+    const std::vector<std::uint8_t>& code() const
+    {
+        return code_;
+    }
+
+    std::size_t here() const
+    {
+        return code_.size();
+    }
+
+    void bytes(std::initializer_list<std::uint8_t> list)
+    {
+        code_.insert(code_.end(), list);
+    }
+
+    void imm32(std::uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i) {
+            code_.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void imm64(std::uint64_t value)
+    {
+        imm32(static_cast<std::uint32_t>(value));
+        imm32(static_cast<std::uint32_t>(value >> 32));
+    }
+
+    // <opcode> r, qword [rbx + 8 * index]
+    void frame_op(std::initializer_list<std::uint8_t> opcode,
+                  reg r,
+                  std::uint32_t index)
+    {
+        code_.push_back(0x48);
+        bytes(opcode);
+        code_.push_back(static_cast<std::uint8_t>(
+            0x80 | (static_cast<unsigned>(r) << 3) |
+            static_cast<unsigned>(reg::rbx)));
+        imm32(index * 8);
+    }
+
+    void load(reg r, std::uint32_t index)
+    {
+        frame_op({ 0x8B }, r, index);
+    }
+
+    void store(std::uint32_t index, reg r)
+    {
+        frame_op({ 0x89 }, r, index);
+    }
+
+    // mov byte [r12 + index], value
+    void set_defined(std::uint32_t index, std::uint8_t value)
+    {
+        bytes({ 0x41, 0xC6, 0x84, 0x24 });
+        imm32(index);
+        code_.push_back(value);
+    }
+
+    // cmp byte [r12 + index], 0
+    void test_defined(std::uint32_t index)
+    {
+        bytes({ 0x41, 0x80, 0xBC, 0x24 });
+        imm32(index);
+        code_.push_back(0x00);
+    }
+
+    // setcc al; movzx eax, al
+    void set(cond cc)
+    {
+        bytes({ 0x0F, opcode(0x90, cc), 0xC0 });
+        bytes({ 0x0F, 0xB6, 0xC0 });
+    }
+
+    // Emits a jcc rel32 and returns where its displacement goes.
+    std::size_t jcc(cond cc)
+    {
+        bytes({ 0x0F, opcode(0x80, cc) });
+        imm32(0);
+        return here() - 4;
+    }
+
+    std::size_t jmp()
+    {
+        code_.push_back(0xE9);
+        imm32(0);
+        return here() - 4;
+    }
+
+    void patch(std::size_t at, std::size_t target)
+    {
+        const auto rel = static_cast<std::uint32_t>(
+            static_cast<std::int64_t>(target) -
+            static_cast<std::int64_t>(at + 4));
+        for (int i = 0; i < 4; ++i) {
+            code_[at + static_cast<std::size_t>(i)] =
+                static_cast<std::uint8_t>(rel >> (8 * i));
+        }
+    }
+};
+
+bool fits(const Program& program, const Instr& in)
+{
+    switch (lowering_of(in.op)) {
+        case lowering::native:
+            break;
+        case lowering::exit:
+            return true;
+        case lowering::reject:
+            return false;
+    }
+    if (in.a >= kMaxRegister || in.b >= kMaxRegister ||
+        in.c >= kMaxRegister) {
+        return false;
+    }
+    if (in.op == op_code::load_var || in.op == op_code::store_var) {
+        for (const auto slot : program.var_refs[in.b].slots) {
+            if (slot >= kMaxRegister) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Emits [loop, end] and returns the machine code, or an empty vector when
+// an instruction cannot be compiled.
+std::vector<std::uint8_t> assemble(const Program& program,
+                                   std::uint32_t loop,
+                                   std::uint32_t end)
+{
+    const auto& code = program.code;
+    for (auto pc = loop; pc <= end; ++pc) {
+        if (!fits(program, code[pc])) {
+            return {};
+        }
+    }
+
+    Assembler as;
+    // push rbx; push r12; mov rbx, rdi; mov r12, rsi
+    as.bytes({ 0x53, 0x41, 0x54, 0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4 });
+
+    std::vector<std::size_t> starts(end - loop + 1);
+    std::vector<std::pair<std::size_t, std::uint32_t>> branches;
+    std::vector<std::pair<std::size_t, std::uint32_t>> exits;
+    auto jump_to = [&](std::size_t at, std::uint32_t target) {
+        if (target >= loop && target <= end) {
+            branches.emplace_back(at, target);
+        } else {
+            exits.emplace_back(at, target);
+        }
+    };
+    auto compare = [&](const Instr& in, cond cc) {
+        as.load(reg::rax, in.b);
+        as.frame_op({ 0x3B }, reg::rax, in.c);
+        as.set(cc);
+        as.store(in.a, reg::rax);
+    };
+    auto branch = [&](const Instr& in, cond cc) {
+        as.load(reg::rax, in.a);
+        as.frame_op({ 0x3B }, reg::rax, in.b);
+        jump_to(as.jcc(cc), in.c);
+    };
+    auto checked = [&](std::initializer_list<std::uint8_t> opcode,
+                       const Instr& in,
+                       std::uint32_t pc) {
+        as.load(reg::rax, in.b);
+        as.frame_op(opcode, reg::rax, in.c);
+        exits.emplace_back(as.jcc(cond::o), pc);
+        as.store(in.a, reg::rax);
+    };
+
+    for (auto pc = loop; pc <= end; ++pc) {
+        starts[pc - loop] = as.here();
+        const auto& in = code[pc];
+        switch (in.op) {
+            case op_code::mov:
+                as.load(reg::rax, in.b);
+                as.store(in.a, reg::rax);
+                break;
+            case op_code::add:
+                checked({ 0x03 }, in, pc);
+                break;
+            case op_code::sub:
+                checked({ 0x2B }, in, pc);
+                break;
+            case op_code::mul:
+                checked({ 0x0F, 0xAF }, in, pc);
+                break;
+            case op_code::div:
+            case op_code::mod: {
+                as.load(reg::rcx, in.c);
+                as.bytes({ 0x48, 0x85, 0xC9 }); // test rcx, rcx
+                exits.emplace_back(as.jcc(cond::e), pc);
+                as.load(reg::rax, in.b);
+                as.bytes({ 0x48, 0x83, 0xF9, 0xFF }); // cmp rcx, -1
+                const auto divisor_ok = as.jcc(cond::ne);
+                as.bytes({ 0x48, 0xBA }); // mov rdx, INT64_MIN
+                as.imm64(std::uint64_t{ 1 } << 63);
+                as.bytes({ 0x48, 0x39, 0xD0 }); // cmp rax, rdx
+                exits.emplace_back(as.jcc(cond::e), pc);
+                as.patch(divisor_ok, as.here());
+                as.bytes({ 0x48, 0x99 });       // cqo
+                as.bytes({ 0x48, 0xF7, 0xF9 }); // idiv rcx
+                as.store(in.a, in.op == op_code::div ? reg::rax : reg::rdx);
+                break;
+            }
+            case op_code::neg:
+                as.load(reg::rax, in.b);
+                as.bytes({ 0x48, 0xF7, 0xD8 }); // neg rax
+                exits.emplace_back(as.jcc(cond::o), pc);
+                as.store(in.a, reg::rax);
+                break;
+            case op_code::lnot:
+                as.load(reg::rax, in.b);
+                as.bytes({ 0x48, 0x85, 0xC0 }); // test rax, rax
+                as.set(cond::e);
+                as.store(in.a, reg::rax);
+                break;
+            case op_code::lt:
+                compare(in, cond::l);
+                break;
+            case op_code::le:
+                compare(in, cond::le);
+                break;
+            case op_code::gt:
+                compare(in, cond::g);
+                break;
+            case op_code::ge:
+                compare(in, cond::ge);
+                break;
+            case op_code::eq:
+                compare(in, cond::e);
+                break;
+            case op_code::ne:
+                compare(in, cond::ne);
+                break;
+            case op_code::bxor:
+                as.load(reg::rax, in.b);
+                as.frame_op({ 0x33 }, reg::rax, in.c);
+                as.store(in.a, reg::rax);
+                break;
+            case op_code::jmp:
+                jump_to(as.jmp(), in.a);
+                break;
+            case op_code::jz:
+            case op_code::jnz:
+                as.load(reg::rax, in.a);
+                as.bytes({ 0x48, 0x85, 0xC0 }); // test rax, rax
+                jump_to(as.jcc(in.op == op_code::jz ? cond::e : cond::ne),
+                        in.b);
+                break;
+            case op_code::jlt:
+                branch(in, cond::l);
+                break;
+            case op_code::jle:
+                branch(in, cond::le);
+                break;
+            case op_code::jgt:
+                branch(in, cond::g);
+                break;
+            case op_code::jge:
+                branch(in, cond::ge);
+                break;
+            case op_code::jeq:
+                branch(in, cond::e);
+                break;
+            case op_code::jne:
+                branch(in, cond::ne);
+                break;
+            case op_code::load_var: {
+                // The first defined candidate, as in VM::load_var; the VM
+                // reports an undefined variable.
+                std::vector<std::size_t> found;
+                for (const auto slot : program.var_refs[in.b].slots) {
+                    as.test_defined(slot);
+                    const auto next = as.jcc(cond::e);
+                    as.load(reg::rax, slot);
+                    found.push_back(as.jmp());
+                    as.patch(next, as.here());
+                }
+                exits.emplace_back(as.jmp(), pc);
+                for (const auto at : found) {
+                    as.patch(at, as.here());
+                }
+                as.store(in.a, reg::rax);
+                break;
+            }
+            case op_code::store_var: {
+                as.load(reg::rax, in.a);
+                std::vector<std::size_t> done;
+                for (const auto slot : program.var_refs[in.b].slots) {
+                    as.test_defined(slot);
+                    const auto next = as.jcc(cond::e);
+                    as.store(slot, reg::rax);
+                    done.push_back(as.jmp());
+                    as.patch(next, as.here());
+                }
+                as.store(in.c, reg::rax);
+                as.set_defined(in.c, 1);
+                for (const auto at : done) {
+                    as.patch(at, as.here());
+                }
+                break;
+            }
+            case op_code::store_def:
+                as.load(reg::rax, in.b);
+                as.store(in.a, reg::rax);
+                as.set_defined(in.a, 1);
+                break;
+            case op_code::undef:
+                as.set_defined(in.a, 0);
+                break;
+            case op_code::halt:
+            case op_code::input:
+            case op_code::print:
+            case op_code::trap:
+            case op_code::closed_form:
+            case op_code::declare:
+            case op_code::arr_fill:
+            case op_code::arr_push:
+            case op_code::arr_set:
+            case op_code::arr_copy:
+            case op_code::arr_load:
+            case op_code::arr_load_nc:
+            case op_code::arr_store:
+            case op_code::arr_store_nc:
+            case op_code::call:
+            case op_code::tail_call:
+            case op_code::ret:
+                exits.emplace_back(as.jmp(), pc);
+                break;
+        }
+    }
+    exits.emplace_back(as.jmp(), end + 1);
+
+    for (const auto& [at, target] : branches) {
+        as.patch(at, starts[target - loop]);
+    }
+    // One stub per resume pc: mov eax, pc; pop r12; pop rbx; ret
+    std::map<std::uint32_t, std::size_t> stubs;
+    for (const auto& [at, resume] : exits) {
+        auto [stub, added] = stubs.emplace(resume, as.here());
+        if (added) {
+            as.bytes({ 0xB8 });
+            as.imm32(resume);
+            as.bytes({ 0x41, 0x5C, 0x5B, 0xC3 });
+        }
+        as.patch(at, stub->second);
+    }
+    return as.code();
+}
+
+} // namespace
+
+Jit::Jit(const Program& program)
+  : program_(program)
+  , counts_(program.code.size(), 0)
+  , entries_(program.code.size(), nullptr)
+{
+}
+
+Jit::~Jit()
+{
+#if PARACL_JIT_X86_64
+    for (const auto& [addr, size] : mappings_) {
+        munmap(addr, size);
+    }
+#endif
+}
+
+bool Jit::supported()
+{
+    return PARACL_JIT_X86_64 != 0;
+}
+
+Jit::Entry Jit::compile(std::uint32_t loop)
+{
+#if PARACL_JIT_X86_64
+    // The loop runs up to its last back edge.
+    std::uint32_t end = loop;
+    for (auto pc = loop; pc < program_.code.size(); ++pc) {
+        if (jump_target(program_.code[pc]) == loop) {
+            end = pc;
+        }
+    }
+
+    const auto machine_code = assemble(program_, loop, end);
+    if (machine_code.empty()) {
+        return nullptr;
+    }
+
+    const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    const auto size = (machine_code.size() + page - 1) / page * page;
+    void* addr = mmap(nullptr,
+                      size,
+                      PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS,
+                      -1,
+                      0);
+    if (addr == MAP_FAILED) {
+        return nullptr;
+    }
+    std::memcpy(addr, machine_code.data(), machine_code.size());
+    if (mprotect(addr, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(addr, size);
+        return nullptr;
+    }
+    mappings_.emplace_back(addr, size);
+    entries_[loop] = reinterpret_cast<Entry>(addr);
+    return entries_[loop];
+#else
+    static_cast<void>(loop);
+    return nullptr;
+#endif
+}
+
+} // namespace ast::bytecode
@@ -0,0 +1,361 @@
+#include "Bytecode/ProgramImage.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace ast::bytecode {
+
+namespace {
+
+constexpr char kMagic[8] = { 'P', 'C', 'L', 'B', 'C', 'O', 'D', 'E' };
+// Written in native byte order; reads back differently on a machine of
+// the other endianness.
+constexpr std::uint32_t kByteOrder = 0x01020304;
+
+// One instruction and its location, the unit of the code array.
+constexpr std::size_t kInstrFields = 9;
+
+class Writer
+{
+public:
+    template <typename T> void put(T value)
+    {
+        static_assert(std::is_integral_v<T>);
+        bytes_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void put_count(std::size_t count)
+    {
+        put(static_cast<std::uint32_t>(count));
+    }
+
+    void put_string(const std::string& text)
+    {
+        put_count(text.size());
+        bytes_ += text;
+    }
+
+    void put_frame(const FrameLayout& frame)
+    {
+        put_count(frame.constants.size());
+        for (const auto value : frame.constants) {
+            put(value);
+        }
+        put_count(frame.slot_names.size());
+        for (const auto& name : frame.slot_names) {
+            put_string(name);
+        }
+        put(frame.num_temps);
+    }
+
+    const std::string& bytes() const
+    {
+        return bytes_;
+    }
+
+private:
+    std::string bytes_;
+};
+
+class Reader
+{
+public:
+    explicit Reader(std::string_view bytes)
+      : bytes_(bytes)
+    {
+    }
+
+    template <typename T> T get()
+    {
+        static_assert(std::is_integral_v<T>);
+        T value;
+        std::memcpy(&value, take(sizeof(value)), sizeof(value));
+        return value;
+    }
+
+    // A count of elements that take at least `min_size` bytes each, checked
+    // against what is left so a corrupt count cannot allocate gigabytes.
+    std::size_t get_count(std::size_t min_size)
+    {
+        const auto count = static_cast<std::size_t>(get<std::uint32_t>());
+        if (count > (bytes_.size() - pos_) / min_size) {
+            corrupt();
+        }
+        return count;
+    }
+
+    template <typename E> E get_enum(E last)
+    {
+        const auto value = get<std::uint32_t>();
+        if (value > static_cast<std::uint32_t>(last)) {
+            corrupt();
+        }
+        return static_cast<E>(value);
+    }
+
+    std::string get_string()
+    {
+        const auto size = get_count(1);
+        return std::string(take(size), size);
+    }
+
+    void get_frame(FrameLayout& frame)
+    {
+        frame.constants.resize(get_count(sizeof(std::int64_t)));
+        for (auto& value : frame.constants) {
+            value = get<std::int64_t>();
+        }
+        frame.slot_names.resize(get_count(sizeof(std::uint32_t)));
+        for (auto& name : frame.slot_names) {
+            name = get_string();
+        }
+        frame.num_temps = get<std::uint32_t>();
+    }
+
+    const char* take(std::size_t size)
+    {
+        if (size > bytes_.size() - pos_) {
+            corrupt();
+        }
+        const char* data = bytes_.data() + pos_;
+        pos_ += size;
+        return data;
+    }
+
+    bool at_end() const
+    {
+        return pos_ == bytes_.size();
+    }
+
+    [[noreturn]] static void corrupt()
+    {
+        throw std::runtime_error("Corrupt bytecode image");
+    }
+
+private:
+    std::string_view bytes_;
+    std::size_t pos_ = 0;
+};
+
+} // namespace
+
+std::uint64_t content_hash(std::string_view bytes)
+{
+    constexpr std::uint64_t kPrime = 0x100000001b3ULL;
+    std::uint64_t hash = 0xcbf29ce484222325ULL ^ bytes.size();
+    auto mix = [&](std::uint64_t word) {
+        hash = (hash ^ word) * kPrime;
+        hash ^= hash >> 29;
+    };
+
+    std::size_t pos = 0;
+    for (; pos + sizeof(std::uint64_t) <= bytes.size();
+         pos += sizeof(std::uint64_t)) {
+        std::uint64_t word;
+        std::memcpy(&word, bytes.data() + pos, sizeof(word));
+        mix(word);
+    }
+    std::uint64_t tail = 0;
+    if (pos < bytes.size()) {
+        std::memcpy(&tail, bytes.data() + pos, bytes.size() - pos);
+    }
+    mix(tail);
+
+    // Let the high bits of the input reach the low bits of the hash.
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+void write_image(const Program& program, std::ostream& out)
+{
+    Writer payload;
+    payload.put_frame(program);
+
+    payload.put_count(program.code.size());
+    for (std::size_t pc = 0; pc < program.code.size(); ++pc) {
+        const auto& in = program.code[pc];
+        const auto& loc = program.locations[pc];
+        payload.put(static_cast<std::uint32_t>(in.op));
+        payload.put(in.a);
+        payload.put(in.b);
+        payload.put(in.c);
+        payload.put(static_cast<std::uint32_t>(loc.file != FileTable::kNoFile));
+        payload.put(loc.begin_line);
+        payload.put(loc.begin_column);
+        payload.put(loc.end_line);
+        payload.put(loc.end_column);
+    }
+
+    payload.put_count(program.var_refs.size());
+    for (const auto& ref : program.var_refs) {
+        payload.put_string(ref.name);
+        payload.put_count(ref.slots.size());
+        for (const auto slot : ref.slots) {
+            payload.put(slot);
+        }
+    }
+
+    payload.put_count(program.messages.size());
+    for (const auto& message : program.messages) {
+        payload.put_string(message);
+    }
+
+    payload.put_count(program.functions.size());
+    for (const auto& function : program.functions) {
+        payload.put_string(function.name);
+        payload.put(function.entry);
+        payload.put(function.num_params);
+        payload.put_frame(function.frame);
+    }
+
+    payload.put_count(program.closed_forms.size());
+    for (const auto& loop : program.closed_forms) {
+        const auto& form = loop.form;
+        payload.put(form.num_vars);
+        payload.put(form.counter);
+        payload.put(static_cast<std::uint32_t>(form.cmp));
+        payload.put(static_cast<std::uint32_t>(form.bound.kind));
+        payload.put(form.bound.value);
+        payload.put_count(form.terms.size());
+        for (const auto& term : form.terms) {
+            payload.put(static_cast<std::uint32_t>(term.kind));
+            payload.put(term.value);
+        }
+        payload.put_count(form.updates.size());
+        for (const auto& update : form.updates) {
+            payload.put(update.var);
+            payload.put(static_cast<std::uint32_t>(update.subtract));
+            payload.put(update.first);
+            payload.put(update.last);
+        }
+        payload.put_count(loop.vars.size());
+        for (const auto ref : loop.vars) {
+            payload.put(ref);
+        }
+    }
+
+    Writer header;
+    header.put(kImageVersion);
+    header.put(kByteOrder);
+    header.put(static_cast<std::uint64_t>(payload.bytes().size()));
+    header.put(content_hash(payload.bytes()));
+
+    out.write(kMagic, sizeof(kMagic));
+    out << header.bytes() << payload.bytes();
+}
+
+Program read_image(std::string_view image, FileTable::FileId file)
+{
+    Reader header(image);
+    if (std::memcmp(header.take(sizeof(kMagic)), kMagic, sizeof(kMagic)) !=
+        0) {
+        throw std::runtime_error("Not a bytecode image");
+    }
+    if (header.get<std::uint32_t>() != kImageVersion ||
+        header.get<std::uint32_t>() != kByteOrder) {
+        throw std::runtime_error("Unsupported bytecode image version");
+    }
+    const auto size = header.get<std::uint64_t>();
+    const auto checksum = header.get<std::uint64_t>();
+    const auto start = sizeof(kMagic) + 2 * sizeof(std::uint32_t) +
+                       2 * sizeof(std::uint64_t);
+    if (size != image.size() - start ||
+        content_hash(image.substr(start)) != checksum) {
+        Reader::corrupt();
+    }
+
+    Reader in(image.substr(start));
+    Program program;
+    in.get_frame(program);
+
+    const auto code_size = in.get_count(kInstrFields * sizeof(std::uint32_t));
+    program.code.resize(code_size);
+    program.locations.resize(code_size);
+    for (std::size_t pc = 0; pc < code_size; ++pc) {
+        std::uint32_t fields[kInstrFields];
+        std::memcpy(fields, in.take(sizeof(fields)), sizeof(fields));
+        if (fields[0] > static_cast<std::uint32_t>(op_code::closed_form)) {
+            Reader::corrupt();
+        }
+        program.code[pc] = Instr{ static_cast<op_code>(fields[0]),
+                                  fields[1],
+                                  fields[2],
+                                  fields[3] };
+        auto& loc = program.locations[pc];
+        loc.file = fields[4] != 0 ? file : FileTable::kNoFile;
+        loc.begin_line = fields[5];
+        loc.begin_column = fields[6];
+        loc.end_line = fields[7];
+        loc.end_column = fields[8];
+    }
+
+    program.var_refs.resize(in.get_count(2 * sizeof(std::uint32_t)));
+    for (auto& ref : program.var_refs) {
+        ref.name = in.get_string();
+        ref.slots.resize(in.get_count(sizeof(std::uint32_t)));
+        for (auto& slot : ref.slots) {
+            slot = in.get<std::uint32_t>();
+        }
+    }
+
+    program.messages.resize(in.get_count(sizeof(std::uint32_t)));
+    for (auto& message : program.messages) {
+        message = in.get_string();
+    }
+
+    program.functions.resize(in.get_count(5 * sizeof(std::uint32_t)));
+    for (auto& function : program.functions) {
+        function.name = in.get_string();
+        function.entry = in.get<std::uint32_t>();
+        function.num_params = in.get<std::uint32_t>();
+        in.get_frame(function.frame);
+    }
+
+    // run_closed_form() checks the form itself; only the enums and the
+    // references into the program are checked here.
+    program.closed_forms.resize(in.get_count(9 * sizeof(std::uint32_t)));
+    for (auto& loop : program.closed_forms) {
+        auto& form = loop.form;
+        form.num_vars = in.get<std::uint32_t>();
+        form.counter = in.get<std::uint32_t>();
+        form.cmp = in.get_enum<ClosedForm::relation>(
+            ClosedForm::relation::ne);
+        form.bound.kind = in.get_enum<ClosedForm::term_kind>(
+            ClosedForm::term_kind::neg);
+        form.bound.value = in.get<std::int64_t>();
+        form.terms.resize(in.get_count(3 * sizeof(std::uint32_t)));
+        for (auto& term : form.terms) {
+            term.kind =
+                in.get_enum<ClosedForm::term_kind>(ClosedForm::term_kind::neg);
+            term.value = in.get<std::int64_t>();
+        }
+        form.updates.resize(in.get_count(4 * sizeof(std::uint32_t)));
+        for (auto& update : form.updates) {
+            update.var = in.get<std::uint32_t>();
+            update.subtract = in.get<std::uint32_t>() != 0;
+            update.first = in.get<std::uint32_t>();
+            update.last = in.get<std::uint32_t>();
+        }
+        loop.vars.resize(in.get_count(sizeof(std::uint32_t)));
+        for (auto& ref : loop.vars) {
+            ref = in.get<std::uint32_t>();
+            if (ref >= program.var_refs.size()) {
+                Reader::corrupt();
+            }
+        }
+        if (loop.vars.size() != form.num_vars) {
+            Reader::corrupt();
+        }
+    }
+
+    if (!in.at_end()) {
+        Reader::corrupt();
+    }
+    return program;
+}
+
+} // namespace ast::bytecode
@@ -0,0 +1,427 @@
+#include "Bytecode/VM.hpp"
+#include "Runtime/Calls.hpp"
+#include "Runtime/CheckedArith.hpp"
+#include "errors-output/error-formatter.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+int64_t read_input_int64_or_throw(ast::InputSource& input,
+                                  const ast::SourceRange& location)
+{
+    int64_t value = 0;
+    if (!input.read(value)) {
+        throw std::runtime_error(
+            err::format_error(location, "Input error: expected int64_t"));
+    }
+    return value;
+}
+
+} // namespace
+
+namespace ast::bytecode {
+
+VM::VM(const Program& program)
+  : program_(program)
+  , regs_(program.num_regs(), 0)
+  , defined_(program.num_regs(), 0)
+  , arrays_(program.num_regs())
+  , top_(program.num_regs())
+  , frame_(&program)
+{
+    std::copy(program_.constants.begin(),
+              program_.constants.end(),
+              regs_.begin() + program_.const_base());
+}
+
+void VM::fail(std::size_t pc, const char* msg) const
+{
+    throw std::runtime_error(err::format_error(program_.locations[pc], msg));
+}
+
+int64_t VM::load_var(std::uint32_t ref) const
+{
+    const auto& var = program_.var_refs[ref];
+    for (const auto slot : var.slots) {
+        if (defined_[base_ + slot]) {
+            return regs_[base_ + slot];
+        }
+    }
+    throw std::runtime_error(
+        err::format_error(SourceRange(), "Undefined variable: " + var.name));
+}
+
+void VM::store_var(std::uint32_t ref, std::uint32_t create, int64_t value)
+{
+    for (const auto slot : program_.var_refs[ref].slots) {
+        if (defined_[base_ + slot]) {
+            regs_[base_ + slot] = value;
+            return;
+        }
+    }
+    regs_[base_ + create] = value;
+    defined_[base_ + create] = 1;
+}
+
+void VM::declare(std::size_t pc, std::uint32_t slot, int64_t value)
+{
+    if (defined_[base_ + slot]) {
+        throw std::runtime_error(err::format_error(
+            program_.locations[pc],
+            "Variable " + frame_->slot_names[slot] + " already declared"));
+    }
+    regs_[base_ + slot] = value;
+    defined_[base_ + slot] = 1;
+}
+
+// Runs program_.closed_forms[loop] on the running frame. False, with
+// nothing changed, if the loop has to run instead.
+bool VM::run_closed_form(std::uint32_t loop)
+{
+    const auto& closed = program_.closed_forms[loop];
+    std::vector<std::int64_t*> cells(closed.vars.size());
+    std::vector<std::int64_t> values(closed.vars.size());
+    for (std::size_t i = 0; i < cells.size(); ++i) {
+        for (const auto slot : program_.var_refs[closed.vars[i]].slots) {
+            if (defined_[base_ + slot]) {
+                cells[i] = &regs_[base_ + slot];
+                break;
+            }
+        }
+        if (cells[i] == nullptr) {
+            return false;
+        }
+        values[i] = *cells[i];
+    }
+    if (!ast::run_closed_form(closed.form, values.data())) {
+        return false;
+    }
+    for (const auto& update : closed.form.updates) {
+        *cells[update.var] = values[update.var];
+    }
+    return true;
+}
+
+// Makes `function` the running frame at `base`, taking its arguments from
+// the registers at `args`. A tail call passes its own base, so `args` may
+// overlap the new parameter slots, but never lies below them.
+void VM::enter(const Function& function, std::size_t base, std::size_t args)
+{
+    const auto& frame = function.frame;
+    const auto top = base + frame.num_regs();
+    if (top > regs_.size()) {
+        // Grow geometrically; returned frames keep their slots (and array
+        // buffers) for the next call.
+        const auto size = std::max(top, regs_.size() * 2);
+        regs_.resize(size, 0);
+        defined_.resize(size, 0);
+        arrays_.resize(size);
+    }
+
+    for (std::size_t i = 0; i < function.num_params; ++i) {
+        regs_[base + i] = regs_[args + i];
+    }
+    std::copy(frame.constants.begin(),
+              frame.constants.end(),
+              regs_.begin() +
+                  static_cast<std::ptrdiff_t>(base + frame.const_base()));
+    const auto slots = defined_.begin() + static_cast<std::ptrdiff_t>(base);
+    std::fill(slots, slots + function.num_params, 1);
+    std::fill(slots + function.num_params, slots + frame.num_slots(), 0);
+
+    base_ = base;
+    top_ = top;
+    frame_ = &frame;
+}
+
+ArrayStorage& VM::load_array(std::uint32_t ref)
+{
+    const auto& var = program_.var_refs[ref];
+    for (const auto slot : var.slots) {
+        if (defined_[base_ + slot]) {
+            return arrays_[base_ + slot];
+        }
+    }
+    throw std::runtime_error(
+        err::format_error(SourceRange(), "Undefined variable: " + var.name));
+}
+
+ArrayStorage& VM::store_array(std::uint32_t ref)
+{
+    const auto& slots = program_.var_refs[ref].slots;
+    for (const auto slot : slots) {
+        if (defined_[base_ + slot]) {
+            return arrays_[base_ + slot];
+        }
+    }
+    defined_[base_ + slots.front()] = 1;
+    return arrays_[base_ + slots.front()];
+}
+
+std::size_t VM::checked_index(std::size_t pc,
+                              std::int64_t index,
+                              const ArrayStorage& array) const
+{
+    if (!array_index_in_range(index, array.size())) {
+        fail(pc, array_index_error(index, array.size()).c_str());
+    }
+    return static_cast<std::size_t>(index);
+}
+
+void VM::enable_jit()
+{
+    if (Jit::supported() && !jit_) {
+        jit_ = std::make_unique<Jit>(program_);
+    }
+}
+
+void VM::run()
+{
+    try {
+        execute();
+    } catch (...) {
+        out_.flush();
+        throw;
+    }
+    out_.flush();
+}
+
+void VM::execute()
+{
+    constexpr int64_t kMin = std::numeric_limits<int64_t>::min();
+    const Instr* const code = program_.code.data();
+    int64_t* r = regs_.data() + base_;
+    std::size_t pc = 0;
+
+    // Taken jumps go through here so that a hot loop can continue in native
+    // code from its head.
+    const auto jump = [&](std::uint32_t target) {
+        if (jit_ && target < pc) {
+            if (const auto entry = jit_->back_edge(target)) {
+                pc = entry(r, defined_.data() + base_);
+                return;
+            }
+        }
+        pc = target;
+    };
+
+    for (;;) {
+        const Instr& in = code[pc++];
+        switch (in.op) {
+            case op_code::halt:
+                return;
+            case op_code::mov:
+                r[in.a] = r[in.b];
+                break;
+            case op_code::add:
+                if (add_overflow(r[in.b], r[in.c], r[in.a])) {
+                    fail(pc - 1, "Integer overflow in addition");
+                }
+                break;
+            case op_code::sub:
+                if (sub_overflow(r[in.b], r[in.c], r[in.a])) {
+                    fail(pc - 1, "Integer overflow in subtraction");
+                }
+                break;
+            case op_code::mul:
+                if (mul_overflow(r[in.b], r[in.c], r[in.a])) {
+                    fail(pc - 1, "Integer overflow in multiplication");
+                }
+                break;
+            case op_code::div:
+                if (r[in.c] == 0) {
+                    fail(pc - 1, "Division by zero");
+                }
+                if (r[in.b] == kMin && r[in.c] == -1) {
+                    fail(pc - 1, "Integer overflow in division");
+                }
+                r[in.a] = r[in.b] / r[in.c];
+                break;
+            case op_code::mod:
+                if (r[in.c] == 0) {
+                    fail(pc - 1, "Division by zero");
+                }
+                if (r[in.b] == kMin && r[in.c] == -1) {
+                    fail(pc - 1, "Integer overflow in modulus");
+                }
+                r[in.a] = r[in.b] % r[in.c];
+                break;
+            case op_code::neg:
+                if (r[in.b] == kMin) {
+                    fail(pc - 1, "Integer overflow in unary minus");
+                }
+                r[in.a] = -r[in.b];
+                break;
+            case op_code::lnot:
+                r[in.a] = !r[in.b];
+                break;
+            case op_code::lt:
+                r[in.a] = r[in.b] < r[in.c];
+                break;
+            case op_code::le:
+                r[in.a] = r[in.b] <= r[in.c];
+                break;
+            case op_code::gt:
+                r[in.a] = r[in.b] > r[in.c];
+                break;
+            case op_code::ge:
+                r[in.a] = r[in.b] >= r[in.c];
+                break;
+            case op_code::eq:
+                r[in.a] = r[in.b] == r[in.c];
+                break;
+            case op_code::ne:
+                r[in.a] = r[in.b] != r[in.c];
+                break;
+            case op_code::bxor:
+                r[in.a] = r[in.b] ^ r[in.c];
+                break;
+            case op_code::jmp:
+                jump(in.a);
+                break;
+            case op_code::jz:
+                if (r[in.a] == 0) {
+                    jump(in.b);
+                }
+                break;
+            case op_code::jnz:
+                if (r[in.a] != 0) {
+                    jump(in.b);
+                }
+                break;
+            case op_code::jlt:
+                if (r[in.a] < r[in.b]) {
+                    jump(in.c);
+                }
+                break;
+            case op_code::jle:
+                if (r[in.a] <= r[in.b]) {
+                    jump(in.c);
+                }
+                break;
+            case op_code::jgt:
+                if (r[in.a] > r[in.b]) {
+                    jump(in.c);
+                }
+                break;
+            case op_code::jge:
+                if (r[in.a] >= r[in.b]) {
+                    jump(in.c);
+                }
+                break;
+            case op_code::jeq:
+                if (r[in.a] == r[in.b]) {
+                    jump(in.c);
+                }
+                break;
+            case op_code::jne:
+                if (r[in.a] != r[in.b]) {
+                    jump(in.c);
+                }
+                break;
+            case op_code::input:
+                out_.flush();
+                r[in.a] = read_input_int64_or_throw(in_, program_.locations[pc - 1]);
+                break;
+            case op_code::print:
+                out_.print(r[in.a]);
+                break;
+            case op_code::load_var:
+                r[in.a] = load_var(in.b);
+                break;
+            case op_code::store_var:
+                store_var(in.b, in.c, r[in.a]);
+                break;
+            case op_code::store_def:
+                r[in.a] = r[in.b];
+                defined_[base_ + in.a] = 1;
+                break;
+            case op_code::declare:
+                declare(pc - 1, in.a, r[in.b]);
+                break;
+            case op_code::undef:
+                defined_[base_ + in.a] = 0;
+                break;
+            case op_code::trap:
+                throw std::runtime_error(program_.messages[in.a]);
+            case op_code::arr_fill: {
+                if (const auto error = array_size_error(r[in.c])) {
+                    fail(pc - 1, error->c_str());
+                }
+                const auto value = r[in.b];
+                store_array(in.a).assign(static_cast<std::size_t>(r[in.c]),
+                                         value);
+                break;
+            }
+            case op_code::arr_push:
+                pending_.push_back(r[in.a]);
+                break;
+            case op_code::arr_set:
+                store_array(in.a).swap(pending_);
+                pending_.clear();
+                break;
+            case op_code::arr_copy: {
+                const auto& src = load_array(in.b);
+                auto& dst = store_array(in.a);
+                if (&dst != &src) {
+                    dst = src;
+                }
+                break;
+            }
+            case op_code::arr_load: {
+                const auto index = r[in.c];
+                const auto& array = load_array(in.b);
+                r[in.a] = array[checked_index(pc - 1, index, array)];
+                break;
+            }
+            case op_code::arr_load_nc:
+                r[in.a] = load_array(in.b)[static_cast<std::size_t>(r[in.c])];
+                break;
+            case op_code::arr_store: {
+                auto& array = load_array(in.a);
+                array[checked_index(pc - 1, r[in.b], array)] = r[in.c];
+                break;
+            }
+            case op_code::arr_store_nc:
+                load_array(in.a)[static_cast<std::size_t>(r[in.b])] = r[in.c];
+                break;
+            case op_code::call:
+                if (calls_.size() == kMaxCallDepth) {
+                    fail(pc - 1, kCallDepthError);
+                }
+                calls_.push_back(CallFrame{ pc, in.a, base_, frame_ });
+                enter(program_.functions[in.b], top_, base_ + in.c);
+                r = regs_.data() + base_;
+                pc = program_.functions[in.b].entry;
+                break;
+            case op_code::tail_call:
+                enter(program_.functions[in.b], base_, base_ + in.c);
+                r = regs_.data() + base_;
+                pc = program_.functions[in.b].entry;
+                break;
+            case op_code::ret: {
+                const auto value = r[in.a];
+                const auto caller = calls_.back();
+                calls_.pop_back();
+                base_ = caller.base;
+                frame_ = caller.frame;
+                top_ = base_ + frame_->num_regs();
+                r = regs_.data() + base_;
+                r[caller.dst] = value;
+                pc = caller.return_pc;
+                break;
+            }
+            case op_code::closed_form:
+                if (run_closed_form(in.a)) {
+                    jump(in.b);
+                }
+                break;
+        }
+    }
+}
+
+} // namespace ast::bytecode
@@ -0,0 +1,484 @@
+#include "Visitors/ClosedFormLoops.hpp"
+
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace ast {
+
+namespace {
+
+const VarNode* scalar_var(const BaseNode* node)
+{
+    if (node == nullptr || node->node_type() != base_node_type::var) {
+        return nullptr;
+    }
+    const auto* var = static_cast<const VarNode*>(node);
+    return var->kind() == value_kind::scalar ? var : nullptr;
+}
+
+bool reads(const BaseNode& node, Name name)
+{
+    if (node.node_type() == base_node_type::var &&
+        static_cast<const VarNode&>(node).name() == name) {
+        return true;
+    }
+    for (const auto& child : node.children()) {
+        if (child && reads(*child, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<ClosedForm::relation> relation_of(bin_logic_op_type op)
+{
+    switch (op) {
+        case bin_logic_op_type::less:
+            return ClosedForm::relation::lt;
+        case bin_logic_op_type::less_equal:
+            return ClosedForm::relation::le;
+        case bin_logic_op_type::greater:
+            return ClosedForm::relation::gt;
+        case bin_logic_op_type::greater_equal:
+            return ClosedForm::relation::ge;
+        case bin_logic_op_type::equal:
+            return ClosedForm::relation::eq;
+        case bin_logic_op_type::not_equal:
+            return ClosedForm::relation::ne;
+        case bin_logic_op_type::logical_and:
+        case bin_logic_op_type::logical_or:
+        case bin_logic_op_type::bitwise_xor:
+            break;
+    }
+    return std::nullopt;
+}
+
+// `a <cmp> b` as `b <swapped cmp> a`.
+ClosedForm::relation swapped(ClosedForm::relation cmp)
+{
+    switch (cmp) {
+        case ClosedForm::relation::lt:
+            return ClosedForm::relation::gt;
+        case ClosedForm::relation::le:
+            return ClosedForm::relation::ge;
+        case ClosedForm::relation::gt:
+            return ClosedForm::relation::lt;
+        case ClosedForm::relation::ge:
+            return ClosedForm::relation::le;
+        case ClosedForm::relation::eq:
+        case ClosedForm::relation::ne:
+            break;
+    }
+    return cmp;
+}
+
+// Describes one loop as a ClosedForm, numbering variables as it meets
+// them. Every step fails on anything the closed form cannot express.
+class Reducer
+{
+public:
+    bool condition(const BaseNode* cond)
+    {
+        if (cond == nullptr ||
+            cond->node_type() != base_node_type::bin_logic_op) {
+            return false;
+        }
+        const auto& compare = static_cast<const BinLogicOpNode&>(*cond);
+        const auto cmp = relation_of(compare.op());
+        if (!cmp || !operand(compare.left()) || !operand(compare.right())) {
+            return false;
+        }
+        cmp_ = *cmp;
+        lhs_ = compare.left();
+        rhs_ = compare.right();
+        return true;
+    }
+
+    // A loop body or for step: one update, or a block of them.
+    bool statements(const BaseNode* node)
+    {
+        if (node == nullptr) {
+            return true;
+        }
+        if (node->node_type() != base_node_type::scope) {
+            return statement(*node);
+        }
+        for (const auto& stmt : node->children()) {
+            if (!stmt || !statement(*stmt)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::shared_ptr<const LoopReduction> finish()
+    {
+        auto& form = reduction_.form;
+        // The counter is the side of the condition the loop updates.
+        const BaseNode* bound = rhs_;
+        if (const auto* var = scalar_var(lhs_); var && updated(var->name())) {
+            form.counter = number(*var);
+            form.cmp = cmp_;
+        } else if (const auto* other = scalar_var(rhs_);
+                   other && updated(other->name())) {
+            form.counter = number(*other);
+            form.cmp = swapped(cmp_);
+            bound = lhs_;
+        } else {
+            return nullptr;
+        }
+
+        if (const auto* var = scalar_var(bound)) {
+            if (updated(var->name())) {
+                return nullptr;
+            }
+            form.bound = { ClosedForm::term_kind::var, number(*var) };
+        } else {
+            form.bound = { ClosedForm::term_kind::constant,
+                           static_cast<const ValueNode*>(bound)->value() };
+        }
+        if (!linear(form.counter) || !steps_stay_linear()) {
+            return nullptr;
+        }
+        form.num_vars = static_cast<std::uint32_t>(reduction_.vars.size());
+        return std::make_shared<const LoopReduction>(std::move(reduction_));
+    }
+
+private:
+    LoopReduction reduction_;
+    std::unordered_map<Name, std::uint32_t> numbers_;
+    std::unordered_set<std::uint32_t> updated_;
+    ClosedForm::relation cmp_ = ClosedForm::relation::lt;
+    const BaseNode* lhs_ = nullptr;
+    const BaseNode* rhs_ = nullptr;
+
+    static bool operand(const BaseNode* node)
+    {
+        return scalar_var(node) != nullptr ||
+               (node != nullptr && node->node_type() == base_node_type::value);
+    }
+
+    std::uint32_t number(const VarNode& var)
+    {
+        const auto [it, added] = numbers_.emplace(
+            var.name(), static_cast<std::uint32_t>(reduction_.vars.size()));
+        if (added) {
+            reduction_.vars.push_back({ var.name(), var.frame_index() });
+        }
+        return it->second;
+    }
+
+    bool updated(Name name) const
+    {
+        const auto it = numbers_.find(name);
+        return it != numbers_.end() && updated_.count(it->second) != 0;
+    }
+
+    bool statement(const BaseNode& node)
+    {
+        const BaseNode* stmt = &node;
+        if (stmt->node_type() == base_node_type::expr) {
+            stmt = static_cast<const ExprNode*>(stmt)->expr();
+        }
+        if (stmt == nullptr) {
+            return false;
+        }
+        if (stmt->node_type() == base_node_type::empty) {
+            return true;
+        }
+        if (stmt->node_type() != base_node_type::assign) {
+            return false;
+        }
+
+        const auto& assign = static_cast<const AssignNode&>(*stmt);
+        const auto* target = scalar_var(assign.lhs());
+        const auto* rhs = assign.rhs();
+        if (target == nullptr || rhs == nullptr ||
+            rhs->node_type() != base_node_type::bin_arith_op ||
+            updated(target->name())) {
+            return false;
+        }
+
+        // v = v + d, v = d + v or v = v - d.
+        const auto& arith = static_cast<const BinArithOpNode&>(*rhs);
+        const auto is_target = [&](const BaseNode* side) {
+            const auto* var = scalar_var(side);
+            return var != nullptr && var->name() == target->name();
+        };
+        const BaseNode* delta = nullptr;
+        bool subtract = false;
+        if (arith.op() == bin_arith_op_type::add) {
+            delta = is_target(arith.left())    ? arith.right()
+                    : is_target(arith.right()) ? arith.left()
+                                               : nullptr;
+        } else if (arith.op() == bin_arith_op_type::sub &&
+                   is_target(arith.left())) {
+            delta = arith.right();
+            subtract = true;
+        }
+        if (delta == nullptr || reads(*delta, target->name())) {
+            return false;
+        }
+
+        auto& form = reduction_.form;
+        ClosedForm::Update update;
+        update.var = number(*target);
+        update.subtract = subtract;
+        update.first = static_cast<std::uint32_t>(form.terms.size());
+        if (!append_terms(*delta)) {
+            return false;
+        }
+        update.last = static_cast<std::uint32_t>(form.terms.size());
+        form.updates.push_back(update);
+        updated_.insert(update.var);
+        return true;
+    }
+
+    bool append_terms(const BaseNode& node)
+    {
+        auto& terms = reduction_.form.terms;
+        switch (node.node_type()) {
+            case base_node_type::value: {
+                const auto value = static_cast<const ValueNode&>(node).value();
+                terms.push_back({ ClosedForm::term_kind::constant, value });
+                return true;
+            }
+            case base_node_type::var: {
+                const auto* var = scalar_var(&node);
+                if (var == nullptr) {
+                    return false;
+                }
+                terms.push_back({ ClosedForm::term_kind::var, number(*var) });
+                return true;
+            }
+            case base_node_type::unop: {
+                const auto& unop = static_cast<const UnOpNode&>(node);
+                if (unop.operand() == nullptr ||
+                    unop.op() == unop_node_type::logical_not ||
+                    !append_terms(*unop.operand())) {
+                    return false;
+                }
+                if (unop.op() == unop_node_type::neg) {
+                    terms.push_back({ ClosedForm::term_kind::neg, 0 });
+                }
+                return true;
+            }
+            case base_node_type::bin_arith_op: {
+                const auto& arith = static_cast<const BinArithOpNode&>(node);
+                ClosedForm::term_kind kind = ClosedForm::term_kind::add;
+                switch (arith.op()) {
+                    case bin_arith_op_type::add:
+                        kind = ClosedForm::term_kind::add;
+                        break;
+                    case bin_arith_op_type::sub:
+                        kind = ClosedForm::term_kind::sub;
+                        break;
+                    case bin_arith_op_type::mul:
+                        kind = ClosedForm::term_kind::mul;
+                        break;
+                    case bin_arith_op_type::div:
+                    case bin_arith_op_type::mod:
+                        return false;
+                }
+                if (arith.left() == nullptr || arith.right() == nullptr ||
+                    !append_terms(*arith.left()) ||
+                    !append_terms(*arith.right())) {
+                    return false;
+                }
+                terms.push_back({ kind, 0 });
+                return true;
+            }
+            case base_node_type::base:
+            case base_node_type::bin_logic_op:
+            case base_node_type::scope:
+            case base_node_type::print:
+            case base_node_type::assign:
+            case base_node_type::expr:
+            case base_node_type::if_node:
+            case base_node_type::while_node:
+            case base_node_type::for_node:
+            case base_node_type::input:
+            case base_node_type::var_decl:
+            case base_node_type::err:
+            case base_node_type::empty:
+            case base_node_type::array:
+            case base_node_type::index:
+            case base_node_type::func:
+            case base_node_type::call:
+            case base_node_type::return_node:
+                break;
+        }
+        return false;
+    }
+
+    const ClosedForm::Update* update_of(std::uint32_t var) const
+    {
+        for (const auto& update : reduction_.form.updates) {
+            if (update.var == var) {
+                return &update;
+            }
+        }
+        return nullptr;
+    }
+
+    // Whether `var` moves by the same amount on every iteration: its
+    // delta reads nothing the loop updates.
+    bool linear(std::uint32_t var) const
+    {
+        const auto* update = update_of(var);
+        if (update == nullptr) {
+            return false;
+        }
+        const auto& terms = reduction_.form.terms;
+        for (auto t = update->first; t < update->last; ++t) {
+            if (terms[t].kind == ClosedForm::term_kind::var &&
+                updated_.count(static_cast<std::uint32_t>(terms[t].value))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Whether every delta is linear in the iteration: it reads only
+    // variables that are invariant or linear, and multiplies no two of
+    // the linear ones. The same checks run_closed_form() makes at runtime.
+    bool steps_stay_linear() const
+    {
+        const auto& terms = reduction_.form.terms;
+        for (const auto& update : reduction_.form.updates) {
+            std::vector<bool> moves;
+            for (auto t = update.first; t < update.last; ++t) {
+                const auto& term = terms[t];
+                switch (term.kind) {
+                    case ClosedForm::term_kind::constant:
+                        moves.push_back(false);
+                        break;
+                    case ClosedForm::term_kind::var: {
+                        const auto var = static_cast<std::uint32_t>(term.value);
+                        if (updated_.count(var) && !linear(var)) {
+                            return false;
+                        }
+                        moves.push_back(updated_.count(var) != 0);
+                        break;
+                    }
+                    case ClosedForm::term_kind::neg:
+                        break;
+                    case ClosedForm::term_kind::add:
+                    case ClosedForm::term_kind::sub:
+                    case ClosedForm::term_kind::mul: {
+                        const bool rhs = moves.back();
+                        moves.pop_back();
+                        if (term.kind == ClosedForm::term_kind::mul &&
+                            rhs && moves.back()) {
+                            return false;
+                        }
+                        moves.back() = moves.back() || rhs;
+                        break;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+};
+
+} // namespace
+
+void ClosedFormLoops::reduce(BaseNode* root)
+{
+    if (root != nullptr) {
+        root->accept(*this);
+    }
+}
+
+void ClosedFormLoops::visit_children(BaseNode& node)
+{
+    for (auto& child : node.children()) {
+        if (child) {
+            child->accept(*this);
+        }
+    }
+}
+
+void ClosedFormLoops::visit(WhileNode& node)
+{
+    visit_children(node);
+    Reducer reducer;
+    if (!reducer.condition(node.condition()) ||
+        !reducer.statements(node.body())) {
+        return;
+    }
+    if (auto reduction = reducer.finish()) {
+        node.set_reduction(std::move(reduction));
+        ++reduced_count_;
+    }
+}
+
+void ClosedFormLoops::visit(ForNode& node)
+{
+    visit_children(node);
+    // The init statement runs before the closed form does, as usual.
+    Reducer reducer;
+    if (!reducer.condition(node.get_cond()) ||
+        !reducer.statements(node.get_body()) ||
+        !reducer.statements(node.get_step())) {
+        return;
+    }
+    if (auto reduction = reducer.finish()) {
+        node.set_reduction(std::move(reduction));
+        ++reduced_count_;
+    }
+}
+
+void ClosedFormLoops::visit(ScopeNode& node)
+{
+    visit_children(node);
+}
+
+void ClosedFormLoops::visit(IfNode& node)
+{
+    visit_children(node);
+}
+
+void ClosedFormLoops::visit(FuncNode& node)
+{
+    visit_children(node);
+}
+
+// Expressions and simple statements hold no loops.
+void ClosedFormLoops::visit(BinArithOpNode&) {}
+
+void ClosedFormLoops::visit(BinLogicOpNode&) {}
+
+void ClosedFormLoops::visit(ValueNode&) {}
+
+void ClosedFormLoops::visit(UnOpNode&) {}
+
+void ClosedFormLoops::visit(AssignNode&) {}
+
+void ClosedFormLoops::visit(VarNode&) {}
+
+void ClosedFormLoops::visit(InputNode&) {}
+
+void ClosedFormLoops::visit(ExprNode&) {}
+
+void ClosedFormLoops::visit(PrintNode&) {}
+
+void ClosedFormLoops::visit(VarDeclNode&) {}
+
+void ClosedFormLoops::visit(ErrorNode&) {}
+
+void ClosedFormLoops::visit(EmptyNode&) {}
+
+void ClosedFormLoops::visit(ArrayNode&) {}
+
+void ClosedFormLoops::visit(IndexNode&) {}
+
+void ClosedFormLoops::visit(CallNode&) {}
+
+void ClosedFormLoops::visit(ReturnNode&) {}
+
+} // namespace ast
@@ -0,0 +1,368 @@
+#include "Visitors/ConstantFolder.hpp"
+#include "Runtime/CheckedArith.hpp"
+
+#include <limits>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace ast {
+
+namespace {
+
+std::optional<int64_t> constant_of(const BaseNode* node)
+{
+    if (node != nullptr && node->node_type() == base_node_type::value) {
+        return static_cast<const ValueNode*>(node)->value();
+    }
+    return std::nullopt;
+}
+
+bool is_value(const BaseNode* node, int64_t value)
+{
+    const auto constant = constant_of(node);
+    return constant && *constant == value;
+}
+
+bool is_not(const BaseNode* node)
+{
+    return node != nullptr && node->node_type() == base_node_type::unop &&
+           static_cast<const UnOpNode*>(node)->op() ==
+               unop_node_type::logical_not;
+}
+
+// Assignments and declarations change meaning when they become the whole
+// condition of a loop, so identities never promote them.
+bool can_stand_alone(const BaseNode* node)
+{
+    return node != nullptr && node->node_type() != base_node_type::assign &&
+           node->node_type() != base_node_type::var_decl;
+}
+
+// Same rules as Interpreter::visit(BinArithOpNode&); nullopt means the
+// operation traps at runtime.
+std::optional<int64_t> evaluate(bin_arith_op_type op, int64_t lhs, int64_t rhs)
+{
+    constexpr int64_t kMin = std::numeric_limits<int64_t>::min();
+    int64_t result = 0;
+    switch (op) {
+        case bin_arith_op_type::add:
+            if (add_overflow(lhs, rhs, result)) {
+                return std::nullopt;
+            }
+            return result;
+        case bin_arith_op_type::sub:
+            if (sub_overflow(lhs, rhs, result)) {
+                return std::nullopt;
+            }
+            return result;
+        case bin_arith_op_type::mul:
+            if (mul_overflow(lhs, rhs, result)) {
+                return std::nullopt;
+            }
+            return result;
+        case bin_arith_op_type::div:
+            if (rhs == 0 || (lhs == kMin && rhs == -1)) {
+                return std::nullopt;
+            }
+            return lhs / rhs;
+        case bin_arith_op_type::mod:
+            if (rhs == 0 || (lhs == kMin && rhs == -1)) {
+                return std::nullopt;
+            }
+            return lhs % rhs;
+    }
+    return std::nullopt;
+}
+
+int64_t evaluate(bin_logic_op_type op, int64_t lhs, int64_t rhs)
+{
+    switch (op) {
+        case bin_logic_op_type::greater:
+            return lhs > rhs;
+        case bin_logic_op_type::less:
+            return lhs < rhs;
+        case bin_logic_op_type::greater_equal:
+            return lhs >= rhs;
+        case bin_logic_op_type::less_equal:
+            return lhs <= rhs;
+        case bin_logic_op_type::equal:
+            return lhs == rhs;
+        case bin_logic_op_type::not_equal:
+            return lhs != rhs;
+        case bin_logic_op_type::logical_and:
+            return lhs && rhs;
+        case bin_logic_op_type::logical_or:
+            return lhs || rhs;
+        case bin_logic_op_type::bitwise_xor:
+            return lhs ^ rhs;
+    }
+    return 0;
+}
+
+} // namespace
+
+void ConstantFolder::fold(BaseNode* root)
+{
+    if (root == nullptr) {
+        return;
+    }
+    root->accept(*this);
+    // The root has no parent slot to be replaced in.
+    replacement_.reset();
+}
+
+void ConstantFolder::fold_children(BaseNode& node)
+{
+    for (auto& child : node.children()) {
+        if (!child) {
+            continue;
+        }
+        child->accept(*this);
+        if (replacement_) {
+            replacement_->set_parent(&node);
+            child = std::move(replacement_);
+        }
+    }
+}
+
+void ConstantFolder::replace_with_value(const BaseNode& node, int64_t value)
+{
+    replacement_ = std::make_unique<ValueNode>(value);
+    replacement_->set_location(node.location());
+    ++folded_count_;
+}
+
+void ConstantFolder::replace_with_child(BaseNode& node, std::size_t index)
+{
+    replacement_ = std::move(node.children()[index]);
+    ++folded_count_;
+}
+
+// `!!x` only matters for its truth value where the result is tested
+// rather than stored, so there it is replaced by `x`.
+void ConstantFolder::strip_double_not(BaseNode& node, const BaseNode* operand)
+{
+    if (!is_not(operand)) {
+        return;
+    }
+    const auto* inner = static_cast<const UnOpNode*>(operand)->operand();
+    if (!is_not(inner) ||
+        !can_stand_alone(static_cast<const UnOpNode*>(inner)->operand())) {
+        return;
+    }
+    for (auto& child : node.children()) {
+        if (child.get() == operand) {
+            auto stripped = std::move(child->children()[0]->children()[0]);
+            stripped->set_parent(&node);
+            child = std::move(stripped);
+            ++folded_count_;
+            return;
+        }
+    }
+}
+
+void ConstantFolder::visit(BinArithOpNode& node)
+{
+    fold_children(node);
+    const auto lhs = constant_of(node.left());
+    const auto rhs = constant_of(node.right());
+
+    if (lhs && rhs) {
+        if (const auto result = evaluate(node.op(), *lhs, *rhs)) {
+            replace_with_value(node, *result);
+        }
+        return;
+    }
+
+    switch (node.op()) {
+        case bin_arith_op_type::add:
+            if (is_value(node.right(), 0) && can_stand_alone(node.left())) {
+                replace_with_child(node, 0);
+            } else if (is_value(node.left(), 0) &&
+                       can_stand_alone(node.right())) {
+                replace_with_child(node, 1);
+            }
+            break;
+        case bin_arith_op_type::mul:
+            if (is_value(node.right(), 1) && can_stand_alone(node.left())) {
+                replace_with_child(node, 0);
+            } else if (is_value(node.left(), 1) &&
+                       can_stand_alone(node.right())) {
+                replace_with_child(node, 1);
+            }
+            break;
+        case bin_arith_op_type::sub:
+            if (is_value(node.right(), 0) && can_stand_alone(node.left())) {
+                replace_with_child(node, 0);
+            }
+            break;
+        case bin_arith_op_type::div:
+            if (is_value(node.right(), 1) && can_stand_alone(node.left())) {
+                replace_with_child(node, 0);
+            }
+            break;
+        case bin_arith_op_type::mod:
+            break;
+    }
+}
+
+void ConstantFolder::visit(BinLogicOpNode& node)
+{
+    fold_children(node);
+    const auto lhs = constant_of(node.left());
+    const auto rhs = constant_of(node.right());
+
+    switch (node.op()) {
+        case bin_logic_op_type::logical_and:
+        case bin_logic_op_type::logical_or: {
+            const bool is_and = node.op() == bin_logic_op_type::logical_and;
+            // The right operand is never evaluated, whatever it is.
+            if (lhs && (*lhs != 0) != is_and) {
+                replace_with_value(node, is_and ? 0 : 1);
+                return;
+            }
+            strip_double_not(node, node.left());
+            strip_double_not(node, node.right());
+            break;
+        }
+        case bin_logic_op_type::bitwise_xor:
+            if (!lhs && is_value(node.right(), 0) &&
+                can_stand_alone(node.left())) {
+                replace_with_child(node, 0);
+                return;
+            }
+            break;
+        case bin_logic_op_type::greater:
+        case bin_logic_op_type::less:
+        case bin_logic_op_type::greater_equal:
+        case bin_logic_op_type::less_equal:
+        case bin_logic_op_type::equal:
+        case bin_logic_op_type::not_equal:
+            break;
+    }
+
+    if (lhs && rhs) {
+        replace_with_value(node, evaluate(node.op(), *lhs, *rhs));
+    }
+}
+
+void ConstantFolder::visit(ValueNode&) {}
+
+void ConstantFolder::visit(UnOpNode& node)
+{
+    fold_children(node);
+    auto* operand = node.operand();
+
+    if (const auto value = constant_of(operand)) {
+        switch (node.op()) {
+            case unop_node_type::pos:
+                replace_with_value(node, *value);
+                break;
+            case unop_node_type::neg:
+                if (*value != std::numeric_limits<int64_t>::min()) {
+                    replace_with_value(node, -*value);
+                }
+                break;
+            case unop_node_type::logical_not:
+                replace_with_value(node, !*value);
+                break;
+        }
+        return;
+    }
+
+    if (node.op() == unop_node_type::pos && can_stand_alone(operand)) {
+        replace_with_child(node, 0);
+        return;
+    }
+
+    // `!!!x` is `!x`.
+    if (node.op() == unop_node_type::logical_not && is_not(operand) &&
+        is_not(static_cast<UnOpNode*>(operand)->operand())) {
+        replacement_ = std::move(operand->children()[0]);
+        ++folded_count_;
+    }
+}
+
+void ConstantFolder::visit(AssignNode& node)
+{
+    fold_children(node);
+}
+
+void ConstantFolder::visit(VarNode&) {}
+
+void ConstantFolder::visit(IfNode& node)
+{
+    fold_children(node);
+    strip_double_not(node, node.condition());
+}
+
+void ConstantFolder::visit(WhileNode& node)
+{
+    fold_children(node);
+    strip_double_not(node, node.condition());
+}
+
+void ConstantFolder::visit(ForNode& node)
+{
+    fold_children(node);
+    strip_double_not(node, node.get_cond());
+}
+
+void ConstantFolder::visit(InputNode&) {}
+
+void ConstantFolder::visit(ExprNode& node)
+{
+    fold_children(node);
+}
+
+void ConstantFolder::visit(PrintNode& node)
+{
+    fold_children(node);
+}
+
+void ConstantFolder::visit(ScopeNode& node)
+{
+    fold_children(node);
+}
+
+void ConstantFolder::visit(VarDeclNode& node)
+{
+    fold_children(node);
+}
+
+void ConstantFolder::visit(ErrorNode&) {}
+
+void ConstantFolder::visit(EmptyNode&) {}
+
+void ConstantFolder::visit(ArrayNode& node)
+{
+    fold_children(node);
+}
+
+void ConstantFolder::visit(IndexNode& node)
+{
+    fold_children(node);
+}
+
+void ConstantFolder::visit(FuncNode& node)
+{
+    fold_children(node);
+}
+
+void ConstantFolder::visit(CallNode& node)
+{
+    fold_children(node);
+}
+
+void ConstantFolder::visit(ReturnNode& node)
+{
+    fold_children(node);
+    // `return f(x) * 1` folds into a tail call.
+    if (auto* expr = node.expr();
+        expr != nullptr && expr->node_type() == base_node_type::call) {
+        static_cast<CallNode*>(expr)->set_tail(true);
+    }
+}
+
+} // namespace ast
@@ -1,13 +1,17 @@
 #include "Visitors/Interpreter.hpp"
 #include "AST/AST.hpp"
+#include "Runtime/CheckedArith.hpp"
+#include "Runtime/ClosedForm.hpp"
+#include "Visitors/ClosedFormLoops.hpp"
+#include "Visitors/detail/Evaluable.hpp"
 #include "Visitors/detail/ScopeGuard.hpp"
 #include "errors-output/error-formatter.hpp"
 
-#include <iostream>
 #include <limits>
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <utility>
 
 namespace {
 
@@ -57,12 +61,46 @@ void accept_stmt_if_present(ast::BaseNode* node, ast::Visitor& visitor)
     }
 }
 
-int64_t read_input_int64_or_throw(const ast::SourceRange& location)
+// Whole-array values only come from an array literal or another array
+// variable; SemanticChecker has marked the latter.
+bool holds_array(const ast::BaseNode& node)
+{
+    if (node.node_type() == ast::base_node_type::array) {
+        return true;
+    }
+    return node.node_type() == ast::base_node_type::var &&
+           static_cast<const ast::VarNode&>(node).kind() ==
+               ast::value_kind::array;
+}
+
+const ast::VarNode& require_array_base(const ast::IndexNode& node)
+{
+    const auto* base = node.base();
+    require_expr_node(base, node.location(), "IndexNode missing array");
+    if (base->node_type() != ast::base_node_type::var) {
+        throw std::runtime_error(err::format_error(
+            node.location(), "Indexed expression must be a variable"));
+    }
+    return static_cast<const ast::VarNode&>(*base);
+}
+
+std::uint32_t tracked_frame_index(const ast::BaseNode& condition)
+{
+    if (condition.node_type() == ast::base_node_type::assign) {
+        const auto* lhs = static_cast<const ast::AssignNode&>(condition).lhs();
+        return static_cast<const ast::VarNode*>(lhs)->frame_index();
+    }
+    if (condition.node_type() == ast::base_node_type::var_decl) {
+        return static_cast<const ast::VarDeclNode&>(condition).frame_index();
+    }
+    return ast::kNoFrameIndex;
+}
+
+int64_t read_input_int64_or_throw(ast::InputSource& input,
+                                  const ast::SourceRange& location)
 {
     int64_t value = 0;
-    if (!(std::cin >> value)) {
-        std::cin.clear();
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    if (!input.read(value)) {
         throw std::runtime_error(
             err::format_error(location, "Input error: expected int64_t"));
     }
@@ -78,6 +116,12 @@ Interpreter::Interpreter()
 {
 }
 
+Interpreter::Interpreter(std::size_t frame_size)
+  : table_(frame_size)
+  , last_value_(0)
+{
+}
+
 void Interpreter::visit(BinArithOpNode& node)
 {
     auto* left = node.left();
@@ -238,6 +282,14 @@ void Interpreter::visit(AssignNode& node)
 
     require_expr_node(lhs, node.location(), "AssignNode's lhs is missing");
 
+    if (lhs->node_type() == base_node_type::index) {
+        auto* operand = node.rhs();
+        require_expr_node(
+            operand, node.location(), "AssignNode missing operand");
+        assign_element(static_cast<IndexNode&>(*lhs), *operand);
+        return;
+    }
+
     bool is_var = lhs->node_type() == base_node_type::var;
     if (!is_var) {
         throw std::runtime_error(
@@ -248,13 +300,22 @@ void Interpreter::visit(AssignNode& node)
     auto* operand = node.rhs();
     require_expr_node(operand, node.location(), "AssignNode missing operand");
 
+    if (holds_array(*operand)) {
+        assign_array(*var, *operand);
+        return;
+    }
+
     operand->accept(*this);
-    table_.assign_or_create(var->name(), last_value_);
+    if (table_.has_frame()) {
+        table_.store(var->frame_index(), last_value_);
+    } else {
+        table_.assign_or_create(var->name(), last_value_);
+    }
 }
 
 void Interpreter::visit(VarNode& node)
 {
-    last_value_ = table_.lookup(node.name());
+    last_value_ = read_var(node.name(), node.frame_index());
 }
 
 void Interpreter::visit(IfNode& node)
@@ -264,9 +325,10 @@ void Interpreter::visit(IfNode& node)
     auto* then_branch = node.then_branch();
     auto* else_branch = node.else_branch();
 
-    detail::ScopeGuard scope_guard(table_, node.location());
-    validate_evaluable_node(
-        *cond, "Invalid condition", evaluable_context::condition);
+    detail::ScopeGuard scope_guard(
+        table_, node.location(), node.frame_range());
+    detail::validate_evaluable_node(
+        *cond, "Invalid condition", detail::evaluable_context::condition);
     cond->accept(*this);
     if (last_value_) {
         accept_stmt_if_present(then_branch, *this);
@@ -282,14 +344,22 @@ void Interpreter::visit(WhileNode& node)
 
     require_expr_node(cond, node.location(), "Missing condition");
 
-    detail::ScopeGuard scope_guard(table_, node.location());
-    const auto cond_var_name = validate_evaluable_node(
-        *cond, "Invalid condition", evaluable_context::condition);
-    evaluate_loop_condition(*cond, cond_var_name, true);
+    detail::ScopeGuard scope_guard(
+        table_, node.location(), node.frame_range());
+    if (run_reduced(node.reduction())) {
+        return;
+    }
+    const auto cond_var_name = detail::validate_evaluable_node(
+        *cond, "Invalid condition", detail::evaluable_context::condition);
+    const auto cond_var_index = tracked_frame_index(*cond);
+    evaluate_loop_condition(*cond, cond_var_name, cond_var_index, true);
 
     while (last_value_) {
         accept_stmt_if_present(body, *this);
-        evaluate_loop_condition(*cond, cond_var_name, false);
+        if (returning_) {
+            return;
+        }
+        evaluate_loop_condition(*cond, cond_var_name, cond_var_index, false);
     }
 }
 
@@ -302,24 +372,33 @@ void Interpreter::visit(ForNode& node)
 
     require_expr_node(cond, node.location(), "Missing condition");
 
-    detail::ScopeGuard scope_guard(table_, node.location());
+    detail::ScopeGuard scope_guard(
+        table_, node.location(), node.frame_range());
 
     accept_stmt_if_present(init, *this);
+    if (run_reduced(node.reduction())) {
+        return;
+    }
 
-    const auto cond_var_name = validate_evaluable_node(
-        *cond, "Invalid condition", evaluable_context::condition);
-    evaluate_loop_condition(*cond, cond_var_name, true);
+    const auto cond_var_name = detail::validate_evaluable_node(
+        *cond, "Invalid condition", detail::evaluable_context::condition);
+    const auto cond_var_index = tracked_frame_index(*cond);
+    evaluate_loop_condition(*cond, cond_var_name, cond_var_index, true);
 
     while (last_value_) {
         accept_stmt_if_present(body, *this);
+        if (returning_) {
+            return;
+        }
         accept_stmt_if_present(step, *this);
-        evaluate_loop_condition(*cond, cond_var_name, false);
+        evaluate_loop_condition(*cond, cond_var_name, cond_var_index, false);
     }
 }
 
 void Interpreter::visit(InputNode& node)
 {
-    last_value_ = read_input_int64_or_throw(node.location());
+    out_.flush();
+    last_value_ = read_input_int64_or_throw(in_, node.location());
 }
 
 void Interpreter::visit(ExprNode& node)
@@ -334,22 +413,27 @@ void Interpreter::visit(PrintNode& node)
     auto* expr = node.expr();
     require_expr_node(expr, node.location(), "Missing expression for printing");
 
-    validate_evaluable_node(*expr, "Invalid print expression");
+    detail::validate_evaluable_node(*expr, "Invalid print expression");
     expr->accept(*this);
-    std::cout << last_value_ << std::endl;
+    out_.print(last_value_);
 }
 
 void Interpreter::visit(ScopeNode& node)
 {
     const bool need_scope = node.parent() != nullptr;
     if (need_scope) {
-        detail::ScopeGuard scope_guard(table_, node.location());
+        detail::ScopeGuard scope_guard(
+            table_, node.location(), node.frame_range());
         for (const auto& stmt : node.statements()) {
             stmt->accept(*this);
+            if (returning_) {
+                break;
+            }
         }
         return;
     }
 
+    collect_functions(node);
     for (const auto& stmt : node.statements()) {
         stmt->accept(*this);
     }
@@ -363,7 +447,12 @@ void Interpreter::visit(VarDeclNode& node)
     } else {
         last_value_ = 0;
     }
-    table_.declare_in_cur_scope(node.name(), last_value_, node.location());
+    if (table_.has_frame()) {
+        table_.declare_at(
+            node.frame_index(), node.name(), last_value_, node.location());
+    } else {
+        table_.declare_in_cur_scope(node.name(), last_value_, node.location());
+    }
 }
 
 void Interpreter::visit(ErrorNode& node)
@@ -376,143 +465,289 @@ void Interpreter::visit(EmptyNode&)
 {
 }
 
-bool Interpreter::add_overflow(int64_t lhs, int64_t rhs, int64_t& out)
+void Interpreter::visit(ArrayNode& node)
 {
-    constexpr int64_t kMax = std::numeric_limits<int64_t>::max();
-    constexpr int64_t kMin = std::numeric_limits<int64_t>::min();
-    if ((rhs > 0 && lhs > kMax - rhs) || (rhs < 0 && lhs < kMin - rhs)) {
-        return true;
-    }
-    out = lhs + rhs;
-    return false;
+    throw std::runtime_error(err::format_error(
+        node.location(),
+        "Array expression can only be assigned to a variable"));
 }
 
-bool Interpreter::sub_overflow(int64_t lhs, int64_t rhs, int64_t& out)
+void Interpreter::visit(IndexNode& node)
 {
-    constexpr int64_t kMax = std::numeric_limits<int64_t>::max();
-    constexpr int64_t kMin = std::numeric_limits<int64_t>::min();
-    if ((rhs < 0 && lhs > kMax + rhs) || (rhs > 0 && lhs < kMin + rhs)) {
-        return true;
+    const auto& var = require_array_base(node);
+    auto* index = node.index();
+    require_expr_node(index, node.location(), "IndexNode missing index");
+
+    index->accept(*this);
+    const auto& array = read_array(var);
+    last_value_ = array[checked_index(node, array)];
+}
+
+// Definitions take effect before the program runs: they are collected
+// here and only run when called.
+void Interpreter::visit(FuncNode&)
+{
+}
+
+void Interpreter::visit(CallNode& node)
+{
+    auto& func = callee(node);
+    const auto args_begin = args_.size();
+    push_args(node, func);
+    invoke(func, args_begin, node.location());
+}
+
+void Interpreter::visit(ReturnNode& node)
+{
+    if (call_depth_ == 0) {
+        throw std::runtime_error(err::format_error(
+            node.location(), "Return outside of a function"));
+    }
+    auto* expr = node.expr();
+    require_expr_node(expr, node.location(), "Missing return value");
+
+    if (expr->node_type() == base_node_type::call &&
+        static_cast<CallNode*>(expr)->is_tail()) {
+        // Leave the arguments where invoke() expects them and let it run
+        // the callee once this frame is gone.
+        auto& call = static_cast<CallNode&>(*expr);
+        auto& func = callee(call);
+        push_args(call, func);
+        tail_call_ = &func;
+    } else {
+        detail::validate_evaluable_node(*expr, "Invalid return value");
+        expr->accept(*this);
     }
-    out = lhs - rhs;
-    return false;
+    returning_ = true;
 }
 
-bool Interpreter::mul_overflow(int64_t lhs, int64_t rhs, int64_t& out)
+int64_t Interpreter::read_var(Name name, std::uint32_t frame_index)
 {
-    constexpr int64_t kMax = std::numeric_limits<int64_t>::max();
-    constexpr int64_t kMin = std::numeric_limits<int64_t>::min();
+    if (table_.has_frame()) {
+        return table_.load(frame_index, name);
+    }
+    return table_.lookup(name);
+}
 
-    if (lhs == 0 || rhs == 0) {
-        out = 0;
-        return false;
+ArrayStorage& Interpreter::read_array(const VarNode& var)
+{
+    if (table_.has_frame()) {
+        return table_.load_array(var.frame_index(), var.name());
     }
-    if ((lhs == -1 && rhs == kMin) || (rhs == -1 && lhs == kMin)) {
-        return true;
+    return table_.lookup_array(var.name());
+}
+
+ArrayStorage& Interpreter::write_array(const VarNode& var)
+{
+    if (table_.has_frame()) {
+        return table_.store_array(var.frame_index());
     }
+    return table_.assign_or_create_array(var.name());
+}
 
-    if (lhs > 0) {
-        if (rhs > 0) {
-            if (lhs > kMax / rhs) {
-                return true;
-            }
-        } else {
-            if (rhs < kMin / lhs) {
-                return true;
-            }
+// An array assignment is a statement of its own, its value is never used.
+void Interpreter::assign_array(const VarNode& var, BaseNode& rhs)
+{
+    if (rhs.node_type() == base_node_type::var) {
+        const auto& src = read_array(static_cast<const VarNode&>(rhs));
+        auto& dst = write_array(var);
+        if (&dst != &src) {
+            dst = src;
         }
-    } else {
-        if (rhs > 0) {
-            if (lhs < kMin / rhs) {
-                return true;
-            }
-        } else {
-            if (lhs < kMax / rhs) {
-                return true;
-            }
+        last_value_ = 0;
+        return;
+    }
+
+    auto& array = static_cast<ArrayNode&>(rhs);
+    if (array.init() == array_init_type::list) {
+        // An element may call a function that builds a literal of its own,
+        // so the buffer is taken out of scratch_ while it fills.
+        auto items = std::move(scratch_);
+        items.clear();
+        for (const auto& item : array.items()) {
+            require_expr_node(
+                item.get(), array.location(), "Array element is missing");
+            item->accept(*this);
+            items.push_back(last_value_);
         }
+        write_array(var).swap(items);
+        scratch_ = std::move(items);
+        last_value_ = 0;
+        return;
     }
 
-    out = lhs * rhs;
-    return false;
+    auto* fill = array.fill_value();
+    auto* size = array.size_expr();
+    require_expr_node(fill, array.location(), "repeat is missing its value");
+    require_expr_node(size, array.location(), "repeat is missing its size");
+    fill->accept(*this);
+    const auto value = last_value_;
+    size->accept(*this);
+    if (const auto error = array_size_error(last_value_)) {
+        throw std::runtime_error(err::format_error(array.location(), *error));
+    }
+    write_array(var).assign(static_cast<std::size_t>(last_value_), value);
+    last_value_ = 0;
 }
 
-void Interpreter::evaluate_loop_condition(
-    BaseNode& condition,
-    const std::optional<std::string>& tracked_var_name,
-    bool initialize_tracked_var)
+void Interpreter::assign_element(IndexNode& lhs, BaseNode& rhs)
 {
-    if (tracked_var_name) {
-        if (initialize_tracked_var) {
-            condition.accept(*this);
+    const auto& var = require_array_base(lhs);
+    auto* index = lhs.index();
+    require_expr_node(index, lhs.location(), "IndexNode missing index");
+
+    index->accept(*this);
+    const auto position = last_value_;
+    rhs.accept(*this);
+    const auto value = last_value_;
+
+    auto& array = read_array(var);
+    last_value_ = position;
+    array[checked_index(lhs, array)] = value;
+    last_value_ = value;
+}
+
+// Takes the index from last_value_.
+std::size_t Interpreter::checked_index(IndexNode& node,
+                                       const ArrayStorage& array)
+{
+    if (node.bounds_checked() &&
+        !array_index_in_range(last_value_, array.size())) {
+        throw std::runtime_error(err::format_error(
+            node.location(), array_index_error(last_value_, array.size())));
+    }
+    return static_cast<std::size_t>(last_value_);
+}
+
+void Interpreter::collect_functions(ScopeNode& root)
+{
+    for (const auto& stmt : root.statements()) {
+        if (stmt->node_type() != base_node_type::func) {
+            continue;
         }
-        last_value_ = table_.lookup(*tracked_var_name);
-        return;
+        auto* func = static_cast<FuncNode*>(stmt.get());
+        const auto index = func->function_index();
+        if (index == kNoFunctionIndex) {
+            continue;
+        }
+        if (index >= functions_.size()) {
+            functions_.resize(index + 1, nullptr);
+        }
+        functions_[index] = func;
     }
+}
 
-    condition.accept(*this);
+FuncNode& Interpreter::callee(const CallNode& node)
+{
+    const auto index = node.function_index();
+    if (index >= functions_.size() || functions_[index] == nullptr) {
+        throw std::runtime_error(err::format_error(
+            node.location(), "Undefined function: " + node.name().str()));
+    }
+    return *functions_[index];
 }
 
-std::optional<std::string> Interpreter::validate_evaluable_node(
-    const BaseNode& node,
-    const char* error_msg,
-    evaluable_context context)
+void Interpreter::push_args(CallNode& node, const FuncNode& func)
 {
-    if (node.node_type() == base_node_type::assign) {
+    if (node.args().size() != func.params().size()) {
+        throw std::runtime_error(err::format_error(
+            node.location(),
+            call_arity_error(
+                func.name().str(), func.params().size(), node.args().size())));
+    }
+    for (const auto& arg : node.args()) {
+        require_expr_node(
+            arg.get(), node.location(), "Call argument is missing");
+        arg->accept(*this);
+        args_.push_back(last_value_);
+    }
+}
 
-        const auto* assign = dynamic_cast<const AssignNode*>(&node);
-        if (!assign || is_missing_or_empty_expr_node(assign->lhs())) {
-            throw std::runtime_error(err::format_error(
-                node.location(), "AssignNode condition missing lhs"));
+void Interpreter::invoke(FuncNode& func,
+                         std::size_t args_begin,
+                         const SourceRange& loc)
+{
+    if (call_depth_ == kMaxCallDepth) {
+        throw std::runtime_error(err::format_error(loc, kCallDepthError));
+    }
+    ++call_depth_;
+
+    // A tail call made by the body leaves its callee in tail_call_ and its
+    // arguments at args_begin, so it runs in this loop instead of nesting.
+    for (auto* next = &func; next != nullptr;
+         next = std::exchange(tail_call_, nullptr)) {
+        auto* body = next->body();
+        require_expr_node(body, next->location(), "Function body is missing");
+
+        const auto caller = table_.enter_call(next->frame_size());
+        const auto& params = next->params();
+        for (std::size_t i = 0; i < params.size(); ++i) {
+            const auto value = args_[args_begin + i];
+            if (table_.has_frame()) {
+                table_.store(static_cast<std::uint32_t>(i), value);
+            } else {
+                table_.declare_in_cur_scope(params[i], value);
+            }
         }
-        if (assign->lhs()->node_type() != base_node_type::var) {
-            throw std::runtime_error(err::format_error(
-                node.location(), "AssignNode condition lhs must be var"));
+        args_.resize(args_begin);
+
+        try {
+            body->accept(*this);
+        } catch (...) {
+            // Scope guards in the caller's body still need its frame.
+            table_.leave_call(caller);
+            --call_depth_;
+            throw;
         }
-        const auto* var = static_cast<const VarNode*>(assign->lhs());
-        return var->name();
+        if (!returning_) {
+            last_value_ = 0;
+        }
+        returning_ = false;
+        table_.leave_call(caller);
     }
+    --call_depth_;
+}
 
-    if (node.node_type() == base_node_type::var_decl) {
-        if (context != evaluable_context::condition) {
-            throw std::runtime_error(
-                err::format_error(node.location(), error_msg));
+bool Interpreter::run_reduced(const LoopReduction* reduction)
+{
+    if (!reduction || !table_.has_frame()) {
+        return false;
+    }
+    // A variable not yet defined makes the loop report it, so the loop
+    // runs.
+    std::vector<int64_t> values;
+    values.reserve(reduction->vars.size());
+    for (const auto& var : reduction->vars) {
+        if (!table_.is_defined(var.frame_index)) {
+            return false;
         }
+        values.push_back(table_.load(var.frame_index, var.name));
+    }
+    if (!run_closed_form(reduction->form, values.data())) {
+        return false;
+    }
+    for (const auto& update : reduction->form.updates) {
+        table_.store(reduction->vars[update.var].frame_index,
+                     values[update.var]);
+    }
+    return true;
+}
 
-        const auto* decl = dynamic_cast<const VarDeclNode*>(&node);
-        if (!decl) {
-            throw std::runtime_error(err::format_error(
-                node.location(), "Invalid VarDeclNode condition"));
+void Interpreter::evaluate_loop_condition(
+    BaseNode& condition,
+    std::optional<Name> tracked_var_name,
+    std::uint32_t tracked_var_index,
+    bool initialize_tracked_var)
+{
+    if (tracked_var_name) {
+        if (initialize_tracked_var) {
+            condition.accept(*this);
         }
-        return decl->name();
-    }
-
-    switch (node.node_type()) {
-        case base_node_type::scope:
-        case base_node_type::while_node:
-        case base_node_type::print:
-        case base_node_type::if_node:
-        case base_node_type::for_node:
-        case base_node_type::err:
-        case base_node_type::empty:
-            throw std::runtime_error(
-                err::format_error(node.location(), error_msg));
-        case base_node_type::base:
-            throw std::runtime_error(err::format_error(
-                node.location(), "you cannot use abstract class"));
-        case base_node_type::assign:
-        case base_node_type::var_decl:
-        case base_node_type::bin_arith_op:
-        case base_node_type::unop:
-        case base_node_type::bin_logic_op:
-        case base_node_type::value:
-        case base_node_type::var:
-        case base_node_type::input:
-        case base_node_type::expr:
-            return std::nullopt;
-    }
-
-    return std::nullopt;
+        last_value_ = read_var(*tracked_var_name, tracked_var_index);
+        return;
+    }
+
+    condition.accept(*this);
 }
 
 } // namespace ast
@@ -0,0 +1,676 @@
+#include "Visitors/LoopInvariantMotion.hpp"
+
+#include <array>
+#include <limits>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace ast {
+
+namespace {
+
+using NodePtr = BaseNode::NodePtr;
+
+std::optional<int64_t> constant_of(const BaseNode* node)
+{
+    if (node != nullptr && node->node_type() == base_node_type::value) {
+        return static_cast<const ValueNode*>(node)->value();
+    }
+    return std::nullopt;
+}
+
+bool is_operator(const BaseNode& node)
+{
+    const auto type = node.node_type();
+    return type == base_node_type::unop ||
+           type == base_node_type::bin_arith_op ||
+           type == base_node_type::bin_logic_op;
+}
+
+// Whether the operation at `node` may throw, whatever its operands are.
+// Same checks as Interpreter::visit(BinArithOpNode&) and (UnOpNode&).
+bool can_trap(const BaseNode& node)
+{
+    if (node.node_type() == base_node_type::unop) {
+        const auto& unop = static_cast<const UnOpNode&>(node);
+        const auto operand = constant_of(unop.operand());
+        return unop.op() == unop_node_type::neg &&
+               (!operand || *operand == std::numeric_limits<int64_t>::min());
+    }
+    if (node.node_type() != base_node_type::bin_arith_op) {
+        return false;
+    }
+    const auto& arith = static_cast<const BinArithOpNode&>(node);
+    switch (arith.op()) {
+        case bin_arith_op_type::add:
+        case bin_arith_op_type::sub:
+        case bin_arith_op_type::mul:
+            return true;
+        case bin_arith_op_type::div:
+        case bin_arith_op_type::mod: {
+            const auto divisor = constant_of(arith.right());
+            return !divisor || *divisor == 0 || *divisor == -1;
+        }
+    }
+    return true;
+}
+
+// Whether evaluating `node` can neither trap nor be observed.
+bool is_quiet(const BaseNode* node)
+{
+    if (node == nullptr) {
+        return false;
+    }
+    if (node->node_type() == base_node_type::value ||
+        node->node_type() == base_node_type::var) {
+        return true;
+    }
+    if (!is_operator(*node) || can_trap(*node)) {
+        return false;
+    }
+    for (const auto& child : node->children()) {
+        if (!is_quiet(child.get())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool reads(const BaseNode& node, Name name)
+{
+    if (node.node_type() == base_node_type::var &&
+        static_cast<const VarNode&>(node).name() == name) {
+        return true;
+    }
+    for (const auto& child : node.children()) {
+        if (child && reads(*child, name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Names the subtree under `node` assigns, element-assigns or declares.
+void collect_written(const BaseNode& node, std::unordered_set<Name>& written)
+{
+    if (node.node_type() == base_node_type::assign) {
+        const auto* target = static_cast<const AssignNode&>(node).lhs();
+        if (target != nullptr && target->node_type() == base_node_type::index) {
+            target = static_cast<const IndexNode*>(target)->base();
+        }
+        if (target != nullptr && target->node_type() == base_node_type::var) {
+            written.insert(static_cast<const VarNode*>(target)->name());
+        }
+    } else if (node.node_type() == base_node_type::var_decl) {
+        written.insert(static_cast<const VarDeclNode&>(node).name());
+    }
+    for (const auto& child : node.children()) {
+        if (child) {
+            collect_written(*child, written);
+        }
+    }
+}
+
+// Spells out an operator tree so that equal expressions get equal keys.
+// Every operator has a fixed number of operands, so no brackets are
+// needed.
+void append_key(const BaseNode& node, std::string& key)
+{
+    auto put = [&key](auto field) {
+        key.append(reinterpret_cast<const char*>(&field), sizeof(field));
+    };
+    put(static_cast<std::uint8_t>(node.node_type()));
+    switch (node.node_type()) {
+        case base_node_type::value:
+            put(static_cast<const ValueNode&>(node).value());
+            break;
+        case base_node_type::var:
+            put(static_cast<const VarNode&>(node).name().id());
+            break;
+        case base_node_type::unop:
+            put(static_cast<std::uint8_t>(
+                static_cast<const UnOpNode&>(node).op()));
+            break;
+        case base_node_type::bin_arith_op:
+            put(static_cast<std::uint8_t>(
+                static_cast<const BinArithOpNode&>(node).op()));
+            break;
+        case base_node_type::bin_logic_op:
+            put(static_cast<std::uint8_t>(
+                static_cast<const BinLogicOpNode&>(node).op()));
+            break;
+        case base_node_type::base:
+        case base_node_type::scope:
+        case base_node_type::print:
+        case base_node_type::assign:
+        case base_node_type::expr:
+        case base_node_type::if_node:
+        case base_node_type::while_node:
+        case base_node_type::for_node:
+        case base_node_type::input:
+        case base_node_type::var_decl:
+        case base_node_type::err:
+        case base_node_type::empty:
+        case base_node_type::array:
+        case base_node_type::index:
+        case base_node_type::func:
+        case base_node_type::call:
+        case base_node_type::return_node:
+            break;
+    }
+    for (const auto& child : node.children()) {
+        append_key(*child, key);
+    }
+}
+
+// One invariant expression of a loop and every place it occurs.
+struct Invariant
+{
+    std::vector<NodePtr*> uses;
+    bool quiet = true;
+    // For one that can trap: the use the loop evaluates first, before
+    // anything else that could trap or be observed, if there is one, and
+    // whether that is in the body rather than in the init or condition.
+    const BaseNode* first = nullptr;
+    bool in_body = false;
+};
+
+class LoopAnalysis
+{
+public:
+    explicit LoopAnalysis(BaseNode& loop)
+    {
+        collect_written(loop, written_);
+        for (auto& child : loop.children()) {
+            if (child && find(child) && is_operator(*child)) {
+                record(child);
+            }
+        }
+    }
+
+    std::vector<Invariant>& invariants()
+    {
+        return invariants_;
+    }
+
+    // Trapping invariants with a first use, in the order they are reached.
+    const std::vector<std::size_t>& anticipated() const
+    {
+        return anticipated_;
+    }
+
+    // Uses reached from now on are in the loop body.
+    void enter_body()
+    {
+        in_body_ = true;
+    }
+
+    bool scan(const BaseNode* node);
+
+private:
+    std::unordered_set<Name> written_;
+    std::vector<Invariant> invariants_;
+    std::unordered_map<std::string, std::size_t> by_key_;
+    std::unordered_map<const BaseNode*, std::size_t> by_node_;
+    std::vector<std::size_t> anticipated_;
+    bool in_body_ = false;
+
+    bool find(NodePtr& slot);
+    void record(NodePtr& slot);
+};
+
+// Whether the expression in `slot` is invariant. The largest invariant
+// operator trees below a node that is not are recorded as uses.
+bool LoopAnalysis::find(NodePtr& slot)
+{
+    auto& node = *slot;
+    switch (node.node_type()) {
+        case base_node_type::value:
+            return true;
+        case base_node_type::var: {
+            const auto& var = static_cast<const VarNode&>(node);
+            return var.kind() == value_kind::scalar &&
+                   !written_.contains(var.name());
+        }
+        case base_node_type::unop:
+        case base_node_type::bin_arith_op:
+        case base_node_type::bin_logic_op: {
+            auto& operands = node.children();
+            std::array<bool, ChildList::kInlineSlots> invariant{};
+            bool all = true;
+            for (std::size_t i = 0; i < operands.size(); ++i) {
+                invariant[i] = operands[i] && find(operands[i]);
+                all = all && invariant[i];
+            }
+            if (all) {
+                return true;
+            }
+            for (std::size_t i = 0; i < operands.size(); ++i) {
+                if (invariant[i] && is_operator(*operands[i])) {
+                    record(operands[i]);
+                }
+            }
+            return false;
+        }
+        case base_node_type::base:
+        case base_node_type::scope:
+        case base_node_type::print:
+        case base_node_type::assign:
+        case base_node_type::expr:
+        case base_node_type::if_node:
+        case base_node_type::while_node:
+        case base_node_type::for_node:
+        case base_node_type::input:
+        case base_node_type::var_decl:
+        case base_node_type::err:
+        case base_node_type::empty:
+        case base_node_type::array:
+        case base_node_type::index:
+        case base_node_type::func:
+        case base_node_type::call:
+        case base_node_type::return_node:
+            for (auto& child : node.children()) {
+                if (child && find(child) && is_operator(*child)) {
+                    record(child);
+                }
+            }
+            return false;
+    }
+    return false;
+}
+
+void LoopAnalysis::record(NodePtr& slot)
+{
+    std::string key;
+    append_key(*slot, key);
+    const auto [iter, added] =
+        by_key_.try_emplace(std::move(key), invariants_.size());
+    if (added) {
+        invariants_.emplace_back();
+        invariants_.back().quiet = is_quiet(slot.get());
+    }
+    invariants_[iter->second].uses.push_back(&slot);
+    by_node_.emplace(slot.get(), iter->second);
+}
+
+// Walks `node` in the order the interpreter evaluates it and stops at the
+// first thing that may trap, print, read input or not run at all. Every
+// trapping invariant reached before that is evaluated first thing by the
+// loop, so computing it ahead of the loop fails the same way.
+bool LoopAnalysis::scan(const BaseNode* node)
+{
+    if (node == nullptr) {
+        return true;
+    }
+    if (const auto iter = by_node_.find(node); iter != by_node_.end()) {
+        auto& inv = invariants_[iter->second];
+        if (!inv.quiet && inv.first == nullptr) {
+            inv.first = node;
+            inv.in_body = in_body_;
+            anticipated_.push_back(iter->second);
+        }
+        return true;
+    }
+
+    switch (node->node_type()) {
+        case base_node_type::value:
+        case base_node_type::var:
+        case base_node_type::empty:
+            return true;
+        case base_node_type::unop:
+            return scan(static_cast<const UnOpNode*>(node)->operand()) &&
+                   !can_trap(*node);
+        case base_node_type::bin_arith_op: {
+            const auto* arith = static_cast<const BinArithOpNode*>(node);
+            return scan(arith->left()) && scan(arith->right()) &&
+                   !can_trap(*node);
+        }
+        case base_node_type::bin_logic_op: {
+            const auto* logic = static_cast<const BinLogicOpNode*>(node);
+            if (!scan(logic->left())) {
+                return false;
+            }
+            // The right operand of && and || may not run.
+            if (logic->op() == bin_logic_op_type::logical_and ||
+                logic->op() == bin_logic_op_type::logical_or) {
+                return is_quiet(logic->right());
+            }
+            return scan(logic->right());
+        }
+        case base_node_type::assign: {
+            const auto* assign = static_cast<const AssignNode*>(node);
+            const auto* rhs = assign->rhs();
+            if (rhs == nullptr || rhs->node_type() == base_node_type::array) {
+                return false;
+            }
+            const auto* lhs = assign->lhs();
+            if (lhs != nullptr && lhs->node_type() == base_node_type::index) {
+                const auto* element = static_cast<const IndexNode*>(lhs);
+                return scan(element->index()) && scan(rhs) &&
+                       !element->bounds_checked();
+            }
+            return scan(rhs);
+        }
+        case base_node_type::index: {
+            const auto* element = static_cast<const IndexNode*>(node);
+            return scan(element->index()) && !element->bounds_checked();
+        }
+        case base_node_type::expr:
+            return scan(static_cast<const ExprNode*>(node)->expr());
+        case base_node_type::scope:
+            for (const auto& stmt : node->children()) {
+                if (!scan(stmt.get())) {
+                    return false;
+                }
+            }
+            return true;
+        case base_node_type::print:
+            scan(static_cast<const PrintNode*>(node)->expr());
+            return false;
+        case base_node_type::if_node:
+            scan(static_cast<const IfNode*>(node)->condition());
+            return false;
+        case base_node_type::while_node:
+            scan(static_cast<const WhileNode*>(node)->condition());
+            return false;
+        case base_node_type::for_node: {
+            const auto* loop = static_cast<const ForNode*>(node);
+            if (scan(loop->get_init())) {
+                scan(loop->get_cond());
+            }
+            return false;
+        }
+        case base_node_type::var_decl:
+            scan(static_cast<const VarDeclNode*>(node)->init_expr());
+            return false;
+        case base_node_type::call:
+            for (const auto& arg : node->children()) {
+                if (!scan(arg.get())) {
+                    break;
+                }
+            }
+            return false;
+        case base_node_type::return_node:
+            scan(static_cast<const ReturnNode*>(node)->expr());
+            return false;
+        case base_node_type::input:
+        case base_node_type::array:
+        case base_node_type::err:
+        case base_node_type::func:
+        case base_node_type::base:
+            return false;
+    }
+    return false;
+}
+
+// Puts a use of `temp` in every place `inv` occurs and returns the use
+// evaluated first, which computes the temporary before the loop.
+NodePtr take_uses(Invariant& inv, Name temp)
+{
+    NodePtr kept;
+    for (auto* slot : inv.uses) {
+        auto var = std::make_unique<VarNode>(temp);
+        var->set_location((*slot)->location());
+        var->set_parent((*slot)->parent());
+        auto old = std::exchange(*slot, std::move(var));
+        if (inv.first != nullptr ? old.get() == inv.first : !kept) {
+            kept = std::move(old);
+        }
+    }
+    kept->set_parent(nullptr);
+    return kept;
+}
+
+NodePtr assign_stmt(Name temp, NodePtr value)
+{
+    const auto loc = value->location();
+    auto var = std::make_unique<VarNode>(temp);
+    var->set_location(loc);
+    auto assign =
+        std::make_unique<AssignNode>(std::move(var), std::move(value));
+    assign->set_location(loc);
+    auto stmt = std::make_unique<ExprNode>(std::move(assign));
+    stmt->set_location(loc);
+    return stmt;
+}
+
+// A for-loop init that can run twice in a row to the same effect: an
+// assignment to a scalar that does not read it.
+bool can_repeat(const BaseNode* init)
+{
+    if (init == nullptr) {
+        return true;
+    }
+    if (init->node_type() == base_node_type::expr) {
+        init = static_cast<const ExprNode*>(init)->expr();
+    }
+    if (init == nullptr || init->node_type() != base_node_type::assign) {
+        return false;
+    }
+    const auto* assign = static_cast<const AssignNode*>(init);
+    const auto* lhs = assign->lhs();
+    if (lhs == nullptr || lhs->node_type() != base_node_type::var ||
+        assign->rhs() == nullptr) {
+        return false;
+    }
+    const auto* var = static_cast<const VarNode*>(lhs);
+    return var->kind() == value_kind::scalar &&
+           !reads(*assign->rhs(), var->name());
+}
+
+} // namespace
+
+void LoopInvariantMotion::hoist(BaseNode* root)
+{
+    if (root == nullptr) {
+        return;
+    }
+    root->accept(*this);
+    // The root has no enclosing scope to take statements.
+    hoisted_.clear();
+}
+
+void LoopInvariantMotion::visit_children(BaseNode& node)
+{
+    for (auto& child : node.children()) {
+        if (child) {
+            child->accept(*this);
+        }
+    }
+}
+
+void LoopInvariantMotion::visit_loop(BaseNode& loop)
+{
+    // Outer loops first, so an expression leaves every loop it is
+    // invariant in.
+    auto before = hoist_from(loop);
+    visit_children(loop);
+    hoisted_ = std::move(before);
+}
+
+std::vector<BaseNode::NodePtr> LoopInvariantMotion::hoist_from(BaseNode& loop)
+{
+    BaseNode* init = nullptr;
+    BaseNode* cond = nullptr;
+    BaseNode* step = nullptr;
+    BaseNode* body = nullptr;
+    if (loop.node_type() == base_node_type::for_node) {
+        auto& for_loop = static_cast<ForNode&>(loop);
+        init = for_loop.get_init();
+        cond = for_loop.get_cond();
+        step = for_loop.get_step();
+        body = for_loop.get_body();
+    } else {
+        auto& while_loop = static_cast<WhileNode&>(loop);
+        cond = while_loop.condition();
+        body = while_loop.body();
+    }
+    // A condition that assigns runs once and is then re-read through its
+    // variable, see Interpreter::evaluate_loop_condition.
+    const auto* parent = loop.parent();
+    if (cond == nullptr || cond->node_type() == base_node_type::assign ||
+        cond->node_type() == base_node_type::var_decl || parent == nullptr ||
+        parent->node_type() != base_node_type::scope) {
+        return {};
+    }
+
+    LoopAnalysis analysis(loop);
+    auto& invariants = analysis.invariants();
+    if (invariants.empty()) {
+        return {};
+    }
+    if (analysis.scan(init) && analysis.scan(cond)) {
+        analysis.enter_body();
+        if (analysis.scan(body)) {
+            analysis.scan(step);
+        }
+    }
+
+    std::vector<NodePtr> before;
+    auto hoist_one = [&](Invariant& inv) {
+        const Name temp("$inv" + std::to_string(next_temp_++));
+        ++hoisted_count_;
+        return std::make_pair(temp, take_uses(inv, temp));
+    };
+
+    for (auto& inv : invariants) {
+        if (inv.quiet) {
+            auto [temp, expr] = hoist_one(inv);
+            before.push_back(assign_stmt(temp, std::move(expr)));
+        }
+    }
+    bool any_in_body = false;
+    for (const auto idx : analysis.anticipated()) {
+        if (!invariants[idx].in_body) {
+            auto [temp, expr] = hoist_one(invariants[idx]);
+            before.push_back(assign_stmt(temp, std::move(expr)));
+        } else {
+            any_in_body = true;
+        }
+    }
+    if (!any_in_body || !can_repeat(init)) {
+        return before;
+    }
+
+    // The body runs only if the condition holds, after the init: compute
+    // the rest behind the same test. The temporaries exist either way.
+    auto guard_cond = cond->clone();
+    auto computed = std::make_unique<ScopeNode>();
+    computed->set_location(loop.location());
+    for (const auto idx : analysis.anticipated()) {
+        if (invariants[idx].in_body) {
+            auto [temp, expr] = hoist_one(invariants[idx]);
+            auto zero = std::make_unique<ValueNode>(0);
+            zero->set_location(expr->location());
+            before.push_back(assign_stmt(temp, std::move(zero)));
+            computed->add_statement(assign_stmt(temp, std::move(expr)));
+        }
+    }
+    NodePtr guard = std::make_unique<IfNode>(
+        std::move(guard_cond), std::move(computed), nullptr);
+    guard->set_location(loop.location());
+    if (init != nullptr) {
+        auto scope = std::make_unique<ScopeNode>();
+        scope->set_location(loop.location());
+        auto init_stmt = init->clone();
+        if (init_stmt->node_type() != base_node_type::expr) {
+            const auto loc = init_stmt->location();
+            init_stmt = std::make_unique<ExprNode>(std::move(init_stmt));
+            init_stmt->set_location(loc);
+        }
+        scope->add_statement(std::move(init_stmt));
+        scope->add_statement(std::move(guard));
+        guard = std::move(scope);
+    }
+    before.push_back(std::move(guard));
+    return before;
+}
+
+void LoopInvariantMotion::visit(ScopeNode& node)
+{
+    auto& statements = node.children();
+    std::vector<NodePtr> merged;
+    for (std::size_t i = 0; i < statements.size(); ++i) {
+        statements[i]->accept(*this);
+        if (hoisted_.empty() && merged.empty()) {
+            continue;
+        }
+        if (merged.empty()) {
+            for (std::size_t j = 0; j < i; ++j) {
+                merged.push_back(std::move(statements[j]));
+            }
+        }
+        for (auto& stmt : hoisted_) {
+            stmt->set_parent(&node);
+            merged.push_back(std::move(stmt));
+        }
+        hoisted_.clear();
+        merged.push_back(std::move(statements[i]));
+    }
+    if (merged.empty()) {
+        return;
+    }
+    statements.clear();
+    statements.reserve(merged.size());
+    for (auto& stmt : merged) {
+        statements.push_back(std::move(stmt));
+    }
+}
+
+void LoopInvariantMotion::visit(WhileNode& node)
+{
+    visit_loop(node);
+}
+
+void LoopInvariantMotion::visit(ForNode& node)
+{
+    visit_loop(node);
+}
+
+void LoopInvariantMotion::visit(IfNode& node)
+{
+    visit_children(node);
+}
+
+void LoopInvariantMotion::visit(FuncNode& node)
+{
+    visit_children(node);
+}
+
+// Expressions and simple statements hold no loops.
+void LoopInvariantMotion::visit(BinArithOpNode&) {}
+
+void LoopInvariantMotion::visit(BinLogicOpNode&) {}
+
+void LoopInvariantMotion::visit(ValueNode&) {}
+
+void LoopInvariantMotion::visit(UnOpNode&) {}
+
+void LoopInvariantMotion::visit(AssignNode&) {}
+
+void LoopInvariantMotion::visit(VarNode&) {}
+
+void LoopInvariantMotion::visit(InputNode&) {}
+
+void LoopInvariantMotion::visit(ExprNode&) {}
+
+void LoopInvariantMotion::visit(PrintNode&) {}
+
+void LoopInvariantMotion::visit(VarDeclNode&) {}
+
+void LoopInvariantMotion::visit(ErrorNode&) {}
+
+void LoopInvariantMotion::visit(EmptyNode&) {}
+
+void LoopInvariantMotion::visit(ArrayNode&) {}
+
+void LoopInvariantMotion::visit(IndexNode&) {}
+
+void LoopInvariantMotion::visit(CallNode&) {}
+
+void LoopInvariantMotion::visit(ReturnNode&) {}
+
+} // namespace ast
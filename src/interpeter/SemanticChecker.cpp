@@ -1,10 +1,79 @@
 #include "Visitors/SemanticChecker.hpp"
+#include "Runtime/Calls.hpp"
 #include "errors-output/error-formatter.hpp"
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <utility>
 
 namespace ast {
 
+namespace {
+
+constexpr int64_t kNoArraySize = std::numeric_limits<int64_t>::max();
+
+// Whole arrays only appear as the value stored into an array variable.
+bool is_assigned_to_variable(const BaseNode& node)
+{
+    const auto* parent = node.parent();
+    if (parent == nullptr || parent->node_type() != base_node_type::assign) {
+        return false;
+    }
+    const auto* assign = static_cast<const AssignNode*>(parent);
+    return assign->rhs() == &node && assign->lhs() != nullptr &&
+           assign->lhs()->node_type() == base_node_type::var;
+}
+
+// An array assignment has no value of its own; it must be a statement or
+// the init/step of a for loop.
+bool is_statement(const AssignNode& node)
+{
+    const auto* parent = node.parent();
+    if (parent == nullptr) {
+        return false;
+    }
+    if (parent->node_type() == base_node_type::expr) {
+        return true;
+    }
+    if (parent->node_type() == base_node_type::for_node) {
+        const auto* loop = static_cast<const ForNode*>(parent);
+        return loop->get_init() == &node || loop->get_step() == &node;
+    }
+    return false;
+}
+
+const VarNode* as_var(const BaseNode* node)
+{
+    if (node != nullptr && node->node_type() == base_node_type::var) {
+        return static_cast<const VarNode*>(node);
+    }
+    return nullptr;
+}
+
+std::optional<int64_t> as_value(const BaseNode* node)
+{
+    if (node != nullptr && node->node_type() == base_node_type::value) {
+        return static_cast<const ValueNode*>(node)->value();
+    }
+    return std::nullopt;
+}
+
+// Length of the array `node` creates when it is known before running.
+std::optional<int64_t> constant_length(const ArrayNode& node)
+{
+    if (node.init() == array_init_type::list) {
+        return static_cast<int64_t>(node.items().size());
+    }
+    const auto size = as_value(node.size_expr());
+    if (size && *size >= 0) {
+        return size;
+    }
+    return std::nullopt;
+}
+
+} // namespace
+
 SemanticChecker::SemanticChecker()
 {
     scopes_.emplace_back();
@@ -12,8 +81,16 @@ SemanticChecker::SemanticChecker()
 
 void SemanticChecker::check(BaseNode* root)
 {
-    if (root)
+    if (root) {
+        declareFunctions(*root);
         root->accept(*this);
+    }
+    collectElidable();
+    if (hasFrameLayout()) {
+        for (auto* node : elidable_) {
+            node->set_bounds_checked(false);
+        }
+    }
 }
 
 void SemanticChecker::printErrors(std::ostream& out) const
@@ -22,38 +99,207 @@ void SemanticChecker::printErrors(std::ostream& out) const
         out << e << std::endl;
 }
 
-void SemanticChecker::enterScope()
+std::uint32_t SemanticChecker::enterScope()
 {
+    // Variables created directly in a fresh scope exist for the rest of it,
+    // whatever path led into the scope.
     scopes_.emplace_back();
+    saved_depths_.push_back(std::exchange(conditional_depth_, 0u));
+    return frame_size_;
 }
 
-void SemanticChecker::leaveScope(const SourceRange& loc)
+FrameRange SemanticChecker::leaveScope(std::uint32_t frame_begin,
+                                       const SourceRange& loc)
 {
     if (scopes_.size() <= 1) {
         addError(loc, "Internal error: trying to leave global scope");
-        return;
+    } else {
+        scopes_.pop_back();
+        conditional_depth_ = saved_depths_.back();
+        saved_depths_.pop_back();
     }
-    scopes_.pop_back();
+    return FrameRange{ frame_begin, frame_size_ };
 }
 
-void SemanticChecker::declareVariable(const std::string& name,
-                                      const SourceRange& loc)
+std::uint32_t SemanticChecker::declareVariable(Name name,
+                                               const SourceRange& loc,
+                                               value_kind kind)
 {
     auto& cur = scopes_.back();
-    if (cur.find(name) != cur.end()) {
-        addError(loc, "Variable '" + name + "' already declared in this scope");
-        return;
+    const auto iter = cur.find(name);
+    if (iter != cur.end()) {
+        addError(loc,
+                 "Variable '" + name.str() +
+                     "' already declared in this scope");
+        return iter->second;
+    }
+    if (conditional_depth_ > 0) {
+        frame_layout_valid_ = false;
     }
-    cur.insert(name);
+    const auto index = frame_size_++;
+    cur.emplace(name, index);
+    var_kinds_.push_back(kind);
+    write_counts_.push_back(0);
+    min_array_sizes_.push_back(kNoArraySize);
+    return index;
 }
 
-bool SemanticChecker::isDeclared(const std::string& name) const
+std::optional<std::uint32_t> SemanticChecker::resolve(Name name) const
 {
     for (auto it = scopes_.rbegin(); it != scopes_.rend(); ++it) {
-        if (it->find(name) != it->end())
-            return true;
+        const auto iter = it->find(name);
+        if (iter != it->end())
+            return iter->second;
     }
-    return false;
+    return std::nullopt;
+}
+
+void SemanticChecker::visitConditional(BaseNode* node)
+{
+    if (!node)
+        return;
+    ++conditional_depth_;
+    node->accept(*this);
+    --conditional_depth_;
+}
+
+value_kind SemanticChecker::kindOf(const BaseNode& node) const
+{
+    if (node.node_type() == base_node_type::array) {
+        return value_kind::array;
+    }
+    if (const auto* var = as_var(&node)) {
+        if (const auto index = resolve(var->name())) {
+            return var_kinds_[*index];
+        }
+    }
+    return value_kind::scalar;
+}
+
+void SemanticChecker::assignArray(AssignNode& node, std::uint32_t index)
+{
+    if (!is_statement(node)) {
+        addError(node.location(), "Array assignment must be a statement");
+    }
+    std::optional<int64_t> length;
+    if (node.rhs()->node_type() == base_node_type::array) {
+        length = constant_length(*static_cast<const ArrayNode*>(node.rhs()));
+    }
+    min_array_sizes_[index] =
+        length ? std::min(min_array_sizes_[index], *length) : -1;
+}
+
+// Matches `for (i = lo; i < n; i = i + 1)` with constant `lo` and `n`.
+std::optional<SemanticChecker::CountedLoop> SemanticChecker::countedLoop(
+    const ForNode& node) const
+{
+    const auto* init = node.get_init();
+    const auto* cond = node.get_cond();
+    const auto* step = node.get_step();
+    if (init == nullptr || init->node_type() != base_node_type::assign ||
+        cond == nullptr || cond->node_type() != base_node_type::bin_logic_op ||
+        step == nullptr || step->node_type() != base_node_type::assign) {
+        return std::nullopt;
+    }
+
+    const auto* init_assign = static_cast<const AssignNode*>(init);
+    const auto* var = as_var(init_assign->lhs());
+    const auto lo = as_value(init_assign->rhs());
+    if (var == nullptr || !lo || var->frame_index() == kNoFrameIndex) {
+        return std::nullopt;
+    }
+    const auto name = var->name();
+
+    const auto* test = static_cast<const BinLogicOpNode*>(cond);
+    const auto* tested = as_var(test->left());
+    const auto bound = as_value(test->right());
+    if (tested == nullptr || tested->name() != name || !bound) {
+        return std::nullopt;
+    }
+    int64_t hi = 0;
+    if (test->op() == bin_logic_op_type::less) {
+        hi = *bound - (*bound == std::numeric_limits<int64_t>::min() ? 0 : 1);
+    } else if (test->op() == bin_logic_op_type::less_equal) {
+        hi = *bound;
+    } else {
+        return std::nullopt;
+    }
+
+    const auto* step_assign = static_cast<const AssignNode*>(step);
+    const auto* stepped = as_var(step_assign->lhs());
+    const auto* inc = step_assign->rhs();
+    if (stepped == nullptr || stepped->name() != name || inc == nullptr ||
+        inc->node_type() != base_node_type::bin_arith_op) {
+        return std::nullopt;
+    }
+    const auto* add = static_cast<const BinArithOpNode*>(inc);
+    const auto* addend = as_var(add->left());
+    if (add->op() != bin_arith_op_type::add || addend == nullptr ||
+        addend->name() != name || as_value(add->right()) != 1) {
+        return std::nullopt;
+    }
+    return CountedLoop{ var->frame_index(), *lo, hi };
+}
+
+void SemanticChecker::collectElidable()
+{
+    for (const auto& access : index_accesses_) {
+        const auto size = min_array_sizes_[access.array];
+        if (size != kNoArraySize && access.lo >= 0 && access.hi < size) {
+            elidable_.push_back(access.node);
+        }
+    }
+    index_accesses_.clear();
+}
+
+// Functions can be called above their definition, so all of them are
+// numbered before the program is checked.
+void SemanticChecker::declareFunctions(BaseNode& root)
+{
+    if (root.node_type() != base_node_type::scope) {
+        return;
+    }
+    for (const auto& stmt : root.children()) {
+        if (stmt->node_type() != base_node_type::func) {
+            continue;
+        }
+        auto* func = static_cast<FuncNode*>(stmt.get());
+        if (!functions_.emplace(func->name(), func).second) {
+            addError(func->location(),
+                     "Function '" + func->name().str() + "' already defined");
+            continue;
+        }
+        func->set_function_index(
+            static_cast<std::uint32_t>(functions_.size() - 1));
+    }
+}
+
+SemanticChecker::FrameState SemanticChecker::saveFrame()
+{
+    FrameState frame;
+    frame.scopes = std::exchange(scopes_, {});
+    frame.frame_size = std::exchange(frame_size_, 0u);
+    frame.conditional_depth = std::exchange(conditional_depth_, 0u);
+    frame.saved_depths = std::exchange(saved_depths_, {});
+    frame.var_kinds = std::exchange(var_kinds_, {});
+    frame.write_counts = std::exchange(write_counts_, {});
+    frame.min_array_sizes = std::exchange(min_array_sizes_, {});
+    frame.counted_loops = std::exchange(counted_loops_, {});
+    frame.index_accesses = std::exchange(index_accesses_, {});
+    return frame;
+}
+
+void SemanticChecker::restoreFrame(FrameState&& frame)
+{
+    scopes_ = std::move(frame.scopes);
+    frame_size_ = frame.frame_size;
+    conditional_depth_ = frame.conditional_depth;
+    saved_depths_ = std::move(frame.saved_depths);
+    var_kinds_ = std::move(frame.var_kinds);
+    write_counts_ = std::move(frame.write_counts);
+    min_array_sizes_ = std::move(frame.min_array_sizes);
+    counted_loops_ = std::move(frame.counted_loops);
+    index_accesses_ = std::move(frame.index_accesses);
 }
 
 void SemanticChecker::addError(const SourceRange& loc, const std::string& msg)
@@ -63,77 +309,135 @@ void SemanticChecker::addError(const SourceRange& loc, const std::string& msg)
 
 void SemanticChecker::visit(VarNode& node)
 {
-    if (!isDeclared(node.name())) {
-        addError(node.location(), "Undefined variable: " + node.name());
+    const auto index = resolve(node.name());
+    if (!index) {
+        addError(node.location(), "Undefined variable: " + node.name().str());
+        return;
+    }
+    node.set_frame_index(*index);
+    node.set_kind(var_kinds_[*index]);
+
+    if (node.kind() == value_kind::array) {
+        const auto* parent = node.parent();
+        const bool indexed =
+            parent != nullptr && parent->node_type() == base_node_type::index &&
+            static_cast<const IndexNode*>(parent)->base() == &node;
+        if (!indexed && !is_assigned_to_variable(node)) {
+            addError(node.location(),
+                     "Array '" + node.name().str() +
+                         "' cannot be used as a value");
+        }
     }
 }
 
 void SemanticChecker::visit(AssignNode& node)
 {
     auto* lhs = node.lhs();
-    if (!lhs || lhs->node_type() != base_node_type::var) {
+    auto* rhs = node.rhs();
+    if (lhs && lhs->node_type() == base_node_type::index) {
+        lhs->accept(*this);
+    } else if (!lhs || lhs->node_type() != base_node_type::var) {
         addError(node.location(),
                  "Left-hand side of assignment must be a variable");
     } else {
-        const auto* var = static_cast<VarNode*>(lhs);
-        if (!isDeclared(var->name())) {
-            declareVariable(var->name(), var->location());
+        auto* var = static_cast<VarNode*>(lhs);
+        const auto kind = rhs ? kindOf(*rhs) : value_kind::scalar;
+        auto index = resolve(var->name());
+        if (!index) {
+            index = declareVariable(var->name(), var->location(), kind);
+        } else if (var_kinds_[*index] != kind) {
+            addError(node.location(),
+                     kind == value_kind::array
+                         ? "Cannot assign an array to scalar variable '" +
+                               var->name().str() + "'"
+                         : "Cannot assign a scalar to array variable '" +
+                               var->name().str() + "'");
+        }
+        var->set_frame_index(*index);
+        var->set_kind(var_kinds_[*index]);
+        ++write_counts_[*index];
+        if (kind == value_kind::array && var->kind() == value_kind::array) {
+            assignArray(node, *index);
         }
     }
-    if (auto* rhs = node.rhs())
+    if (rhs)
         rhs->accept(*this);
 }
 
 void SemanticChecker::visit(VarDeclNode& node)
 {
-    declareVariable(node.name(), node.location());
+    // The initializer runs before the variable exists, so it must resolve
+    // names against the enclosing scopes.
     if (auto* init = node.init_expr())
         init->accept(*this);
+    node.set_frame_index(declareVariable(node.name(), node.location()));
 }
 
 void SemanticChecker::visit(ScopeNode& node)
 {
-    enterScope();
+    const auto frame_begin = enterScope();
     for (const auto& stmt : node.statements()) {
         stmt->accept(*this);
     }
-    leaveScope(node.location());
+    node.set_frame_range(leaveScope(frame_begin, node.location()));
 }
 
 void SemanticChecker::visit(IfNode& node)
 {
-    enterScope();
+    const auto frame_begin = enterScope();
     if (auto* cond = node.condition())
         cond->accept(*this);
-    if (auto* thenBr = node.then_branch())
-        thenBr->accept(*this);
-    if (auto* elseBr = node.else_branch())
-        elseBr->accept(*this);
-    leaveScope(node.location());
+    visitConditional(node.then_branch());
+    visitConditional(node.else_branch());
+    node.set_frame_range(leaveScope(frame_begin, node.location()));
 }
 
 void SemanticChecker::visit(WhileNode& node)
 {
-    enterScope();
+    const auto frame_begin = enterScope();
     if (auto* cond = node.condition())
         cond->accept(*this);
     if (auto* body = node.body())
         body->accept(*this);
-    leaveScope(node.location());
+    node.set_frame_range(leaveScope(frame_begin, node.location()));
 }
 
 void SemanticChecker::visit(ForNode& node)
 {
-    enterScope();
+    const auto frame_begin = enterScope();
     if (auto* init = node.get_init())
         init->accept(*this);
     if (auto* cond = node.get_cond())
         cond->accept(*this);
-    if (auto* body = node.get_body())
+    if (auto* body = node.get_body()) {
+        // Inside the body of a counted loop its variable stays in range
+        // unless the body assigns it.
+        const auto loop = countedLoop(node);
+        const auto first_access = index_accesses_.size();
+        const auto writes = loop ? write_counts_[loop->var] : 0u;
+        if (loop)
+            counted_loops_.push_back(*loop);
         body->accept(*this);
+        if (loop) {
+            counted_loops_.pop_back();
+            if (write_counts_[loop->var] != writes) {
+                const auto var = loop->var;
+                const auto first =
+                    index_accesses_.begin() +
+                    static_cast<std::ptrdiff_t>(first_access);
+                index_accesses_.erase(
+                    std::remove_if(first,
+                                   index_accesses_.end(),
+                                   [var](const IndexAccess& access) {
+                                       return access.loop_var == var;
+                                   }),
+                    index_accesses_.end());
+            }
+        }
+    }
     if (auto* step = node.get_step())
         step->accept(*this);
-    leaveScope(node.location());
+    node.set_frame_range(leaveScope(frame_begin, node.location()));
 }
 
 void SemanticChecker::visit(BinArithOpNode& node)
@@ -148,8 +452,14 @@ void SemanticChecker::visit(BinLogicOpNode& node)
 {
     if (auto* left = node.left())
         left->accept(*this);
-    if (auto* right = node.right())
+
+    const bool short_circuits = node.op() == bin_logic_op_type::logical_and ||
+                                node.op() == bin_logic_op_type::logical_or;
+    if (short_circuits) {
+        visitConditional(node.right());
+    } else if (auto* right = node.right()) {
         right->accept(*this);
+    }
 }
 
 void SemanticChecker::visit(UnOpNode& node)
@@ -183,4 +493,116 @@ void SemanticChecker::visit(EmptyNode&)
 {
 }
 
+void SemanticChecker::visit(ArrayNode& node)
+{
+    if (!is_assigned_to_variable(node)) {
+        addError(node.location(),
+                 "Array expression can only be assigned to a variable");
+    }
+    for (const auto& item : node.items()) {
+        item->accept(*this);
+    }
+}
+
+void SemanticChecker::visit(IndexNode& node)
+{
+    auto* base = node.base();
+    const auto* var = as_var(base);
+    if (var == nullptr) {
+        addError(node.location(), "Indexed expression must be a variable");
+        return;
+    }
+    base->accept(*this);
+    const auto array = var->frame_index();
+    if (array != kNoFrameIndex && var->kind() != value_kind::array) {
+        addError(node.location(),
+                 "'" + var->name().str() + "' is not an array");
+    }
+
+    auto* index = node.index();
+    if (index == nullptr) {
+        return;
+    }
+    index->accept(*this);
+    if (array == kNoFrameIndex || var->kind() != value_kind::array) {
+        return;
+    }
+
+    if (const auto constant = as_value(index)) {
+        index_accesses_.push_back(
+            IndexAccess{ &node, array, *constant, *constant, kNoFrameIndex });
+        return;
+    }
+    const auto* counter = as_var(index);
+    if (counter == nullptr) {
+        return;
+    }
+    for (auto it = counted_loops_.rbegin(); it != counted_loops_.rend(); ++it) {
+        if (it->var == counter->frame_index()) {
+            index_accesses_.push_back(
+                IndexAccess{ &node, array, it->lo, it->hi, it->var });
+            return;
+        }
+    }
+}
+
+void SemanticChecker::visit(FuncNode& node)
+{
+    const auto* parent = node.parent();
+    if (parent == nullptr || parent->node_type() != base_node_type::scope ||
+        parent->parent() != nullptr) {
+        addError(node.location(),
+                 "Functions can only be defined at the top level");
+        return;
+    }
+
+    // The body sees only its parameters, which take the first indices of
+    // a frame of its own.
+    auto program = saveFrame();
+    in_function_ = true;
+    scopes_.emplace_back();
+    for (const auto& param : node.params()) {
+        declareVariable(param, node.location());
+    }
+    if (auto* body = node.body())
+        body->accept(*this);
+    node.set_frame_size(frame_size_);
+    collectElidable();
+    in_function_ = false;
+    restoreFrame(std::move(program));
+}
+
+void SemanticChecker::visit(CallNode& node)
+{
+    const auto iter = functions_.find(node.name());
+    if (iter == functions_.end()) {
+        addError(node.location(), "Undefined function: " + node.name().str());
+    } else {
+        const auto* func = iter->second;
+        if (func->params().size() != node.args().size()) {
+            addError(node.location(),
+                     call_arity_error(func->name().str(),
+                                      func->params().size(),
+                                      node.args().size()));
+        }
+        node.set_function_index(func->function_index());
+    }
+
+    const auto* parent = node.parent();
+    node.set_tail(parent != nullptr &&
+                  parent->node_type() == base_node_type::return_node);
+    for (const auto& arg : node.args()) {
+        arg->accept(*this);
+    }
+}
+
+void SemanticChecker::visit(ReturnNode& node)
+{
+    if (!in_function_) {
+        addError(node.location(), "Return outside of a function");
+    }
+    if (auto* expr = node.expr())
+        expr->accept(*this);
+}
+
 } // namespace ast
@@ -0,0 +1,88 @@
+#include "Visitors/detail/Evaluable.hpp"
+#include "errors-output/error-formatter.hpp"
+
+#include <stdexcept>
+
+namespace ast::detail {
+
+namespace {
+
+inline bool is_missing_or_empty_expr_node(const BaseNode* node)
+{
+    return node == nullptr || node->node_type() == base_node_type::empty;
+}
+
+} // namespace
+
+std::optional<Name> validate_evaluable_node(const BaseNode& node,
+                                            const char* error_msg,
+                                            evaluable_context context)
+{
+    if (node.node_type() == base_node_type::assign) {
+
+        const auto* assign = dynamic_cast<const AssignNode*>(&node);
+        if (!assign || is_missing_or_empty_expr_node(assign->lhs())) {
+            throw std::runtime_error(err::format_error(
+                node.location(), "AssignNode condition missing lhs"));
+        }
+        // An element store has no variable of its own to re-read.
+        if (assign->lhs()->node_type() == base_node_type::index &&
+            context != evaluable_context::condition) {
+            return std::nullopt;
+        }
+        if (assign->lhs()->node_type() != base_node_type::var) {
+            throw std::runtime_error(err::format_error(
+                node.location(), "AssignNode condition lhs must be var"));
+        }
+        const auto* var = static_cast<const VarNode*>(assign->lhs());
+        return var->name();
+    }
+
+    if (node.node_type() == base_node_type::var_decl) {
+        if (context != evaluable_context::condition) {
+            throw std::runtime_error(
+                err::format_error(node.location(), error_msg));
+        }
+
+        const auto* decl = dynamic_cast<const VarDeclNode*>(&node);
+        if (!decl) {
+            throw std::runtime_error(err::format_error(
+                node.location(), "Invalid VarDeclNode condition"));
+        }
+        return decl->name();
+    }
+
+    switch (node.node_type()) {
+        case base_node_type::scope:
+        case base_node_type::while_node:
+        case base_node_type::print:
+        case base_node_type::if_node:
+        case base_node_type::for_node:
+        case base_node_type::err:
+        case base_node_type::empty:
+        case base_node_type::array:
+        case base_node_type::func:
+        case base_node_type::return_node:
+            throw std::runtime_error(
+                err::format_error(node.location(), error_msg));
+        case base_node_type::base:
+            throw std::runtime_error(err::format_error(
+                node.location(), "you cannot use abstract class"));
+        case base_node_type::assign:
+        case base_node_type::var_decl:
+        case base_node_type::bin_arith_op:
+        case base_node_type::unop:
+        case base_node_type::bin_logic_op:
+        case base_node_type::value:
+        case base_node_type::var:
+        case base_node_type::input:
+        case base_node_type::expr:
+        case base_node_type::index:
+        case base_node_type::call:
+            return std::nullopt;
+    }
+
+    return std::nullopt;
+}
+
+} // namespace ast::detail
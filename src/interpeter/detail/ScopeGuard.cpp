@@ -4,17 +4,26 @@
 
 namespace ast::detail {
 
-ScopeGuard::ScopeGuard(VarTable& table, const SourceRange& location)
+ScopeGuard::ScopeGuard(VarTable& table,
+                       const SourceRange& location,
+                       const FrameRange& frame_range)
   : table_(table)
   , location_(location)
+  , frame_range_(frame_range)
 {
-    table_.enter_scope();
+    if (!table_.has_frame()) {
+        table_.enter_scope();
+    }
 }
 
 ScopeGuard::~ScopeGuard() noexcept
 {
     try {
-        table_.leave_scope(location_);
+        if (table_.has_frame()) {
+            table_.release(frame_range_);
+        } else {
+            table_.leave_scope(location_);
+        }
     } catch (...) {
         std::terminate();
     }
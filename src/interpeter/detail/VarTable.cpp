@@ -1,45 +1,60 @@
 #include "Visitors/detail/VarTable.hpp"
 #include "errors-output/error-formatter.hpp"
 
+#include <algorithm>
 #include <stdexcept>
+#include <utility>
 
 namespace ast {
 
 VarTable::VarTable()
 {
     scopes_.emplace_back();
+    array_scopes_.emplace_back();
+}
+
+VarTable::VarTable(std::size_t frame_size)
+  : frame_(frame_size, 0)
+  , arrays_(frame_size)
+  , defined_(frame_size, 0)
+  , top_(frame_size)
+  , has_frame_(true)
+{
+    scopes_.emplace_back();
+    array_scopes_.emplace_back();
 }
 
 void VarTable::enter_scope()
 {
     scopes_.emplace_back();
+    array_scopes_.emplace_back();
 }
 
 void VarTable::leave_scope(const SourceRange& loc)
 {
-    if (scopes_.size() <= 1) {
+    if (scopes_.size() <= call_scope_ + 1) {
         throw std::runtime_error(
             err::format_error(loc, "Trying to leave from global scope"));
     }
     scopes_.pop_back();
+    array_scopes_.pop_back();
 }
 
-void VarTable::declare_in_cur_scope(const std::string& name,
+void VarTable::declare_in_cur_scope(Name name,
                                     int64_t value,
                                     const SourceRange& loc)
 {
     auto& cur = scopes_.back();
     const auto iter = cur.find(name);
     if (iter != cur.end()) {
-        throw std::runtime_error(
-            err::format_error(loc, "Variable " + name + " already declared"));
+        throw_already_declared(name, loc);
     }
     cur[name] = value;
 }
 
-int64_t VarTable::lookup(const std::string& name, const SourceRange& loc)
+int64_t VarTable::lookup(Name name, const SourceRange& loc)
 {
-    for (size_t i = scopes_.size(); i-- > 0;) {
+    for (size_t i = scopes_.size(); i-- > call_scope_;) {
         auto& cur = scopes_[i];
         const auto iter = cur.find(name);
         if (iter != cur.end()) {
@@ -47,13 +62,12 @@ int64_t VarTable::lookup(const std::string& name, const SourceRange& loc)
         }
     }
 
-    throw std::runtime_error(
-        err::format_error(loc, "Undefined variable: " + name));
+    throw_undefined(name, loc);
 }
 
-void VarTable::assign_or_create(const std::string& name, int64_t value)
+void VarTable::assign_or_create(Name name, int64_t value)
 {
-    for (size_t i = scopes_.size(); i-- > 0;) {
+    for (size_t i = scopes_.size(); i-- > call_scope_;) {
         auto& cur = scopes_[i];
         const auto iter = cur.find(name);
         if (iter != cur.end()) {
@@ -64,4 +78,85 @@ void VarTable::assign_or_create(const std::string& name, int64_t value)
     scopes_.back()[name] = value;
 }
 
+ArrayStorage& VarTable::lookup_array(Name name,
+                                    const SourceRange& loc)
+{
+    for (size_t i = array_scopes_.size(); i-- > call_scope_;) {
+        auto& cur = array_scopes_[i];
+        const auto iter = cur.find(name);
+        if (iter != cur.end()) {
+            return iter->second;
+        }
+    }
+
+    throw_undefined(name, loc);
+}
+
+ArrayStorage& VarTable::assign_or_create_array(Name name)
+{
+    for (size_t i = array_scopes_.size(); i-- > call_scope_;) {
+        auto& cur = array_scopes_[i];
+        const auto iter = cur.find(name);
+        if (iter != cur.end()) {
+            return iter->second;
+        }
+    }
+    return array_scopes_.back()[name];
+}
+
+void VarTable::release(const FrameRange& range)
+{
+    const auto frame = defined_.begin() + static_cast<std::ptrdiff_t>(base_);
+    std::fill(frame + range.begin, frame + range.end, 0);
+}
+
+std::size_t VarTable::enter_call(std::size_t frame_size)
+{
+    if (!has_frame_) {
+        const auto caller = std::exchange(call_scope_, scopes_.size());
+        scopes_.emplace_back();
+        array_scopes_.emplace_back();
+        return caller;
+    }
+
+    const auto caller = std::exchange(base_, top_);
+    top_ += frame_size;
+    if (top_ > frame_.size()) {
+        // Grow geometrically so deep recursion reallocates rarely; the
+        // slots of returned frames stay allocated for the next call.
+        const auto size = std::max(top_, frame_.size() * 2);
+        frame_.resize(size, 0);
+        arrays_.resize(size);
+        defined_.resize(size, 0);
+    }
+    std::fill(defined_.begin() + static_cast<std::ptrdiff_t>(base_),
+              defined_.begin() + static_cast<std::ptrdiff_t>(top_),
+              0);
+    return caller;
+}
+
+void VarTable::leave_call(std::size_t caller)
+{
+    if (!has_frame_) {
+        scopes_.resize(call_scope_);
+        array_scopes_.resize(call_scope_);
+        call_scope_ = caller;
+        return;
+    }
+    top_ = base_;
+    base_ = caller;
+}
+
+void VarTable::throw_already_declared(Name name, const SourceRange& loc)
+{
+    throw std::runtime_error(
+        err::format_error(loc, "Variable " + name.str() + " already declared"));
+}
+
+void VarTable::throw_undefined(Name name, const SourceRange& loc)
+{
+    throw std::runtime_error(
+        err::format_error(loc, "Undefined variable: " + name.str()));
+}
+
 } // namespace ast
@@ -1,21 +1,220 @@
+#include "AST/AstImage.hpp"
+#include "Bytecode/BytecodeCompiler.hpp"
+#include "Bytecode/CEmitter.hpp"
+#include "Bytecode/VM.hpp"
 #include "Visitors/Interpreter.hpp"
+#include "Visitors/ProfilingInterpreter.hpp"
 #include "Visitors/SemanticChecker.hpp"
 #include "driver/driver.hpp"
+#include "driver/pipeline.hpp"
+#include "driver/program_cache.hpp"
+#include "driver/source_file.hpp"
 #include "errors-output/error-formatter.hpp"
 
-#include <FlexLexer.h>
-
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <optional>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
 
 namespace {
 
-int parse_and_run(const char* path)
+struct CliOptions
+{
+    const char* path = nullptr;
+    bool tree_walk = false;
+    bool jit = false;
+    bool line_buffered = false;
+    bool profile = false;
+    std::string profile_out;
+    bool emit_c = false;
+    std::string emit_c_out;
+    std::string cache_dir;
+    std::string emit_ast_out;
+    int opt_level = 0;
+
+    // Whether the program runs as bytecode, the only form that is cached.
+    bool compiled() const
+    {
+        return emit_ast_out.empty() && (emit_c || (!profile && !tree_walk));
+    }
+};
+
+bool parse_options(int argc, char* argv[], CliOptions& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--tree-walk") {
+            options.tree_walk = true;
+        } else if (arg == "--jit") {
+            options.jit = true;
+        } else if (arg == "--line-buffered") {
+            options.line_buffered = true;
+        } else if (arg == "--profile") {
+            options.profile = true;
+        } else if (arg.rfind("--profile-out=", 0) == 0) {
+            options.profile = true;
+            options.profile_out = arg.substr(sizeof("--profile-out=") - 1);
+        } else if (arg == "--emit-c") {
+            options.emit_c = true;
+        } else if (arg.rfind("--emit-c=", 0) == 0) {
+            options.emit_c = true;
+            options.emit_c_out = arg.substr(sizeof("--emit-c=") - 1);
+        } else if (arg.rfind("--emit-ast=", 0) == 0) {
+            options.emit_ast_out = arg.substr(sizeof("--emit-ast=") - 1);
+            if (options.emit_ast_out.empty()) {
+                return false;
+            }
+        } else if (arg.rfind("--cache-dir=", 0) == 0) {
+            options.cache_dir = arg.substr(sizeof("--cache-dir=") - 1);
+        } else if (arg == "--no-cache") {
+            options.cache_dir.clear();
+        } else if (arg == "-O0" || arg == "-O1") {
+            options.opt_level = arg[2] - '0';
+        } else if (!arg.empty() && arg[0] == '-') {
+            return false;
+        } else if (options.path == nullptr) {
+            options.path = argv[i];
+        } else {
+            return false;
+        }
+    }
+    return options.path != nullptr;
+}
+
+// Runs the tree-walking interpreter under ProfilingInterpreter and reports
+// the profile even if the program stops with a runtime error.
+void run_profiled(ast::BaseNode& root,
+                  const ast::SemanticChecker& checker,
+                  ast::OutputSink::buffering buffering,
+                  const CliOptions& options)
+{
+    auto interpreter = checker.hasFrameLayout()
+                           ? ast::ProfilingInterpreter(checker.frameSize())
+                           : ast::ProfilingInterpreter();
+    interpreter.output().set_mode(buffering);
+    interpreter.input() = ast::InputSource::from_stdin();
+
+    auto report = [&] {
+        interpreter.output().flush();
+        interpreter.profile().write_hot_lines(std::cerr);
+        if (options.profile_out.empty())
+            return;
+        std::ofstream out(options.profile_out);
+        if (!out.is_open()) {
+            std::cerr << err::format_error(ast::SourceRange(),
+                                           "Failed to open file: " +
+                                               options.profile_out)
+                      << '\n';
+            return;
+        }
+        interpreter.profile().write_collapsed(out);
+    };
+
+    try {
+        root.accept(interpreter);
+    } catch (...) {
+        report();
+        throw;
+    }
+    report();
+}
+
+// Writes the program as C to stdout or to --emit-c=<file>. The file is only
+// created once the whole translation unit has been generated.
+int emit_c(const ast::bytecode::Program& program, const CliOptions& options)
+{
+    ast::bytecode::CEmitter emitter(program);
+    if (options.emit_c_out.empty()) {
+        emitter.emit(std::cout);
+        return 0;
+    }
+
+    std::ostringstream source;
+    emitter.emit(source);
+    std::ofstream out(options.emit_c_out);
+    if (!out.is_open()) {
+        std::cerr << err::format_error(ast::SourceRange(),
+                                       "Failed to open file: " +
+                                           options.emit_c_out)
+                  << '\n';
+        return 1;
+    }
+    out << source.str();
+    return 0;
+}
+
+// Writes the checked program as an AST image that paracl-cli runs without
+// parsing it again.
+int emit_ast(const ast::BaseNode& root, const CliOptions& options)
+{
+    std::ostringstream image;
+    ast::write_ast_image(root, image);
+    std::ofstream out(options.emit_ast_out, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << err::format_error(ast::SourceRange(),
+                                       "Failed to open file: " +
+                                           options.emit_ast_out)
+                  << '\n';
+        return 1;
+    }
+    out << image.str();
+    return 0;
+}
+
+// Parses the program, or rebuilds it from an image written by --emit-ast.
+// Null once the errors have been reported.
+std::optional<ast::AST> read_ast(std::string_view text, const char* path)
+{
+    if (ast::AstImage::is_image(text)) {
+        try {
+            const ast::AstImage image(text, ast::FileTable::intern(path));
+            return image.build();
+        } catch (const std::runtime_error& ex) {
+            std::cerr << err::format_error(ast::SourceRange(),
+                                           std::string(path) + ": " +
+                                               ex.what())
+                      << '\n';
+            return std::nullopt;
+        }
+    }
+
+    yy::NumDriver driver(text, path);
+    if (!driver.parse() || driver.has_errors()) {
+        return std::nullopt;
+    }
+    return driver.take_ast();
+}
+
+// Runs compiled bytecode on the VM, or writes it out for --emit-c.
+int run_program(const ast::bytecode::Program& program,
+                const CliOptions& options)
+{
+    if (options.emit_c) {
+        return emit_c(program, options);
+    }
+
+    ast::bytecode::VM vm(program);
+    if (options.jit) {
+        vm.enable_jit();
+    }
+    vm.output().set_mode(options.line_buffered
+                             ? ast::OutputSink::buffering::line
+                             : ast::OutputSink::buffering::block);
+    vm.input() = ast::InputSource::from_stdin();
+    vm.run();
+    return 0;
+}
+
+int parse_and_run(const CliOptions& options)
 {
-    std::ifstream input(path);
-    if (!input.is_open()) {
+    const char* path = options.path;
+    const auto source = yy::SourceFile::open(path);
+    if (!source) {
         std::cerr << err::format_error(ast::SourceRange(),
                                        "Failed to open file: " +
                                            std::string(path))
@@ -23,32 +222,61 @@ int parse_and_run(const char* path)
         return 1;
     }
 
-    yyFlexLexer lexer(&input);
-    yy::NumDriver driver(&lexer, path);
+    std::optional<yy::ProgramCache> cache;
+    if (!options.cache_dir.empty() && options.compiled()) {
+        cache.emplace(options.cache_dir);
+    }
 
     try {
-        if (!driver.parse())
+        if (cache) {
+            const auto program =
+                cache->load(source->text(), options.opt_level, path);
+            if (program) {
+                return run_program(*program, options);
+            }
+        }
+
+        auto parsed = read_ast(source->text(), path);
+        if (!parsed) {
             return 1;
-        if (driver.has_errors())
+        }
+        // An image is written as checked, before any optimization.
+        const auto opt_level =
+            options.emit_ast_out.empty() ? options.opt_level : 0;
+        auto checked =
+            yy::check_program(std::move(*parsed), opt_level, std::cerr);
+        if (!checked) {
             return 1;
+        }
+        auto& ast_tree = checked->tree;
+        const auto& checker = checked->checker;
 
-        ast::AST ast_tree = driver.get_ast();
-        if (ast_tree.root() == nullptr) {
-            std::cerr << err::format_error(ast::SourceRange(),
-                                           "Parser produced empty AST")
-                      << '\n';
-            return 1;
+        if (!options.emit_ast_out.empty()) {
+            return emit_ast(*ast_tree.root(), options);
         }
 
-        ast::SemanticChecker checker;
-        checker.check(ast_tree.root());
-        if (checker.hasErrors()) {
-            checker.printErrors(std::cerr);
-            return 1;
+        if (options.compiled()) {
+            ast::bytecode::BytecodeCompiler compiler;
+            const auto program = compiler.compile(*ast_tree.root());
+            if (cache) {
+                cache->store(source->text(), options.opt_level, program);
+            }
+            return run_program(program, options);
         }
 
-        ast::Interpreter interpreter;
-        ast_tree.root()->accept(interpreter);
+        const auto buffering = options.line_buffered
+                                   ? ast::OutputSink::buffering::line
+                                   : ast::OutputSink::buffering::block;
+        if (options.profile) {
+            run_profiled(*ast_tree.root(), checker, buffering, options);
+        } else if (options.tree_walk) {
+            auto interpreter = checker.hasFrameLayout()
+                                   ? ast::Interpreter(checker.frameSize())
+                                   : ast::Interpreter();
+            interpreter.output().set_mode(buffering);
+            interpreter.input() = ast::InputSource::from_stdin();
+            ast_tree.root()->accept(interpreter);
+        }
     } catch (const std::runtime_error& ex) {
         std::cerr << ex.what() << '\n';
         return 1;
@@ -60,10 +288,19 @@ int parse_and_run(const char* path)
 
 int main(int argc, char* argv[])
 {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <filename>\n";
+    CliOptions options;
+    if (const char* dir = std::getenv("PARACL_CACHE_DIR")) {
+        options.cache_dir = dir;
+    }
+    if (!parse_options(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [-O0|-O1] [--tree-walk] [--jit] [--line-buffered]"
+                     " [--profile] [--profile-out=<file>]"
+                     " [--emit-c[=<file>]] [--emit-ast=<file>]"
+                     " [--cache-dir=<dir>|--no-cache]"
+                     " <filename>\n";
         return 1;
     }
 
-    return parse_and_run(argv[1]);
-}
\ No newline at end of file
+    return parse_and_run(options);
+}
@@ -0,0 +1,206 @@
+#include "driver/buffer_lexer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace yy {
+
+namespace {
+
+using token = parser::token_type;
+
+enum class char_class : std::uint8_t
+{
+    other,
+    space,
+    newline,
+    digit,
+    letter, // letters and '_'
+};
+
+constexpr auto kClass = [] {
+    std::array<char_class, 256> table{};
+    for (const char c : { ' ', '\t', '\r', '\f', '\v' }) {
+        table[static_cast<unsigned char>(c)] = char_class::space;
+    }
+    table['\n'] = char_class::newline;
+    for (unsigned char c = '0'; c <= '9'; ++c) {
+        table[c] = char_class::digit;
+    }
+    for (unsigned char c = 'a'; c <= 'z'; ++c) {
+        table[c] = char_class::letter;
+        table[c - 'a' + 'A'] = char_class::letter;
+    }
+    table['_'] = char_class::letter;
+    return table;
+}();
+
+// One-byte tokens; anything else that reaches the table is ERR, like the
+// catch-all rule in grammar.l.
+constexpr auto kSingle = [] {
+    std::array<token, 256> table{};
+    table.fill(token::ERR);
+    table['+'] = token::PLUS;
+    table['-'] = token::MINUS;
+    table['/'] = token::DIV;
+    table['*'] = token::MUL;
+    table['%'] = token::MODULUS;
+    table['='] = token::ASSIGNMENT;
+    table[';'] = token::SEMICOLON;
+    table[','] = token::COMMA;
+    table['<'] = token::LESS;
+    table['>'] = token::GREATER;
+    table['?'] = token::QUESTION_MARK;
+    table['!'] = token::NOT;
+    table['^'] = token::XOR;
+    table[')'] = token::RIGHT_PAREN;
+    table['('] = token::LEFT_PAREN;
+    table['}'] = token::RIGHT_CURLY_BRACKET;
+    table['{'] = token::LEFT_CURLY_BRACKET;
+    table[']'] = token::RIGHT_SQUARE_BRACKET;
+    table['['] = token::LEFT_SQUARE_BRACKET;
+    return table;
+}();
+
+// Two-byte tokens, keyed by their first byte.
+struct pair_entry
+{
+    char second = '\0';
+    token type = token::ERR;
+};
+
+constexpr auto kPairs = [] {
+    std::array<pair_entry, 256> table{};
+    table['<'] = { '=', token::LESS_OR_EQUAL };
+    table['>'] = { '=', token::GREATER_OR_EQUAL };
+    table['='] = { '=', token::EQUAL };
+    table['!'] = { '=', token::NOT_EQUAL };
+    table['&'] = { '&', token::AND };
+    table['|'] = { '|', token::OR };
+    return table;
+}();
+
+struct keyword_entry
+{
+    std::string_view spelling;
+    token type;
+};
+
+constexpr std::array<keyword_entry, 9> kKeywords = { {
+    { "if", token::IF },
+    { "for", token::FOR },
+    { "else", token::ELSE },
+    { "while", token::WHILE },
+    { "print", token::PRINT },
+    { "repeat", token::REPEAT },
+    { "array", token::ARRAY },
+    { "func", token::FUNC },
+    { "return", token::RETURN },
+} };
+
+char_class class_of(char c)
+{
+    return kClass[static_cast<unsigned char>(c)];
+}
+
+bool continues_name(char c)
+{
+    const auto cls = class_of(c);
+    return cls == char_class::letter || cls == char_class::digit;
+}
+
+token name_or_keyword(std::string_view name)
+{
+    for (const auto& keyword : kKeywords) {
+        if (keyword.spelling == name) {
+            return keyword.type;
+        }
+    }
+    return token::VAR;
+}
+
+int width(const char* begin, const char* end)
+{
+    return static_cast<int>(end - begin);
+}
+
+} // namespace
+
+BufferLexer::BufferLexer(std::string_view source)
+  : pos_(source.data())
+  , end_(source.data() + source.size())
+{
+}
+
+parser::token_type BufferLexer::next(parser::location_type& loc)
+{
+    loc.step();
+    while (pos_ != end_) {
+        const char* start = pos_;
+        const auto cls = class_of(*pos_);
+        if (cls == char_class::newline) {
+            pos_ = std::find_if(
+                pos_, end_, [](char c) { return c != '\n'; });
+            loc.lines(width(start, pos_));
+        } else if (cls == char_class::space) {
+            pos_ = std::find_if(pos_, end_, [](char c) {
+                return class_of(c) != char_class::space;
+            });
+            loc.columns(width(start, pos_));
+        } else if (*pos_ == '/' && end_ - pos_ > 1 && pos_[1] == '/') {
+            pos_ = std::find(pos_, end_, '\n');
+            loc.columns(width(start, pos_));
+        } else {
+            break;
+        }
+        loc.step();
+    }
+
+    if (pos_ == end_) {
+        text_ = {};
+        return token::YYEOF;
+    }
+
+    const auto type = scan_token();
+    loc.columns(static_cast<int>(text_.size()));
+    return type;
+}
+
+parser::token_type BufferLexer::scan_token()
+{
+    const char* start = pos_;
+    const char first = *pos_++;
+    token type = token::ERR;
+
+    switch (class_of(first)) {
+        case char_class::digit:
+            pos_ = std::find_if(pos_, end_, [](char c) {
+                return class_of(c) != char_class::digit;
+            });
+            type = token::NUMBER;
+            break;
+        case char_class::letter:
+            pos_ = std::find_if_not(pos_, end_, continues_name);
+            type = name_or_keyword(std::string_view(
+                start, static_cast<std::size_t>(pos_ - start)));
+            break;
+        case char_class::other:
+        case char_class::space:
+        case char_class::newline: {
+            const auto& pair = kPairs[static_cast<unsigned char>(first)];
+            if (pair.second != '\0' && pos_ != end_ && *pos_ == pair.second) {
+                ++pos_;
+                type = pair.type;
+            } else {
+                type = kSingle[static_cast<unsigned char>(first)];
+            }
+            break;
+        }
+    }
+
+    text_ = std::string_view(start, static_cast<std::size_t>(pos_ - start));
+    return type;
+}
+
+} // namespace yy
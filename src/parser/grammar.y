@@ -59,17 +59,23 @@ parser::token_type yylex(parser::semantic_type* yylval,
     LEFT_PAREN           "("
     RIGHT_CURLY_BRACKET  "}"
     LEFT_CURLY_BRACKET   "{"
+    RIGHT_SQUARE_BRACKET "]"
+    LEFT_SQUARE_BRACKET  "["
     IF                   "if"
     FOR                  "for"
     ELSE                 "else"
     WHILE                "while"
     PRINT                "print"
+    REPEAT               "repeat"
+    ARRAY                "array"
+    FUNC                 "func"
+    RETURN               "return"
     NEWLINE
     ERR
 ;
 
 %token <int64_t> NUMBER
-%token <std::string> VAR
+%token <ast::Name> VAR
 
 %nterm <std::unique_ptr<ast::BaseNode>> expr
 %nterm <std::unique_ptr<ast::BaseNode>> stmt
@@ -79,7 +85,11 @@ parser::token_type yylex(parser::semantic_type* yylval,
 %nterm <std::unique_ptr<ast::BaseNode>> for_step
 %nterm <std::unique_ptr<ast::BaseNode>> for_step_expr
 %nterm <std::unique_ptr<ast::BaseNode>> program
-%nterm <std::vector<std::unique_ptr<ast::BaseNode>>> stmts
+%nterm <std::unique_ptr<ast::ScopeNode>> stmts
+%nterm <std::vector<std::unique_ptr<ast::BaseNode>>> array_items
+%nterm <std::vector<std::unique_ptr<ast::BaseNode>>> call_args
+%nterm <std::vector<ast::Name>> params
+%nterm <std::vector<ast::Name>> param_list
 
 %right ASSIGNMENT
 %left OR
@@ -96,41 +106,45 @@ parser::token_type yylex(parser::semantic_type* yylval,
 
 %start program
 
+// The statement list starts with an empty reduction, which takes its
+// location from here; give it the driver's file name.
+%initial-action
+{
+    @$ = driver->get_location();
+}
+
 %%
 
 program: stmts
     {
-        auto scope = std::make_unique<ast::ScopeNode>();
-        for (size_t i = $1.size(); i-- > 0;) {
-            if ($1[i]) {
-                scope->add_statement(std::move($1[i]));
-            }
-        }
-        driver->set_ast_root(with_loc(std::move(scope), @$));
+        driver->set_ast_root(with_loc(std::move($1), @$));
     }
 ;
 
-stmts: stmt stmts
+// Left-recursive so each statement is reduced straight into the scope as
+// soon as it is parsed: the parser stack stays flat however long the
+// statement list is.
+stmts: stmts stmt
     {
-        $$ = std::move($2);
-        if ($1) {
-            $$.push_back(std::move($1));
+        $$ = std::move($1);
+        if ($2) {
+            $$->add_statement(std::move($2));
         }
     }
     | %empty
     {
-        $$ = std::vector<std::unique_ptr<ast::BaseNode>>();
+        $$ = driver->make_node<ast::ScopeNode>();
     }
 ;
 
 stmt: expr SEMICOLON
     {
-        $$ = with_loc(std::make_unique<ast::ExprNode>(std::move($1)), @$);
+        $$ = with_loc(driver->make_node<ast::ExprNode>(std::move($1)), @$);
     }
     | expr error
     {
         error(@2, "No semicolon");
-        $$ = with_loc(std::make_unique<ast::ExprNode>(std::make_unique<ast::ValueNode>(0)), @$);
+        $$ = with_loc(driver->make_node<ast::ExprNode>(driver->make_node<ast::ValueNode>(0)), @$);
     }
     | SEMICOLON
     {
@@ -138,39 +152,39 @@ stmt: expr SEMICOLON
     }
     | VAR SEMICOLON
     {
-        $$ = with_loc(std::make_unique<ast::VarDeclNode>($1), @$);
+        $$ = with_loc(driver->make_node<ast::VarDeclNode>($1), @$);
     }
     | VAR error
     {
         error(@2, "No semicolon");
-        $$ = with_loc(std::make_unique<ast::VarDeclNode>($1), @$);
+        $$ = with_loc(driver->make_node<ast::VarDeclNode>($1), @$);
     }
     | IF LEFT_PAREN expr RIGHT_PAREN stmt %prec XIF
     {
-        $$ = with_loc(std::make_unique<ast::IfNode>(std::move($3), std::move($5)), @$);
+        $$ = with_loc(driver->make_node<ast::IfNode>(std::move($3), std::move($5)), @$);
     }
     | IF LEFT_PAREN error RIGHT_PAREN stmt %prec XIF
     {
         error(@3, "Missing condition in if");
-        $$ = with_loc(std::make_unique<ast::IfNode>(std::make_unique<ast::ValueNode>(0), std::move($5)), @$);
+        $$ = with_loc(driver->make_node<ast::IfNode>(driver->make_node<ast::ValueNode>(0), std::move($5)), @$);
     }
     | IF LEFT_PAREN expr RIGHT_PAREN stmt ELSE stmt
     {
-        $$ = with_loc(std::make_unique<ast::IfNode>(std::move($3), std::move($5), std::move($7)), @$);
+        $$ = with_loc(driver->make_node<ast::IfNode>(std::move($3), std::move($5), std::move($7)), @$);
     }
     | IF LEFT_PAREN error RIGHT_PAREN stmt ELSE stmt
     {
         error(@3, "Missing condition in if-else");
-        $$ = with_loc(std::make_unique<ast::IfNode>(std::make_unique<ast::ValueNode>(0), std::move($5), std::move($7)), @$);
+        $$ = with_loc(driver->make_node<ast::IfNode>(driver->make_node<ast::ValueNode>(0), std::move($5), std::move($7)), @$);
     }
     | WHILE LEFT_PAREN expr RIGHT_PAREN stmt
     {
-        $$ = with_loc(std::make_unique<ast::WhileNode>(std::move($3), std::move($5)), @$);
+        $$ = with_loc(driver->make_node<ast::WhileNode>(std::move($3), std::move($5)), @$);
     }
     | WHILE LEFT_PAREN error RIGHT_PAREN stmt
     {
         error(@3, "Missing condition in while");
-        $$ = with_loc(std::make_unique<ast::WhileNode>(std::make_unique<ast::ValueNode>(0), std::move($5)), @$);
+        $$ = with_loc(driver->make_node<ast::WhileNode>(driver->make_node<ast::ValueNode>(0), std::move($5)), @$);
     }
     | FOR LEFT_PAREN for_init for_cond for_step RIGHT_PAREN stmt
     {
@@ -179,14 +193,14 @@ stmt: expr SEMICOLON
         if ($7 && $7->node_type() == ast::base_node_type::scope) {
             body = std::move($7);
         } else {
-            auto scope = std::make_unique<ast::ScopeNode>();
+            auto scope = driver->make_node<ast::ScopeNode>();
             if ($7) {
                 scope->add_statement(std::move($7));
             }
             body = std::move(scope);
         }
 
-        $$ = with_loc(std::make_unique<ast::ForNode>(std::move($3), std::move($4), std::move($5), std::move(body)), @$);
+        $$ = with_loc(driver->make_node<ast::ForNode>(std::move($3), std::move($4), std::move($5), std::move(body)), @$);
     }
     | FOR LEFT_PAREN error RIGHT_PAREN stmt
     {
@@ -196,39 +210,91 @@ stmt: expr SEMICOLON
         if ($5 && $5->node_type() == ast::base_node_type::scope) {
             body = std::move($5);
         } else {
-            auto scope = std::make_unique<ast::ScopeNode>();
+            auto scope = driver->make_node<ast::ScopeNode>();
             if ($5) {
                 scope->add_statement(std::move($5));
             }
             body = std::move(scope);
         }
 
-        $$ = with_loc(std::make_unique<ast::ForNode>(nullptr, nullptr, nullptr, std::move(body)), @$);
+        $$ = with_loc(driver->make_node<ast::ForNode>(nullptr, nullptr, nullptr, std::move(body)), @$);
     }
     | LEFT_CURLY_BRACKET stmts RIGHT_CURLY_BRACKET
     {
-        auto scope = std::make_unique<ast::ScopeNode>();
-        for (size_t i = $2.size(); i-- > 0;) {
-            if ($2[i]) {
-                static_cast<ast::ScopeNode*>(scope.get())->add_statement(std::move($2[i]));
-            }
-        }
-        $$ = with_loc(std::move(scope), @$);
+        $$ = with_loc(std::move($2), @$);
     }
     | PRINT expr SEMICOLON
     {
-        $$ = with_loc(std::make_unique<ast::PrintNode>(std::move($2)), @$);
+        $$ = with_loc(driver->make_node<ast::PrintNode>(std::move($2)), @$);
     }
     | PRINT expr error
     {
         error(@3, "Missing semicolon in print");
-        $$ = with_loc(std::make_unique<ast::PrintNode>(std::make_unique<ast::ValueNode>(0)), @$);
+        $$ = with_loc(driver->make_node<ast::PrintNode>(driver->make_node<ast::ValueNode>(0)), @$);
+    }
+    | FUNC VAR LEFT_PAREN params RIGHT_PAREN LEFT_CURLY_BRACKET stmts RIGHT_CURLY_BRACKET
+    {
+        auto body = with_loc(std::move($7), @6 + @8);
+        $$ = with_loc(driver->make_node<ast::FuncNode>($2, std::move($4), std::move(body)), @$);
+    }
+    | RETURN expr SEMICOLON
+    {
+        $$ = with_loc(driver->make_node<ast::ReturnNode>(std::move($2)), @$);
+    }
+    | RETURN expr error
+    {
+        error(@3, "Missing semicolon in return");
+        $$ = with_loc(driver->make_node<ast::ReturnNode>(std::move($2)), @$);
+    }
+;
+
+params: param_list
+    {
+        $$ = std::move($1);
+    }
+    | %empty
+    {
+    }
+;
+
+param_list: VAR
+    {
+        $$.push_back($1);
+    }
+    | param_list COMMA VAR
+    {
+        $$ = std::move($1);
+        $$.push_back($3);
     }
 ;
 
 lvalue: VAR
     {
-        $$ = with_loc(std::make_unique<ast::VarNode>($1), @$);
+        $$ = with_loc(driver->make_node<ast::VarNode>($1), @$);
+    }
+    | VAR LEFT_SQUARE_BRACKET expr RIGHT_SQUARE_BRACKET
+    {
+        $$ = with_loc(driver->make_node<ast::IndexNode>(with_loc(driver->make_node<ast::VarNode>($1), @1), std::move($3)), @$);
+    }
+;
+
+array_items: expr
+    {
+        $$.push_back(std::move($1));
+    }
+    | array_items COMMA expr
+    {
+        $$ = std::move($1);
+        $$.push_back(std::move($3));
+    }
+;
+
+call_args: array_items
+    {
+        $$ = std::move($1);
+    }
+    | %empty
+    {
     }
 ;
 
@@ -249,7 +315,7 @@ for_cond: expr SEMICOLON
     | error SEMICOLON
     {
         error(@1, "Missing condition in for");
-        $$ = with_loc(std::make_unique<ast::ValueNode>(0), @$);
+        $$ = with_loc(driver->make_node<ast::ValueNode>(0), @$);
     }
 ;
 
@@ -265,45 +331,45 @@ for_step: for_step_expr
 
 for_step_expr: lvalue ASSIGNMENT expr
     {
-        $$ = with_loc(std::make_unique<ast::AssignNode>(std::move($1), std::move($3)), @$);
+        $$ = with_loc(driver->make_node<ast::AssignNode>(std::move($1), std::move($3)), @$);
     }
 ;
 
 expr: expr PLUS expr
     {
-        $$ = with_loc(std::make_unique<ast::BinArithOpNode>(ast::bin_arith_op_type::add, std::move($1), std::move($3)), @$);
+        $$ = with_loc(driver->make_node<ast::BinArithOpNode>(ast::bin_arith_op_type::add, std::move($1), std::move($3)), @$);
     }
     | error PLUS expr
     {
         error(@1, "Missing left operand");
-        $$ = with_loc(std::make_unique<ast::BinArithOpNode>(ast::bin_arith_op_type::add, std::make_unique<ast::ValueNode>(0), std::move($3)), @$);
+        $$ = with_loc(driver->make_node<ast::BinArithOpNode>(ast::bin_arith_op_type::add, driver->make_node<ast::ValueNode>(0), std::move($3)), @$);
     }
     | expr PLUS error
     {
         error(@3, "Missing right operand");
-        $$ = with_loc(std::make_unique<ast::BinArithOpNode>(ast::bin_arith_op_type::add, std::move($1), std::make_unique<ast::ValueNode>(0)), @$);
+        $$ = with_loc(driver->make_node<ast::BinArithOpNode>(ast::bin_arith_op_type::add, std::move($1), driver->make_node<ast::ValueNode>(0)), @$);
     }
     | expr MINUS expr
     {
-        $$ = with_loc(std::make_unique<ast::BinArithOpNode>(ast::bin_arith_op_type::sub, std::move($1), std::move($3)), @$);
+        $$ = with_loc(driver->make_node<ast::BinArithOpNode>(ast::bin_arith_op_type::sub, std::move($1), std::move($3)), @$);
     }
     | error MINUS expr
     {
         error(@1, "Missing left operand");
-        $$ = with_loc(std::make_unique<ast::BinArithOpNode>(ast::bin_arith_op_type::sub, std::make_unique<ast::ValueNode>(0), std::move($3)), @$);
+        $$ = with_loc(driver->make_node<ast::BinArithOpNode>(ast::bin_arith_op_type::sub, driver->make_node<ast::ValueNode>(0), std::move($3)), @$);
     }
     | expr MINUS error
     {
         error(@3, "Missing right operand");
-        $$ = with_loc(std::make_unique<ast::BinArithOpNode>(ast::bin_arith_op_type::sub, std::move($1), std::make_unique<ast::ValueNode>(0)), @$);
+        $$ = with_loc(driver->make_node<ast::BinArithOpNode>(ast::bin_arith_op_type::sub, std::move($1), driver->make_node<ast::ValueNode>(0)), @$);
     }
     | expr MUL expr
     {
-        $$ = with_loc(std::make_unique<ast::BinArithOpNode>(ast::bin_arith_op_type::mul, std::move($1), std::move($3)), @$);
+        $$ = with_loc(driver->make_node<ast::BinArithOpNode>(ast::bin_arith_op_type::mul, std::move($1), std::move($3)), @$);
     }
     | expr DIV expr
     {
-        $$ = with_loc(std::make_unique<ast::BinArithOpNode>(
+        $$ = with_loc(driver->make_node<ast::BinArithOpNode>(
                 ast::bin_arith_op_type::div,
                 std::move($1),
                 std::move($3)),
@@ -311,7 +377,7 @@ expr: expr PLUS expr
     }
     | expr MODULUS expr
     {
-        $$ = with_loc(std::make_unique<ast::BinArithOpNode>(
+        $$ = with_loc(driver->make_node<ast::BinArithOpNode>(
                 ast::bin_arith_op_type::mod,
                 std::move($1),
                 std::move($3)),
@@ -319,51 +385,51 @@ expr: expr PLUS expr
     }
     | expr EQUAL expr
     {
-        $$ = with_loc(std::make_unique<ast::BinLogicOpNode>(ast::bin_logic_op_type::equal, std::move($1), std::move($3)), @$);
+        $$ = with_loc(driver->make_node<ast::BinLogicOpNode>(ast::bin_logic_op_type::equal, std::move($1), std::move($3)), @$);
     }
     | expr NOT_EQUAL expr
     {
-        $$ = with_loc(std::make_unique<ast::BinLogicOpNode>(ast::bin_logic_op_type::not_equal, std::move($1), std::move($3)), @$);
+        $$ = with_loc(driver->make_node<ast::BinLogicOpNode>(ast::bin_logic_op_type::not_equal, std::move($1), std::move($3)), @$);
     }
     | expr LESS expr
     {
-        $$ = with_loc(std::make_unique<ast::BinLogicOpNode>(ast::bin_logic_op_type::less, std::move($1), std::move($3)), @$);
+        $$ = with_loc(driver->make_node<ast::BinLogicOpNode>(ast::bin_logic_op_type::less, std::move($1), std::move($3)), @$);
     }
     | expr GREATER expr
     {
-        $$ = with_loc(std::make_unique<ast::BinLogicOpNode>(ast::bin_logic_op_type::greater, std::move($1), std::move($3)), @$);
+        $$ = with_loc(driver->make_node<ast::BinLogicOpNode>(ast::bin_logic_op_type::greater, std::move($1), std::move($3)), @$);
     }
     | expr LESS_OR_EQUAL expr
     {
-        $$ = with_loc(std::make_unique<ast::BinLogicOpNode>(ast::bin_logic_op_type::less_equal, std::move($1), std::move($3)), @$);
+        $$ = with_loc(driver->make_node<ast::BinLogicOpNode>(ast::bin_logic_op_type::less_equal, std::move($1), std::move($3)), @$);
     }
     | expr GREATER_OR_EQUAL expr
     {
-        $$ = with_loc(std::make_unique<ast::BinLogicOpNode>(ast::bin_logic_op_type::greater_equal, std::move($1), std::move($3)), @$);
+        $$ = with_loc(driver->make_node<ast::BinLogicOpNode>(ast::bin_logic_op_type::greater_equal, std::move($1), std::move($3)), @$);
     }
     | expr AND expr
     {
-        $$ = with_loc(std::make_unique<ast::BinLogicOpNode>(ast::bin_logic_op_type::logical_and, std::move($1), std::move($3)), @$);
+        $$ = with_loc(driver->make_node<ast::BinLogicOpNode>(ast::bin_logic_op_type::logical_and, std::move($1), std::move($3)), @$);
     }
     | expr OR expr
     {
-        $$ = with_loc(std::make_unique<ast::BinLogicOpNode>(ast::bin_logic_op_type::logical_or, std::move($1), std::move($3)), @$);
+        $$ = with_loc(driver->make_node<ast::BinLogicOpNode>(ast::bin_logic_op_type::logical_or, std::move($1), std::move($3)), @$);
     }
     | expr XOR expr
     {
-        $$ = with_loc(std::make_unique<ast::BinLogicOpNode>(ast::bin_logic_op_type::bitwise_xor, std::move($1), std::move($3)), @$);
+        $$ = with_loc(driver->make_node<ast::BinLogicOpNode>(ast::bin_logic_op_type::bitwise_xor, std::move($1), std::move($3)), @$);
     }
     | NOT expr
     {
-        $$ = with_loc(std::make_unique<ast::UnOpNode>(ast::unop_node_type::logical_not, std::move($2)), @$);
+        $$ = with_loc(driver->make_node<ast::UnOpNode>(ast::unop_node_type::logical_not, std::move($2)), @$);
     }
     | MINUS expr %prec UMINUS
     {
-        $$ = with_loc(std::make_unique<ast::UnOpNode>(ast::unop_node_type::neg, std::move($2)), @$);
+        $$ = with_loc(driver->make_node<ast::UnOpNode>(ast::unop_node_type::neg, std::move($2)), @$);
     }
     | PLUS expr %prec UMINUS
     {
-        $$ = with_loc(std::make_unique<ast::UnOpNode>(ast::unop_node_type::pos, std::move($2)), @$);
+        $$ = with_loc(driver->make_node<ast::UnOpNode>(ast::unop_node_type::pos, std::move($2)), @$);
     }
     | LEFT_PAREN expr RIGHT_PAREN
     {
@@ -371,19 +437,38 @@ expr: expr PLUS expr
     }
     | NUMBER
     {
-        $$ = with_loc(std::make_unique<ast::ValueNode>($1), @$);
+        $$ = with_loc(driver->make_node<ast::ValueNode>($1), @$);
     }
     | VAR
     {
-        $$ = with_loc(std::make_unique<ast::VarNode>(std::move($1)), @$);
+        $$ = with_loc(driver->make_node<ast::VarNode>($1), @$);
+    }
+    | VAR LEFT_SQUARE_BRACKET expr RIGHT_SQUARE_BRACKET
+    {
+        $$ = with_loc(driver->make_node<ast::IndexNode>(with_loc(driver->make_node<ast::VarNode>($1), @1), std::move($3)), @$);
+    }
+    | VAR LEFT_PAREN call_args RIGHT_PAREN
+    {
+        $$ = with_loc(driver->make_node<ast::CallNode>($1, std::move($3)), @$);
+    }
+    | REPEAT LEFT_PAREN expr COMMA expr RIGHT_PAREN
+    {
+        auto node = driver->make_node<ast::ArrayNode>(ast::array_init_type::repeat);
+        node->add_item(std::move($3));
+        node->add_item(std::move($5));
+        $$ = with_loc(std::move(node), @$);
+    }
+    | ARRAY LEFT_PAREN array_items RIGHT_PAREN
+    {
+        $$ = with_loc(driver->make_node<ast::ArrayNode>(ast::array_init_type::list, std::move($3)), @$);
     }
     | lvalue ASSIGNMENT expr
     {
-        $$ = with_loc(std::make_unique<ast::AssignNode>(std::move($1), std::move($3)), @$);
+        $$ = with_loc(driver->make_node<ast::AssignNode>(std::move($1), std::move($3)), @$);
     }
     | QUESTION_MARK
     {
-        $$ = with_loc(std::make_unique<ast::InputNode>(), @$);
+        $$ = with_loc(driver->make_node<ast::InputNode>(), @$);
     }
 ;
 
@@ -0,0 +1,62 @@
+#include "driver/pipeline.hpp"
+
+#include "Visitors/ClosedFormLoops.hpp"
+#include "Visitors/ConstantFolder.hpp"
+#include "Visitors/LoopInvariantMotion.hpp"
+#include "errors-output/error-formatter.hpp"
+
+#include <utility>
+
+namespace yy {
+
+std::optional<CheckedProgram> check_program(ast::AST tree,
+                                            int opt_level,
+                                            std::ostream& diagnostics)
+{
+    if (tree.root() == nullptr) {
+        diagnostics << err::format_error(ast::SourceRange(),
+                                         "Parser produced empty AST")
+                    << '\n';
+        return std::nullopt;
+    }
+
+    CheckedProgram program{ std::move(tree), ast::SemanticChecker() };
+    auto* root = program.tree.root();
+    auto& checker = program.checker;
+    checker.check(root);
+    if (checker.hasErrors()) {
+        checker.printErrors(diagnostics);
+        return std::nullopt;
+    }
+
+    if (opt_level >= 1) {
+        ast::ConstantFolder folder;
+        folder.fold(root);
+        if (checker.hasFrameLayout()) {
+            ast::LoopInvariantMotion motion;
+            motion.hoist(root);
+            if (motion.hoisted_count() > 0) {
+                // The temporaries need frame slots of their own. The tree
+                // passed once, so any error now is the optimizer's.
+                checker = ast::SemanticChecker();
+                checker.check(root);
+                if (checker.hasErrors()) {
+                    diagnostics << err::format_error(
+                                       ast::SourceRange(),
+                                       "Internal error: loop-invariant "
+                                       "motion broke the program")
+                                << '\n';
+                    checker.printErrors(diagnostics);
+                    return std::nullopt;
+                }
+            }
+            if (checker.hasFrameLayout()) {
+                ast::ClosedFormLoops loops;
+                loops.reduce(root);
+            }
+        }
+    }
+    return program;
+}
+
+} // namespace yy
@@ -0,0 +1,129 @@
+#include "driver/program_cache.hpp"
+
+#include "AST/FileTable.hpp"
+#include "Bytecode/ProgramImage.hpp"
+#include "driver/source_file.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+// Set by CMake from the project version; part of every cache key.
+#ifndef PARACL_VERSION
+#define PARACL_VERSION "0"
+#endif
+
+namespace yy {
+
+namespace {
+
+// The first line of an entry. It names everything the compiled program
+// depends on, and load() compares it byte for byte, so an entry whose file
+// name collides with another key is a miss rather than the wrong program.
+std::string entry_key(std::string_view source, int opt_level)
+{
+    char hash[17];
+    std::snprintf(hash,
+                  sizeof(hash),
+                  "%016llx",
+                  static_cast<unsigned long long>(
+                      ast::bytecode::content_hash(source)));
+    return "paracl " PARACL_VERSION " image " +
+           std::to_string(ast::bytecode::kImageVersion) + " -O" +
+           std::to_string(opt_level) + " source " +
+           std::to_string(source.size()) + " " + hash + "\n";
+}
+
+bool write_all(int fd, std::string_view bytes)
+{
+    while (!bytes.empty()) {
+        const auto put = write(fd, bytes.data(), bytes.size());
+        if (put < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes.remove_prefix(static_cast<std::size_t>(put));
+    }
+    return true;
+}
+
+} // namespace
+
+ProgramCache::ProgramCache(std::string dir)
+  : dir_(std::move(dir))
+{
+}
+
+std::string ProgramCache::entry_path(std::string_view source,
+                                     int opt_level) const
+{
+    char name[22];
+    std::snprintf(name,
+                  sizeof(name),
+                  "%016llx.pclc",
+                  static_cast<unsigned long long>(ast::bytecode::content_hash(
+                      entry_key(source, opt_level))));
+    return (std::filesystem::path(dir_) / name).string();
+}
+
+std::optional<ast::bytecode::Program>
+ProgramCache::load(std::string_view source,
+                   int opt_level,
+                   const std::string& path) const
+{
+    const auto entry = SourceFile::open(entry_path(source, opt_level));
+    if (!entry) {
+        return std::nullopt;
+    }
+
+    const auto key = entry_key(source, opt_level);
+    const auto text = entry->text();
+    if (text.substr(0, key.size()) != key) {
+        return std::nullopt;
+    }
+    try {
+        return ast::bytecode::read_image(text.substr(key.size()),
+                                         ast::FileTable::intern(path));
+    } catch (const std::runtime_error&) {
+        return std::nullopt;
+    }
+}
+
+bool ProgramCache::store(std::string_view source,
+                         int opt_level,
+                         const ast::bytecode::Program& program) const
+{
+    std::error_code ec;
+    std::filesystem::create_directories(dir_, ec);
+    if (ec) {
+        return false;
+    }
+
+    std::ostringstream image;
+    image << entry_key(source, opt_level);
+    ast::bytecode::write_image(program, image);
+
+    const auto path = entry_path(source, opt_level);
+    auto temp = path + ".XXXXXX";
+    const int fd = mkstemp(temp.data());
+    if (fd < 0) {
+        return false;
+    }
+    const bool written = write_all(fd, image.str());
+    if (close(fd) != 0 || !written ||
+        std::rename(temp.c_str(), path.c_str()) != 0) {
+        unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace yy
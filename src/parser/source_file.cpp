@@ -0,0 +1,135 @@
+#include "driver/source_file.hpp"
+
+#include <cerrno>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace yy {
+
+namespace {
+
+constexpr std::size_t kReadChunk = 64 * 1024;
+
+class FileDescriptor
+{
+public:
+    explicit FileDescriptor(int fd)
+      : fd_(fd)
+    {
+    }
+
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+    ~FileDescriptor()
+    {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    int get() const
+    {
+        return fd_;
+    }
+
+private:
+    int fd_;
+};
+
+// Appends everything left in `fd` to `out`. `expected` is the size to read
+// in one go when it is known, as for a regular file.
+bool read_all(int fd, std::string& out, std::size_t expected)
+{
+    std::size_t used = out.size();
+    for (;;) {
+        if (out.size() == used) {
+            out.resize(used + (expected != 0 ? expected : kReadChunk));
+            expected = 0;
+        }
+        const auto got = read(fd, out.data() + used, out.size() - used);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (got == 0) {
+            out.resize(used);
+            return true;
+        }
+        used += static_cast<std::size_t>(got);
+    }
+}
+
+} // namespace
+
+std::optional<SourceFile> SourceFile::open(const std::string& path)
+{
+    const FileDescriptor fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd.get() < 0) {
+        return std::nullopt;
+    }
+
+    struct stat info = {};
+    if (fstat(fd.get(), &info) != 0) {
+        return std::nullopt;
+    }
+
+    SourceFile file;
+    std::size_t expected = 0;
+    if (S_ISREG(info.st_mode) && info.st_size > 0) {
+        expected = static_cast<std::size_t>(info.st_size);
+        void* addr =
+            mmap(nullptr, expected, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+        if (addr != MAP_FAILED) {
+            madvise(addr, expected, MADV_SEQUENTIAL);
+            file.mapping_ = static_cast<const char*>(addr);
+            file.size_ = expected;
+            return file;
+        }
+    }
+
+    if (!read_all(fd.get(), file.buffer_, expected)) {
+        return std::nullopt;
+    }
+    return file;
+}
+
+SourceFile::SourceFile(SourceFile&& other) noexcept
+  : mapping_(std::exchange(other.mapping_, nullptr))
+  , size_(std::exchange(other.size_, 0))
+  , buffer_(std::move(other.buffer_))
+{
+}
+
+SourceFile& SourceFile::operator=(SourceFile&& other) noexcept
+{
+    if (this != &other) {
+        unmap();
+        mapping_ = std::exchange(other.mapping_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        buffer_ = std::move(other.buffer_);
+    }
+    return *this;
+}
+
+SourceFile::~SourceFile()
+{
+    unmap();
+}
+
+void SourceFile::unmap()
+{
+    if (mapping_ != nullptr) {
+        munmap(const_cast<char*>(mapping_), size_);
+        mapping_ = nullptr;
+        size_ = 0;
+    }
+}
+
+} // namespace yy
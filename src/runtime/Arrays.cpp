@@ -0,0 +1,22 @@
+#include "Runtime/Arrays.hpp"
+
+namespace ast {
+
+std::optional<std::string> array_size_error(std::int64_t size)
+{
+    if (size < 0) {
+        return "Invalid array size: " + std::to_string(size);
+    }
+    if (size > kMaxArraySize) {
+        return "Array size " + std::to_string(size) + " is too large";
+    }
+    return std::nullopt;
+}
+
+std::string array_index_error(std::int64_t index, std::size_t size)
+{
+    return "Array index " + std::to_string(index) +
+           " is out of range for array of size " + std::to_string(size);
+}
+
+} // namespace ast
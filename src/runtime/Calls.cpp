@@ -0,0 +1,14 @@
+#include "Runtime/Calls.hpp"
+
+namespace ast {
+
+std::string call_arity_error(const std::string& name,
+                             std::size_t expected,
+                             std::size_t given)
+{
+    return "Function '" + name + "' takes " + std::to_string(expected) +
+           (expected == 1 ? " argument, " : " arguments, ") +
+           std::to_string(given) + " given";
+}
+
+} // namespace ast
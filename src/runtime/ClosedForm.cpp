@@ -0,0 +1,409 @@
+#include "Runtime/ClosedForm.hpp"
+#include "Runtime/CheckedArith.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <optional>
+
+namespace ast {
+
+#if defined(__SIZEOF_INT128__) && PARACL_HAS_OVERFLOW_BUILTINS
+
+namespace {
+
+// Holds any trip count and any sum of a few int64 products. Every step is
+// checked; a formula that outgrows it is given up on, and the loop runs.
+__extension__ using wide = __int128;
+
+constexpr auto kNoUpdate = std::numeric_limits<std::uint32_t>::max();
+
+// Wide arithmetic that remembers whether any operation overflowed, so a
+// formula is checked once at the end.
+class Exact
+{
+public:
+    wide add(wide lhs, wide rhs)
+    {
+        wide out = 0;
+        failed_ |= __builtin_add_overflow(lhs, rhs, &out);
+        return out;
+    }
+    wide sub(wide lhs, wide rhs)
+    {
+        wide out = 0;
+        failed_ |= __builtin_sub_overflow(lhs, rhs, &out);
+        return out;
+    }
+    wide mul(wide lhs, wide rhs)
+    {
+        wide out = 0;
+        failed_ |= __builtin_mul_overflow(lhs, rhs, &out);
+        return out;
+    }
+
+    bool failed() const
+    {
+        return failed_;
+    }
+
+private:
+    bool failed_ = false;
+};
+
+bool fits(wide value)
+{
+    return value >= std::numeric_limits<std::int64_t>::min() &&
+           value <= std::numeric_limits<std::int64_t>::max();
+}
+
+wide floor_div(wide lhs, wide rhs)
+{
+    const auto quotient = lhs / rhs;
+    return (lhs % rhs != 0 && (lhs < 0) != (rhs < 0)) ? quotient - 1
+                                                       : quotient;
+}
+
+bool holds(ClosedForm::relation cmp, std::int64_t lhs, std::int64_t rhs)
+{
+    switch (cmp) {
+        case ClosedForm::relation::lt:
+            return lhs < rhs;
+        case ClosedForm::relation::le:
+            return lhs <= rhs;
+        case ClosedForm::relation::gt:
+            return lhs > rhs;
+        case ClosedForm::relation::ge:
+            return lhs >= rhs;
+        case ClosedForm::relation::eq:
+            return lhs == rhs;
+        case ClosedForm::relation::ne:
+            return lhs != rhs;
+    }
+    return false;
+}
+
+// Number of iterations of a loop whose condition holds on entry, with the
+// counter moving by `step` each time; nullopt if the counter never gets
+// past the bound.
+std::optional<wide> trip_count(ClosedForm::relation cmp,
+                               wide start,
+                               wide bound,
+                               wide step,
+                               Exact& exact)
+{
+    const auto ahead = bound - start;
+    switch (cmp) {
+        case ClosedForm::relation::lt:
+            if (step <= 0) {
+                return std::nullopt;
+            }
+            return ahead / step + (ahead % step != 0);
+        case ClosedForm::relation::le:
+            if (step <= 0) {
+                return std::nullopt;
+            }
+            return ahead / step + 1;
+        case ClosedForm::relation::gt:
+        case ClosedForm::relation::ge: {
+            if (step >= 0) {
+                return std::nullopt;
+            }
+            const auto back = exact.sub(0, step);
+            if (exact.failed()) {
+                return std::nullopt;
+            }
+            if (cmp == ClosedForm::relation::ge) {
+                return -ahead / back + 1;
+            }
+            return -ahead / back + (-ahead % back != 0);
+        }
+        case ClosedForm::relation::eq:
+            if (step == 0) {
+                return std::nullopt;
+            }
+            return 1;
+        case ClosedForm::relation::ne:
+            if (step == 0 || ahead % step != 0 || ahead / step <= 0) {
+                return std::nullopt;
+            }
+            return ahead / step;
+    }
+    return std::nullopt;
+}
+
+// The value a delta node takes on iteration k, counted from zero.
+struct Linear
+{
+    wide base = 0;
+    wide slope = 0;
+
+    wide at(wide k, Exact& exact) const
+    {
+        return exact.add(base, exact.mul(slope, k));
+    }
+};
+
+class Evaluator
+{
+public:
+    Evaluator(const ClosedForm& form, const std::int64_t* values)
+      : form_(form)
+      , values_(values)
+      , update_of_(form.num_vars, kNoUpdate)
+      , step_(form.num_vars, 0)
+      , linear_(form.num_vars, 0)
+    {
+    }
+
+    // Checks that the form refers only to what exists and numbers each
+    // variable's update.
+    bool index()
+    {
+        const auto num_updates = form_.updates.size();
+        for (std::uint32_t i = 0; i < num_updates; ++i) {
+            const auto& update = form_.updates[i];
+            if (update.var >= form_.num_vars ||
+                update_of_[update.var] != kNoUpdate ||
+                update.first >= update.last ||
+                update.last > form_.terms.size()) {
+                return false;
+            }
+            update_of_[update.var] = i;
+        }
+        for (const auto& term : form_.terms) {
+            if (term.kind == ClosedForm::term_kind::var &&
+                (term.value < 0 || term.value >= form_.num_vars)) {
+                return false;
+            }
+        }
+        const auto& bound = form_.bound;
+        if (bound.kind == ClosedForm::term_kind::var) {
+            if (bound.value < 0 || bound.value >= form_.num_vars ||
+                update_of_[static_cast<std::size_t>(bound.value)] !=
+                    kNoUpdate) {
+                return false;
+            }
+        } else if (bound.kind != ClosedForm::term_kind::constant) {
+            return false;
+        }
+        return form_.counter < form_.num_vars &&
+               update_of_[form_.counter] != kNoUpdate;
+    }
+
+    // Finds the variables that move by the same amount on every
+    // iteration: those whose delta reads nothing the loop updates.
+    bool find_steps()
+    {
+        for (std::uint32_t i = 0; i < form_.updates.size(); ++i) {
+            const auto& update = form_.updates[i];
+            const auto first = form_.terms.begin() + update.first;
+            const auto last = form_.terms.begin() + update.last;
+            const bool invariant = std::none_of(first, last, [&](auto& term) {
+                return term.kind == ClosedForm::term_kind::var &&
+                       update_of_[static_cast<std::size_t>(term.value)] !=
+                           kNoUpdate;
+            });
+            if (!invariant) {
+                continue;
+            }
+            const auto delta = evaluate(i, std::nullopt);
+            if (!delta) {
+                return false;
+            }
+            step_[update.var] = update.subtract ? exact_.sub(0, delta->base)
+                                                : delta->base;
+            linear_[update.var] = 1;
+        }
+        return linear_[form_.counter] && !exact_.failed();
+    }
+
+    wide step(std::uint32_t var) const
+    {
+        return step_[var];
+    }
+
+    // Value of update `i`'s delta on each iteration. With `last`, also
+    // checks that every operation in it fits on iterations 0 to `last`;
+    // being linear in the iteration, it fits in between as well.
+    std::optional<Linear> evaluate(std::uint32_t i, std::optional<wide> last)
+    {
+        const auto& update = form_.updates[i];
+        stack_.clear();
+        for (auto t = update.first; t < update.last; ++t) {
+            const auto& term = form_.terms[t];
+            if (term.kind == ClosedForm::term_kind::constant) {
+                stack_.push_back(Linear{ term.value, 0 });
+                continue;
+            }
+            if (term.kind == ClosedForm::term_kind::var) {
+                const auto var = static_cast<std::uint32_t>(term.value);
+                const auto pos = update_of_[var];
+                if (pos == kNoUpdate) {
+                    stack_.push_back(Linear{ values_[var], 0 });
+                    continue;
+                }
+                if (!linear_[var]) {
+                    return std::nullopt;
+                }
+                // Read after its own update in this iteration, the variable
+                // is one step further along.
+                const auto base = pos < i ? exact_.add(values_[var], step_[var])
+                                          : wide{ values_[var] };
+                stack_.push_back(Linear{ base, step_[var] });
+                continue;
+            }
+
+            const auto arity =
+                term.kind == ClosedForm::term_kind::neg ? 1u : 2u;
+            if (stack_.size() < arity) {
+                return std::nullopt;
+            }
+            const auto rhs = stack_.back();
+            if (arity == 2) {
+                stack_.pop_back();
+            }
+            auto& lhs = stack_.back();
+            switch (term.kind) {
+                case ClosedForm::term_kind::add:
+                    lhs = Linear{ exact_.add(lhs.base, rhs.base),
+                                  exact_.add(lhs.slope, rhs.slope) };
+                    break;
+                case ClosedForm::term_kind::sub:
+                    lhs = Linear{ exact_.sub(lhs.base, rhs.base),
+                                  exact_.sub(lhs.slope, rhs.slope) };
+                    break;
+                case ClosedForm::term_kind::mul:
+                    // Keeps the delta linear in the iteration.
+                    if (lhs.slope != 0 && rhs.slope != 0) {
+                        return std::nullopt;
+                    }
+                    lhs = Linear{ exact_.mul(lhs.base, rhs.base),
+                                  exact_.add(exact_.mul(lhs.base, rhs.slope),
+                                             exact_.mul(lhs.slope, rhs.base)) };
+                    break;
+                case ClosedForm::term_kind::neg:
+                    lhs = Linear{ exact_.sub(0, rhs.base),
+                                  exact_.sub(0, rhs.slope) };
+                    break;
+                case ClosedForm::term_kind::constant:
+                case ClosedForm::term_kind::var:
+                    break;
+            }
+            if (last && (!fits(lhs.base) || !fits(lhs.at(*last, exact_)))) {
+                return std::nullopt;
+            }
+        }
+        if (stack_.size() != 1 || exact_.failed()) {
+            return std::nullopt;
+        }
+        return stack_.back();
+    }
+
+    // Value of update `i`'s variable after each of `trips` iterations, or
+    // nullopt if one of them does not fit. Returns the last one.
+    std::optional<std::int64_t> run_update(std::uint32_t i, wide trips)
+    {
+        const auto delta = evaluate(i, trips - 1);
+        if (!delta) {
+            return std::nullopt;
+        }
+        const auto& update = form_.updates[i];
+        const wide start = values_[update.var];
+
+        // After m iterations the variable has moved by
+        // m * base + slope * m * (m - 1) / 2.
+        const auto after = [&](wide m) {
+            const auto moved = exact_.add(
+                exact_.mul(m, delta->base),
+                exact_.mul(delta->slope, exact_.mul(m, m - 1) / 2));
+            return update.subtract ? exact_.sub(start, moved)
+                                   : exact_.add(start, moved);
+        };
+
+        // The increments change sign at most once, so the value peaks at
+        // either end or where they do.
+        wide candidates[5] = { 1, trips, 1, 1, 1 };
+        if (delta->slope != 0) {
+            const auto turn = floor_div(exact_.sub(0, delta->base),
+                                        delta->slope);
+            for (int j = 0; j < 3; ++j) {
+                candidates[2 + j] =
+                    std::clamp<wide>(exact_.add(turn, j), 1, trips);
+            }
+        }
+        for (const auto m : candidates) {
+            if (!fits(after(m))) {
+                return std::nullopt;
+            }
+        }
+        const auto last = after(trips);
+        if (exact_.failed()) {
+            return std::nullopt;
+        }
+        return static_cast<std::int64_t>(last);
+    }
+
+    Exact& exact()
+    {
+        return exact_;
+    }
+
+private:
+    const ClosedForm& form_;
+    const std::int64_t* values_;
+    std::vector<std::uint32_t> update_of_;
+    std::vector<wide> step_;
+    std::vector<std::uint8_t> linear_;
+    std::vector<Linear> stack_;
+    Exact exact_;
+};
+
+} // namespace
+
+bool run_closed_form(const ClosedForm& form, std::int64_t* values)
+{
+    Evaluator eval(form, values);
+    if (!eval.index()) {
+        return false;
+    }
+
+    const auto start = values[form.counter];
+    const auto bound = form.bound.kind == ClosedForm::term_kind::var
+                           ? values[static_cast<std::size_t>(form.bound.value)]
+                           : form.bound.value;
+    if (!holds(form.cmp, start, bound)) {
+        return true;
+    }
+    if (!eval.find_steps()) {
+        return false;
+    }
+    const auto trips = trip_count(
+        form.cmp, start, bound, eval.step(form.counter), eval.exact());
+    if (!trips) {
+        return false;
+    }
+
+    std::vector<std::int64_t> after(form.updates.size());
+    for (std::uint32_t i = 0; i < form.updates.size(); ++i) {
+        const auto value = eval.run_update(i, *trips);
+        if (!value) {
+            return false;
+        }
+        after[i] = *value;
+    }
+    for (std::size_t i = 0; i < after.size(); ++i) {
+        values[form.updates[i].var] = after[i];
+    }
+    return true;
+}
+
+#else
+
+bool run_closed_form(const ClosedForm&, std::int64_t*)
+{
+    return false;
+}
+
+#endif
+
+} // namespace ast
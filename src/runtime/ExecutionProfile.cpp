@@ -0,0 +1,174 @@
+#include "Runtime/ExecutionProfile.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace ast {
+
+namespace {
+
+using LineKey = std::pair<FileTable::FileId, std::uint32_t>;
+
+LineKey line_of(const BaseNode& node)
+{
+    const auto& loc = node.location();
+    return { loc.file, loc.begin_line };
+}
+
+struct LineStats
+{
+    LineKey line;
+    std::uint64_t hits = 0;
+    ExecutionProfile::clock::duration self{};
+    ExecutionProfile::clock::duration total{};
+};
+
+double to_ms(ExecutionProfile::clock::duration d)
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+std::string line_label(const LineKey& line)
+{
+    if (line.second == 0) {
+        return "<unknown>";
+    }
+    return std::string(FileTable::name(line.first)) + ":" +
+           std::to_string(line.second);
+}
+
+// Collapsed-stack frames are separated by ';' and followed by a space.
+std::string frame_label(const BaseNode& node)
+{
+    std::string label = node_type_name(node.node_type());
+    label += '@';
+    label += line_label(line_of(node));
+    std::replace(label.begin(), label.end(), ' ', '_');
+    std::replace(label.begin(), label.end(), ';', '_');
+    return label;
+}
+
+} // namespace
+
+void ExecutionProfile::enter(const BaseNode& node)
+{
+    auto& stats = stats_[&node];
+    ++stats.visits;
+    stack_.push_back(Frame{ &stats, clock::now() });
+}
+
+void ExecutionProfile::leave()
+{
+    const auto elapsed = clock::now() - stack_.back().start;
+    stack_.back().stats->total += elapsed;
+    stack_.pop_back();
+    if (!stack_.empty()) {
+        stack_.back().stats->children += elapsed;
+    }
+}
+
+ExecutionProfile::clock::duration ExecutionProfile::total() const
+{
+    clock::duration sum{};
+    for (const auto& [node, stats] : stats_) {
+        sum += stats.self();
+    }
+    return sum;
+}
+
+void ExecutionProfile::write_hot_lines(std::ostream& os,
+                                       std::size_t limit) const
+{
+    std::map<LineKey, LineStats> by_line;
+    for (const auto& [node, stats] : stats_) {
+        const auto key = line_of(*node);
+        auto& line = by_line[key];
+        line.line = key;
+        line.hits = std::max(line.hits, stats.visits);
+        line.self += stats.self();
+        // Nested nodes on the same line are already part of their
+        // ancestor's total.
+        const auto* parent = node->parent();
+        if (parent == nullptr || stats_.count(parent) == 0 ||
+            line_of(*parent) != key) {
+            line.total += stats.total;
+        }
+    }
+
+    std::vector<LineStats> lines;
+    lines.reserve(by_line.size());
+    for (auto& [key, line] : by_line) {
+        lines.push_back(line);
+    }
+    std::stable_sort(lines.begin(),
+                     lines.end(),
+                     [](const LineStats& a, const LineStats& b) {
+                         return a.self > b.self;
+                     });
+    if (lines.size() > limit) {
+        lines.resize(limit);
+    }
+
+    const auto total_time = total();
+    char row[128];
+    std::snprintf(row, sizeof(row), "Profile: %.3f ms\n", to_ms(total_time));
+    os << row;
+    std::snprintf(row,
+                  sizeof(row),
+                  "%8s %12s %12s %12s  %s\n",
+                  "self%",
+                  "self ms",
+                  "total ms",
+                  "hits",
+                  "line");
+    os << row;
+    for (const auto& line : lines) {
+        const double share =
+            total_time.count() > 0
+                ? 100.0 * static_cast<double>(line.self.count()) /
+                      static_cast<double>(total_time.count())
+                : 0.0;
+        std::snprintf(row,
+                      sizeof(row),
+                      "%7.2f%% %12.3f %12.3f %12llu  ",
+                      share,
+                      to_ms(line.self),
+                      to_ms(line.total),
+                      static_cast<unsigned long long>(line.hits));
+        os << row << line_label(line.line) << '\n';
+    }
+}
+
+void ExecutionProfile::write_collapsed(std::ostream& os) const
+{
+    std::map<std::string, long long> stacks;
+    std::vector<const BaseNode*> path;
+    for (const auto& [node, stats] : stats_) {
+        const auto self_ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(stats.self())
+                .count();
+        if (self_ns <= 0) {
+            continue;
+        }
+        path.clear();
+        for (const auto* cur = node; cur != nullptr; cur = cur->parent()) {
+            path.push_back(cur);
+        }
+        std::string stack;
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            if (!stack.empty()) {
+                stack += ';';
+            }
+            stack += frame_label(**it);
+        }
+        stacks[stack] += self_ns;
+    }
+    for (const auto& [stack, ns] : stacks) {
+        os << stack << ' ' << ns << '\n';
+    }
+}
+
+} // namespace ast
@@ -0,0 +1,189 @@
+#include "Runtime/InputSource.hpp"
+
+#include <cerrno>
+#include <limits>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PARACL_POSIX_INPUT 1
+#endif
+
+namespace ast {
+
+namespace {
+
+bool is_space(char c)
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' ||
+           c == '\f';
+}
+
+bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+} // namespace
+
+InputSource::InputSource(std::istream& in)
+  : stream_(&in)
+{
+}
+
+InputSource InputSource::from_fd(int fd)
+{
+#ifdef PARACL_POSIX_INPUT
+    InputSource source(fd);
+
+    struct stat info{};
+    const off_t offset = ::lseek(fd, 0, SEEK_CUR);
+    if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) &&
+        offset >= 0 && info.st_size > offset) {
+        const auto size = static_cast<std::size_t>(info.st_size);
+        void* mapped =
+            ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            ::madvise(mapped, size, MADV_SEQUENTIAL);
+            source.mapped_ = static_cast<char*>(mapped);
+            source.mapped_size_ = size;
+            source.pos_ = source.mapped_ + offset;
+            source.end_ = source.mapped_ + size;
+            return source;
+        }
+    }
+
+    source.buffer_ = std::make_unique_for_overwrite<char[]>(kBlockSize);
+    return source;
+#else
+    static_cast<void>(fd);
+    return InputSource(std::cin);
+#endif
+}
+
+InputSource InputSource::from_stdin()
+{
+    return from_fd(0);
+}
+
+InputSource::InputSource(InputSource&& other) noexcept
+  : stream_(std::exchange(other.stream_, nullptr))
+  , fd_(std::exchange(other.fd_, -1))
+  , buffer_(std::move(other.buffer_))
+  , mapped_(std::exchange(other.mapped_, nullptr))
+  , mapped_size_(std::exchange(other.mapped_size_, 0))
+  , pos_(std::exchange(other.pos_, nullptr))
+  , end_(std::exchange(other.end_, nullptr))
+{
+}
+
+InputSource& InputSource::operator=(InputSource&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        stream_ = std::exchange(other.stream_, nullptr);
+        fd_ = std::exchange(other.fd_, -1);
+        buffer_ = std::move(other.buffer_);
+        mapped_ = std::exchange(other.mapped_, nullptr);
+        mapped_size_ = std::exchange(other.mapped_size_, 0);
+        pos_ = std::exchange(other.pos_, nullptr);
+        end_ = std::exchange(other.end_, nullptr);
+    }
+    return *this;
+}
+
+InputSource::~InputSource()
+{
+    release();
+}
+
+void InputSource::release()
+{
+#ifdef PARACL_POSIX_INPUT
+    if (mapped_ != nullptr) {
+        ::munmap(mapped_, mapped_size_);
+        mapped_ = nullptr;
+    }
+#endif
+}
+
+bool InputSource::refill()
+{
+    if (mapped_ != nullptr || !buffer_) {
+        return false;
+    }
+
+    std::size_t got = 0;
+#ifdef PARACL_POSIX_INPUT
+    ssize_t n = 0;
+    do {
+        n = ::read(fd_, buffer_.get(), kBlockSize);
+    } while (n < 0 && errno == EINTR);
+    got = n > 0 ? static_cast<std::size_t>(n) : 0;
+#endif
+
+    pos_ = buffer_.get();
+    end_ = pos_ + got;
+    return got != 0;
+}
+
+void InputSource::skip_line()
+{
+    for (int c = peek(); c != kEof; c = peek()) {
+        advance();
+        if (c == '\n') {
+            return;
+        }
+    }
+}
+
+bool InputSource::read(std::int64_t& value)
+{
+    int c = peek();
+    while (c != kEof && is_space(static_cast<char>(c))) {
+        advance();
+        c = peek();
+    }
+    if (c == kEof) {
+        return false;
+    }
+
+    bool negative = false;
+    if (c == '-' || c == '+') {
+        negative = c == '-';
+        advance();
+        c = peek();
+    }
+    if (c == kEof || !is_digit(static_cast<char>(c))) {
+        skip_line();
+        return false;
+    }
+
+    constexpr auto kMax =
+        static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max());
+    const std::uint64_t limit = negative ? kMax + 1 : kMax;
+    std::uint64_t magnitude = 0;
+    bool overflow = false;
+    while (c != kEof && is_digit(static_cast<char>(c))) {
+        const auto digit = static_cast<std::uint64_t>(c - '0');
+        if (magnitude > (limit - digit) / 10) {
+            overflow = true;
+        } else {
+            magnitude = magnitude * 10 + digit;
+        }
+        advance();
+        c = peek();
+    }
+    if (overflow) {
+        skip_line();
+        return false;
+    }
+
+    value = negative ? static_cast<std::int64_t>(0 - magnitude)
+                     : static_cast<std::int64_t>(magnitude);
+    return true;
+}
+
+} // namespace ast
@@ -0,0 +1,89 @@
+#include "Runtime/OutputSink.hpp"
+
+#include <charconv>
+#include <limits>
+#include <utility>
+
+namespace ast {
+
+namespace {
+
+// Longest int64_t in decimal plus the sign and the trailing newline.
+constexpr std::size_t kMaxLineSize =
+    std::numeric_limits<std::int64_t>::digits10 + 3;
+
+} // namespace
+
+OutputSink::OutputSink(std::ostream& out, buffering mode)
+  : out_(&out)
+  , mode_(mode)
+  , buffer_(std::make_unique_for_overwrite<char[]>(kBufferSize))
+{
+}
+
+OutputSink::OutputSink(OutputSink&& other) noexcept
+  : out_(other.out_)
+  , mode_(other.mode_)
+  , buffer_(std::move(other.buffer_))
+  , used_(std::exchange(other.used_, 0))
+{
+}
+
+OutputSink::~OutputSink()
+{
+    try {
+        flush();
+    } catch (...) {
+    }
+}
+
+void OutputSink::print(std::int64_t value)
+{
+    if (kBufferSize - used_ < kMaxLineSize) {
+        write_buffer();
+    }
+
+    char* begin = buffer_.get() + used_;
+    char* end =
+        std::to_chars(begin, buffer_.get() + kBufferSize, value).ptr;
+    *end++ = '\n';
+    used_ += static_cast<std::size_t>(end - begin);
+
+    if (mode_ == buffering::line) {
+        flush();
+    }
+}
+
+void OutputSink::flush()
+{
+    if (!buffer_) {
+        return;
+    }
+    write_buffer();
+    out_->flush();
+}
+
+void OutputSink::set_mode(buffering mode)
+{
+    mode_ = mode;
+    if (mode_ == buffering::line) {
+        flush();
+    }
+}
+
+void OutputSink::set_stream(std::ostream& out)
+{
+    flush();
+    out_ = &out;
+}
+
+void OutputSink::write_buffer()
+{
+    if (used_ == 0) {
+        return;
+    }
+    out_->write(buffer_.get(), static_cast<std::streamsize>(used_));
+    used_ = 0;
+}
+
+} // namespace ast
@@ -0,0 +1,105 @@
+#include "AST/AST.hpp"
+#include "AST/NodeArena.hpp"
+#include "gtest/gtest.h"
+
+#include <memory>
+
+namespace {
+
+std::unique_ptr<ast::ScopeNode> BuildInArena(ast::NodeArena* arena)
+{
+    auto scope = ast::make_node<ast::ScopeNode>(arena);
+    for (int64_t i = 0; i < 10; ++i) {
+        scope->add_statement(ast::make_node<ast::PrintNode>(
+            arena,
+            ast::make_node<ast::BinArithOpNode>(
+                arena, ast::bin_arith_op_type::add,
+                ast::make_node<ast::VarNode>(arena, "x"),
+                ast::make_node<ast::ValueNode>(arena, i))));
+    }
+    return scope;
+}
+
+} // namespace
+
+TEST(NodeArenaTest, NodesComeFromArena)
+{
+    ast::NodeArena arena;
+    auto scope = BuildInArena(&arena);
+
+    EXPECT_TRUE(scope->in_arena());
+    ASSERT_EQ(scope->statements().size(), 10u);
+    EXPECT_TRUE(scope->statements()[3]->in_arena());
+    EXPECT_GT(arena.bytes_used(), 0u);
+    EXPECT_GE(arena.bytes_reserved(), arena.bytes_used());
+}
+
+TEST(NodeArenaTest, NullArenaUsesHeap)
+{
+    auto scope = BuildInArena(nullptr);
+
+    EXPECT_FALSE(scope->in_arena());
+    EXPECT_FALSE(scope->statements()[0]->in_arena());
+}
+
+TEST(NodeArenaTest, CloneOfArenaTreeIsOnHeap)
+{
+    ast::NodeArena arena;
+    auto scope = BuildInArena(&arena);
+    auto copy = scope->clone();
+
+    EXPECT_FALSE(copy->in_arena());
+    ASSERT_EQ(copy->children().size(), 10u);
+    EXPECT_FALSE(copy->children()[9]->in_arena());
+}
+
+TEST(NodeArenaTest, ASTKeepsArenaAlive)
+{
+    ast::AST tree;
+    {
+        auto arena = std::make_shared<ast::NodeArena>();
+        tree.set_root(BuildInArena(arena.get()), arena);
+    }
+    ASSERT_NE(tree.arena(), nullptr);
+    EXPECT_EQ(tree.root()->children().size(), 10u);
+
+    ast::AST moved;
+    moved = std::move(tree);
+    EXPECT_EQ(moved.root()->children().size(), 10u);
+
+    ast::AST copied(moved);
+    EXPECT_FALSE(copied.root()->in_arena());
+    EXPECT_EQ(copied.arena(), nullptr);
+}
+
+TEST(ChildListTest, SpillsPastInlineSlots)
+{
+    ast::ChildList list;
+    for (int64_t i = 0; i < 9; ++i)
+        list.push_back(std::make_unique<ast::ValueNode>(i));
+    list.push_front(std::make_unique<ast::ValueNode>(-1));
+
+    ASSERT_EQ(list.size(), 10u);
+    int64_t expected = -1;
+    for (const auto& child : list)
+        EXPECT_EQ(static_cast<const ast::ValueNode&>(*child).value(),
+                  expected++);
+
+    ast::ChildList moved(std::move(list));
+    EXPECT_EQ(moved.size(), 10u);
+    EXPECT_TRUE(list.empty());
+
+    moved.clear();
+    EXPECT_TRUE(moved.empty());
+}
+
+TEST(ChildListTest, PushFrontWithinInlineSlots)
+{
+    ast::ChildList list;
+    list.push_back(std::make_unique<ast::ValueNode>(2));
+    list.push_front(std::make_unique<ast::ValueNode>(1));
+
+    ASSERT_EQ(list.size(), 2u);
+    EXPECT_EQ(static_cast<const ast::ValueNode&>(*list[0]).value(), 1);
+    EXPECT_EQ(static_cast<const ast::ValueNode&>(*list[1]).value(), 2);
+}
@@ -180,6 +180,61 @@ bool check_node_equality(const ast::BaseNode* node1, const ast::BaseNode* node2)
             return compare_leaf_nodes<ast::ErrorNode>(node1, node2);
         case ast::base_node_type::empty:
             return compare_leaf_nodes<ast::EmptyNode>(node1, node2);
+        case ast::base_node_type::array:
+            return compare_typed_nodes<ast::ArrayNode>(
+                node1,
+                node2,
+                [](const ast::ArrayNode* a, const ast::ArrayNode* b) {
+                    const auto& ia = a->items();
+                    const auto& ib = b->items();
+                    if (a->init() != b->init() || ia.size() != ib.size())
+                        return false;
+                    for (size_t i = 0; i < ia.size(); ++i) {
+                        if (!check_node_equality(ia[i].get(), ib[i].get()))
+                            return false;
+                    }
+                    return true;
+                });
+        case ast::base_node_type::index:
+            return compare_typed_nodes<ast::IndexNode>(
+                node1,
+                node2,
+                [](const ast::IndexNode* a, const ast::IndexNode* b) {
+                    return a->bounds_checked() == b->bounds_checked() &&
+                           check_node_equality(a->base(), b->base()) &&
+                           check_node_equality(a->index(), b->index());
+                });
+        case ast::base_node_type::func:
+            return compare_typed_nodes<ast::FuncNode>(
+                node1,
+                node2,
+                [](const ast::FuncNode* a, const ast::FuncNode* b) {
+                    return a->name() == b->name() &&
+                           a->params() == b->params() &&
+                           check_node_equality(a->body(), b->body());
+                });
+        case ast::base_node_type::call:
+            return compare_typed_nodes<ast::CallNode>(
+                node1,
+                node2,
+                [](const ast::CallNode* a, const ast::CallNode* b) {
+                    const auto& ia = a->args();
+                    const auto& ib = b->args();
+                    if (a->name() != b->name() || ia.size() != ib.size())
+                        return false;
+                    for (size_t i = 0; i < ia.size(); ++i) {
+                        if (!check_node_equality(ia[i].get(), ib[i].get()))
+                            return false;
+                    }
+                    return true;
+                });
+        case ast::base_node_type::return_node:
+            return compare_typed_nodes<ast::ReturnNode>(
+                node1,
+                node2,
+                [](const ast::ReturnNode* a, const ast::ReturnNode* b) {
+                    return check_node_equality(a->expr(), b->expr());
+                });
         case ast::base_node_type::base:
         default:
             return false;
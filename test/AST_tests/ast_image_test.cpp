@@ -0,0 +1,356 @@
+#include "AST/AST.hpp"
+#include "AST/AstImage.hpp"
+#include "Visitors/Interpreter.hpp"
+#include "Visitors/SemanticChecker.hpp"
+#include "driver/driver.hpp"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+using NodePtr = ast::BaseNode::NodePtr;
+
+constexpr const char* kSource = R"(
+func pick(a, b, c) {
+    if (a > b && !(c == 0) || a <= -b)
+        return a % c;
+    else
+        return +b;
+}
+x;
+x = ?;
+arr = repeat(1, 5);
+lst = array(3, 4, 5);
+arr[2] = pick(x, 2, 3) * 4 - 10 / 3;
+for (; x < 3; ) {
+    x = x + 1;
+}
+for (i = 0; i != 2; i = i + 1) print lst[i] ^ 1;
+while (x >= 1) { x = x - 1; if (x < 2) print x; }
+{
+    y = arr[2] + lst[0];
+    print y;
+}
+print arr[2];
+)";
+
+// Every field of the node and of its subtree, with slots that are empty
+// in the node class printed as "-".
+std::string Dump(const ast::BaseNode* node);
+
+std::string Dump(ast::NodeView node);
+
+ast::AST Parse(const std::string& source, const std::string& path)
+{
+    yy::NumDriver driver(source, path);
+    if (!driver.parse() || driver.has_errors()) {
+        throw std::runtime_error("parse failed");
+    }
+    return driver.take_ast();
+}
+
+std::string Image(const ast::BaseNode& root)
+{
+    std::ostringstream out;
+    ast::write_ast_image(root, out);
+    return out.str();
+}
+
+std::string Interpret(ast::AST& tree, const std::string& input)
+{
+    ast::SemanticChecker checker;
+    checker.check(tree.root());
+    if (checker.hasErrors()) {
+        return "check failed";
+    }
+    std::istringstream in(input);
+    std::ostringstream out;
+    std::streambuf* old_in = std::cin.rdbuf(in.rdbuf());
+    std::streambuf* old_out = std::cout.rdbuf(out.rdbuf());
+    std::string error;
+    auto interpreter = checker.hasFrameLayout()
+                           ? ast::Interpreter(checker.frameSize())
+                           : ast::Interpreter();
+    try {
+        tree.root()->accept(interpreter);
+    } catch (const std::runtime_error& ex) {
+        error = ex.what();
+    }
+    interpreter.output().flush();
+    std::cin.rdbuf(old_in);
+    std::cout.rdbuf(old_out);
+    return out.str() + error;
+}
+
+std::string Location(const ast::SourceRange& loc)
+{
+    return loc.file_name() + ":" + std::to_string(loc.begin_line) + ":" +
+           std::to_string(loc.begin_column) + "-" +
+           std::to_string(loc.end_line) + ":" +
+           std::to_string(loc.end_column);
+}
+
+std::string Dump(const ast::BaseNode* node)
+{
+    if (node == nullptr) {
+        return "-";
+    }
+    std::string out = std::string("(") +
+                      ast::node_type_name(node->node_type()) + " " +
+                      Location(node->location());
+    std::vector<const ast::BaseNode*> slots;
+    bool list = false;
+    switch (node->node_type()) {
+        case ast::base_node_type::value:
+            out += " " +
+                   std::to_string(
+                       static_cast<const ast::ValueNode*>(node)->value());
+            break;
+        case ast::base_node_type::var:
+            out += " " + static_cast<const ast::VarNode*>(node)->name().str();
+            break;
+        case ast::base_node_type::unop: {
+            const auto* op = static_cast<const ast::UnOpNode*>(node);
+            out += " op" + std::to_string(static_cast<int>(op->op()));
+            slots = { op->operand() };
+            break;
+        }
+        case ast::base_node_type::bin_arith_op: {
+            const auto* op = static_cast<const ast::BinArithOpNode*>(node);
+            out += " op" + std::to_string(static_cast<int>(op->op()));
+            slots = { op->left(), op->right() };
+            break;
+        }
+        case ast::base_node_type::bin_logic_op: {
+            const auto* op = static_cast<const ast::BinLogicOpNode*>(node);
+            out += " op" + std::to_string(static_cast<int>(op->op()));
+            slots = { op->left(), op->right() };
+            break;
+        }
+        case ast::base_node_type::if_node: {
+            const auto* branch = static_cast<const ast::IfNode*>(node);
+            slots = { branch->condition(),
+                      branch->then_branch(),
+                      branch->else_branch() };
+            break;
+        }
+        case ast::base_node_type::for_node: {
+            const auto* loop = static_cast<const ast::ForNode*>(node);
+            slots = { loop->get_init(),
+                      loop->get_cond(),
+                      loop->get_step(),
+                      loop->get_body() };
+            break;
+        }
+        case ast::base_node_type::var_decl: {
+            const auto* decl = static_cast<const ast::VarDeclNode*>(node);
+            out += " " + decl->name().str();
+            slots = { decl->init_expr() };
+            break;
+        }
+        case ast::base_node_type::func: {
+            const auto* func = static_cast<const ast::FuncNode*>(node);
+            out += " " + func->name().str() + "(";
+            for (const auto param : func->params()) {
+                out += param.str() + ",";
+            }
+            out += ")";
+            slots = { func->body() };
+            break;
+        }
+        case ast::base_node_type::call:
+            out += " " + static_cast<const ast::CallNode*>(node)->name().str();
+            list = true;
+            break;
+        case ast::base_node_type::array:
+            out += " op" + std::to_string(static_cast<int>(
+                               static_cast<const ast::ArrayNode*>(node)
+                                   ->init()));
+            list = true;
+            break;
+        case ast::base_node_type::scope:
+            list = true;
+            break;
+        case ast::base_node_type::print:
+        case ast::base_node_type::assign:
+        case ast::base_node_type::expr:
+        case ast::base_node_type::while_node:
+        case ast::base_node_type::input:
+        case ast::base_node_type::err:
+        case ast::base_node_type::empty:
+        case ast::base_node_type::index:
+        case ast::base_node_type::return_node:
+        case ast::base_node_type::base:
+            // Children in slot order and never empty in these tests.
+            list = true;
+            break;
+    }
+    if (list) {
+        for (const auto& child : node->children()) {
+            out += " " + Dump(child.get());
+        }
+    } else {
+        for (const auto* slot : slots) {
+            out += " " + Dump(slot);
+        }
+    }
+    return out + ")";
+}
+
+std::string Dump(ast::NodeView node)
+{
+    if (!node) {
+        return "-";
+    }
+    std::string out = std::string("(") + ast::node_type_name(node.type()) +
+                      " " + Location(node.location());
+    std::size_t slots = 0;
+    switch (node.type()) {
+        case ast::base_node_type::value:
+            out += " " + std::to_string(node.value());
+            break;
+        case ast::base_node_type::var:
+            out += " " + std::string(node.name());
+            break;
+        case ast::base_node_type::unop:
+            out += " op" + std::to_string(static_cast<int>(
+                               node.op<ast::unop_node_type>()));
+            slots = 1;
+            break;
+        case ast::base_node_type::bin_arith_op:
+            out += " op" + std::to_string(static_cast<int>(
+                               node.op<ast::bin_arith_op_type>()));
+            slots = 2;
+            break;
+        case ast::base_node_type::bin_logic_op:
+            out += " op" + std::to_string(static_cast<int>(
+                               node.op<ast::bin_logic_op_type>()));
+            slots = 2;
+            break;
+        case ast::base_node_type::if_node:
+            slots = 3;
+            break;
+        case ast::base_node_type::for_node:
+            slots = 4;
+            break;
+        case ast::base_node_type::var_decl:
+            out += " " + std::string(node.name());
+            slots = 1;
+            break;
+        case ast::base_node_type::func:
+            out += " " + std::string(node.name()) + "(";
+            for (std::size_t i = 0; i < node.num_params(); ++i) {
+                out += std::string(node.param(i)) + ",";
+            }
+            out += ")";
+            slots = 1;
+            break;
+        case ast::base_node_type::call:
+            out += " " + std::string(node.name());
+            break;
+        case ast::base_node_type::array:
+            out += " op" + std::to_string(static_cast<int>(
+                               node.op<ast::array_init_type>()));
+            break;
+        case ast::base_node_type::scope:
+        case ast::base_node_type::print:
+        case ast::base_node_type::assign:
+        case ast::base_node_type::expr:
+        case ast::base_node_type::while_node:
+        case ast::base_node_type::input:
+        case ast::base_node_type::err:
+        case ast::base_node_type::empty:
+        case ast::base_node_type::index:
+        case ast::base_node_type::return_node:
+        case ast::base_node_type::base:
+            break;
+    }
+    if (slots == 0) {
+        for (std::size_t i = 0; i < node.num_children(); ++i) {
+            out += " " + Dump(node.child(i));
+        }
+    } else {
+        for (std::size_t i = 0; i < slots; ++i) {
+            out += " " + Dump(node.slot(i));
+        }
+    }
+    return out + ")";
+}
+
+} // namespace
+
+TEST(AstImageTest, ViewsMatchTheTree)
+{
+    const auto tree = Parse(kSource, "prog.pcl");
+    const auto bytes = Image(*tree.root());
+    const ast::AstImage image(bytes, ast::FileTable::intern("prog.pcl"));
+
+    EXPECT_EQ(Dump(image.root()), Dump(tree.root()));
+    EXPECT_NE(Dump(image.root()).find("(for prog.pcl:13:1-15:2 - "),
+              std::string::npos);
+}
+
+TEST(AstImageTest, BuiltTreeRunsTheSame)
+{
+    auto tree = Parse(kSource, "prog.pcl");
+    const auto bytes = Image(*tree.root());
+    auto built =
+        ast::AstImage(bytes, ast::FileTable::intern("prog.pcl")).build();
+
+    ASSERT_NE(built.arena(), nullptr);
+    EXPECT_TRUE(built.root()->in_arena());
+    EXPECT_EQ(Dump(built.root()), Dump(tree.root()));
+    EXPECT_EQ(Image(*built.root()), bytes);
+    EXPECT_EQ(Interpret(tree, "5"), "2\n5\n1\n0\n8\n5\n");
+    EXPECT_EQ(Interpret(built, "5"), Interpret(tree, "5"));
+    EXPECT_EQ(Interpret(built, "0"), Interpret(tree, "0"));
+}
+
+TEST(AstImageTest, KeepsEmptySlots)
+{
+    NodePtr init = std::make_unique<ast::ErrorNode>();
+    NodePtr body = std::make_unique<ast::ScopeNode>();
+    NodePtr loop = std::make_unique<ast::ForNode>(
+        std::move(init), nullptr, nullptr, std::move(body));
+    NodePtr branch = std::make_unique<ast::IfNode>(
+        std::make_unique<ast::ValueNode>(-7), nullptr, std::move(loop));
+    ast::ScopeNode root;
+    root.add_statement(std::move(branch));
+    root.add_statement(std::make_unique<ast::EmptyNode>());
+
+    const auto bytes = Image(root);
+    const ast::AstImage image(bytes, ast::FileTable::kNoFile);
+    const auto view = image.root().child(0);
+    EXPECT_FALSE(view.slot(1));
+    EXPECT_EQ(view.slot(2).type(), ast::base_node_type::for_node);
+    EXPECT_EQ(view.slot(2).slot(0).type(), ast::base_node_type::err);
+    EXPECT_FALSE(view.slot(2).slot(1));
+    EXPECT_EQ(view.slot(0).value(), -7);
+    EXPECT_EQ(image.size(), 7u);
+
+    const auto built = image.build();
+    EXPECT_EQ(Dump(built.root()), Dump(&root));
+}
+
+TEST(AstImageTest, RejectsDamagedImages)
+{
+    const auto tree = Parse(kSource, "prog.pcl");
+    const auto bytes = Image(*tree.root());
+
+    EXPECT_FALSE(ast::AstImage::is_image(kSource));
+    for (std::size_t size = 0; size < bytes.size(); size += 11) {
+        EXPECT_THROW(ast::AstImage(bytes.substr(0, size), 0),
+                     std::runtime_error)
+            << "truncated to " << size;
+    }
+    for (std::size_t pos = 0; pos < bytes.size(); pos += 3) {
+        auto damaged = bytes;
+        damaged[pos] = static_cast<char>(damaged[pos] ^ 0x10);
+        EXPECT_THROW(ast::AstImage(damaged, 0), std::runtime_error)
+            << "flipped byte " << pos;
+    }
+}
@@ -6,7 +6,7 @@
 TEST(ErrorFormatterTest, FormatsGnuErrorWithLocation)
 {
     ast::SourceRange range;
-    range.file = "sample.pcl";
+    range.file = ast::FileTable::intern("sample.pcl");
     range.begin_line = 3;
     range.begin_column = 14;
 
@@ -19,3 +19,16 @@ TEST(ErrorFormatterTest, FormatsErrorWithoutLocation)
 
     EXPECT_EQ(err::format_error(range, "boom"), "error: boom");
 }
+
+TEST(ErrorFormatterTest, FileNamesAreInterned)
+{
+    const auto first = ast::FileTable::intern("a.pcl");
+    const auto second = ast::FileTable::intern("b.pcl");
+
+    EXPECT_NE(first, ast::FileTable::kNoFile);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(ast::FileTable::intern("a.pcl"), first);
+    EXPECT_EQ(ast::FileTable::name(first), "a.pcl");
+    EXPECT_EQ(ast::FileTable::name(second), "b.pcl");
+    EXPECT_EQ(ast::FileTable::intern(""), ast::FileTable::kNoFile);
+}
@@ -0,0 +1,89 @@
+#include "AST/AST.hpp"
+#include "AST/NameTable.hpp"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+TEST(NameTableTest, SameSpellingSameId)
+{
+    const std::string spelling = "name_table_counter";
+    const ast::Name a(spelling);
+    const ast::Name b("name_table_counter");
+
+    EXPECT_EQ(a, b);
+    EXPECT_EQ(a.id(), b.id());
+    EXPECT_NE(a, ast::Name("name_table_counter2"));
+}
+
+TEST(NameTableTest, IdGivesBackTheSpelling)
+{
+    const ast::Name name("name_table_spelling");
+    EXPECT_EQ(name.view(), "name_table_spelling");
+    EXPECT_EQ(ast::NameTable::name(name.id()), "name_table_spelling");
+    EXPECT_EQ(name.str() + "!", "name_table_spelling!");
+}
+
+TEST(NameTableTest, EmptyNameIsNoName)
+{
+    EXPECT_EQ(ast::Name().id(), ast::NameTable::kNoName);
+    EXPECT_EQ(ast::Name("").id(), ast::NameTable::kNoName);
+    EXPECT_TRUE(ast::Name().view().empty());
+}
+
+TEST(NameTableTest, SpellingOutlivesTheSource)
+{
+    ast::Name name;
+    {
+        std::string temporary = "name_table_temporary";
+        name = ast::Name(temporary);
+        temporary.assign("overwritten");
+    }
+    EXPECT_EQ(name.view(), "name_table_temporary");
+}
+
+TEST(NameTableTest, NodesCompareByName)
+{
+    const ast::VarNode var("name_table_node");
+    const ast::VarDeclNode decl(std::string("name_table_node"));
+    EXPECT_EQ(var.name(), decl.name());
+    EXPECT_EQ(std::hash<ast::Name>{}(var.name()), var.name().id());
+}
+
+TEST(NameTableTest, ThreadsAgreeOnIds)
+{
+    constexpr std::size_t kThreads = 8;
+    constexpr std::size_t kNames = 500;
+    const auto spelling = [](std::size_t n) {
+        return "name_table_thread_" + std::to_string(n);
+    };
+
+    // Each thread interns the same names in a different order.
+    std::vector<std::vector<ast::NameTable::NameId>> ids(
+        kThreads, std::vector<ast::NameTable::NameId>(kNames));
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < kThreads; ++t) {
+        threads.emplace_back([t, &ids, &spelling] {
+            for (std::size_t i = 0; i < kNames; ++i) {
+                const auto n = (i + t * 37) % kNames;
+                ids[t][n] = ast::Name(spelling(n)).id();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::unordered_set<ast::NameTable::NameId> distinct;
+    for (std::size_t n = 0; n < kNames; ++n) {
+        const ast::Name name(spelling(n));
+        EXPECT_EQ(name.view(), spelling(n));
+        distinct.insert(name.id());
+        for (std::size_t t = 0; t < kThreads; ++t) {
+            EXPECT_EQ(ids[t][n], name.id());
+        }
+    }
+    EXPECT_EQ(distinct.size(), kNames);
+}
@@ -0,0 +1,175 @@
+#include "batch/batch_runner.hpp"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+class BatchRunnerTest : public ::testing::Test
+{
+protected:
+    std::filesystem::path dir_;
+
+    void SetUp() override
+    {
+        const auto* test =
+            ::testing::UnitTest::GetInstance()->current_test_info();
+        dir_ = std::filesystem::temp_directory_path() /
+               ("paracl_batch_" + std::to_string(::getpid()) + "_" +
+                test->name());
+        std::filesystem::create_directories(dir_);
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(dir_);
+    }
+
+    std::string Write(const std::string& name, const std::string& text)
+    {
+        const auto path = dir_ / name;
+        std::ofstream(path, std::ios::binary) << text;
+        return path.string();
+    }
+
+    std::string Path(const std::string& name) const
+    {
+        return (dir_ / name).string();
+    }
+
+    static std::string Read(const std::string& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), {});
+    }
+};
+
+// Sums `count` numbers read with `?`.
+const char* const kSumProgram = "count = ?;\n"
+                                "sum = 0;\n"
+                                "while (count > 0) {\n"
+                                "    sum = sum + ?;\n"
+                                "    count = count - 1;\n"
+                                "}\n"
+                                "print sum;\n";
+
+} // namespace
+
+TEST(BatchManifestTest, ReadsTriples)
+{
+    std::istringstream in("# program input output\n"
+                          "a.pcl a.in a.out\n"
+                          "\n"
+                          "  b.pcl   -   b.out  \n");
+    const auto tasks = batch::read_manifest(in, "jobs.txt");
+
+    ASSERT_EQ(tasks.size(), 2u);
+    EXPECT_EQ(tasks[0].program, "a.pcl");
+    EXPECT_EQ(tasks[0].input, "a.in");
+    EXPECT_EQ(tasks[0].output, "a.out");
+    EXPECT_EQ(tasks[1].program, "b.pcl");
+    EXPECT_EQ(tasks[1].input, "-");
+    EXPECT_EQ(tasks[1].output, "b.out");
+}
+
+TEST(BatchManifestTest, MalformedLineNamesTheLine)
+{
+    std::istringstream in("a.pcl a.in a.out\nb.pcl b.in\n");
+    try {
+        batch::read_manifest(in, "jobs.txt");
+        FAIL() << "expected an error";
+    } catch (const std::runtime_error& ex) {
+        EXPECT_EQ(std::string(ex.what()),
+                  "jobs.txt:2:1: error: Expected <program> <stdin> <stdout>");
+    }
+
+    std::istringstream extra("a.pcl a.in a.out extra\n");
+    EXPECT_THROW(batch::read_manifest(extra, "jobs.txt"), std::runtime_error);
+}
+
+TEST_F(BatchRunnerTest, RunsEveryTaskWithItsOwnStreams)
+{
+    const auto program = Write("sum.pcl", kSumProgram);
+    std::vector<batch::Task> tasks;
+    std::vector<std::string> expected;
+    for (int i = 0; i < 64; ++i) {
+        std::string input = std::to_string(i);
+        int sum = 0;
+        for (int k = 1; k <= i; ++k) {
+            input += " " + std::to_string(k);
+            sum += k;
+        }
+        const auto name = std::to_string(i);
+        tasks.push_back({ program, Write(name + ".in", input),
+                          Path(name + ".out") });
+        expected.push_back(std::to_string(sum) + "\n");
+    }
+
+    for (const bool tree_walk : { false, true }) {
+        batch::Options options;
+        options.jobs = 4;
+        options.tree_walk = tree_walk;
+        const auto results = batch::run_batch(tasks, options);
+
+        ASSERT_EQ(results.size(), tasks.size());
+        for (std::size_t i = 0; i < tasks.size(); ++i) {
+            EXPECT_TRUE(results[i].ok) << results[i].diagnostics;
+            EXPECT_EQ(Read(tasks[i].output), expected[i]);
+        }
+    }
+}
+
+TEST_F(BatchRunnerTest, FailuresStayWithTheirTask)
+{
+    const auto good = Write("good.pcl", "print 7;\n");
+    const auto syntax = Write("syntax.pcl", "x = ;\n");
+    const auto undefined = Write("undefined.pcl", "print y;\n");
+    const auto runtime =
+        Write("runtime.pcl", "x = 0;\nprint 1;\nprint 5 / x;\n");
+
+    const std::vector<batch::Task> tasks = {
+        { good, "-", Path("good.out") },
+        { syntax, "-", Path("syntax.out") },
+        { undefined, "-", Path("undefined.out") },
+        { runtime, "-", Path("runtime.out") },
+        { Path("missing.pcl"), "-", Path("missing.out") },
+        { good, Path("missing.in"), Path("input.out") },
+    };
+    batch::Options options;
+    options.jobs = 3;
+    const auto results = batch::run_batch(tasks, options);
+
+    ASSERT_EQ(results.size(), tasks.size());
+    EXPECT_TRUE(results[0].ok);
+    EXPECT_TRUE(results[0].diagnostics.empty());
+    EXPECT_EQ(Read(Path("good.out")), "7\n");
+
+    EXPECT_FALSE(results[1].ok);
+    EXPECT_EQ(results[1].diagnostics.rfind(syntax + ":1:", 0), 0u)
+        << results[1].diagnostics;
+
+    EXPECT_FALSE(results[2].ok);
+    EXPECT_EQ(results[2].diagnostics.rfind(undefined + ":1:", 0), 0u)
+        << results[2].diagnostics;
+
+    EXPECT_FALSE(results[3].ok);
+    EXPECT_NE(results[3].diagnostics.find("error"), std::string::npos);
+    EXPECT_EQ(Read(Path("runtime.out")), "1\n");
+
+    EXPECT_FALSE(results[4].ok);
+    EXPECT_EQ(results[4].diagnostics,
+              "error: Failed to open file: " + Path("missing.pcl") + "\n");
+
+    EXPECT_FALSE(results[5].ok);
+    EXPECT_EQ(results[5].diagnostics,
+              "error: Failed to open file: " + Path("missing.in") + "\n");
+}
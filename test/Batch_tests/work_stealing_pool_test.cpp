@@ -0,0 +1,95 @@
+#include "batch/work_stealing_pool.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST(WorkStealingPoolTest, RunsEveryIndexOnce)
+{
+    batch::WorkStealingPool pool(4);
+    std::vector<std::atomic<int>> calls(1000);
+
+    pool.run(calls.size(), [&](std::size_t i) { ++calls[i]; });
+
+    for (const auto& count : calls) {
+        EXPECT_EQ(count.load(), 1);
+    }
+}
+
+TEST(WorkStealingPoolTest, IsReusable)
+{
+    batch::WorkStealingPool pool(3);
+    std::atomic<std::size_t> sum = 0;
+
+    for (std::size_t round = 1; round <= 20; ++round) {
+        pool.run(round, [&](std::size_t i) { sum += i + 1; });
+    }
+
+    std::size_t expected = 0;
+    for (std::size_t round = 1; round <= 20; ++round) {
+        expected += round * (round + 1) / 2;
+    }
+    EXPECT_EQ(sum.load(), expected);
+}
+
+TEST(WorkStealingPoolTest, IdleWorkersStealSlowQueues)
+{
+    constexpr std::size_t kWorkers = 4;
+    batch::WorkStealingPool pool(kWorkers);
+    std::mutex mutex;
+    std::set<std::thread::id> runners;
+
+    // Index 0 blocks its worker until every other index has run, which
+    // only happens if the indices queued behind it are stolen.
+    constexpr std::size_t kJobs = 64;
+    std::atomic<std::size_t> finished = 0;
+    pool.run(kJobs, [&](std::size_t i) {
+        if (i == 0) {
+            while (finished.load() != kJobs - 1) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return;
+        }
+        {
+            std::lock_guard lock(mutex);
+            runners.insert(std::this_thread::get_id());
+        }
+        ++finished;
+    });
+
+    EXPECT_EQ(finished.load(), kJobs - 1);
+    EXPECT_GT(runners.size(), 1u);
+}
+
+TEST(WorkStealingPoolTest, RethrowsAfterTheOtherJobs)
+{
+    batch::WorkStealingPool pool(2);
+    std::atomic<int> ran = 0;
+
+    EXPECT_THROW(pool.run(10,
+                          [&](std::size_t i) {
+                              ++ran;
+                              if (i == 3) {
+                                  throw std::runtime_error("job failed");
+                              }
+                          }),
+                 std::runtime_error);
+    EXPECT_EQ(ran.load(), 10);
+
+    pool.run(5, [&](std::size_t) { ++ran; });
+    EXPECT_EQ(ran.load(), 15);
+}
+
+TEST(WorkStealingPoolTest, ZeroMeansHardwareThreads)
+{
+    batch::WorkStealingPool pool;
+    EXPECT_GE(pool.size(), 1u);
+    pool.run(0, [](std::size_t) { FAIL(); });
+}
@@ -0,0 +1,438 @@
+#include "AST/AST.hpp"
+#include "Bytecode/BytecodeCompiler.hpp"
+#include "Bytecode/VM.hpp"
+#include "Visitors/Interpreter.hpp"
+#include "Visitors/SemanticChecker.hpp"
+#include "gtest/gtest.h"
+
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using NodePtr = ast::BaseNode::NodePtr;
+
+struct RunResult
+{
+    std::string out;
+    std::string error;
+};
+
+template <typename Fn>
+RunResult Capture(const std::string& input, Fn&& fn)
+{
+    RunResult result;
+    std::istringstream in(input);
+    std::ostringstream out;
+    std::streambuf* old_in = std::cin.rdbuf(in.rdbuf());
+    std::streambuf* old_out = std::cout.rdbuf(out.rdbuf());
+    try {
+        fn();
+    } catch (const std::runtime_error& ex) {
+        result.error = ex.what();
+    }
+    std::cin.rdbuf(old_in);
+    std::cout.rdbuf(old_out);
+    result.out = out.str();
+    return result;
+}
+
+RunResult RunTree(ast::BaseNode& root, const std::string& input = "")
+{
+    return Capture(input, [&] {
+        ast::Interpreter interpreter;
+        root.accept(interpreter);
+    });
+}
+
+RunResult RunVM(ast::BaseNode& root, const std::string& input = "")
+{
+    return Capture(input, [&] {
+        ast::bytecode::BytecodeCompiler compiler;
+        const auto program = compiler.compile(root);
+        ast::bytecode::VM vm(program);
+        vm.run();
+    });
+}
+
+void ExpectSameAsTreeWalker(ast::BaseNode& root, const std::string& input = "")
+{
+    const auto expected = RunTree(root, input);
+    const auto actual = RunVM(root, input);
+    EXPECT_EQ(actual.out, expected.out);
+    EXPECT_EQ(actual.error, expected.error);
+}
+
+NodePtr Num(int64_t value)
+{
+    return std::make_unique<ast::ValueNode>(value);
+}
+
+NodePtr Var(const std::string& name)
+{
+    return std::make_unique<ast::VarNode>(name);
+}
+
+NodePtr Assign(const std::string& name, NodePtr rhs)
+{
+    return std::make_unique<ast::AssignNode>(Var(name), std::move(rhs));
+}
+
+NodePtr Stmt(NodePtr expr)
+{
+    return std::make_unique<ast::ExprNode>(std::move(expr));
+}
+
+NodePtr Print(NodePtr expr)
+{
+    return std::make_unique<ast::PrintNode>(std::move(expr));
+}
+
+NodePtr Arith(ast::bin_arith_op_type op, NodePtr lhs, NodePtr rhs)
+{
+    return std::make_unique<ast::BinArithOpNode>(
+        op, std::move(lhs), std::move(rhs));
+}
+
+NodePtr Logic(ast::bin_logic_op_type op, NodePtr lhs, NodePtr rhs)
+{
+    return std::make_unique<ast::BinLogicOpNode>(
+        op, std::move(lhs), std::move(rhs));
+}
+
+std::unique_ptr<ast::ScopeNode> Block()
+{
+    return std::make_unique<ast::ScopeNode>();
+}
+
+} // namespace
+
+TEST(BytecodeVMTest, FibonacciLoopMatchesTreeWalker)
+{
+    auto root = Block();
+    root->add_statement(Stmt(Assign("n", std::make_unique<ast::InputNode>())));
+    root->add_statement(Stmt(Assign("a", Num(0))));
+    root->add_statement(Stmt(Assign("b", Num(1))));
+    root->add_statement(Stmt(Assign("i", Num(0))));
+
+    auto body = Block();
+    body->add_statement(Stmt(Assign(
+        "c", Arith(ast::bin_arith_op_type::add, Var("a"), Var("b")))));
+    body->add_statement(Print(Var("c")));
+    body->add_statement(Stmt(Assign("a", Var("b"))));
+    body->add_statement(Stmt(Assign("b", Var("c"))));
+    body->add_statement(Stmt(Assign(
+        "i", Arith(ast::bin_arith_op_type::add, Var("i"), Num(1)))));
+    root->add_statement(std::make_unique<ast::WhileNode>(
+        Logic(ast::bin_logic_op_type::less, Var("i"), Var("n")),
+        std::move(body)));
+
+    const auto result = RunVM(*root, "10");
+    EXPECT_EQ(result.out, "1\n2\n3\n5\n8\n13\n21\n34\n55\n89\n");
+    EXPECT_EQ(result.error, "");
+    ExpectSameAsTreeWalker(*root, "10");
+}
+
+TEST(BytecodeVMTest, ShadowingAndScopeExit)
+{
+    auto root = Block();
+    root->add_statement(Stmt(Assign("x", Num(1))));
+    auto inner = Block();
+    inner->add_statement(std::make_unique<ast::VarDeclNode>("x", Num(2)));
+    inner->add_statement(Print(Var("x")));
+    inner->add_statement(Stmt(Assign("y", Num(3))));
+    root->add_statement(std::move(inner));
+    root->add_statement(Print(Var("x")));
+    root->add_statement(Print(Var("y")));
+
+    const auto result = RunVM(*root);
+    EXPECT_EQ(result.out, "2\n1\n");
+    EXPECT_EQ(result.error, "error: Undefined variable: y");
+    ExpectSameAsTreeWalker(*root);
+}
+
+TEST(BytecodeVMTest, VariableCreatedInOneBranchOnly)
+{
+    auto root = Block();
+    root->add_statement(Stmt(Assign("c", std::make_unique<ast::InputNode>())));
+    root->add_statement(std::make_unique<ast::IfNode>(
+        Var("c"), Stmt(Assign("x", Num(1))), Print(Var("x"))));
+
+    ExpectSameAsTreeWalker(*root, "1");
+    ExpectSameAsTreeWalker(*root, "0");
+    EXPECT_EQ(RunVM(*root, "0").error, "error: Undefined variable: x");
+}
+
+TEST(BytecodeVMTest, AssignmentResolvesToOuterVariableWhenDefined)
+{
+    // The for step creates `x` in the loop scope after the first iteration,
+    // so the inner block writes its own `x` once and the outer one later.
+    auto inner = Block();
+    inner->add_statement(Stmt(
+        Assign("x", Arith(ast::bin_arith_op_type::add, Num(10), Var("i")))));
+    inner->add_statement(Print(Var("x")));
+    auto body = Block();
+    body->add_statement(std::move(inner));
+    body->add_statement(Stmt(
+        Assign("i", Arith(ast::bin_arith_op_type::add, Var("i"), Num(1)))));
+
+    auto root = Block();
+    root->add_statement(std::make_unique<ast::ForNode>(
+        Assign("i", Num(0)),
+        Logic(ast::bin_logic_op_type::less, Var("i"), Num(3)),
+        Assign("x", Var("i")),
+        std::move(body)));
+
+    const auto result = RunVM(*root);
+    EXPECT_EQ(result.out, "10\n11\n12\n");
+    ExpectSameAsTreeWalker(*root);
+}
+
+TEST(BytecodeVMTest, RedeclarationInLoopWithoutBlockFails)
+{
+    auto root = Block();
+    root->add_statement(Stmt(Assign("i", Num(0))));
+    auto body = Block();
+    body->add_statement(std::make_unique<ast::ForNode>(
+        Assign("j", Num(0)),
+        Logic(ast::bin_logic_op_type::less, Var("j"), Num(2)),
+        Assign("j", Arith(ast::bin_arith_op_type::add, Var("j"), Num(1))),
+        std::make_unique<ast::VarDeclNode>("k")));
+    root->add_statement(std::move(body));
+
+    ExpectSameAsTreeWalker(*root);
+    EXPECT_NE(RunVM(*root).error, "");
+}
+
+TEST(BytecodeVMTest, TrackedLoopConditionReadsVariable)
+{
+    auto root = Block();
+    auto body = Block();
+    body->add_statement(Print(Var("x")));
+    body->add_statement(Stmt(
+        Assign("x", Arith(ast::bin_arith_op_type::sub, Var("x"), Num(1)))));
+    root->add_statement(std::make_unique<ast::WhileNode>(
+        Assign("x", std::make_unique<ast::InputNode>()), std::move(body)));
+
+    const auto result = RunVM(*root, "3 7");
+    EXPECT_EQ(result.out, "3\n2\n1\n");
+    ExpectSameAsTreeWalker(*root, "3 7");
+}
+
+TEST(BytecodeVMTest, LeftOperandIsReadBeforeRightSideEffects)
+{
+    auto root = Block();
+    root->add_statement(Stmt(Assign("x", Num(1))));
+    root->add_statement(Print(
+        Arith(ast::bin_arith_op_type::add, Var("x"), Assign("x", Num(5)))));
+    root->add_statement(Stmt(Assign(
+        "x",
+        Arith(ast::bin_arith_op_type::mul, Var("x"), Assign("x", Num(2))))));
+    root->add_statement(Print(Var("x")));
+
+    const auto result = RunVM(*root);
+    EXPECT_EQ(result.out, "6\n10\n");
+    ExpectSameAsTreeWalker(*root);
+}
+
+TEST(BytecodeVMTest, ShortCircuitSkipsRightOperand)
+{
+    auto root = Block();
+    root->add_statement(Stmt(Assign("x", Num(0))));
+    root->add_statement(
+        Print(Logic(ast::bin_logic_op_type::logical_and,
+                    Var("x"),
+                    Arith(ast::bin_arith_op_type::div, Num(1), Var("x")))));
+    root->add_statement(
+        Print(Logic(ast::bin_logic_op_type::logical_or,
+                    Num(3),
+                    Arith(ast::bin_arith_op_type::div, Num(1), Var("x")))));
+    root->add_statement(Print(Logic(
+        ast::bin_logic_op_type::bitwise_xor,
+        Logic(ast::bin_logic_op_type::less_equal, Var("x"), Num(0)),
+        std::make_unique<ast::UnOpNode>(ast::unop_node_type::logical_not,
+                                        Var("x")))));
+
+    const auto result = RunVM(*root);
+    EXPECT_EQ(result.out, "0\n1\n0\n");
+    ExpectSameAsTreeWalker(*root);
+}
+
+TEST(BytecodeVMTest, RuntimeErrorsKeepLocations)
+{
+    ast::SourceRange loc;
+    loc.file = ast::FileTable::intern("prog.pcl");
+    loc.begin_line = 4;
+    loc.begin_column = 7;
+
+    auto div = Arith(ast::bin_arith_op_type::div, Num(1), Num(0));
+    div->set_location(loc);
+    auto root = Block();
+    root->add_statement(Print(Num(1)));
+    root->add_statement(Print(std::move(div)));
+
+    const auto result = RunVM(*root);
+    EXPECT_EQ(result.out, "1\n");
+    EXPECT_EQ(result.error, "prog.pcl:4:7: error: Division by zero");
+    ExpectSameAsTreeWalker(*root);
+}
+
+TEST(BytecodeVMTest, OverflowMatchesTreeWalker)
+{
+    constexpr int64_t kMax = std::numeric_limits<int64_t>::max();
+    constexpr int64_t kMin = std::numeric_limits<int64_t>::min();
+
+    auto add = Block();
+    add->add_statement(Stmt(Assign("x", Num(kMax))));
+    add->add_statement(
+        Print(Arith(ast::bin_arith_op_type::add, Var("x"), Num(1))));
+    ExpectSameAsTreeWalker(*add);
+
+    auto mul = Block();
+    mul->add_statement(Stmt(Assign("x", Num(kMin))));
+    mul->add_statement(
+        Print(Arith(ast::bin_arith_op_type::mul, Var("x"), Num(-1))));
+    ExpectSameAsTreeWalker(*mul);
+
+    auto neg = Block();
+    neg->add_statement(Stmt(Assign("x", Num(kMin))));
+    neg->add_statement(Print(
+        std::make_unique<ast::UnOpNode>(ast::unop_node_type::neg, Var("x"))));
+    ExpectSameAsTreeWalker(*neg);
+
+    auto mod = Block();
+    mod->add_statement(Stmt(Assign("x", Num(kMin))));
+    mod->add_statement(
+        Print(Arith(ast::bin_arith_op_type::mod, Var("x"), Num(-1))));
+    ExpectSameAsTreeWalker(*mod);
+}
+
+TEST(BytecodeVMTest, InvalidInputMatchesTreeWalker)
+{
+    auto root = Block();
+    root->add_statement(Print(std::make_unique<ast::InputNode>()));
+    root->add_statement(Print(std::make_unique<ast::InputNode>()));
+
+    ExpectSameAsTreeWalker(*root, "5 abc");
+}
+
+TEST(BytecodeVMTest, InvalidNodesTrapLikeTreeWalker)
+{
+    auto print_scope = Block();
+    print_scope->add_statement(Print(Block()));
+    ExpectSameAsTreeWalker(*print_scope);
+
+    auto error = Block();
+    error->add_statement(Print(Num(1)));
+    error->add_statement(std::make_unique<ast::ErrorNode>());
+    ExpectSameAsTreeWalker(*error);
+
+    auto missing = Block();
+    missing->add_statement(std::make_unique<ast::PrintNode>());
+    ExpectSameAsTreeWalker(*missing);
+}
+
+TEST(BytecodeVMTest, ArraysMatchTreeWalker)
+{
+    auto repeat =
+        std::make_unique<ast::ArrayNode>(ast::array_init_type::repeat);
+    repeat->add_item(Num(0));
+    repeat->add_item(std::make_unique<ast::InputNode>());
+
+    // a = repeat(0, ?); for (i = 0; i < 4; i = i + 1) a[i] = i * i;
+    // b = a; b[0] = 5; print a[0]; print b[0]; print a[?];
+    auto root = Block();
+    root->add_statement(Stmt(Assign("a", std::move(repeat))));
+    auto body = Block();
+    body->add_statement(Stmt(std::make_unique<ast::AssignNode>(
+        std::make_unique<ast::IndexNode>(Var("a"), Var("i")),
+        Arith(ast::bin_arith_op_type::mul, Var("i"), Var("i")))));
+    root->add_statement(std::make_unique<ast::ForNode>(
+        Assign("i", Num(0)),
+        Logic(ast::bin_logic_op_type::less, Var("i"), Num(4)),
+        Assign("i", Arith(ast::bin_arith_op_type::add, Var("i"), Num(1))),
+        std::move(body)));
+    root->add_statement(Stmt(Assign("b", Var("a"))));
+    root->add_statement(Stmt(std::make_unique<ast::AssignNode>(
+        std::make_unique<ast::IndexNode>(Var("b"), Num(0)), Num(5))));
+    root->add_statement(
+        Print(std::make_unique<ast::IndexNode>(Var("a"), Num(0))));
+    root->add_statement(
+        Print(std::make_unique<ast::IndexNode>(Var("b"), Num(0))));
+    root->add_statement(Print(std::make_unique<ast::IndexNode>(
+        Var("a"), std::make_unique<ast::InputNode>())));
+
+    ast::SemanticChecker checker;
+    checker.check(root.get());
+    ASSERT_FALSE(checker.hasErrors());
+
+    const auto result = RunVM(*root, "4 3");
+    EXPECT_EQ(result.out, "0\n5\n9\n");
+    EXPECT_EQ(result.error, "");
+    ExpectSameAsTreeWalker(*root, "4 3");
+    ExpectSameAsTreeWalker(*root, "4 4");
+    ExpectSameAsTreeWalker(*root, "2 0");
+    ExpectSameAsTreeWalker(*root, "-1 0");
+}
+
+TEST(BytecodeVMTest, FunctionsMatchTreeWalker)
+{
+    auto n_is_zero = [] {
+        return Logic(ast::bin_logic_op_type::equal, Var("n"), Num(0));
+    };
+    auto n_minus_one = [] {
+        return Arith(ast::bin_arith_op_type::sub, Var("n"), Num(1));
+    };
+
+    // func sum(n) { if (n == 0) return 0; return n + sum(n - 1); }
+    auto sum_call = std::make_unique<ast::CallNode>("sum");
+    sum_call->add_arg(n_minus_one());
+    auto sum = Block();
+    sum->add_statement(std::make_unique<ast::IfNode>(
+        n_is_zero(), std::make_unique<ast::ReturnNode>(Num(0))));
+    sum->add_statement(std::make_unique<ast::ReturnNode>(
+        Arith(ast::bin_arith_op_type::add, Var("n"), std::move(sum_call))));
+
+    // func down(n) { if (n == 0) return 7; return down(n - 1); }
+    auto down_call = std::make_unique<ast::CallNode>("down");
+    down_call->add_arg(n_minus_one());
+    auto down = Block();
+    down->add_statement(std::make_unique<ast::IfNode>(
+        n_is_zero(), std::make_unique<ast::ReturnNode>(Num(7))));
+    down->add_statement(
+        std::make_unique<ast::ReturnNode>(std::move(down_call)));
+
+    auto root = Block();
+    root->add_statement(std::make_unique<ast::FuncNode>(
+        "sum", std::vector<ast::Name>{ "n" }, std::move(sum)));
+    root->add_statement(std::make_unique<ast::FuncNode>(
+        "down", std::vector<ast::Name>{ "n" }, std::move(down)));
+    for (const char* name : { "sum", "down" }) {
+        auto call = std::make_unique<ast::CallNode>(name);
+        call->add_arg(std::make_unique<ast::InputNode>());
+        root->add_statement(Print(std::move(call)));
+    }
+
+    ast::SemanticChecker checker;
+    checker.check(root.get());
+    ASSERT_FALSE(checker.hasErrors());
+
+    const auto deep = std::to_string(ast::kMaxCallDepth * 10);
+    const auto result = RunVM(*root, "100 " + deep);
+    EXPECT_EQ(result.out, "5050\n7\n");
+    EXPECT_EQ(result.error, "");
+    ExpectSameAsTreeWalker(*root, "100 " + deep);
+    ExpectSameAsTreeWalker(*root, deep + " 0");
+
+    auto undefined = Block();
+    undefined->add_statement(Print(Num(1)));
+    undefined->add_statement(Print(std::make_unique<ast::CallNode>("sum")));
+    ExpectSameAsTreeWalker(*undefined);
+
+    auto top_level_return = Block();
+    top_level_return->add_statement(
+        std::make_unique<ast::ReturnNode>(Num(1)));
+    ExpectSameAsTreeWalker(*top_level_return);
+}
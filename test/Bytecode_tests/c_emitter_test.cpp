@@ -0,0 +1,367 @@
+#include "AST/AST.hpp"
+#include "Bytecode/BytecodeCompiler.hpp"
+#include "Bytecode/CEmitter.hpp"
+#include "Visitors/Interpreter.hpp"
+#include "Visitors/SemanticChecker.hpp"
+#include "gtest/gtest.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef PARACL_C_COMPILER
+#define PARACL_C_COMPILER "cc"
+#endif
+
+namespace {
+
+using NodePtr = ast::BaseNode::NodePtr;
+
+struct RunResult
+{
+    std::string out;
+    std::string error;
+};
+
+std::string ReadFile(const std::filesystem::path& path)
+{
+    std::ifstream in(path);
+    std::ostringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+RunResult RunTree(ast::BaseNode& root, const std::string& input)
+{
+    RunResult result;
+    std::istringstream in(input);
+    std::ostringstream out;
+    std::streambuf* old_in = std::cin.rdbuf(in.rdbuf());
+    std::streambuf* old_out = std::cout.rdbuf(out.rdbuf());
+    try {
+        ast::Interpreter interpreter;
+        root.accept(interpreter);
+    } catch (const std::runtime_error& ex) {
+        result.error = ex.what();
+    }
+    std::cin.rdbuf(old_in);
+    std::cout.rdbuf(old_out);
+    result.out = out.str();
+    return result;
+}
+
+// Emits `root` as C, builds it with the system C compiler and runs it on
+// `input`. A failed build is reported as the error.
+RunResult RunNative(ast::BaseNode& root, const std::string& input)
+{
+    static int counter = 0;
+    const auto dir = std::filesystem::temp_directory_path() /
+                     ("paracl_c_emitter_" + std::to_string(::getpid()) + "_" +
+                      std::to_string(counter++));
+    std::filesystem::create_directories(dir);
+
+    ast::bytecode::BytecodeCompiler compiler;
+    const auto program = compiler.compile(root);
+    {
+        std::ofstream source(dir / "program.c");
+        ast::bytecode::CEmitter(program).emit(source);
+        std::ofstream(dir / "input") << input;
+    }
+
+    RunResult result;
+    const auto build = std::string(PARACL_C_COMPILER) + " -O1 -o " +
+                       (dir / "program").string() + " " +
+                       (dir / "program.c").string() + " 2> " +
+                       (dir / "build.log").string();
+    if (std::system(build.c_str()) != 0) {
+        result.error = "build failed: " + ReadFile(dir / "build.log");
+    } else {
+        const auto run = (dir / "program").string() + " < " +
+                         (dir / "input").string() + " > " +
+                         (dir / "out").string() + " 2> " +
+                         (dir / "err").string();
+        const int status = std::system(run.c_str());
+        result.out = ReadFile(dir / "out");
+        result.error = ReadFile(dir / "err");
+        if (!result.error.empty() && result.error.back() == '\n') {
+            result.error.pop_back();
+        }
+        EXPECT_EQ(WEXITSTATUS(status), result.error.empty() ? 0 : 1);
+    }
+    std::filesystem::remove_all(dir);
+    return result;
+}
+
+// Checks `root`, runs it as a native program and compares the result with
+// the tree-walker's.
+RunResult ExpectSameAsTreeWalker(ast::BaseNode& root,
+                                 const std::string& input = "")
+{
+    ast::SemanticChecker checker;
+    checker.check(&root);
+    EXPECT_FALSE(checker.hasErrors());
+
+    const auto expected = RunTree(root, input);
+    const auto actual = RunNative(root, input);
+    EXPECT_EQ(actual.out, expected.out);
+    EXPECT_EQ(actual.error, expected.error);
+    return actual;
+}
+
+NodePtr Num(int64_t value)
+{
+    return std::make_unique<ast::ValueNode>(value);
+}
+
+NodePtr Var(const std::string& name)
+{
+    return std::make_unique<ast::VarNode>(name);
+}
+
+NodePtr Input()
+{
+    return std::make_unique<ast::InputNode>();
+}
+
+NodePtr Assign(const std::string& name, NodePtr rhs)
+{
+    return std::make_unique<ast::AssignNode>(Var(name), std::move(rhs));
+}
+
+NodePtr Stmt(NodePtr expr)
+{
+    return std::make_unique<ast::ExprNode>(std::move(expr));
+}
+
+NodePtr Print(NodePtr expr)
+{
+    return std::make_unique<ast::PrintNode>(std::move(expr));
+}
+
+NodePtr Arith(ast::bin_arith_op_type op, NodePtr lhs, NodePtr rhs)
+{
+    return std::make_unique<ast::BinArithOpNode>(
+        op, std::move(lhs), std::move(rhs));
+}
+
+NodePtr Logic(ast::bin_logic_op_type op, NodePtr lhs, NodePtr rhs)
+{
+    return std::make_unique<ast::BinLogicOpNode>(
+        op, std::move(lhs), std::move(rhs));
+}
+
+NodePtr Index(const std::string& name, NodePtr index)
+{
+    return std::make_unique<ast::IndexNode>(Var(name), std::move(index));
+}
+
+NodePtr Call(const std::string& name, std::vector<NodePtr> args)
+{
+    return std::make_unique<ast::CallNode>(name, std::move(args));
+}
+
+NodePtr Increment(const std::string& name)
+{
+    return Stmt(
+        Assign(name, Arith(ast::bin_arith_op_type::add, Var(name), Num(1))));
+}
+
+std::unique_ptr<ast::ScopeNode> Block()
+{
+    return std::make_unique<ast::ScopeNode>();
+}
+
+// while (i < bound) { body; i = i + 1; }
+NodePtr CountTo(NodePtr bound, std::unique_ptr<ast::ScopeNode> body)
+{
+    body->add_statement(Increment("i"));
+    return std::make_unique<ast::WhileNode>(
+        Logic(ast::bin_logic_op_type::less, Var("i"), std::move(bound)),
+        std::move(body));
+}
+
+} // namespace
+
+class CEmitterTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        const auto probe =
+            std::string(PARACL_C_COMPILER) + " --version > /dev/null 2>&1";
+        if (std::system(probe.c_str()) != 0) {
+            GTEST_SKIP() << "no C compiler";
+        }
+    }
+};
+
+TEST_F(CEmitterTest, LoopsInputAndOutputMatchTreeWalker)
+{
+    // n = ?; i = 0; s = 0;
+    // while (i < n) { s = (s * 31 + i ^ 5) % 1000003; if (i % 100 == 0)
+    //                 print s; }
+    // print s;
+    auto body = Block();
+    body->add_statement(Stmt(Assign(
+        "s",
+        Arith(ast::bin_arith_op_type::mod,
+              Logic(ast::bin_logic_op_type::bitwise_xor,
+                    Arith(ast::bin_arith_op_type::add,
+                          Arith(ast::bin_arith_op_type::mul, Var("s"), Num(31)),
+                          Var("i")),
+                    Num(5)),
+              Num(1000003)))));
+    body->add_statement(std::make_unique<ast::IfNode>(
+        Logic(ast::bin_logic_op_type::equal,
+              Arith(ast::bin_arith_op_type::mod, Var("i"), Num(100)),
+              Num(0)),
+        Print(Var("s"))));
+    auto root = Block();
+    root->add_statement(Stmt(Assign("n", Input())));
+    root->add_statement(Stmt(Assign("i", Num(0))));
+    root->add_statement(Stmt(Assign("s", Num(0))));
+    root->add_statement(CountTo(Var("n"), std::move(body)));
+    root->add_statement(Print(Var("s")));
+
+    ExpectSameAsTreeWalker(*root, "100000");
+    ExpectSameAsTreeWalker(*root, "  -3\n");
+    EXPECT_EQ(ExpectSameAsTreeWalker(*root, "x").error,
+              "error: Input error: expected int64_t");
+    // More output than one buffer holds.
+    ExpectSameAsTreeWalker(*root, "1000000");
+}
+
+TEST_F(CEmitterTest, RuntimeErrorsMatchTreeWalker)
+{
+    // a = ?; b = ?; print a + b; print a - b; print a * b; print a / b;
+    // print a % b; print -a;
+    auto root = Block();
+    root->add_statement(Stmt(Assign("a", Input())));
+    root->add_statement(Stmt(Assign("b", Input())));
+    for (const auto op : { ast::bin_arith_op_type::add,
+                           ast::bin_arith_op_type::sub,
+                           ast::bin_arith_op_type::mul,
+                           ast::bin_arith_op_type::div,
+                           ast::bin_arith_op_type::mod }) {
+        root->add_statement(Print(Arith(op, Var("a"), Var("b"))));
+    }
+    root->add_statement(Print(std::make_unique<ast::UnOpNode>(
+        ast::unop_node_type::neg, Var("a"))));
+
+    ExpectSameAsTreeWalker(*root, "17 -5");
+    EXPECT_EQ(ExpectSameAsTreeWalker(*root, "9223372036854775807 1").error,
+              "error: Integer overflow in addition");
+    EXPECT_EQ(ExpectSameAsTreeWalker(*root, "-9223372036854775807 2").error,
+              "error: Integer overflow in subtraction");
+    EXPECT_EQ(ExpectSameAsTreeWalker(*root, "4611686018427387904 -3").error,
+              "error: Integer overflow in multiplication");
+    EXPECT_EQ(ExpectSameAsTreeWalker(*root, "7 0").error,
+              "error: Division by zero");
+    EXPECT_EQ(ExpectSameAsTreeWalker(*root, "9223372036854775808 1").error,
+              "error: Input error: expected int64_t");
+
+    // print ? / -1; print 1 / 0; -- both divisors are constants.
+    auto constant = Block();
+    constant->add_statement(
+        Print(Arith(ast::bin_arith_op_type::div, Input(), Num(-1))));
+    constant->add_statement(
+        Print(Arith(ast::bin_arith_op_type::div, Num(1), Num(0))));
+    EXPECT_EQ(ExpectSameAsTreeWalker(*constant, "5").error,
+              "error: Division by zero");
+    EXPECT_EQ(ExpectSameAsTreeWalker(*constant, "-9223372036854775808").error,
+              "error: Integer overflow in division");
+}
+
+TEST_F(CEmitterTest, ArraysMatchTreeWalker)
+{
+    // a = repeat(1, n); i = 2;
+    // while (i < n) { a[i] = a[i - 1] + a[i - 2]; } b = a; print b[?];
+    auto repeat =
+        std::make_unique<ast::ArrayNode>(ast::array_init_type::repeat);
+    repeat->add_item(Num(1));
+    repeat->add_item(Var("n"));
+    auto body = Block();
+    body->add_statement(Stmt(std::make_unique<ast::AssignNode>(
+        Index("a", Var("i")),
+        Arith(ast::bin_arith_op_type::add,
+              Index("a", Arith(ast::bin_arith_op_type::sub, Var("i"), Num(1))),
+              Index("a",
+                    Arith(ast::bin_arith_op_type::sub, Var("i"), Num(2)))))));
+    auto root = Block();
+    root->add_statement(Stmt(Assign("n", Input())));
+    root->add_statement(Stmt(Assign("a", std::move(repeat))));
+    root->add_statement(Stmt(Assign("i", Num(2))));
+    root->add_statement(CountTo(Var("n"), std::move(body)));
+    root->add_statement(Stmt(Assign("b", Var("a"))));
+    root->add_statement(Print(Index("b", Input())));
+    // c = array(3, ?, 5); print c[1];
+    auto list = std::make_unique<ast::ArrayNode>(ast::array_init_type::list);
+    list->add_item(Num(3));
+    list->add_item(Input());
+    list->add_item(Num(5));
+    root->add_statement(Stmt(Assign("c", std::move(list))));
+    root->add_statement(Print(Index("c", Num(1))));
+
+    ExpectSameAsTreeWalker(*root, "50 49 42");
+    EXPECT_EQ(ExpectSameAsTreeWalker(*root, "10 10").error,
+              "error: Array index 10 is out of range for array of size 10");
+    EXPECT_EQ(ExpectSameAsTreeWalker(*root, "-1").error,
+              "error: Invalid array size: -1");
+}
+
+TEST_F(CEmitterTest, FunctionsMatchTreeWalker)
+{
+    // func fact(n) { if (n < 2) return 1; return n * fact(n - 1); }
+    auto fact_args = std::vector<NodePtr>{};
+    fact_args.push_back(Arith(ast::bin_arith_op_type::sub, Var("n"), Num(1)));
+    auto fact = Block();
+    fact->add_statement(std::make_unique<ast::IfNode>(
+        Logic(ast::bin_logic_op_type::less, Var("n"), Num(2)),
+        std::make_unique<ast::ReturnNode>(Num(1))));
+    fact->add_statement(std::make_unique<ast::ReturnNode>(
+        Arith(ast::bin_arith_op_type::mul,
+              Var("n"),
+              Call("fact", std::move(fact_args)))));
+
+    // func count(n, acc) { if (n == 0) return acc;
+    //                      return count(n - 1, acc + 1); }
+    auto count_args = std::vector<NodePtr>{};
+    count_args.push_back(
+        Arith(ast::bin_arith_op_type::sub, Var("n"), Num(1)));
+    count_args.push_back(
+        Arith(ast::bin_arith_op_type::add, Var("acc"), Num(1)));
+    auto count = Block();
+    count->add_statement(std::make_unique<ast::IfNode>(
+        Logic(ast::bin_logic_op_type::equal, Var("n"), Num(0)),
+        std::make_unique<ast::ReturnNode>(Var("acc"))));
+    count->add_statement(std::make_unique<ast::ReturnNode>(
+        Call("count", std::move(count_args))));
+
+    auto root = Block();
+    root->add_statement(std::make_unique<ast::FuncNode>(
+        "fact", std::vector<ast::Name>{ "n" }, std::move(fact)));
+    root->add_statement(std::make_unique<ast::FuncNode>(
+        "count",
+        std::vector<ast::Name>{ "n", "acc" },
+        std::move(count)));
+    auto fact_call = std::vector<NodePtr>{};
+    fact_call.push_back(Input());
+    root->add_statement(Print(Call("fact", std::move(fact_call))));
+    auto count_call = std::vector<NodePtr>{};
+    count_call.push_back(Input());
+    count_call.push_back(Num(0));
+    root->add_statement(Print(Call("count", std::move(count_call))));
+
+    // Tail calls run in constant depth.
+    ExpectSameAsTreeWalker(*root, "20 100000");
+    EXPECT_EQ(ExpectSameAsTreeWalker(*root, "21 1").error,
+              "error: Integer overflow in multiplication");
+    EXPECT_EQ(ExpectSameAsTreeWalker(*root, "5000 1").error,
+              "error: Call stack overflow");
+}
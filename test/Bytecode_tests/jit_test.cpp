@@ -0,0 +1,345 @@
+#include "AST/AST.hpp"
+#include "Bytecode/BytecodeCompiler.hpp"
+#include "Bytecode/Jit.hpp"
+#include "Bytecode/VM.hpp"
+#include "Visitors/Interpreter.hpp"
+#include "Visitors/SemanticChecker.hpp"
+#include "gtest/gtest.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using NodePtr = ast::BaseNode::NodePtr;
+
+struct RunResult
+{
+    std::string out;
+    std::string error;
+    std::size_t compiled_loops = 0;
+};
+
+template <typename Fn>
+RunResult Capture(const std::string& input, Fn&& fn)
+{
+    RunResult result;
+    std::istringstream in(input);
+    std::ostringstream out;
+    std::streambuf* old_in = std::cin.rdbuf(in.rdbuf());
+    std::streambuf* old_out = std::cout.rdbuf(out.rdbuf());
+    try {
+        fn(result);
+    } catch (const std::runtime_error& ex) {
+        result.error = ex.what();
+    }
+    std::cin.rdbuf(old_in);
+    std::cout.rdbuf(old_out);
+    result.out = out.str();
+    return result;
+}
+
+RunResult RunTree(ast::BaseNode& root, const std::string& input)
+{
+    return Capture(input, [&](RunResult&) {
+        ast::Interpreter interpreter;
+        root.accept(interpreter);
+    });
+}
+
+RunResult RunJit(ast::BaseNode& root, const std::string& input)
+{
+    ast::bytecode::BytecodeCompiler compiler;
+    const auto program = compiler.compile(root);
+    ast::bytecode::VM vm(program);
+    vm.enable_jit();
+    return Capture(input, [&](RunResult& result) {
+        try {
+            vm.run();
+        } catch (...) {
+            result.compiled_loops = vm.jit_compiled_loops();
+            throw;
+        }
+        result.compiled_loops = vm.jit_compiled_loops();
+    });
+}
+
+// Checks `root`, runs it on the VM with the JIT and compares the result
+// with the tree-walker's.
+RunResult ExpectSameAsTreeWalker(ast::BaseNode& root,
+                                 const std::string& input = "")
+{
+    ast::SemanticChecker checker;
+    checker.check(&root);
+    EXPECT_FALSE(checker.hasErrors());
+
+    const auto expected = RunTree(root, input);
+    const auto actual = RunJit(root, input);
+    EXPECT_EQ(actual.out, expected.out);
+    EXPECT_EQ(actual.error, expected.error);
+    return actual;
+}
+
+NodePtr Num(int64_t value)
+{
+    return std::make_unique<ast::ValueNode>(value);
+}
+
+NodePtr Var(const std::string& name)
+{
+    return std::make_unique<ast::VarNode>(name);
+}
+
+NodePtr Assign(const std::string& name, NodePtr rhs)
+{
+    return std::make_unique<ast::AssignNode>(Var(name), std::move(rhs));
+}
+
+NodePtr Stmt(NodePtr expr)
+{
+    return std::make_unique<ast::ExprNode>(std::move(expr));
+}
+
+NodePtr Print(NodePtr expr)
+{
+    return std::make_unique<ast::PrintNode>(std::move(expr));
+}
+
+NodePtr Arith(ast::bin_arith_op_type op, NodePtr lhs, NodePtr rhs)
+{
+    return std::make_unique<ast::BinArithOpNode>(
+        op, std::move(lhs), std::move(rhs));
+}
+
+NodePtr Logic(ast::bin_logic_op_type op, NodePtr lhs, NodePtr rhs)
+{
+    return std::make_unique<ast::BinLogicOpNode>(
+        op, std::move(lhs), std::move(rhs));
+}
+
+NodePtr Unary(ast::unop_node_type op, NodePtr operand)
+{
+    return std::make_unique<ast::UnOpNode>(op, std::move(operand));
+}
+
+NodePtr Increment(const std::string& name, int64_t step = 1)
+{
+    return Stmt(
+        Assign(name, Arith(ast::bin_arith_op_type::add, Var(name), Num(step))));
+}
+
+std::unique_ptr<ast::ScopeNode> Block()
+{
+    return std::make_unique<ast::ScopeNode>();
+}
+
+// while (i < bound) { body; i = i + 1; }
+NodePtr CountTo(NodePtr bound, std::unique_ptr<ast::ScopeNode> body)
+{
+    body->add_statement(Increment("i"));
+    return std::make_unique<ast::WhileNode>(
+        Logic(ast::bin_logic_op_type::less, Var("i"), std::move(bound)),
+        std::move(body));
+}
+
+} // namespace
+
+class JitTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        if (!ast::bytecode::Jit::supported()) {
+            GTEST_SKIP() << "no JIT for this target";
+        }
+    }
+};
+
+TEST_F(JitTest, NestedArithmeticLoopsRunNatively)
+{
+    // s = 0; i = 0; n = ?;
+    // while (i < n) {
+    //     j = 0;
+    //     while (j < i) {
+    //         s = (s + i * j - j / 3 + -i % 7) % 1000003; j = j + 1;
+    //     }
+    //     i = i + 1;
+    // }
+    // print s;
+    auto term = Arith(
+        ast::bin_arith_op_type::add,
+        Arith(ast::bin_arith_op_type::sub,
+              Arith(ast::bin_arith_op_type::add,
+                    Var("s"),
+                    Arith(ast::bin_arith_op_type::mul, Var("i"), Var("j"))),
+              Arith(ast::bin_arith_op_type::div, Var("j"), Num(3))),
+        Arith(ast::bin_arith_op_type::mod,
+              Unary(ast::unop_node_type::neg, Var("i")),
+              Num(7)));
+    auto inner = Block();
+    inner->add_statement(Stmt(Assign(
+        "s",
+        Arith(ast::bin_arith_op_type::mod, std::move(term), Num(1000003)))));
+    inner->add_statement(Increment("j"));
+    auto outer = Block();
+    outer->add_statement(Stmt(Assign("j", Num(0))));
+    outer->add_statement(std::make_unique<ast::WhileNode>(
+        Logic(ast::bin_logic_op_type::less, Var("j"), Var("i")),
+        std::move(inner)));
+
+    auto root = Block();
+    root->add_statement(Stmt(Assign("s", Num(0))));
+    root->add_statement(Stmt(Assign("i", Num(0))));
+    root->add_statement(
+        Stmt(Assign("n", std::make_unique<ast::InputNode>())));
+    root->add_statement(CountTo(Var("n"), std::move(outer)));
+    root->add_statement(Print(Var("s")));
+
+    EXPECT_GE(ExpectSameAsTreeWalker(*root, "300").compiled_loops, 1u);
+    // Too few iterations to get hot.
+    EXPECT_EQ(ExpectSameAsTreeWalker(*root, "5").compiled_loops, 0u);
+}
+
+TEST_F(JitTest, ComparisonsAndLogicMatchTreeWalker)
+{
+    // while (i < 200) { c = c + (i > 50 && i <= 150) + !(i == 7) +
+    //                          (i != 3 || i >= 100) + (i % 2 ^ 1); ... }
+    auto sum = Arith(
+        ast::bin_arith_op_type::add,
+        Arith(ast::bin_arith_op_type::add,
+              Logic(ast::bin_logic_op_type::logical_and,
+                    Logic(ast::bin_logic_op_type::greater, Var("i"), Num(50)),
+                    Logic(ast::bin_logic_op_type::less_equal,
+                          Var("i"),
+                          Num(150))),
+              Unary(ast::unop_node_type::logical_not,
+                    Logic(ast::bin_logic_op_type::equal, Var("i"), Num(7)))),
+        Arith(ast::bin_arith_op_type::add,
+              Logic(ast::bin_logic_op_type::logical_or,
+                    Logic(ast::bin_logic_op_type::not_equal, Var("i"), Num(3)),
+                    Logic(ast::bin_logic_op_type::greater_equal,
+                          Var("i"),
+                          Num(100))),
+              Logic(ast::bin_logic_op_type::bitwise_xor,
+                    Arith(ast::bin_arith_op_type::mod, Var("i"), Num(2)),
+                    Num(1))));
+    auto body = Block();
+    body->add_statement(Stmt(Assign(
+        "c", Arith(ast::bin_arith_op_type::add, Var("c"), std::move(sum)))));
+
+    auto root = Block();
+    root->add_statement(Stmt(Assign("c", Num(0))));
+    root->add_statement(Stmt(Assign("i", Num(0))));
+    root->add_statement(CountTo(Num(200), std::move(body)));
+    root->add_statement(Print(Var("c")));
+
+    EXPECT_EQ(ExpectSameAsTreeWalker(*root).compiled_loops, 1u);
+}
+
+TEST_F(JitTest, OverflowDeoptimizesToTheVM)
+{
+    // s = 0; while (1) { s = s + 10^16; } -- overflows on iteration 923
+    auto body = Block();
+    body->add_statement(Increment("s", 10000000000000000));
+    auto root = Block();
+    root->add_statement(Stmt(Assign("s", Num(0))));
+    root->add_statement(
+        std::make_unique<ast::WhileNode>(Num(1), std::move(body)));
+
+    const auto result = ExpectSameAsTreeWalker(*root);
+    EXPECT_EQ(result.error, "error: Integer overflow in addition");
+    EXPECT_EQ(result.compiled_loops, 1u);
+
+    // Same for the checks of multiplication, negation and division.
+    for (const auto op : { ast::bin_arith_op_type::mul,
+                           ast::bin_arith_op_type::div,
+                           ast::bin_arith_op_type::mod }) {
+        // i = 100; x = 0;
+        // while (i > -5) { x = 1000 op i; x = -x; i = i - 1; }
+        auto loop_body = Block();
+        loop_body->add_statement(
+            Stmt(Assign("x", Arith(op, Num(1000), Var("i")))));
+        loop_body->add_statement(
+            Stmt(Assign("x", Unary(ast::unop_node_type::neg, Var("x")))));
+        loop_body->add_statement(Increment("i", -1));
+        auto program = Block();
+        program->add_statement(Stmt(Assign("i", Num(100))));
+        program->add_statement(Stmt(Assign("x", Num(0))));
+        program->add_statement(std::make_unique<ast::WhileNode>(
+            Logic(ast::bin_logic_op_type::greater, Var("i"), Num(-5)),
+            std::move(loop_body)));
+        program->add_statement(Print(Var("x")));
+
+        const auto run = ExpectSameAsTreeWalker(*program);
+        EXPECT_EQ(run.compiled_loops, 1u);
+        if (op != ast::bin_arith_op_type::mul) {
+            EXPECT_EQ(run.error, "error: Division by zero");
+        }
+    }
+}
+
+TEST_F(JitTest, InputAndPrintRunInTheVM)
+{
+    // i = 0; while (i < 100) { print i * ?; i = i + 1; }
+    auto body = Block();
+    body->add_statement(Print(Arith(ast::bin_arith_op_type::mul,
+                                    Var("i"),
+                                    std::make_unique<ast::InputNode>())));
+    auto root = Block();
+    root->add_statement(Stmt(Assign("i", Num(0))));
+    root->add_statement(CountTo(Num(100), std::move(body)));
+
+    std::string input;
+    for (int i = 0; i < 100; ++i) {
+        input += std::to_string(i % 5 - 2) + " ";
+    }
+    EXPECT_EQ(ExpectSameAsTreeWalker(*root, input).compiled_loops, 1u);
+    // Running out of input inside native code still reports the error.
+    EXPECT_NE(ExpectSameAsTreeWalker(*root, "1 2 3").error, "");
+}
+
+TEST_F(JitTest, LoopsWithArraysOrCallsStayInTheVM)
+{
+    // a = repeat(0, 100); while (i < 100) { a[i] = i; }
+    auto repeat =
+        std::make_unique<ast::ArrayNode>(ast::array_init_type::repeat);
+    repeat->add_item(Num(0));
+    repeat->add_item(Num(100));
+    auto array_body = Block();
+    array_body->add_statement(Stmt(std::make_unique<ast::AssignNode>(
+        std::make_unique<ast::IndexNode>(Var("a"), Var("i")), Var("i"))));
+    auto arrays = Block();
+    arrays->add_statement(Stmt(Assign("a", std::move(repeat))));
+    arrays->add_statement(Stmt(Assign("i", Num(0))));
+    arrays->add_statement(CountTo(Num(100), std::move(array_body)));
+    arrays->add_statement(
+        Print(std::make_unique<ast::IndexNode>(Var("a"), Num(99))));
+    EXPECT_EQ(ExpectSameAsTreeWalker(*arrays).compiled_loops, 0u);
+
+    // func sq(x) { i = 0; s = 0; while (i < x) { s = s + x; i = i + 1; }
+    //              return s; }
+    // while (i < 100) { t = t + sq(i); }
+    auto sq_body = Block();
+    sq_body->add_statement(Stmt(Assign("i", Num(0))));
+    sq_body->add_statement(Stmt(Assign("s", Num(0))));
+    auto sq_loop = Block();
+    sq_loop->add_statement(Stmt(
+        Assign("s", Arith(ast::bin_arith_op_type::add, Var("s"), Var("x")))));
+    sq_body->add_statement(CountTo(Var("x"), std::move(sq_loop)));
+    sq_body->add_statement(std::make_unique<ast::ReturnNode>(Var("s")));
+    auto call = std::make_unique<ast::CallNode>("sq");
+    call->add_arg(Var("i"));
+    auto calls_body = Block();
+    calls_body->add_statement(Stmt(Assign(
+        "t", Arith(ast::bin_arith_op_type::add, Var("t"), std::move(call)))));
+    auto calls = Block();
+    calls->add_statement(std::make_unique<ast::FuncNode>(
+        "sq", std::vector<ast::Name>{ "x" }, std::move(sq_body)));
+    calls->add_statement(Stmt(Assign("t", Num(0))));
+    calls->add_statement(Stmt(Assign("i", Num(0))));
+    calls->add_statement(CountTo(Num(100), std::move(calls_body)));
+    calls->add_statement(Print(Var("t")));
+    // Only the loop inside sq is compiled; it runs in every callee frame.
+    EXPECT_EQ(ExpectSameAsTreeWalker(*calls).compiled_loops, 1u);
+}
@@ -1,14 +1,19 @@
+#include "driver/buffer_lexer.hpp"
+#include "driver/driver.hpp"
+#include "driver/scanner.hpp"
 #include "grammar.tab.hh"
 
-#include <FlexLexer.h>
 #include <gtest/gtest.h>
 #include <memory>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
 
 TEST(LexerTest, BasicTokens)
 {
     std::stringstream input("x = 5;");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
 
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::VAR);
     EXPECT_STREQ(lexer.YYText(), "x");
@@ -22,7 +27,7 @@ TEST(LexerTest, BasicTokens)
 TEST(LexerTest, ArithmeticOperators)
 {
     std::stringstream input("a + b - c * d / e % f;");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
 
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::VAR);
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::PLUS);
@@ -42,7 +47,7 @@ TEST(LexerTest, ArithmeticOperators)
 TEST(LexerTest, ComparisonOperators)
 {
     std::stringstream input("x < y > z <= w >= v == u != t;");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
 
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::VAR);
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::LESS);
@@ -64,7 +69,7 @@ TEST(LexerTest, ComparisonOperators)
 TEST(LexerTest, LogicalOperators)
 {
     std::stringstream input("a && b || c ! d ^ e;");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
 
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::VAR);
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::AND);
@@ -82,7 +87,7 @@ TEST(LexerTest, LogicalOperators)
 TEST(LexerTest, BracketsAndDelimiters)
 {
     std::stringstream input("( ) { } , ?");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
 
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::LEFT_PAREN);
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::RIGHT_PAREN);
@@ -96,7 +101,7 @@ TEST(LexerTest, BracketsAndDelimiters)
 TEST(LexerTest, Keywords)
 {
     std::stringstream input("if else while for print");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
 
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::IF);
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::ELSE);
@@ -109,7 +114,7 @@ TEST(LexerTest, Keywords)
 TEST(LexerTest, VariablesAndNumbers)
 {
     std::stringstream input("var123 _var 123 0");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
 
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::VAR);
     EXPECT_STREQ(lexer.YYText(), "var123");
@@ -125,7 +130,7 @@ TEST(LexerTest, VariablesAndNumbers)
 TEST(LexerTest, CommentsAndWhitespace)
 {
     std::stringstream input("// comment\n x\t=  42;");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
 
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::VAR);
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::ASSIGNMENT);
@@ -137,7 +142,7 @@ TEST(LexerTest, CommentsAndWhitespace)
 TEST(LexerTest, InvalidCharacters)
 {
     std::stringstream input("@invalid$");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
 
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::ERR); // @
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::VAR); // invalid
@@ -148,7 +153,7 @@ TEST(LexerTest, InvalidCharacters)
 TEST(LexerTest, MultiLineInput)
 {
     std::stringstream input("x = 1;\ny = 2;");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
 
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::VAR);
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::ASSIGNMENT);
@@ -164,7 +169,7 @@ TEST(LexerTest, MultiLineInput)
 TEST(LexerTest, EdgeCases)
 {
     std::stringstream input("long_var_123 999999 //end\n?");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
 
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::VAR);
     EXPECT_EQ(lexer.yylex(), yy::parser::token_type::NUMBER);
@@ -172,6 +177,189 @@ TEST(LexerTest, EdgeCases)
     EXPECT_EQ(lexer.yylex(), 0);
 }
 
+TEST(LexerTest, ArrayTokens)
+{
+    std::stringstream input("a = repeat(0, 3); a[1] = array(4);");
+    yy::Scanner lexer(&input);
+
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::VAR);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::ASSIGNMENT);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::REPEAT);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::LEFT_PAREN);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::NUMBER);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::COMMA);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::NUMBER);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::RIGHT_PAREN);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::SEMICOLON);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::VAR);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::LEFT_SQUARE_BRACKET);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::NUMBER);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::RIGHT_SQUARE_BRACKET);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::ASSIGNMENT);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::ARRAY);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::LEFT_PAREN);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::NUMBER);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::RIGHT_PAREN);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::SEMICOLON);
+    EXPECT_EQ(lexer.yylex(), 0);
+}
+
+TEST(LexerTest, FunctionTokens)
+{
+    std::stringstream input("func f(a, b) { return f(b); }");
+    yy::Scanner lexer(&input);
+
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::FUNC);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::VAR);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::LEFT_PAREN);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::VAR);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::COMMA);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::VAR);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::RIGHT_PAREN);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::LEFT_CURLY_BRACKET);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::RETURN);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::VAR);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::LEFT_PAREN);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::VAR);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::RIGHT_PAREN);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::SEMICOLON);
+    EXPECT_EQ(lexer.yylex(), yy::parser::token_type::RIGHT_CURLY_BRACKET);
+    EXPECT_EQ(lexer.yylex(), 0);
+}
+
+namespace {
+
+struct Scanned
+{
+    int type;
+    std::string text;
+
+    bool operator==(const Scanned&) const = default;
+};
+
+std::vector<Scanned> ScanWithFlex(const std::string& source)
+{
+    std::stringstream input(source);
+    yy::Scanner lexer(&input);
+    std::vector<Scanned> tokens;
+    while (const int type = lexer.yylex()) {
+        tokens.push_back({ type, lexer.YYText() });
+    }
+    return tokens;
+}
+
+std::vector<Scanned> ScanWithBuffer(std::string_view source)
+{
+    yy::BufferLexer lexer(source);
+    yy::location loc;
+    std::vector<Scanned> tokens;
+    while (const int type = lexer.next(loc)) {
+        tokens.push_back({ type, std::string(lexer.text()) });
+    }
+    return tokens;
+}
+
+// Token spans as the parser sees them, through the driver.
+std::vector<yy::location> Locations(yy::NumDriver& driver)
+{
+    std::vector<yy::location> spans;
+    yy::parser::semantic_type value;
+    yy::location loc;
+    for (auto type = driver.yylex(&value, &loc); type != 0;
+         type = driver.yylex(&value, &loc)) {
+        spans.push_back(loc);
+        if (type == yy::parser::token_type::VAR) {
+            value.destroy<ast::Name>();
+        } else if (type == yy::parser::token_type::NUMBER) {
+            value.destroy<std::int64_t>();
+        }
+    }
+    return spans;
+}
+
+// "file:line.column-column", as Bison prints a location.
+std::string Spelled(const yy::location& loc)
+{
+    std::ostringstream out;
+    out << loc;
+    return out.str();
+}
+
+} // namespace
+
+TEST(BufferLexerTest, MatchesFlexScanner)
+{
+    const std::vector<std::string> inputs = {
+        "x = 5;",
+        "a + b - c * d / e % f;",
+        "x < y > z <= w >= v == u != t;",
+        "a && b || c ! d ^ e;",
+        "( ) { } [ ] , ?",
+        "if else while for print repeat array func return",
+        "var123 _var 123 0 007",
+        "// comment\n x\t=  42;",
+        "@invalid$",
+        "x = 1;\ny = 2;",
+        "long_var_123 999999 //end\n?",
+        "iff if1 _if ifelse returns",
+        "12ab a12 1_2",
+        "a&b|c &&& ||| === !== <== >==",
+        "x=/ /y// z\n\n\n/",
+        " \t\r\f\v\n \r\n",
+        "\xff\x80~`'\"\\.#:",
+        "",
+        "// only a comment",
+    };
+
+    for (const auto& input : inputs) {
+        EXPECT_EQ(ScanWithBuffer(input), ScanWithFlex(input)) << input;
+    }
+}
+
+TEST(BufferLexerTest, TextPointsIntoTheBuffer)
+{
+    const std::string_view source = "  counter = 12345;";
+    yy::BufferLexer lexer(source);
+    yy::location loc;
+
+    EXPECT_EQ(lexer.next(loc), yy::parser::token_type::VAR);
+    EXPECT_EQ(lexer.text(), "counter");
+    EXPECT_EQ(lexer.text().data(), source.data() + 2);
+    EXPECT_EQ(lexer.next(loc), yy::parser::token_type::ASSIGNMENT);
+    EXPECT_EQ(lexer.next(loc), yy::parser::token_type::NUMBER);
+    EXPECT_EQ(lexer.text().data(), source.data() + 12);
+    EXPECT_EQ(lexer.next(loc), yy::parser::token_type::SEMICOLON);
+    EXPECT_EQ(lexer.next(loc), 0);
+    EXPECT_EQ(lexer.next(loc), 0);
+}
+
+TEST(BufferLexerTest, TracksLocationsLikeFlexScanner)
+{
+    const std::string source =
+        "x = 1; // one\n\n  \ty >= 42\n\t// tail\n  @ z";
+    std::stringstream input(source);
+    yy::Scanner flex(&input);
+    yy::NumDriver flex_driver(&flex, "loc.pcl");
+    yy::NumDriver buffer_driver(std::string_view(source), "loc.pcl");
+
+    const auto flex_spans = Locations(flex_driver);
+    const auto buffer_spans = Locations(buffer_driver);
+    ASSERT_EQ(buffer_spans.size(), 9u);
+    ASSERT_EQ(buffer_spans.size(), flex_spans.size());
+    for (std::size_t i = 0; i < buffer_spans.size(); ++i) {
+        EXPECT_EQ(Spelled(buffer_spans[i]), Spelled(flex_spans[i]))
+            << "token " << i;
+    }
+
+    // "42" on line 3, after two spaces and a tab.
+    EXPECT_EQ(buffer_spans[6].begin.line, 3);
+    EXPECT_EQ(buffer_spans[6].begin.column, 9);
+    EXPECT_EQ(buffer_spans[6].end.column, 11);
+    // "@" on line 5.
+    EXPECT_EQ(buffer_spans[7].begin.line, 5);
+    EXPECT_EQ(buffer_spans[7].begin.column, 3);
+}
+
 int main(int argc, char** argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
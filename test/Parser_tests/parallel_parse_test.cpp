@@ -0,0 +1,194 @@
+#include "driver/driver.hpp"
+#include "driver/scanner.hpp"
+#include "driver/source_file.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+constexpr std::size_t kFiles = 256;
+constexpr std::size_t kThreads = 8;
+
+struct SourceOnDisk
+{
+    std::string path;
+    // Where the syntax error at the end of the file is reported, or empty
+    // for a valid program.
+    std::string error_at;
+};
+
+enum class scanner_kind
+{
+    flex,
+    buffer,
+};
+
+// Syntax errors and the location of every top-level statement; equal
+// summaries mean the parses saw the same token locations.
+std::string Summarize(yy::NumDriver& driver, const std::ostringstream& errors)
+{
+    std::string summary = errors.str();
+    const auto* root =
+        static_cast<const ast::ScopeNode*>(driver.get_ast().root());
+    if (root != nullptr) {
+        for (const auto& stmt : root->statements()) {
+            summary += stmt->location().make_string() + "\n";
+        }
+    }
+    return summary;
+}
+
+std::string Parse(const std::string& path, scanner_kind kind)
+{
+    std::ostringstream errors;
+    if (kind == scanner_kind::flex) {
+        std::ifstream input(path, std::ios::binary);
+        yy::Scanner scanner(&input);
+        yy::NumDriver driver(&scanner, path);
+        driver.set_error_stream(errors);
+        driver.parse();
+        return Summarize(driver, errors);
+    }
+
+    const auto source = yy::SourceFile::open(path);
+    if (!source) {
+        return "cannot open " + path;
+    }
+    yy::NumDriver driver(source->text(), path);
+    driver.set_error_stream(errors);
+    driver.parse();
+    return Summarize(driver, errors);
+}
+
+class ParallelParseTest : public ::testing::Test
+{
+protected:
+    std::filesystem::path dir_;
+    std::vector<SourceOnDisk> files_;
+
+    void SetUp() override
+    {
+        dir_ = std::filesystem::temp_directory_path() /
+               ("paracl_parallel_parse_" + std::to_string(::getpid()));
+        std::filesystem::create_directories(dir_);
+
+        // Every file lays its statements out differently, so a token
+        // location taken from another parse is wrong in this one.
+        for (std::size_t i = 0; i < kFiles; ++i) {
+            const auto blank = std::string(i % 5, '\n');
+            const auto indent = std::string(i % 7, ' ');
+            std::string text = blank + "v" + std::to_string(i) + " = " +
+                               std::to_string(i) + "; // first\n";
+            for (std::size_t k = 0; k < i % 11; ++k) {
+                text += indent + "print v" + std::to_string(i) + " + " +
+                        std::to_string(k) + ";\n" + blank;
+            }
+            text += indent + "while (v" + std::to_string(i) +
+                    " > 0)\n\t// countdown\n" + indent + "  v" +
+                    std::to_string(i) + " = v" + std::to_string(i) +
+                    " - 1;\n";
+
+            SourceOnDisk file;
+            const auto name = "prog" + std::to_string(i) + ".pcl";
+            file.path = (dir_ / name).string();
+            if (i % 2 == 1) {
+                const auto line =
+                    std::count(text.begin(), text.end(), '\n') + 1;
+                text += indent + "x = ;\n";
+                file.error_at = file.path + ":" + std::to_string(line) +
+                                ":" + std::to_string(indent.size() + 5);
+            }
+            std::ofstream(file.path, std::ios::binary) << text;
+            files_.push_back(std::move(file));
+        }
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(dir_);
+    }
+};
+
+} // namespace
+
+TEST_F(ParallelParseTest, MatchesSequentialParses)
+{
+    for (const auto kind : { scanner_kind::flex, scanner_kind::buffer }) {
+        std::vector<std::string> expected;
+        for (const auto& file : files_) {
+            expected.push_back(Parse(file.path, kind));
+            if (file.error_at.empty()) {
+                EXPECT_EQ(expected.back().find("error"), std::string::npos)
+                    << expected.back();
+            } else {
+                EXPECT_EQ(expected.back().rfind(file.error_at + ": error:", 0),
+                          0u)
+                    << expected.back();
+            }
+        }
+
+        // Each thread walks all files from a different starting point, so
+        // every file is parsed by several threads at once.
+        std::vector<std::vector<std::string>> seen(
+            kThreads, std::vector<std::string>(kFiles));
+        std::atomic<bool> go = false;
+        std::vector<std::thread> threads;
+        for (std::size_t t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&, t] {
+                while (!go.load()) {
+                    std::this_thread::yield();
+                }
+                for (std::size_t k = 0; k < kFiles; ++k) {
+                    const auto i = (k + t * kFiles / kThreads) % kFiles;
+                    seen[t][i] = Parse(files_[i].path, kind);
+                }
+            });
+        }
+        go = true;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        for (std::size_t t = 0; t < kThreads; ++t) {
+            for (std::size_t i = 0; i < kFiles; ++i) {
+                EXPECT_EQ(seen[t][i], expected[i])
+                    << "thread " << t << ", " << files_[i].path;
+            }
+        }
+    }
+}
+
+TEST(ScannerTest, KeepsItsOwnLocation)
+{
+    // Two scanners interleaved token by token on one thread: neither may
+    // see the whitespace the other skipped.
+    std::stringstream first_input("a\n\n   b");
+    std::stringstream second_input("     c d");
+    yy::Scanner first(&first_input);
+    yy::Scanner second(&second_input);
+    yy::location first_loc;
+    yy::location second_loc;
+
+    EXPECT_EQ(first.next(first_loc), yy::parser::token_type::VAR);
+    EXPECT_EQ(second.next(second_loc), yy::parser::token_type::VAR);
+    EXPECT_EQ(first.next(first_loc), yy::parser::token_type::VAR);
+    EXPECT_EQ(second.next(second_loc), yy::parser::token_type::VAR);
+
+    EXPECT_EQ(first_loc.begin.line, 3);
+    EXPECT_EQ(first_loc.begin.column, 4);
+    EXPECT_EQ(second_loc.begin.line, 1);
+    EXPECT_EQ(second_loc.begin.column, 8);
+    EXPECT_EQ(second_loc.end.column, 9);
+}
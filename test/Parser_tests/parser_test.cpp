@@ -4,6 +4,9 @@
 #include <functional>
 #include <gtest/gtest.h>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace {
 
@@ -26,7 +29,7 @@ std::string CaptureCerr(const std::function<void()>& fn)
 TEST(ParserTest, SimpleAssignment)
 {
     std::stringstream input("x = 5;");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
     yy::NumDriver driver(&lexer);
 
     EXPECT_TRUE(driver.parse());
@@ -54,7 +57,7 @@ TEST(ParserTest, SimpleAssignment)
 TEST(ParserTest, IfStatement)
 {
     std::stringstream input("if (x > 0) { y = 1; } else y = 0;");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
     yy::NumDriver driver(&lexer);
 
     EXPECT_TRUE(driver.parse());
@@ -92,7 +95,7 @@ TEST(ParserTest, IfStatement)
 TEST(ParserTest, WhileLoop)
 {
     std::stringstream input("while (x < 10) { x = x + 1; }");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
     yy::NumDriver driver(&lexer);
 
     EXPECT_TRUE(driver.parse());
@@ -112,7 +115,7 @@ TEST(ParserTest, WhileLoop)
 TEST(ParserTest, ForLoopFull)
 {
     std::stringstream input("for (x = 0; x < 10; x = x + 1) { print x; }");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
     yy::NumDriver driver(&lexer);
 
     EXPECT_TRUE(driver.parse());
@@ -154,7 +157,7 @@ TEST(ParserTest, ForLoopFull)
 TEST(ParserTest, ForLoopNoInitNoStep)
 {
     std::stringstream input("for (; x < 3; ) x = x + 1;");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
     yy::NumDriver driver(&lexer);
 
     EXPECT_TRUE(driver.parse());
@@ -190,7 +193,7 @@ TEST(ParserTest, ForLoopNoInitNoStep)
 TEST(ParserTest, ForLoopEmptyConditionError)
 {
     std::stringstream input("for (x = 0; ; x = x + 1) { }");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
     yy::NumDriver driver(&lexer);
 
     EXPECT_TRUE(driver.parse());
@@ -214,7 +217,7 @@ TEST(ParserTest, ForLoopEmptyConditionError)
 TEST(ParserTest, ForLoopInvalidHeader)
 {
     std::stringstream input("for (x = 0 x < 10 x = x + 1) { }");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
     yy::NumDriver driver(&lexer);
 
     EXPECT_TRUE(driver.parse());
@@ -242,7 +245,7 @@ TEST(ParserTest, ForLoopInvalidHeader)
 TEST(ParserTest, PrintStatement)
 {
     std::stringstream input("print x;");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
     yy::NumDriver driver(&lexer);
 
     EXPECT_TRUE(driver.parse());
@@ -260,7 +263,7 @@ TEST(ParserTest, PrintStatement)
 TEST(ParserTest, InvalidSyntaxMissingSemicolon)
 {
     std::stringstream input("x = 5");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
     yy::NumDriver driver(&lexer);
 
     EXPECT_TRUE(driver.parse());
@@ -270,7 +273,7 @@ TEST(ParserTest, InvalidSyntaxMissingSemicolon)
 TEST(ParserTest, EmptyConditionError)
 {
     std::stringstream input("if () { }");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
     yy::NumDriver driver(&lexer);
 
     EXPECT_TRUE(driver.parse());
@@ -280,7 +283,7 @@ TEST(ParserTest, EmptyConditionError)
 TEST(ParserTest, DriverErrorsUseGnuFormat)
 {
     std::stringstream input;
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
     yy::NumDriver driver(&lexer);
 
     yy::location loc;
@@ -303,7 +306,7 @@ TEST(ParserTest, DriverErrorsUseGnuFormat)
 TEST(ParserTest, EmptyInput)
 {
     std::stringstream input("");
-    yyFlexLexer lexer(&input);
+    yy::Scanner lexer(&input);
     yy::NumDriver driver(&lexer);
 
     EXPECT_TRUE(driver.parse());
@@ -312,6 +315,188 @@ TEST(ParserTest, EmptyInput)
         static_cast<const ast::ScopeNode*>(ast.root())->statements().size(), 0);
 }
 
+TEST(ParserTest, TakeAstMovesTree)
+{
+    std::stringstream input("x = 5; print x;");
+    yy::Scanner lexer(&input);
+    yy::NumDriver driver(&lexer);
+
+    ASSERT_TRUE(driver.parse());
+    const ast::BaseNode* parsed = driver.get_ast().root();
+    ASSERT_NE(parsed, nullptr);
+
+    ast::AST taken = driver.take_ast();
+    EXPECT_EQ(taken.root(), parsed);
+    EXPECT_EQ(driver.get_ast().root(), nullptr);
+    EXPECT_EQ(taken.root()->children().size(), 2u);
+}
+
+TEST(ParserTest, LongStatementListKeepsOrder)
+{
+    constexpr int64_t kCount = 200000;
+    std::string source = "{ a = 1; b = 2; }\n";
+    for (int64_t i = 0; i < kCount; ++i)
+        source += "x = " + std::to_string(i) + ";\n";
+    std::stringstream input(source);
+    yy::Scanner lexer(&input);
+    yy::NumDriver driver(&lexer);
+
+    ASSERT_TRUE(driver.parse());
+    const auto& stmts =
+        static_cast<const ast::ScopeNode*>(driver.get_ast().root())
+            ->statements();
+    ASSERT_EQ(stmts.size(), static_cast<std::size_t>(kCount + 1));
+
+    ASSERT_EQ(stmts[0]->node_type(), ast::base_node_type::scope);
+    const auto& block =
+        static_cast<const ast::ScopeNode*>(stmts[0].get())->statements();
+    ASSERT_EQ(block.size(), 2u);
+    auto assigned = [](const ast::BaseNode* stmt) {
+        auto expr = static_cast<const ast::ExprNode*>(stmt)->expr();
+        return static_cast<const ast::AssignNode*>(expr)->rhs();
+    };
+    EXPECT_EQ(
+        static_cast<const ast::ValueNode*>(assigned(block[1].get()))->value(),
+        2);
+
+    const std::size_t last = stmts.size() - 1;
+    for (std::size_t i : { std::size_t{ 1 }, std::size_t{ 2 }, last }) {
+        ASSERT_EQ(assigned(stmts[i].get())->node_type(),
+                  ast::base_node_type::value);
+        EXPECT_EQ(
+            static_cast<const ast::ValueNode*>(assigned(stmts[i].get()))
+                ->value(),
+            static_cast<int64_t>(i) - 1);
+        EXPECT_EQ(stmts[i]->parent(), driver.get_ast().root());
+    }
+}
+
+TEST(ParserTest, ProgramScopeHasFileLocation)
+{
+    std::stringstream input("\n  x = 1;\nprint x;");
+    yy::Scanner lexer(&input);
+    yy::NumDriver driver(&lexer, "scope.pcl");
+
+    ASSERT_TRUE(driver.parse());
+    const auto& loc = driver.get_ast().root()->location();
+    EXPECT_EQ(loc.file_name(), "scope.pcl");
+    EXPECT_EQ(loc.begin_line, 1u);
+    EXPECT_EQ(loc.end_line, 3u);
+}
+
+TEST(ParserTest, BufferDriverParsesInPlace)
+{
+    const std::string_view source = "\n  x = 1;\nprint x;";
+    yy::NumDriver driver(source, "scope.pcl");
+
+    ASSERT_TRUE(driver.parse());
+    EXPECT_FALSE(driver.has_errors());
+    const auto* root = driver.get_ast().root();
+    EXPECT_EQ(root->location().begin_line, 1u);
+    EXPECT_EQ(root->location().end_line, 3u);
+    const auto& stmts = static_cast<const ast::ScopeNode*>(root)->statements();
+    ASSERT_EQ(stmts.size(), 2u);
+    EXPECT_EQ(stmts[0]->location().begin_line, 2u);
+    EXPECT_EQ(stmts[0]->location().begin_column, 3u);
+    EXPECT_EQ(stmts[1]->node_type(), ast::base_node_type::print);
+}
+
+TEST(ParserTest, OutOfRangeLiteralIsAnError)
+{
+    const std::string source =
+        "x = 9223372036854775807;\ny = 9223372036854775808;";
+
+    std::stringstream input(source);
+    yy::Scanner lexer(&input);
+    yy::NumDriver flex_driver(&lexer, "literal.pcl");
+    yy::NumDriver buffer_driver(std::string_view(source), "literal.pcl");
+
+    for (auto* driver : { &flex_driver, &buffer_driver }) {
+        const std::string output =
+            CaptureCerr([&]() { EXPECT_TRUE(driver->parse()); });
+        EXPECT_EQ(output,
+                  "literal.pcl:2:5: error: Integer literal is out of range\n");
+        EXPECT_TRUE(driver->has_errors());
+    }
+}
+
+TEST(ParserTest, ArrayExpressions)
+{
+    std::stringstream input(
+        "a = repeat(0, n); b = array(1, 2, 3); a[i] = b[2];");
+    yy::Scanner lexer(&input);
+    yy::NumDriver driver(&lexer);
+
+    ASSERT_TRUE(driver.parse());
+    const auto& stmts =
+        static_cast<const ast::ScopeNode*>(driver.get_ast().root())
+            ->statements();
+    ASSERT_EQ(stmts.size(), 3u);
+
+    auto assign_of = [&](std::size_t i) {
+        const auto* expr = static_cast<const ast::ExprNode*>(stmts[i].get());
+        return static_cast<const ast::AssignNode*>(expr->expr());
+    };
+
+    const auto* repeat = assign_of(0)->rhs();
+    ASSERT_EQ(repeat->node_type(), ast::base_node_type::array);
+    const auto* repeat_node = static_cast<const ast::ArrayNode*>(repeat);
+    EXPECT_EQ(repeat_node->init(), ast::array_init_type::repeat);
+    EXPECT_EQ(repeat_node->size_expr()->node_type(),
+              ast::base_node_type::var);
+
+    const auto* list = assign_of(1)->rhs();
+    ASSERT_EQ(list->node_type(), ast::base_node_type::array);
+    EXPECT_EQ(static_cast<const ast::ArrayNode*>(list)->items().size(), 3u);
+
+    const auto* store = assign_of(2);
+    ASSERT_EQ(store->lhs()->node_type(), ast::base_node_type::index);
+    ASSERT_EQ(store->rhs()->node_type(), ast::base_node_type::index);
+    const auto* load = static_cast<const ast::IndexNode*>(store->rhs());
+    EXPECT_EQ(static_cast<const ast::VarNode*>(load->base())->name(), "b");
+    EXPECT_EQ(load->index()->node_type(), ast::base_node_type::value);
+}
+
+TEST(ParserTest, FunctionDefinitionAndCalls)
+{
+    std::stringstream input(
+        "func gcd(a, b) { if (b == 0) return a; return gcd(b, a % b); }\n"
+        "func zero() { return 0; }\n"
+        "print gcd(?, zero());");
+    yy::Scanner lexer(&input);
+    yy::NumDriver driver(&lexer);
+
+    ASSERT_TRUE(driver.parse());
+    const auto& stmts =
+        static_cast<const ast::ScopeNode*>(driver.get_ast().root())
+            ->statements();
+    ASSERT_EQ(stmts.size(), 3u);
+
+    ASSERT_EQ(stmts[0]->node_type(), ast::base_node_type::func);
+    const auto* gcd = static_cast<const ast::FuncNode*>(stmts[0].get());
+    EXPECT_EQ(gcd->name(), "gcd");
+    EXPECT_EQ(gcd->params(), (std::vector<ast::Name>{ "a", "b" }));
+    ASSERT_EQ(gcd->body()->node_type(), ast::base_node_type::scope);
+    const auto& body =
+        static_cast<const ast::ScopeNode*>(gcd->body())->statements();
+    ASSERT_EQ(body.size(), 2u);
+    ASSERT_EQ(body[1]->node_type(), ast::base_node_type::return_node);
+    const auto* ret = static_cast<const ast::ReturnNode*>(body[1].get());
+    ASSERT_EQ(ret->expr()->node_type(), ast::base_node_type::call);
+    EXPECT_EQ(static_cast<const ast::CallNode*>(ret->expr())->args().size(),
+              2u);
+
+    EXPECT_TRUE(
+        static_cast<const ast::FuncNode*>(stmts[1].get())->params().empty());
+
+    const auto* print = static_cast<const ast::PrintNode*>(stmts[2].get());
+    ASSERT_EQ(print->expr()->node_type(), ast::base_node_type::call);
+    const auto* call = static_cast<const ast::CallNode*>(print->expr());
+    EXPECT_EQ(call->name(), "gcd");
+    ASSERT_EQ(call->args().size(), 2u);
+    EXPECT_EQ(call->args()[1]->node_type(), ast::base_node_type::call);
+}
+
 int main(int argc, char** argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,210 @@
+#include "Bytecode/BytecodeCompiler.hpp"
+#include "Bytecode/ProgramImage.hpp"
+#include "Bytecode/VM.hpp"
+#include "Visitors/ClosedFormLoops.hpp"
+#include "Visitors/SemanticChecker.hpp"
+#include "driver/driver.hpp"
+#include "driver/program_cache.hpp"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <unistd.h>
+
+namespace {
+
+constexpr const char* kSource = R"(
+func sum(n) {
+    s = 0;
+    i = 1;
+    while (i <= n) {
+        s = s + i;
+        i = i + 1;
+    }
+    return s;
+}
+a = repeat(3, 4);
+a[1] = sum(10);
+print a[1] + a[0];
+print 7 / (a[2] - 3);
+)";
+
+struct RunResult
+{
+    std::string out;
+    std::string error;
+};
+
+ast::bytecode::Program Compile(const std::string& source,
+                               const std::string& path)
+{
+    yy::NumDriver driver(source, path);
+    if (!driver.parse() || driver.has_errors()) {
+        throw std::runtime_error("parse failed");
+    }
+    auto tree = driver.take_ast();
+    ast::SemanticChecker checker;
+    checker.check(tree.root());
+    if (checker.hasErrors()) {
+        throw std::runtime_error("check failed");
+    }
+    // As at -O1, so the images carry the loop's closed form.
+    ast::ClosedFormLoops loops;
+    loops.reduce(tree.root());
+    ast::bytecode::BytecodeCompiler compiler;
+    return compiler.compile(*tree.root());
+}
+
+RunResult RunVM(const ast::bytecode::Program& program)
+{
+    RunResult result;
+    std::ostringstream out;
+    ast::bytecode::VM vm(program);
+    vm.output().set_stream(out);
+    try {
+        vm.run();
+    } catch (const std::runtime_error& ex) {
+        result.error = ex.what();
+    }
+    vm.output().flush();
+    result.out = out.str();
+    return result;
+}
+
+std::string Image(const ast::bytecode::Program& program)
+{
+    std::ostringstream image;
+    ast::bytecode::write_image(program, image);
+    return image.str();
+}
+
+class ProgramCacheTest : public ::testing::Test
+{
+protected:
+    std::filesystem::path dir_;
+
+    void SetUp() override
+    {
+        const auto* test =
+            ::testing::UnitTest::GetInstance()->current_test_info();
+        dir_ = std::filesystem::temp_directory_path() /
+               ("paracl_program_cache_" + std::to_string(::getpid()) + "_" +
+                test->name());
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(dir_);
+    }
+};
+
+} // namespace
+
+TEST(ProgramImageTest, RoundTripRunsTheSame)
+{
+    const auto program = Compile(kSource, "prog.pcl");
+    ASSERT_EQ(program.closed_forms.size(), 1u);
+    const auto image = Image(program);
+    const auto loaded = ast::bytecode::read_image(
+        image, ast::FileTable::intern("prog.pcl"));
+
+    EXPECT_EQ(Image(loaded), image);
+    EXPECT_EQ(loaded.closed_forms.size(), 1u);
+    const auto expected = RunVM(program);
+    EXPECT_EQ(expected.out, "58\n");
+    EXPECT_NE(expected.error.find("prog.pcl:14:"), std::string::npos)
+        << expected.error;
+    const auto actual = RunVM(loaded);
+    EXPECT_EQ(actual.out, expected.out);
+    EXPECT_EQ(actual.error, expected.error);
+}
+
+TEST(ProgramImageTest, LocationsPointAtTheLoadingFile)
+{
+    const auto image = Image(Compile(kSource, "old.pcl"));
+    const auto loaded = ast::bytecode::read_image(
+        image, ast::FileTable::intern("new.pcl"));
+    EXPECT_EQ(RunVM(loaded).error.rfind("new.pcl:14:", 0), 0u);
+}
+
+TEST(ProgramImageTest, RejectsDamagedImages)
+{
+    const auto image = Image(Compile(kSource, "prog.pcl"));
+    const auto file = ast::FileTable::intern("prog.pcl");
+
+    for (std::size_t size = 0; size < image.size(); size += 7) {
+        EXPECT_THROW(ast::bytecode::read_image(image.substr(0, size), file),
+                     std::runtime_error)
+            << "truncated to " << size;
+    }
+    for (std::size_t pos = 0; pos < image.size(); pos += 5) {
+        auto damaged = image;
+        damaged[pos] = static_cast<char>(damaged[pos] ^ 0x40);
+        EXPECT_THROW(ast::bytecode::read_image(damaged, file),
+                     std::runtime_error)
+            << "flipped byte " << pos;
+    }
+    EXPECT_THROW(ast::bytecode::read_image(image + "x", file),
+                 std::runtime_error);
+}
+
+TEST_F(ProgramCacheTest, StoresAndLoads)
+{
+    const yy::ProgramCache cache(dir_.string());
+    EXPECT_FALSE(cache.load(kSource, 0, "prog.pcl"));
+
+    const auto program = Compile(kSource, "prog.pcl");
+    ASSERT_TRUE(cache.store(kSource, 0, program));
+    EXPECT_TRUE(std::filesystem::exists(cache.entry_path(kSource, 0)));
+
+    const auto loaded = cache.load(kSource, 0, "prog.pcl");
+    ASSERT_TRUE(loaded);
+    EXPECT_EQ(Image(*loaded), Image(program));
+}
+
+TEST_F(ProgramCacheTest, KeyedBySourceAndOptLevel)
+{
+    const yy::ProgramCache cache(dir_.string());
+    ASSERT_TRUE(cache.store(kSource, 0, Compile(kSource, "prog.pcl")));
+
+    const std::string edited = std::string(kSource) + "print 1;\n";
+    EXPECT_NE(cache.entry_path(edited, 0), cache.entry_path(kSource, 0));
+    EXPECT_NE(cache.entry_path(kSource, 1), cache.entry_path(kSource, 0));
+    EXPECT_FALSE(cache.load(edited, 0, "prog.pcl"));
+    EXPECT_FALSE(cache.load(kSource, 1, "prog.pcl"));
+    EXPECT_TRUE(cache.load(kSource, 0, "prog.pcl"));
+}
+
+TEST_F(ProgramCacheTest, CorruptEntryIsAMiss)
+{
+    const yy::ProgramCache cache(dir_.string());
+    ASSERT_TRUE(cache.store(kSource, 0, Compile(kSource, "prog.pcl")));
+    const auto entry = cache.entry_path(kSource, 0);
+
+    std::filesystem::resize_file(entry,
+                                 std::filesystem::file_size(entry) - 1);
+    EXPECT_FALSE(cache.load(kSource, 0, "prog.pcl"));
+
+    // Another key written under this entry's name.
+    std::ofstream(entry, std::ios::binary) << "paracl 0 image\n";
+    EXPECT_FALSE(cache.load(kSource, 0, "prog.pcl"));
+
+    ASSERT_TRUE(cache.store(kSource, 0, Compile(kSource, "prog.pcl")));
+    EXPECT_TRUE(cache.load(kSource, 0, "prog.pcl"));
+}
+
+TEST_F(ProgramCacheTest, UnwritableDirectoryIsIgnored)
+{
+    std::filesystem::create_directories(dir_);
+    const auto blocker = dir_ / "file";
+    std::ofstream(blocker) << "not a directory";
+
+    const yy::ProgramCache cache((blocker / "cache").string());
+    EXPECT_FALSE(cache.store(kSource, 0, Compile(kSource, "prog.pcl")));
+    EXPECT_FALSE(cache.load(kSource, 0, "prog.pcl"));
+}
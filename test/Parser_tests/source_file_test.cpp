@@ -0,0 +1,140 @@
+#include "driver/driver.hpp"
+#include "driver/source_file.hpp"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+class SourceFileTest : public ::testing::Test
+{
+protected:
+    std::filesystem::path dir_;
+
+    void SetUp() override
+    {
+        const auto* test =
+            ::testing::UnitTest::GetInstance()->current_test_info();
+        dir_ = std::filesystem::temp_directory_path() /
+               ("paracl_source_file_" + std::to_string(::getpid()) + "_" +
+                test->name());
+        std::filesystem::create_directories(dir_);
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(dir_);
+    }
+
+    std::string Write(const std::string& name, const std::string& text)
+    {
+        const auto path = dir_ / name;
+        std::ofstream(path, std::ios::binary) << text;
+        return path.string();
+    }
+};
+
+} // namespace
+
+TEST_F(SourceFileTest, MapsRegularFiles)
+{
+    const std::string text = "x = 1;\nprint x;\n";
+    auto source = yy::SourceFile::open(Write("prog.pcl", text));
+
+    ASSERT_TRUE(source.has_value());
+    EXPECT_TRUE(source->is_mapped());
+    EXPECT_EQ(source->text(), text);
+}
+
+TEST_F(SourceFileTest, EmptyFileIsEmptyText)
+{
+    auto source = yy::SourceFile::open(Write("empty.pcl", ""));
+
+    ASSERT_TRUE(source.has_value());
+    EXPECT_FALSE(source->is_mapped());
+    EXPECT_TRUE(source->text().empty());
+}
+
+TEST_F(SourceFileTest, MissingFileIsNull)
+{
+    EXPECT_FALSE(yy::SourceFile::open((dir_ / "missing.pcl").string()));
+    EXPECT_FALSE(yy::SourceFile::open(dir_.string()));
+}
+
+TEST_F(SourceFileTest, ReadsPipes)
+{
+    int fds[2];
+    ASSERT_EQ(::pipe(fds), 0);
+    std::string text;
+    for (int i = 0; i < 4096; ++i) {
+        text += "v" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+    }
+
+    // Larger than the pipe buffer, so the writer has to run concurrently.
+    const pid_t child = ::fork();
+    ASSERT_GE(child, 0);
+    if (child == 0) {
+        ::close(fds[0]);
+        const char* data = text.data();
+        std::size_t left = text.size();
+        while (left > 0) {
+            const auto n = ::write(fds[1], data, left);
+            if (n <= 0) {
+                ::_exit(1);
+            }
+            data += n;
+            left -= static_cast<std::size_t>(n);
+        }
+        ::_exit(0);
+    }
+    ::close(fds[1]);
+
+    auto source = yy::SourceFile::open("/dev/fd/" + std::to_string(fds[0]));
+    ::close(fds[0]);
+    int status = 0;
+    ::waitpid(child, &status, 0);
+
+    ASSERT_TRUE(source.has_value());
+    EXPECT_FALSE(source->is_mapped());
+    EXPECT_EQ(source->text(), text);
+}
+
+TEST_F(SourceFileTest, MoveKeepsTheText)
+{
+    const std::string text = "print 42;";
+    auto mapped = yy::SourceFile::open(Write("mapped.pcl", text));
+    auto read = yy::SourceFile::open(Write("read.pcl", ""));
+    ASSERT_TRUE(mapped && read);
+
+    const char* data = mapped->text().data();
+    yy::SourceFile moved = std::move(*mapped);
+    EXPECT_EQ(moved.text(), text);
+    EXPECT_EQ(moved.text().data(), data);
+
+    *read = std::move(moved);
+    EXPECT_EQ(read->text(), text);
+    EXPECT_TRUE(read->is_mapped());
+}
+
+TEST_F(SourceFileTest, DriverParsesTheMapping)
+{
+    auto source = yy::SourceFile::open(
+        Write("prog.pcl", "counter = 0;\nwhile (counter < 3) counter = "
+                          "counter + 1;\nprint counter;\n"));
+    ASSERT_TRUE(source.has_value());
+
+    yy::NumDriver driver(source->text(), "prog.pcl");
+    ASSERT_TRUE(driver.parse());
+    EXPECT_FALSE(driver.has_errors());
+    const auto* root =
+        static_cast<const ast::ScopeNode*>(driver.get_ast().root());
+    ASSERT_NE(root, nullptr);
+    EXPECT_EQ(root->statements().size(), 3u);
+}
@@ -0,0 +1,102 @@
+#include "Runtime/CheckedArith.hpp"
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace {
+
+constexpr auto kMax = std::numeric_limits<std::int64_t>::max();
+constexpr auto kMin = std::numeric_limits<std::int64_t>::min();
+
+using CheckedOp = bool (*)(std::int64_t, std::int64_t, std::int64_t&);
+
+// The result of `op`, or -1 if it overflows.
+constexpr std::int64_t Checked(CheckedOp op, std::int64_t lhs, std::int64_t rhs)
+{
+    std::int64_t out = 0;
+    return op(lhs, rhs, out) ? -1 : out;
+}
+
+// Constant evaluation takes the portable path.
+static_assert(Checked(ast::add_overflow, kMax - 1, 1) == kMax);
+static_assert(Checked(ast::add_overflow, kMax, 1) == -1);
+static_assert(Checked(ast::sub_overflow, kMin + 1, 1) == kMin);
+static_assert(Checked(ast::sub_overflow, 0, kMin) == -1);
+static_assert(Checked(ast::mul_overflow, 3037000499, 3037000499) ==
+              9223372030926249001);
+static_assert(Checked(ast::mul_overflow, kMin, -1) == -1);
+
+std::vector<std::int64_t> EdgeValues()
+{
+    return { 0,
+             1,
+             -1,
+             2,
+             -2,
+             3037000499,
+             3037000500,
+             -3037000499,
+             -3037000500,
+             std::int64_t{ 1 } << 32,
+             -(std::int64_t{ 1 } << 32),
+             kMax / 2,
+             kMin / 2,
+             kMax - 1,
+             kMin + 1,
+             kMax,
+             kMin };
+}
+
+// The builtins and the portable checks agree on every pair of edge values,
+// and a result that fits is the exact one.
+void ExpectSameAsPortable(CheckedOp fast, CheckedOp portable)
+{
+    for (const auto lhs : EdgeValues()) {
+        for (const auto rhs : EdgeValues()) {
+            std::int64_t fast_out = 0;
+            std::int64_t portable_out = 0;
+            const bool fast_overflow = fast(lhs, rhs, fast_out);
+            const bool portable_overflow = portable(lhs, rhs, portable_out);
+            EXPECT_EQ(fast_overflow, portable_overflow)
+                << lhs << ", " << rhs;
+            if (!fast_overflow && !portable_overflow) {
+                EXPECT_EQ(fast_out, portable_out) << lhs << ", " << rhs;
+            }
+        }
+    }
+}
+
+} // namespace
+
+TEST(CheckedArithTest, AdditionMatchesPortableChecks)
+{
+    ExpectSameAsPortable(ast::add_overflow, ast::portable::add_overflow);
+}
+
+TEST(CheckedArithTest, SubtractionMatchesPortableChecks)
+{
+    ExpectSameAsPortable(ast::sub_overflow, ast::portable::sub_overflow);
+}
+
+TEST(CheckedArithTest, MultiplicationMatchesPortableChecks)
+{
+    ExpectSameAsPortable(ast::mul_overflow, ast::portable::mul_overflow);
+}
+
+TEST(CheckedArithTest, ReportsOverflowAtTheBoundaries)
+{
+    std::int64_t out = 0;
+    EXPECT_TRUE(ast::add_overflow(kMax, 1, out));
+    EXPECT_TRUE(ast::add_overflow(kMin, -1, out));
+    EXPECT_TRUE(ast::sub_overflow(kMin, 1, out));
+    EXPECT_TRUE(ast::sub_overflow(kMax, -1, out));
+    EXPECT_TRUE(ast::mul_overflow(kMin, -1, out));
+    EXPECT_TRUE(ast::mul_overflow(3037000500, 3037000500, out));
+
+    EXPECT_FALSE(ast::mul_overflow(kMin, 1, out));
+    EXPECT_EQ(out, kMin);
+    EXPECT_FALSE(ast::mul_overflow(-3037000499, 3037000499, out));
+    EXPECT_EQ(out, -9223372030926249001);
+}
@@ -0,0 +1,121 @@
+#include "Runtime/InputSource.hpp"
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+TEST(InputSourceTest, ReadsWhitespaceSeparatedValues)
+{
+    std::istringstream in("  12\n-7\t+3\r\n0");
+    ast::InputSource source(in);
+
+    std::int64_t value = 0;
+    ASSERT_TRUE(source.read(value));
+    EXPECT_EQ(value, 12);
+    ASSERT_TRUE(source.read(value));
+    EXPECT_EQ(value, -7);
+    ASSERT_TRUE(source.read(value));
+    EXPECT_EQ(value, 3);
+    ASSERT_TRUE(source.read(value));
+    EXPECT_EQ(value, 0);
+    EXPECT_FALSE(source.read(value));
+}
+
+TEST(InputSourceTest, HandlesInt64Limits)
+{
+    std::istringstream in("9223372036854775807 -9223372036854775808 "
+                          "00000000000000000000000042");
+    ast::InputSource source(in);
+
+    std::int64_t value = 0;
+    ASSERT_TRUE(source.read(value));
+    EXPECT_EQ(value, std::numeric_limits<std::int64_t>::max());
+    ASSERT_TRUE(source.read(value));
+    EXPECT_EQ(value, std::numeric_limits<std::int64_t>::min());
+    ASSERT_TRUE(source.read(value));
+    EXPECT_EQ(value, 42);
+}
+
+TEST(InputSourceTest, ErrorDropsRestOfLine)
+{
+    std::istringstream in("9223372036854775808 1\nabc 2\n- 3\n4x\n5");
+    ast::InputSource source(in);
+
+    std::int64_t value = 0;
+    EXPECT_FALSE(source.read(value));
+    EXPECT_FALSE(source.read(value));
+    EXPECT_FALSE(source.read(value));
+    ASSERT_TRUE(source.read(value));
+    EXPECT_EQ(value, 4);
+    EXPECT_FALSE(source.read(value));
+    ASSERT_TRUE(source.read(value));
+    EXPECT_EQ(value, 5);
+}
+
+namespace {
+
+constexpr int kManyValues = 50000;
+
+std::string ManyValues()
+{
+    std::string text;
+    for (int i = 0; i < kManyValues; ++i) {
+        text += std::to_string(i * 7919) + (i % 10 == 0 ? "\n" : " ");
+    }
+    return text;
+}
+
+void ExpectManyValues(ast::InputSource& source)
+{
+    std::int64_t value = 0;
+    for (int i = 0; i < kManyValues; ++i) {
+        ASSERT_TRUE(source.read(value));
+        ASSERT_EQ(value, i * 7919);
+    }
+    EXPECT_FALSE(source.read(value));
+}
+
+} // namespace
+
+TEST(InputSourceTest, ReadsMappedFile)
+{
+    std::FILE* file = std::tmpfile();
+    ASSERT_NE(file, nullptr);
+    const auto text = ManyValues();
+    std::fwrite(text.data(), 1, text.size(), file);
+    std::fflush(file);
+    std::rewind(file);
+
+    auto source = ast::InputSource::from_fd(fileno(file));
+    ExpectManyValues(source);
+    std::fclose(file);
+}
+
+TEST(InputSourceTest, ReadsPipeInBlocks)
+{
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::thread writer([fd = fds[1]] {
+        const auto text = ManyValues();
+        std::size_t written = 0;
+        while (written < text.size()) {
+            const auto n = write(fd, text.data() + written, text.size() - written);
+            if (n <= 0) {
+                break;
+            }
+            written += static_cast<std::size_t>(n);
+        }
+        close(fd);
+    });
+
+    auto source = ast::InputSource::from_fd(fds[0]);
+    ExpectManyValues(source);
+    writer.join();
+    close(fds[0]);
+}
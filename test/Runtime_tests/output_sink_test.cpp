@@ -0,0 +1,84 @@
+#include "Runtime/OutputSink.hpp"
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+
+TEST(OutputSinkTest, LineModeWritesEveryValue)
+{
+    std::ostringstream out;
+    ast::OutputSink sink(out);
+
+    sink.print(42);
+    EXPECT_EQ(out.str(), "42\n");
+    sink.print(-7);
+    EXPECT_EQ(out.str(), "42\n-7\n");
+}
+
+TEST(OutputSinkTest, BlockModeWaitsForFlush)
+{
+    std::ostringstream out;
+    ast::OutputSink sink(out, ast::OutputSink::buffering::block);
+
+    sink.print(1);
+    sink.print(2);
+    EXPECT_EQ(out.str(), "");
+
+    sink.flush();
+    EXPECT_EQ(out.str(), "1\n2\n");
+}
+
+TEST(OutputSinkTest, FlushesOnDestruction)
+{
+    std::ostringstream out;
+    {
+        ast::OutputSink sink(out, ast::OutputSink::buffering::block);
+        sink.print(std::numeric_limits<std::int64_t>::min());
+        sink.print(std::numeric_limits<std::int64_t>::max());
+    }
+    EXPECT_EQ(out.str(), "-9223372036854775808\n9223372036854775807\n");
+}
+
+TEST(OutputSinkTest, FullBufferIsWrittenOut)
+{
+    std::ostringstream out;
+    ast::OutputSink sink(out, ast::OutputSink::buffering::block);
+
+    std::string expected;
+    std::int64_t value = 0;
+    while (out.str().empty()) {
+        sink.print(value);
+        expected += std::to_string(value) + "\n";
+        ++value;
+    }
+    EXPECT_LE(out.str().size(), ast::OutputSink::kBufferSize);
+
+    sink.flush();
+    EXPECT_EQ(out.str(), expected);
+}
+
+TEST(OutputSinkTest, SwitchingToLineModeFlushes)
+{
+    std::ostringstream out;
+    ast::OutputSink sink(out, ast::OutputSink::buffering::block);
+
+    sink.print(5);
+    sink.set_mode(ast::OutputSink::buffering::line);
+    EXPECT_EQ(out.str(), "5\n");
+}
+
+TEST(OutputSinkTest, SwitchingStreamFlushesToTheOldOne)
+{
+    std::ostringstream first;
+    std::ostringstream second;
+    ast::OutputSink sink(first, ast::OutputSink::buffering::block);
+
+    sink.print(1);
+    sink.set_stream(second);
+    sink.print(2);
+    sink.flush();
+    EXPECT_EQ(first.str(), "1\n");
+    EXPECT_EQ(second.str(), "2\n");
+}
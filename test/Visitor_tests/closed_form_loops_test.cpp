@@ -0,0 +1,281 @@
+#include "AST/AST.hpp"
+#include "Bytecode/BytecodeCompiler.hpp"
+#include "Bytecode/VM.hpp"
+#include "Visitors/ClosedFormLoops.hpp"
+#include "Visitors/Interpreter.hpp"
+#include "Visitors/SemanticChecker.hpp"
+#include "driver/driver.hpp"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+struct RunResult
+{
+    std::string out;
+    std::string error;
+};
+
+ast::AST Parse(const std::string& source)
+{
+    yy::NumDriver driver(source, "loop.pcl");
+    if (!driver.parse() || driver.has_errors()) {
+        throw std::runtime_error("parse failed");
+    }
+    return driver.take_ast();
+}
+
+ast::SemanticChecker Check(ast::AST& tree)
+{
+    ast::SemanticChecker checker;
+    checker.check(tree.root());
+    if (checker.hasErrors() || !checker.hasFrameLayout()) {
+        throw std::runtime_error("check failed");
+    }
+    return checker;
+}
+
+RunResult Interpret(ast::AST& tree, const std::string& input)
+{
+    const auto checker = Check(tree);
+    RunResult result;
+    std::istringstream in(input);
+    std::ostringstream out;
+    ast::Interpreter interpreter(checker.frameSize());
+    interpreter.output().set_stream(out);
+    interpreter.input() = ast::InputSource(in);
+    try {
+        tree.root()->accept(interpreter);
+    } catch (const std::runtime_error& ex) {
+        result.error = ex.what();
+    }
+    interpreter.output().flush();
+    result.out = out.str();
+    return result;
+}
+
+RunResult RunVM(ast::AST& tree, const std::string& input)
+{
+    Check(tree);
+    ast::bytecode::BytecodeCompiler compiler;
+    const auto program = compiler.compile(*tree.root());
+    RunResult result;
+    std::istringstream in(input);
+    std::ostringstream out;
+    ast::bytecode::VM vm(program);
+    vm.output().set_stream(out);
+    vm.input() = ast::InputSource(in);
+    try {
+        vm.run();
+    } catch (const std::runtime_error& ex) {
+        result.error = ex.what();
+    }
+    vm.output().flush();
+    result.out = out.str();
+    return result;
+}
+
+std::size_t Reduce(ast::AST& tree)
+{
+    Check(tree);
+    ast::ClosedFormLoops loops;
+    loops.reduce(tree.root());
+    return loops.reduced_count();
+}
+
+// Reduces `source` and expects both backends to behave as they do on the
+// program as written, for every input. Returns the reduced count.
+std::size_t ExpectSameBehaviour(const std::string& source,
+                                std::initializer_list<std::string> inputs)
+{
+    auto plain = Parse(source);
+    auto reduced = Parse(source);
+    const auto count = Reduce(reduced);
+
+    for (const auto& input : inputs) {
+        const auto expected = Interpret(plain, input);
+        const auto walked = Interpret(reduced, input);
+        const auto compiled = RunVM(reduced, input);
+        EXPECT_EQ(walked.out, expected.out) << "input " << input;
+        EXPECT_EQ(walked.error, expected.error) << "input " << input;
+        EXPECT_EQ(compiled.out, expected.out) << "input " << input;
+        EXPECT_EQ(compiled.error, expected.error) << "input " << input;
+    }
+    return count;
+}
+
+constexpr const char* kSum = R"(
+n = ?;
+i = 1;
+s = 0;
+while (i <= n) { s = s + i; i = i + 1; }
+print s;
+print i;
+)";
+
+} // namespace
+
+TEST(ClosedFormLoopsTest, SumsCountedLoops)
+{
+    EXPECT_EQ(ExpectSameBehaviour(kSum, { "0", "1", "10", "-5" }), 1u);
+}
+
+TEST(ClosedFormLoopsTest, DoesNotIterate)
+{
+    // A billion iterations, which only finish in time without the loop.
+    auto tree = Parse(kSum);
+    ASSERT_EQ(Reduce(tree), 1u);
+    const auto walked = Interpret(tree, "1000000000");
+    EXPECT_EQ(walked.error, "");
+    EXPECT_EQ(walked.out, "500000000500000000\n1000000001\n");
+    const auto compiled = RunVM(tree, "1000000000");
+    EXPECT_EQ(compiled.error, "");
+    EXPECT_EQ(compiled.out, walked.out);
+}
+
+TEST(ClosedFormLoopsTest, ReportsOverflowWhereTheLoopWould)
+{
+    constexpr const char* kSource = R"(
+n = ?;
+s = ?;
+k = ?;
+i = 1;
+t = 0;
+while (i <= n) {
+    s = s + i;
+    t = t + i * k;
+    i = i + 1;
+}
+print s;
+print t;
+)";
+    EXPECT_EQ(ExpectSameBehaviour(kSource,
+                                  { "10 9223372036854775800 1",
+                                    "10 9223372036854775753 1",
+                                    "10 9223372036854775752 1",
+                                    "3 0 4611686018427387904",
+                                    "3 0 -3074457345618258602",
+                                    "3 0 -3074457345618258603" }),
+              1u);
+
+    auto tree = Parse(kSource);
+    Reduce(tree);
+    EXPECT_EQ(Interpret(tree, "10 9223372036854775800 1").error,
+              "loop.pcl:8:9: error: Integer overflow in addition");
+    EXPECT_EQ(RunVM(tree, "3 0 4611686018427387904").error,
+              "loop.pcl:9:13: error: Integer overflow in multiplication");
+}
+
+TEST(ClosedFormLoopsTest, CoversEveryComparison)
+{
+    constexpr const char* kSource = R"(
+a = ?;
+b = ?;
+i = a;
+s = 0;
+while (i < b) { i = i + 3; s = s - i; }
+print i; print s;
+i = a;
+while (i >= b) { s = 2 + s; i = i - 2; }
+print i; print s;
+i = a;
+while (b > i) { s = s + (i * 5 - b); i = 7 + i; }
+print i; print s;
+i = a;
+while (b <= i) { i = i - 1; s = s - (i - a) * -3; }
+print i; print s;
+i = b + 6;
+while (i != b) { s = s + i; i = i - 2; }
+print i; print s;
+i = a;
+while (i == b) { i = i + 1; s = s + 1; }
+print i; print s;
+)";
+    EXPECT_EQ(ExpectSameBehaviour(
+                  kSource, { "0 10", "10 0", "-7 -7", "5 4", "-20 -21" }),
+              6u);
+}
+
+TEST(ClosedFormLoopsTest, ReducesForLoops)
+{
+    constexpr const char* kSource = R"(
+n = ?;
+c = ?;
+s = 0;
+t = 0;
+for (j = 0; j < n; j = j + 3) {
+    s = s + (j - 1) * c;
+    t = t - j;
+    ;
+}
+print s;
+print t;
+)";
+    EXPECT_EQ(ExpectSameBehaviour(
+                  kSource, { "0 1", "10 2", "11 -4", "100 3074457345618258" }),
+              1u);
+}
+
+TEST(ClosedFormLoopsTest, RunsLoopsThatStepPastTheBound)
+{
+    // i only meets n if they differ by a multiple of the step; otherwise
+    // it overflows on the way.
+    constexpr const char* kSource = R"(
+n = ?;
+k = ?;
+i = 1;
+while (i != n) { i = i + k; }
+print i;
+)";
+    EXPECT_EQ(ExpectSameBehaviour(kSource,
+                                  { "9 2",
+                                    "1 5",
+                                    "0 4611686018427387904",
+                                    "-9223372036854775807 "
+                                    "-4611686018427387904" }),
+              1u);
+}
+
+TEST(ClosedFormLoopsTest, ReducesInnerLoops)
+{
+    constexpr const char* kSource = R"(
+n = ?;
+s = 0;
+for (i = 0; i < n; i = i + 1) {
+    j = 0;
+    while (j < i) { s = s + j; j = j + 1; }
+}
+print s;
+)";
+    EXPECT_EQ(ExpectSameBehaviour(kSource, { "0", "5", "40" }), 1u);
+}
+
+TEST(ClosedFormLoopsTest, LeavesOtherLoopsAlone)
+{
+    constexpr const char* kSource = R"(
+n = ?;
+i = 0;
+s = 1;
+while (i < n) { print i; i = i + 1; }
+i = 0;
+while (i < n) { s = s + s; i = i + 1; }
+i = 0;
+while (i < n) { s = s + i / 2; i = i + 1; }
+i = 0;
+while (i < n) { s = s + i * i; i = i + 1; }
+i = 0;
+while (i < n) { s = s + 1; i = i + s; }
+i = 0;
+while (i < n) { s = s + 1; s = s + 1; i = i + 1; }
+i = 0;
+while (i < n) { i = i + 1; n = n + 0; }
+i = 0;
+while (i < n && s > 0) { i = i + 1; }
+print s;
+)";
+    EXPECT_EQ(ExpectSameBehaviour(kSource, { "0", "6" }), 0u);
+}
@@ -0,0 +1,216 @@
+#include "AST/AST.hpp"
+#include "Visitors/ConstantFolder.hpp"
+#include "Visitors/Interpreter.hpp"
+#include "gtest/gtest.h"
+
+#include <limits>
+#include <sstream>
+
+namespace {
+
+using NodePtr = ast::BaseNode::NodePtr;
+
+struct RunResult
+{
+    std::string out;
+    std::string error;
+};
+
+RunResult RunProgram(ast::BaseNode& root, const std::string& input = "")
+{
+    RunResult result;
+    ast::Interpreter interpreter;
+    std::istringstream in(input);
+    std::ostringstream out;
+    std::streambuf* old_in = std::cin.rdbuf(in.rdbuf());
+    std::streambuf* old_out = std::cout.rdbuf(out.rdbuf());
+    try {
+        root.accept(interpreter);
+    } catch (const std::runtime_error& ex) {
+        result.error = ex.what();
+    }
+    std::cin.rdbuf(old_in);
+    std::cout.rdbuf(old_out);
+    result.out = out.str();
+    return result;
+}
+
+// Runs `root` before and after folding and expects the same behaviour.
+std::size_t ExpectFoldPreservesResult(ast::ScopeNode& root,
+                                      const std::string& input = "")
+{
+    const auto before = RunProgram(root, input);
+    ast::ConstantFolder folder;
+    folder.fold(&root);
+    const auto after = RunProgram(root, input);
+    EXPECT_EQ(after.out, before.out);
+    EXPECT_EQ(after.error, before.error);
+    return folder.folded_count();
+}
+
+NodePtr Num(int64_t value)
+{
+    return std::make_unique<ast::ValueNode>(value);
+}
+
+NodePtr Var(const std::string& name)
+{
+    return std::make_unique<ast::VarNode>(name);
+}
+
+NodePtr Arith(ast::bin_arith_op_type op, NodePtr lhs, NodePtr rhs)
+{
+    return std::make_unique<ast::BinArithOpNode>(
+        op, std::move(lhs), std::move(rhs));
+}
+
+NodePtr Logic(ast::bin_logic_op_type op, NodePtr lhs, NodePtr rhs)
+{
+    return std::make_unique<ast::BinLogicOpNode>(
+        op, std::move(lhs), std::move(rhs));
+}
+
+NodePtr Not(NodePtr operand)
+{
+    return std::make_unique<ast::UnOpNode>(ast::unop_node_type::logical_not,
+                                           std::move(operand));
+}
+
+NodePtr Assign(const std::string& name, NodePtr rhs)
+{
+    return std::make_unique<ast::AssignNode>(Var(name), std::move(rhs));
+}
+
+ast::PrintNode* AddPrint(ast::ScopeNode& root, NodePtr expr)
+{
+    auto print = std::make_unique<ast::PrintNode>(std::move(expr));
+    auto* raw = print.get();
+    root.add_statement(std::move(print));
+    return raw;
+}
+
+} // namespace
+
+TEST(ConstantFolderTest, FoldsConstantExpression)
+{
+    using ast::bin_arith_op_type;
+    ast::ScopeNode root;
+    auto* print = AddPrint(
+        root,
+        Arith(bin_arith_op_type::add,
+              Arith(bin_arith_op_type::mul, Num(2), Num(3)),
+              std::make_unique<ast::UnOpNode>(ast::unop_node_type::neg,
+                                              Num(4))));
+
+    EXPECT_EQ(ExpectFoldPreservesResult(root), 3u);
+    ASSERT_EQ(print->expr()->node_type(), ast::base_node_type::value);
+    EXPECT_EQ(static_cast<const ast::ValueNode*>(print->expr())->value(), 2);
+    EXPECT_EQ(print->expr()->parent(), print);
+}
+
+TEST(ConstantFolderTest, AppliesIdentities)
+{
+    using ast::bin_arith_op_type;
+    ast::ScopeNode root;
+    root.add_statement(std::make_unique<ast::ExprNode>(Assign("x", Num(7))));
+    auto* mul = AddPrint(root,
+                         Arith(bin_arith_op_type::add,
+                               Arith(bin_arith_op_type::mul, Var("x"), Num(1)),
+                               Num(0)));
+    auto* sub = AddPrint(
+        root,
+        Arith(bin_arith_op_type::div,
+              Arith(bin_arith_op_type::sub, Var("x"), Num(0)),
+              Num(1)));
+
+    EXPECT_EQ(ExpectFoldPreservesResult(root), 4u);
+    EXPECT_EQ(mul->expr()->node_type(), ast::base_node_type::var);
+    EXPECT_EQ(sub->expr()->node_type(), ast::base_node_type::var);
+}
+
+TEST(ConstantFolderTest, StripsDoubleNotInConditions)
+{
+    ast::ScopeNode root;
+    root.add_statement(std::make_unique<ast::ExprNode>(Assign("x", Num(5))));
+    auto if_node = std::make_unique<ast::IfNode>(
+        Not(Not(Var("x"))), AddPrint(root, Num(1))->clone());
+    auto* if_raw = if_node.get();
+    root.add_statement(std::move(if_node));
+    // Printed, so the 0/1 result of `!!x` must stay.
+    auto* kept = AddPrint(root, Not(Not(Var("x"))));
+    auto* triple = AddPrint(root, Not(Not(Not(Var("x")))));
+
+    ExpectFoldPreservesResult(root);
+    EXPECT_EQ(if_raw->condition()->node_type(), ast::base_node_type::var);
+    EXPECT_EQ(if_raw->condition()->parent(), if_raw);
+    EXPECT_EQ(kept->expr()->node_type(), ast::base_node_type::unop);
+    ASSERT_EQ(triple->expr()->node_type(), ast::base_node_type::unop);
+    EXPECT_EQ(static_cast<const ast::UnOpNode*>(triple->expr())
+                  ->operand()
+                  ->node_type(),
+              ast::base_node_type::var);
+}
+
+TEST(ConstantFolderTest, ShortCircuitDropsRightOperand)
+{
+    using ast::bin_logic_op_type;
+    ast::ScopeNode root;
+    auto* and_print = AddPrint(
+        root,
+        Logic(bin_logic_op_type::logical_and,
+              Num(0),
+              std::make_unique<ast::InputNode>()));
+    auto* or_print = AddPrint(
+        root,
+        Logic(bin_logic_op_type::logical_or, Num(3), Var("undefined")));
+
+    EXPECT_EQ(ExpectFoldPreservesResult(root), 2u);
+    EXPECT_EQ(and_print->expr()->node_type(), ast::base_node_type::value);
+    EXPECT_EQ(or_print->expr()->node_type(), ast::base_node_type::value);
+}
+
+TEST(ConstantFolderTest, TrappingExpressionsKeepLocation)
+{
+    using ast::bin_arith_op_type;
+    ast::SourceRange loc;
+    loc.file = ast::FileTable::intern("fold.pcl");
+    loc.begin_line = 2;
+    loc.begin_column = 9;
+
+    ast::ScopeNode root;
+    auto div = Arith(bin_arith_op_type::div,
+                     Arith(bin_arith_op_type::add, Num(1), Num(2)),
+                     Num(0));
+    div->set_location(loc);
+    auto* print = AddPrint(root, std::move(div));
+
+    EXPECT_EQ(ExpectFoldPreservesResult(root), 1u);
+    EXPECT_EQ(print->expr()->node_type(), ast::base_node_type::bin_arith_op);
+    EXPECT_EQ(RunProgram(root).error,
+              "fold.pcl:2:9: error: Division by zero");
+
+    ast::ScopeNode overflow;
+    AddPrint(overflow,
+             Arith(bin_arith_op_type::mul,
+                   Num(std::numeric_limits<int64_t>::max()),
+                   Num(2)));
+    EXPECT_EQ(ExpectFoldPreservesResult(overflow), 0u);
+}
+
+TEST(ConstantFolderTest, KeepsAssignmentConditions)
+{
+    ast::ScopeNode root;
+    auto body = std::make_unique<ast::ScopeNode>();
+    body->add_statement(std::make_unique<ast::PrintNode>(Var("x")));
+    auto while_node = std::make_unique<ast::WhileNode>(
+        Arith(ast::bin_arith_op_type::add,
+              Assign("x", std::make_unique<ast::InputNode>()),
+              Num(0)),
+        std::move(body));
+    auto* while_raw = while_node.get();
+    root.add_statement(std::move(while_node));
+
+    EXPECT_EQ(ExpectFoldPreservesResult(root, "3 2 0"), 0u);
+    EXPECT_EQ(while_raw->condition()->node_type(),
+              ast::base_node_type::bin_arith_op);
+}
@@ -0,0 +1,307 @@
+#include "AST/AST.hpp"
+#include "Visitors/Interpreter.hpp"
+#include "Visitors/SemanticChecker.hpp"
+#include "gtest/gtest.h"
+
+#include <sstream>
+#include <vector>
+
+namespace {
+
+using NodePtr = ast::BaseNode::NodePtr;
+
+struct RunResult
+{
+    std::string out;
+    std::string error;
+};
+
+RunResult Run(ast::BaseNode& root,
+              ast::Interpreter& interpreter,
+              const std::string& input)
+{
+    RunResult result;
+    std::istringstream in(input);
+    std::ostringstream out;
+    std::streambuf* old_in = std::cin.rdbuf(in.rdbuf());
+    std::streambuf* old_out = std::cout.rdbuf(out.rdbuf());
+    try {
+        root.accept(interpreter);
+    } catch (const std::runtime_error& ex) {
+        result.error = ex.what();
+    }
+    interpreter.output().flush();
+    std::cin.rdbuf(old_in);
+    std::cout.rdbuf(old_out);
+    result.out = out.str();
+    return result;
+}
+
+// Checks `root` and runs it with name lookup and with the frame layout,
+// expecting the same result from both.
+RunResult CheckAndRun(ast::BaseNode& root, const std::string& input = "")
+{
+    ast::SemanticChecker checker;
+    checker.check(&root);
+    EXPECT_FALSE(checker.hasErrors());
+
+    ast::Interpreter by_name;
+    const auto expected = Run(root, by_name, input);
+    ast::Interpreter by_frame(checker.frameSize());
+    const auto actual = Run(root, by_frame, input);
+    EXPECT_EQ(actual.out, expected.out);
+    EXPECT_EQ(actual.error, expected.error);
+    return actual;
+}
+
+bool HasCheckErrors(ast::BaseNode& root)
+{
+    ast::SemanticChecker checker;
+    checker.check(&root);
+    return checker.hasErrors();
+}
+
+NodePtr Num(int64_t value)
+{
+    return std::make_unique<ast::ValueNode>(value);
+}
+
+NodePtr Var(const std::string& name)
+{
+    return std::make_unique<ast::VarNode>(name);
+}
+
+NodePtr Assign(NodePtr lhs, NodePtr rhs)
+{
+    return std::make_unique<ast::AssignNode>(std::move(lhs), std::move(rhs));
+}
+
+NodePtr Assign(const std::string& name, NodePtr rhs)
+{
+    return Assign(Var(name), std::move(rhs));
+}
+
+NodePtr Stmt(NodePtr expr)
+{
+    return std::make_unique<ast::ExprNode>(std::move(expr));
+}
+
+NodePtr Print(NodePtr expr)
+{
+    return std::make_unique<ast::PrintNode>(std::move(expr));
+}
+
+NodePtr Add(NodePtr lhs, NodePtr rhs)
+{
+    return std::make_unique<ast::BinArithOpNode>(
+        ast::bin_arith_op_type::add, std::move(lhs), std::move(rhs));
+}
+
+NodePtr Less(NodePtr lhs, NodePtr rhs)
+{
+    return std::make_unique<ast::BinLogicOpNode>(
+        ast::bin_logic_op_type::less, std::move(lhs), std::move(rhs));
+}
+
+NodePtr Repeat(NodePtr value, NodePtr size)
+{
+    auto node =
+        std::make_unique<ast::ArrayNode>(ast::array_init_type::repeat);
+    node->add_item(std::move(value));
+    node->add_item(std::move(size));
+    return node;
+}
+
+NodePtr List(const std::vector<int64_t>& values)
+{
+    auto node = std::make_unique<ast::ArrayNode>(ast::array_init_type::list);
+    for (const auto value : values) {
+        node->add_item(Num(value));
+    }
+    return node;
+}
+
+std::unique_ptr<ast::IndexNode> At(const std::string& name, NodePtr index)
+{
+    return std::make_unique<ast::IndexNode>(Var(name), std::move(index));
+}
+
+// for (i = 0; i < bound; i = i + 1) { body }
+NodePtr CountTo(int64_t bound, std::unique_ptr<ast::ScopeNode> body)
+{
+    return std::make_unique<ast::ForNode>(Assign("i", Num(0)),
+                                          Less(Var("i"), Num(bound)),
+                                          Assign("i", Add(Var("i"), Num(1))),
+                                          std::move(body));
+}
+
+} // namespace
+
+TEST(InterpreterArrayTest, RepeatFillsAndElementsCanBeWritten)
+{
+    ast::ScopeNode root;
+    root.add_statement(
+        Stmt(Assign("a", Repeat(Num(7), std::make_unique<ast::InputNode>()))));
+    root.add_statement(Stmt(Assign(At("a", Num(1)), Num(-3))));
+    auto body = std::make_unique<ast::ScopeNode>();
+    body->add_statement(Print(At("a", Var("i"))));
+    root.add_statement(CountTo(3, std::move(body)));
+
+    const auto result = CheckAndRun(root, "3");
+    EXPECT_EQ(result.out, "7\n-3\n7\n");
+    EXPECT_EQ(result.error, "");
+}
+
+TEST(InterpreterArrayTest, ArraysAreCopiedByValue)
+{
+    ast::ScopeNode root;
+    root.add_statement(Stmt(Assign("a", List({ 1, 2, 3 }))));
+    root.add_statement(Stmt(Assign("b", Var("a"))));
+    root.add_statement(Stmt(Assign(At("b", Num(0)), Num(10))));
+    root.add_statement(Print(At("a", Num(0))));
+    root.add_statement(Print(At("b", Num(0))));
+    // Elements of a literal may read the array they replace.
+    auto swapped = std::make_unique<ast::ArrayNode>(ast::array_init_type::list);
+    swapped->add_item(At("a", Num(2)));
+    swapped->add_item(At("a", Num(0)));
+    root.add_statement(Stmt(Assign("a", std::move(swapped))));
+    root.add_statement(Print(At("a", Num(0))));
+    root.add_statement(Print(At("a", Num(1))));
+
+    const auto result = CheckAndRun(root);
+    EXPECT_EQ(result.out, "1\n10\n3\n1\n");
+    EXPECT_EQ(result.error, "");
+}
+
+TEST(InterpreterArrayTest, OutOfRangeIndexIsARuntimeError)
+{
+    ast::ScopeNode root;
+    root.add_statement(
+        Stmt(Assign("a", Repeat(Num(0), std::make_unique<ast::InputNode>()))));
+    root.add_statement(Print(At("a", Num(1))));
+    root.add_statement(Print(At("a", Num(2))));
+
+    const auto result = CheckAndRun(root, "2");
+    EXPECT_EQ(result.out, "0\n");
+    EXPECT_EQ(result.error,
+              "error: Array index 2 is out of range for array of size 2");
+
+    ast::ScopeNode negative;
+    negative.add_statement(Stmt(Assign("a", List({ 1 }))));
+    negative.add_statement(
+        Stmt(Assign(At("a", std::make_unique<ast::InputNode>()), Num(5))));
+    EXPECT_EQ(CheckAndRun(negative, "-1").error,
+              "error: Array index -1 is out of range for array of size 1");
+}
+
+TEST(InterpreterArrayTest, InvalidSizesAreRejected)
+{
+    ast::ScopeNode root;
+    root.add_statement(
+        Stmt(Assign("a", Repeat(Num(0), std::make_unique<ast::InputNode>()))));
+
+    EXPECT_EQ(CheckAndRun(root, "-4").error,
+              "error: Invalid array size: -4");
+    EXPECT_EQ(CheckAndRun(root, "1000000000000").error,
+              "error: Array size 1000000000000 is too large");
+}
+
+TEST(InterpreterArrayTest, CheckerRejectsMixingArraysAndScalars)
+{
+    ast::ScopeNode print_array;
+    print_array.add_statement(Stmt(Assign("a", List({ 1 }))));
+    print_array.add_statement(Print(Var("a")));
+    EXPECT_TRUE(HasCheckErrors(print_array));
+
+    ast::ScopeNode scalar_to_array;
+    scalar_to_array.add_statement(Stmt(Assign("a", List({ 1 }))));
+    scalar_to_array.add_statement(Stmt(Assign("a", Num(1))));
+    EXPECT_TRUE(HasCheckErrors(scalar_to_array));
+
+    ast::ScopeNode array_to_scalar;
+    array_to_scalar.add_statement(Stmt(Assign("x", Num(1))));
+    array_to_scalar.add_statement(Stmt(Assign("x", List({ 1 }))));
+    EXPECT_TRUE(HasCheckErrors(array_to_scalar));
+
+    ast::ScopeNode index_scalar;
+    index_scalar.add_statement(Stmt(Assign("x", Num(1))));
+    index_scalar.add_statement(Print(At("x", Num(0))));
+    EXPECT_TRUE(HasCheckErrors(index_scalar));
+
+    ast::ScopeNode literal_in_expr;
+    literal_in_expr.add_statement(Print(List({ 1, 2 })));
+    EXPECT_TRUE(HasCheckErrors(literal_in_expr));
+
+    ast::ScopeNode nested_assign;
+    nested_assign.add_statement(
+        Stmt(Assign("x", Assign("a", List({ 1, 2 })))));
+    EXPECT_TRUE(HasCheckErrors(nested_assign));
+
+    ast::ScopeNode element_from_array;
+    element_from_array.add_statement(Stmt(Assign("a", List({ 1 }))));
+    element_from_array.add_statement(
+        Stmt(Assign(At("a", Num(0)), Var("a"))));
+    EXPECT_TRUE(HasCheckErrors(element_from_array));
+}
+
+TEST(InterpreterArrayTest, ProvenIndicesSkipTheBoundsCheck)
+{
+    ast::ScopeNode root;
+    root.add_statement(Stmt(Assign("a", List({ 1, 2, 3 }))));
+    root.add_statement(Stmt(Assign("a", Repeat(Num(0), Num(4)))));
+    auto in_range = At("a", Num(2));
+    auto* in_range_raw = in_range.get();
+    root.add_statement(Print(std::move(in_range)));
+    auto past_shortest = At("a", Num(3));
+    auto* past_shortest_raw = past_shortest.get();
+    root.add_statement(Print(std::move(past_shortest)));
+
+    auto body = std::make_unique<ast::ScopeNode>();
+    auto counted = At("a", Var("i"));
+    auto* counted_raw = counted.get();
+    body->add_statement(Stmt(Assign(std::move(counted), Var("i"))));
+    root.add_statement(CountTo(3, std::move(body)));
+
+    auto long_body = std::make_unique<ast::ScopeNode>();
+    auto too_far = At("a", Var("i"));
+    auto* too_far_raw = too_far.get();
+    long_body->add_statement(Print(std::move(too_far)));
+    root.add_statement(CountTo(4, std::move(long_body)));
+
+    ast::SemanticChecker checker;
+    checker.check(&root);
+    ASSERT_FALSE(checker.hasErrors());
+    EXPECT_FALSE(in_range_raw->bounds_checked());
+    EXPECT_TRUE(past_shortest_raw->bounds_checked());
+    EXPECT_FALSE(counted_raw->bounds_checked());
+    EXPECT_TRUE(too_far_raw->bounds_checked());
+}
+
+TEST(InterpreterArrayTest, LoopThatWritesItsCounterKeepsTheCheck)
+{
+    ast::ScopeNode root;
+    root.add_statement(Stmt(Assign("a", List({ 1, 2, 3 }))));
+    auto body = std::make_unique<ast::ScopeNode>();
+    auto access = At("a", Var("i"));
+    auto* access_raw = access.get();
+    body->add_statement(Print(std::move(access)));
+    body->add_statement(Stmt(Assign("i", Add(Var("i"), Num(1)))));
+    root.add_statement(CountTo(3, std::move(body)));
+
+    ast::ScopeNode dynamic;
+    dynamic.add_statement(
+        Stmt(Assign("a", Repeat(Num(0), std::make_unique<ast::InputNode>()))));
+    auto dynamic_access = At("a", Num(0));
+    auto* dynamic_raw = dynamic_access.get();
+    dynamic.add_statement(Print(std::move(dynamic_access)));
+
+    ast::SemanticChecker checker;
+    checker.check(&root);
+    ASSERT_FALSE(checker.hasErrors());
+    EXPECT_TRUE(access_raw->bounds_checked());
+    ast::SemanticChecker dynamic_checker;
+    dynamic_checker.check(&dynamic);
+    ASSERT_FALSE(dynamic_checker.hasErrors());
+    EXPECT_TRUE(dynamic_raw->bounds_checked());
+    EXPECT_EQ(CheckAndRun(root).out, "1\n3\n");
+}
@@ -0,0 +1,205 @@
+#include "AST/AST.hpp"
+#include "Visitors/Interpreter.hpp"
+#include "Visitors/SemanticChecker.hpp"
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+namespace {
+
+using NodePtr = ast::BaseNode::NodePtr;
+
+struct RunResult
+{
+    std::string out;
+    std::string error;
+};
+
+RunResult Run(ast::BaseNode& root,
+              ast::Interpreter& interpreter,
+              const std::string& input)
+{
+    RunResult result;
+    std::istringstream in(input);
+    std::ostringstream out;
+    std::streambuf* old_in = std::cin.rdbuf(in.rdbuf());
+    std::streambuf* old_out = std::cout.rdbuf(out.rdbuf());
+    try {
+        root.accept(interpreter);
+    } catch (const std::runtime_error& ex) {
+        result.error = ex.what();
+    }
+    std::cin.rdbuf(old_in);
+    std::cout.rdbuf(old_out);
+    result.out = out.str();
+    return result;
+}
+
+// Checks `root`, then runs it both with name lookup and with the frame
+// layout and expects identical output and errors.
+RunResult ExpectFrameMatchesNames(ast::BaseNode& root,
+                                  const std::string& input = "")
+{
+    ast::SemanticChecker checker;
+    checker.check(&root);
+    EXPECT_FALSE(checker.hasErrors());
+    EXPECT_TRUE(checker.hasFrameLayout());
+
+    ast::Interpreter by_name;
+    const auto expected = Run(root, by_name, input);
+    ast::Interpreter by_frame(checker.frameSize());
+    const auto actual = Run(root, by_frame, input);
+    EXPECT_EQ(actual.out, expected.out);
+    EXPECT_EQ(actual.error, expected.error);
+    return actual;
+}
+
+NodePtr Num(int64_t value)
+{
+    return std::make_unique<ast::ValueNode>(value);
+}
+
+NodePtr Var(const std::string& name)
+{
+    return std::make_unique<ast::VarNode>(name);
+}
+
+NodePtr Assign(const std::string& name, NodePtr rhs)
+{
+    return std::make_unique<ast::AssignNode>(Var(name), std::move(rhs));
+}
+
+NodePtr Stmt(NodePtr expr)
+{
+    return std::make_unique<ast::ExprNode>(std::move(expr));
+}
+
+NodePtr Print(NodePtr expr)
+{
+    return std::make_unique<ast::PrintNode>(std::move(expr));
+}
+
+NodePtr Add(NodePtr lhs, NodePtr rhs)
+{
+    return std::make_unique<ast::BinArithOpNode>(
+        ast::bin_arith_op_type::add, std::move(lhs), std::move(rhs));
+}
+
+NodePtr Less(NodePtr lhs, NodePtr rhs)
+{
+    return std::make_unique<ast::BinLogicOpNode>(
+        ast::bin_logic_op_type::less, std::move(lhs), std::move(rhs));
+}
+
+} // namespace
+
+TEST(InterpreterFrameTest, CheckerAssignsFrameIndices)
+{
+    ast::ScopeNode root;
+    auto* x = new ast::VarNode("x");
+    root.add_statement(Stmt(
+        std::make_unique<ast::AssignNode>(NodePtr(x), Num(1))));
+    auto inner = std::make_unique<ast::ScopeNode>();
+    auto* decl = new ast::VarDeclNode("x");
+    inner->add_statement(NodePtr(decl));
+    auto* read = new ast::VarNode("x");
+    inner->add_statement(Print(NodePtr(read)));
+    auto* inner_raw = inner.get();
+    root.add_statement(std::move(inner));
+
+    ast::SemanticChecker checker;
+    checker.check(&root);
+
+    ASSERT_FALSE(checker.hasErrors());
+    EXPECT_EQ(checker.frameSize(), 2u);
+    EXPECT_EQ(x->frame_index(), 0u);
+    EXPECT_EQ(decl->frame_index(), 1u);
+    EXPECT_EQ(read->frame_index(), 1u);
+    EXPECT_EQ(inner_raw->frame_range().begin, 1u);
+    EXPECT_EQ(inner_raw->frame_range().end, 2u);
+}
+
+TEST(InterpreterFrameTest, LoopMatchesNameLookup)
+{
+    ast::ScopeNode root;
+    root.add_statement(Stmt(Assign("a", Num(0))));
+    root.add_statement(Stmt(Assign("b", Num(1))));
+    root.add_statement(Stmt(Assign("i", Num(0))));
+    auto body = std::make_unique<ast::ScopeNode>();
+    body->add_statement(Stmt(Assign("c", Add(Var("a"), Var("b")))));
+    body->add_statement(Print(Var("c")));
+    body->add_statement(Stmt(Assign("a", Var("b"))));
+    body->add_statement(Stmt(Assign("b", Var("c"))));
+    body->add_statement(Stmt(Assign("i", Add(Var("i"), Num(1)))));
+    root.add_statement(std::make_unique<ast::WhileNode>(
+        Less(Var("i"), Num(5)), std::move(body)));
+
+    EXPECT_EQ(ExpectFrameMatchesNames(root).out, "1\n2\n3\n5\n8\n");
+}
+
+TEST(InterpreterFrameTest, TrackedLoopConditionUsesFrame)
+{
+    ast::ScopeNode root;
+    auto body = std::make_unique<ast::ScopeNode>();
+    body->add_statement(Print(Var("x")));
+    body->add_statement(Stmt(Assign("x", Add(Var("x"), Num(-1)))));
+    root.add_statement(std::make_unique<ast::WhileNode>(
+        Assign("x", std::make_unique<ast::InputNode>()), std::move(body)));
+
+    EXPECT_EQ(ExpectFrameMatchesNames(root, "3").out, "3\n2\n1\n");
+}
+
+TEST(InterpreterFrameTest, ScopeExitReleasesVariables)
+{
+    ast::ScopeNode root;
+    root.add_statement(Stmt(Assign("i", Num(0))));
+    auto body = std::make_unique<ast::ScopeNode>();
+    body->add_statement(std::make_unique<ast::VarDeclNode>("k", Var("i")));
+    body->add_statement(Print(Var("k")));
+    body->add_statement(Stmt(Assign("i", Add(Var("i"), Num(1)))));
+    root.add_statement(std::make_unique<ast::WhileNode>(
+        Less(Var("i"), Num(2)), std::move(body)));
+
+    EXPECT_EQ(ExpectFrameMatchesNames(root).out, "0\n1\n");
+}
+
+TEST(InterpreterFrameTest, ErrorsMatchNameLookup)
+{
+    ast::ScopeNode self_reference;
+    self_reference.add_statement(Stmt(Assign("y", Add(Var("y"), Num(1)))));
+    EXPECT_EQ(ExpectFrameMatchesNames(self_reference).error,
+              "error: Undefined variable: y");
+
+    ast::ScopeNode redeclared;
+    redeclared.add_statement(Stmt(Assign("i", Num(0))));
+    redeclared.add_statement(std::make_unique<ast::WhileNode>(
+        Less(Var("i"), Num(2)),
+        std::make_unique<ast::VarDeclNode>(
+            "k", Assign("i", Add(Var("i"), Num(1))))));
+    EXPECT_EQ(ExpectFrameMatchesNames(redeclared).error,
+              "error: Variable k already declared");
+}
+
+TEST(InterpreterFrameTest, ConditionalCreationDisablesFrameLayout)
+{
+    ast::ScopeNode root;
+    root.add_statement(Stmt(Assign("c", Num(0))));
+    root.add_statement(std::make_unique<ast::IfNode>(
+        Var("c"), Stmt(Assign("x", Num(1))), Print(Var("x"))));
+
+    ast::SemanticChecker checker;
+    checker.check(&root);
+    EXPECT_FALSE(checker.hasErrors());
+    EXPECT_FALSE(checker.hasFrameLayout());
+
+    ast::ScopeNode braced;
+    auto then_branch = std::make_unique<ast::ScopeNode>();
+    then_branch->add_statement(Stmt(Assign("x", Num(1))));
+    braced.add_statement(Stmt(Assign("c", Num(1))));
+    braced.add_statement(
+        std::make_unique<ast::IfNode>(Var("c"), std::move(then_branch)));
+
+    ast::SemanticChecker braced_checker;
+    braced_checker.check(&braced);
+    EXPECT_TRUE(braced_checker.hasFrameLayout());
+}
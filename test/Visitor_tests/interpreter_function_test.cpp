@@ -0,0 +1,268 @@
+#include "AST/AST.hpp"
+#include "Visitors/Interpreter.hpp"
+#include "Visitors/SemanticChecker.hpp"
+#include "gtest/gtest.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using NodePtr = ast::BaseNode::NodePtr;
+
+struct RunResult
+{
+    std::string out;
+    std::string error;
+};
+
+RunResult Run(ast::BaseNode& root,
+              ast::Interpreter& interpreter,
+              const std::string& input)
+{
+    RunResult result;
+    std::istringstream in(input);
+    std::ostringstream out;
+    std::streambuf* old_in = std::cin.rdbuf(in.rdbuf());
+    std::streambuf* old_out = std::cout.rdbuf(out.rdbuf());
+    try {
+        root.accept(interpreter);
+    } catch (const std::runtime_error& ex) {
+        result.error = ex.what();
+    }
+    interpreter.output().flush();
+    std::cin.rdbuf(old_in);
+    std::cout.rdbuf(old_out);
+    result.out = out.str();
+    return result;
+}
+
+// Checks `root` and runs it with name lookup and with the frame layout,
+// expecting the same result from both.
+RunResult CheckAndRun(ast::BaseNode& root, const std::string& input = "")
+{
+    ast::SemanticChecker checker;
+    checker.check(&root);
+    EXPECT_FALSE(checker.hasErrors());
+
+    ast::Interpreter by_name;
+    const auto expected = Run(root, by_name, input);
+    ast::Interpreter by_frame(checker.frameSize());
+    const auto actual = Run(root, by_frame, input);
+    EXPECT_EQ(actual.out, expected.out);
+    EXPECT_EQ(actual.error, expected.error);
+    return actual;
+}
+
+bool HasCheckErrors(ast::BaseNode& root)
+{
+    ast::SemanticChecker checker;
+    checker.check(&root);
+    return checker.hasErrors();
+}
+
+NodePtr Num(int64_t value)
+{
+    return std::make_unique<ast::ValueNode>(value);
+}
+
+NodePtr Var(const std::string& name)
+{
+    return std::make_unique<ast::VarNode>(name);
+}
+
+NodePtr Assign(NodePtr lhs, NodePtr rhs)
+{
+    return std::make_unique<ast::AssignNode>(std::move(lhs), std::move(rhs));
+}
+
+NodePtr Assign(const std::string& name, NodePtr rhs)
+{
+    return Assign(Var(name), std::move(rhs));
+}
+
+NodePtr Stmt(NodePtr expr)
+{
+    return std::make_unique<ast::ExprNode>(std::move(expr));
+}
+
+NodePtr Print(NodePtr expr)
+{
+    return std::make_unique<ast::PrintNode>(std::move(expr));
+}
+
+NodePtr Arith(ast::bin_arith_op_type op, NodePtr lhs, NodePtr rhs)
+{
+    return std::make_unique<ast::BinArithOpNode>(
+        op, std::move(lhs), std::move(rhs));
+}
+
+NodePtr Logic(ast::bin_logic_op_type op, NodePtr lhs, NodePtr rhs)
+{
+    return std::make_unique<ast::BinLogicOpNode>(
+        op, std::move(lhs), std::move(rhs));
+}
+
+NodePtr Return(NodePtr expr)
+{
+    return std::make_unique<ast::ReturnNode>(std::move(expr));
+}
+
+template<typename... Args>
+NodePtr Call(const std::string& name, Args&&... args)
+{
+    auto call = std::make_unique<ast::CallNode>(name);
+    (call->add_arg(std::forward<Args>(args)), ...);
+    return call;
+}
+
+NodePtr Func(const std::string& name,
+             std::vector<ast::Name> params,
+             std::unique_ptr<ast::ScopeNode> body)
+{
+    return std::make_unique<ast::FuncNode>(
+        name, std::move(params), std::move(body));
+}
+
+// if (n == 0) return base; return step;
+std::unique_ptr<ast::ScopeNode> Recurse(NodePtr base, NodePtr step)
+{
+    auto body = std::make_unique<ast::ScopeNode>();
+    body->add_statement(std::make_unique<ast::IfNode>(
+        Logic(ast::bin_logic_op_type::equal, Var("n"), Num(0)),
+        Return(std::move(base))));
+    body->add_statement(Return(std::move(step)));
+    return body;
+}
+
+NodePtr Decrement(const std::string& name)
+{
+    return Arith(ast::bin_arith_op_type::sub, Var(name), Num(1));
+}
+
+} // namespace
+
+TEST(InterpreterFunctionTest, RecursiveEuclid)
+{
+    // func gcd(a, b) { if (b == 0) return a; return gcd(b, a % b); }
+    auto body = std::make_unique<ast::ScopeNode>();
+    body->add_statement(std::make_unique<ast::IfNode>(
+        Logic(ast::bin_logic_op_type::equal, Var("b"), Num(0)),
+        Return(Var("a"))));
+    body->add_statement(Return(
+        Call("gcd",
+             Var("b"),
+             Arith(ast::bin_arith_op_type::mod, Var("a"), Var("b")))));
+
+    ast::ScopeNode root;
+    root.add_statement(Func("gcd", { "a", "b" }, std::move(body)));
+    root.add_statement(Print(Call("gcd",
+                                  std::make_unique<ast::InputNode>(),
+                                  std::make_unique<ast::InputNode>())));
+
+    EXPECT_EQ(CheckAndRun(root, "1071 462").out, "21\n");
+    EXPECT_EQ(CheckAndRun(root, "7 0").out, "7\n");
+}
+
+TEST(InterpreterFunctionTest, TailCallsRunInConstantStack)
+{
+    // func down(n) { if (n == 0) return 0; return down(n - 1); }
+    ast::ScopeNode root;
+    root.add_statement(
+        Func("down", { "n" }, Recurse(Num(0), Call("down", Decrement("n")))));
+    root.add_statement(Print(Call("down", std::make_unique<ast::InputNode>())));
+
+    const auto result =
+        CheckAndRun(root, std::to_string(ast::kMaxCallDepth * 10));
+    EXPECT_EQ(result.out, "0\n");
+    EXPECT_EQ(result.error, "");
+}
+
+TEST(InterpreterFunctionTest, NestedCallsAndDepthLimit)
+{
+    // func sum(n) { if (n == 0) return 0; return n + sum(n - 1); }
+    ast::ScopeNode root;
+    root.add_statement(Func("sum",
+                            { "n" },
+                            Recurse(Num(0),
+                                    Arith(ast::bin_arith_op_type::add,
+                                          Var("n"),
+                                          Call("sum", Decrement("n"))))));
+    root.add_statement(Print(Call("sum", std::make_unique<ast::InputNode>())));
+
+    EXPECT_EQ(CheckAndRun(root, "100").out, "5050\n");
+    const auto result =
+        CheckAndRun(root, std::to_string(ast::kMaxCallDepth + 1));
+    EXPECT_EQ(result.out, "");
+    EXPECT_EQ(result.error, std::string("error: ") + ast::kCallDepthError);
+}
+
+TEST(InterpreterFunctionTest, FramesAreIsolated)
+{
+    // func f(x) { y = x * 2; while (1) { return y; } }
+    // func none() {}
+    // y = 5; print f(y); print y; print none();
+    auto loop_body = std::make_unique<ast::ScopeNode>();
+    loop_body->add_statement(Return(Var("y")));
+    auto body = std::make_unique<ast::ScopeNode>();
+    body->add_statement(Stmt(
+        Assign("y", Arith(ast::bin_arith_op_type::mul, Var("x"), Num(2)))));
+    body->add_statement(
+        std::make_unique<ast::WhileNode>(Num(1), std::move(loop_body)));
+
+    ast::ScopeNode root;
+    root.add_statement(Func("f", { "x" }, std::move(body)));
+    root.add_statement(
+        Func("none", {}, std::make_unique<ast::ScopeNode>()));
+    root.add_statement(Stmt(Assign("y", Num(5))));
+    root.add_statement(Print(Call("f", Var("y"))));
+    root.add_statement(Print(Var("y")));
+    root.add_statement(Print(Call("none")));
+
+    const auto result = CheckAndRun(root);
+    EXPECT_EQ(result.out, "10\n5\n0\n");
+    EXPECT_EQ(result.error, "");
+}
+
+TEST(InterpreterFunctionTest, CheckerRejectsBadCalls)
+{
+    auto identity = [] {
+        auto body = std::make_unique<ast::ScopeNode>();
+        body->add_statement(Return(Var("x")));
+        return Func("id", { "x" }, std::move(body));
+    };
+
+    ast::ScopeNode undefined;
+    undefined.add_statement(Print(Call("nope", Num(1))));
+    EXPECT_TRUE(HasCheckErrors(undefined));
+
+    ast::ScopeNode arity;
+    arity.add_statement(identity());
+    arity.add_statement(Print(Call("id", Num(1), Num(2))));
+    EXPECT_TRUE(HasCheckErrors(arity));
+
+    ast::ScopeNode twice;
+    twice.add_statement(identity());
+    twice.add_statement(identity());
+    EXPECT_TRUE(HasCheckErrors(twice));
+
+    ast::ScopeNode top_level_return;
+    top_level_return.add_statement(Return(Num(1)));
+    EXPECT_TRUE(HasCheckErrors(top_level_return));
+
+    // Globals are not visible inside a function.
+    auto reads_global = std::make_unique<ast::ScopeNode>();
+    reads_global->add_statement(Return(Var("g")));
+    ast::ScopeNode global;
+    global.add_statement(Stmt(Assign("g", Num(1))));
+    global.add_statement(Func("f", {}, std::move(reads_global)));
+    global.add_statement(Print(Call("f")));
+    EXPECT_TRUE(HasCheckErrors(global));
+
+    ast::ScopeNode ok;
+    ok.add_statement(Print(Call("id", Num(3))));
+    ok.add_statement(identity());
+    EXPECT_FALSE(HasCheckErrors(ok));
+    EXPECT_EQ(CheckAndRun(ok).out, "3\n");
+}
@@ -136,7 +136,7 @@ TEST(DiagnosticsTest, RuntimeErrorsUseGnuFormat)
     ast::InputNode node;
 
     ast::SourceRange range;
-    range.file = "runtime.pcl";
+    range.file = ast::FileTable::intern("runtime.pcl");
     range.begin_line = 4;
     range.begin_column = 2;
     node.set_location(range);
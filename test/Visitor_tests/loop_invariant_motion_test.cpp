@@ -0,0 +1,256 @@
+#include "AST/AST.hpp"
+#include "Bytecode/BytecodeCompiler.hpp"
+#include "Bytecode/VM.hpp"
+#include "Visitors/Interpreter.hpp"
+#include "Visitors/LoopInvariantMotion.hpp"
+#include "Visitors/SemanticChecker.hpp"
+#include "driver/driver.hpp"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+struct RunResult
+{
+    std::string out;
+    std::string error;
+};
+
+ast::AST Parse(const std::string& source)
+{
+    yy::NumDriver driver(source, "loop.pcl");
+    if (!driver.parse() || driver.has_errors()) {
+        throw std::runtime_error("parse failed");
+    }
+    return driver.take_ast();
+}
+
+ast::SemanticChecker Check(ast::AST& tree)
+{
+    ast::SemanticChecker checker;
+    checker.check(tree.root());
+    if (checker.hasErrors() || !checker.hasFrameLayout()) {
+        throw std::runtime_error("check failed");
+    }
+    return checker;
+}
+
+RunResult Interpret(ast::AST& tree, const std::string& input)
+{
+    const auto checker = Check(tree);
+    RunResult result;
+    std::istringstream in(input);
+    std::ostringstream out;
+    ast::Interpreter interpreter(checker.frameSize());
+    interpreter.output().set_stream(out);
+    interpreter.input() = ast::InputSource(in);
+    try {
+        tree.root()->accept(interpreter);
+    } catch (const std::runtime_error& ex) {
+        result.error = ex.what();
+    }
+    interpreter.output().flush();
+    result.out = out.str();
+    return result;
+}
+
+RunResult RunVM(ast::AST& tree, const std::string& input)
+{
+    Check(tree);
+    ast::bytecode::BytecodeCompiler compiler;
+    const auto program = compiler.compile(*tree.root());
+    RunResult result;
+    std::istringstream in(input);
+    std::ostringstream out;
+    ast::bytecode::VM vm(program);
+    vm.output().set_stream(out);
+    vm.input() = ast::InputSource(in);
+    try {
+        vm.run();
+    } catch (const std::runtime_error& ex) {
+        result.error = ex.what();
+    }
+    vm.output().flush();
+    result.out = out.str();
+    return result;
+}
+
+// Hoists from `source` and expects both backends to behave as they do on
+// the program as written, for every input. Returns the hoisted count.
+std::size_t ExpectSameBehaviour(const std::string& source,
+                                std::initializer_list<std::string> inputs)
+{
+    auto plain = Parse(source);
+    auto hoisted = Parse(source);
+    Check(hoisted);
+    ast::LoopInvariantMotion motion;
+    motion.hoist(hoisted.root());
+
+    for (const auto& input : inputs) {
+        const auto expected = Interpret(plain, input);
+        const auto walked = Interpret(hoisted, input);
+        const auto compiled = RunVM(hoisted, input);
+        EXPECT_EQ(walked.out, expected.out) << "input " << input;
+        EXPECT_EQ(walked.error, expected.error) << "input " << input;
+        EXPECT_EQ(compiled.out, expected.out) << "input " << input;
+        EXPECT_EQ(compiled.error, expected.error) << "input " << input;
+    }
+    return motion.hoisted_count();
+}
+
+const ast::BaseNode* Statement(const ast::AST& tree, std::size_t idx)
+{
+    return tree.root()->children()[idx].get();
+}
+
+} // namespace
+
+TEST(LoopInvariantMotionTest, HoistsArithmeticOnUnwrittenVariables)
+{
+    constexpr const char* kSource = R"(
+n = ?;
+i = 0;
+s = 0;
+while (i <= n) {
+    s = s + (n * n - 1);
+    i = i + 1;
+}
+print s;
+)";
+    EXPECT_EQ(ExpectSameBehaviour(kSource, { "0", "4", "-3", "3037000500" }),
+              1u);
+
+    auto tree = Parse(kSource);
+    Check(tree);
+    ast::LoopInvariantMotion motion;
+    motion.hoist(tree.root());
+    // n * n - 1 traps, so it is computed behind the loop condition.
+    ASSERT_EQ(tree.root()->children().size(), 7u);
+    EXPECT_EQ(Statement(tree, 3)->node_type(), ast::base_node_type::expr);
+    EXPECT_EQ(Statement(tree, 4)->node_type(), ast::base_node_type::if_node);
+    EXPECT_EQ(Statement(tree, 5)->node_type(),
+              ast::base_node_type::while_node);
+}
+
+TEST(LoopInvariantMotionTest, ReportsOverflowWhereTheLoopWould)
+{
+    constexpr const char* kSource = R"(
+n = ?;
+k = 0;
+while (k < n * n) {
+    k = k + 1;
+}
+print k;
+)";
+    EXPECT_EQ(ExpectSameBehaviour(kSource, { "3", "0", "3037000500" }), 1u);
+
+    auto tree = Parse(kSource);
+    auto checker = Check(tree);
+    ast::LoopInvariantMotion motion;
+    motion.hoist(tree.root());
+    EXPECT_EQ(Interpret(tree, "3037000500").error,
+              "loop.pcl:4:12: error: Integer overflow in multiplication");
+}
+
+TEST(LoopInvariantMotionTest, KeepsTrapsAfterOutputInPlace)
+{
+    constexpr const char* kSource = R"(
+d = ?;
+i = 0;
+while (i < 3) {
+    print i;
+    x = 10 / d;
+    i = i + 1;
+}
+print 7;
+)";
+    EXPECT_EQ(ExpectSameBehaviour(kSource, { "0", "2" }), 0u);
+}
+
+TEST(LoopInvariantMotionTest, SkipsTrapsOfLoopsThatDoNotRun)
+{
+    constexpr const char* kSource = R"(
+d = ?;
+i = 0;
+while (i < 0) {
+    print 10 / d;
+    i = i + 1;
+}
+print 7;
+for (j = 0; j < 2; j = j + 1) print 10 / d;
+)";
+    EXPECT_EQ(ExpectSameBehaviour(kSource, { "0", "3" }), 2u);
+}
+
+TEST(LoopInvariantMotionTest, HoistsQuietExpressionsFromBranches)
+{
+    constexpr const char* kSource = R"(
+n = ?;
+m = ?;
+s = 0;
+d = 1;
+for (i = 0; i < 10; i = i + 1) {
+    if (i == 5) {
+        print n > 3 && m < 2;
+        print 100 / d;
+    }
+    d = i + 1;
+    s = s + (n == m) + !n;
+}
+print s;
+)";
+    // `100 / d` reads d, which the body writes.
+    EXPECT_EQ(ExpectSameBehaviour(kSource, { "4 1", "1 1" }), 3u);
+}
+
+TEST(LoopInvariantMotionTest, ReusesOneTemporaryForEqualExpressions)
+{
+    constexpr const char* kSource = R"(
+a = ?;
+b = ?;
+for (i = 0; i < 3; i = i + 1) {
+    print a * b + i;
+    if (i > 1)
+        print a * b;
+    while (i < 0) i = a * b;
+}
+)";
+    EXPECT_EQ(ExpectSameBehaviour(kSource, { "2 3", "4611686018427387904 2" }),
+              1u);
+}
+
+TEST(LoopInvariantMotionTest, MovesOuterInvariantsOutOfNestedLoops)
+{
+    constexpr const char* kSource = R"(
+n = ?;
+t = 0;
+for (i = 0; i < n; i = i + 1) {
+    for (j = 0; j < n; j = j + 1) {
+        t = t + (n < 5) * (i + 2);
+    }
+}
+print t;
+)";
+    // n < 5 leaves the outer loop, then the product leaves the inner one.
+    EXPECT_EQ(ExpectSameBehaviour(kSource, { "0", "3", "9" }), 2u);
+}
+
+TEST(LoopInvariantMotionTest, LeavesWrittenAndIndexedValuesAlone)
+{
+    constexpr const char* kSource = R"(
+arr = repeat(1, 4);
+k = 3;
+i = 0;
+while (i < 4) {
+    k = k * 2;
+    arr[i] = arr[0] + k * 2;
+    i = i + 1;
+}
+print arr[3];
+)";
+    EXPECT_EQ(ExpectSameBehaviour(kSource, { "" }), 0u);
+}
@@ -0,0 +1,172 @@
+#include "AST/AST.hpp"
+#include "Visitors/ProfilingInterpreter.hpp"
+#include "gtest/gtest.h"
+
+#include <sstream>
+#include <string>
+
+namespace {
+
+using NodePtr = ast::BaseNode::NodePtr;
+
+template<typename NodeT>
+NodeT* AtLine(NodeT* node, std::uint32_t line)
+{
+    ast::SourceRange loc;
+    loc.file = ast::FileTable::intern("profile.pcl");
+    loc.begin_line = line;
+    loc.begin_column = 1;
+    node->set_location(loc);
+    return node;
+}
+
+NodePtr Num(int64_t value, std::uint32_t line)
+{
+    auto node = std::make_unique<ast::ValueNode>(value);
+    AtLine(node.get(), line);
+    return node;
+}
+
+NodePtr Var(const std::string& name, std::uint32_t line)
+{
+    auto node = std::make_unique<ast::VarNode>(name);
+    AtLine(node.get(), line);
+    return node;
+}
+
+NodePtr Assign(const std::string& name, NodePtr rhs, std::uint32_t line)
+{
+    auto assign =
+        std::make_unique<ast::AssignNode>(Var(name, line), std::move(rhs));
+    AtLine(assign.get(), line);
+    auto stmt = std::make_unique<ast::ExprNode>(std::move(assign));
+    AtLine(stmt.get(), line);
+    return stmt;
+}
+
+// 1: i = 0;
+// 2: while (i < 3) {
+// 3:     i = i + 1;
+// 4:     print i;
+//    }
+std::unique_ptr<ast::ScopeNode> CountToThree(ast::ExprNode** body_stmt)
+{
+    auto root = std::make_unique<ast::ScopeNode>();
+    AtLine(root.get(), 1);
+    root->add_statement(Assign("i", Num(0, 1), 1));
+
+    auto body = std::make_unique<ast::ScopeNode>();
+    AtLine(body.get(), 2);
+    auto inc = Assign("i",
+                      std::make_unique<ast::BinArithOpNode>(
+                          ast::bin_arith_op_type::add, Var("i", 3), Num(1, 3)),
+                      3);
+    AtLine(static_cast<ast::ExprNode*>(inc.get())->expr(), 3);
+    *body_stmt = static_cast<ast::ExprNode*>(inc.get());
+    body->add_statement(std::move(inc));
+    auto print = std::make_unique<ast::PrintNode>(Var("i", 4));
+    AtLine(print.get(), 4);
+    body->add_statement(std::move(print));
+
+    auto cond = std::make_unique<ast::BinLogicOpNode>(
+        ast::bin_logic_op_type::less, Var("i", 2), Num(3, 2));
+    AtLine(cond.get(), 2);
+    auto loop =
+        std::make_unique<ast::WhileNode>(std::move(cond), std::move(body));
+    AtLine(loop.get(), 2);
+    root->add_statement(std::move(loop));
+    return root;
+}
+
+std::string RunProfiled(ast::ScopeNode& root, ast::ProfilingInterpreter& vm)
+{
+    std::ostringstream out;
+    std::streambuf* old_out = std::cout.rdbuf(out.rdbuf());
+    root.accept(vm);
+    vm.output().flush();
+    std::cout.rdbuf(old_out);
+    return out.str();
+}
+
+} // namespace
+
+TEST(ProfilingInterpreterTest, CountsVisitsPerNode)
+{
+    ast::ExprNode* inc = nullptr;
+    auto root = CountToThree(&inc);
+    ast::ProfilingInterpreter interpreter;
+
+    EXPECT_EQ(RunProfiled(*root, interpreter), "1\n2\n3\n");
+
+    const auto& nodes = interpreter.profile().nodes();
+    ASSERT_EQ(nodes.count(root.get()), 1u);
+    EXPECT_EQ(nodes.at(root.get()).visits, 1u);
+    ASSERT_EQ(nodes.count(inc), 1u);
+    EXPECT_EQ(nodes.at(inc).visits, 3u);
+    EXPECT_GE(nodes.at(inc).total, nodes.at(inc).self());
+    EXPECT_GE(nodes.at(root.get()).total, nodes.at(inc).total);
+}
+
+TEST(ProfilingInterpreterTest, HotLineTableListsExecutedLines)
+{
+    ast::ExprNode* inc = nullptr;
+    auto root = CountToThree(&inc);
+    ast::ProfilingInterpreter interpreter;
+    RunProfiled(*root, interpreter);
+
+    std::ostringstream report;
+    interpreter.profile().write_hot_lines(report);
+    const auto text = report.str();
+    EXPECT_EQ(text.rfind("Profile: ", 0), 0u);
+    for (const char* line :
+         { "profile.pcl:1\n", "profile.pcl:2\n", "profile.pcl:3\n" })
+        EXPECT_NE(text.find(line), std::string::npos) << line;
+
+    std::ostringstream top;
+    interpreter.profile().write_hot_lines(top, 1);
+    std::size_t rows = 0;
+    for (char c : top.str())
+        rows += c == '\n';
+    EXPECT_EQ(rows, 3u);
+}
+
+TEST(ProfilingInterpreterTest, CollapsedStacksFollowTheTree)
+{
+    ast::ExprNode* inc = nullptr;
+    auto root = CountToThree(&inc);
+    ast::ProfilingInterpreter interpreter;
+    RunProfiled(*root, interpreter);
+
+    std::ostringstream collapsed;
+    interpreter.profile().write_collapsed(collapsed);
+    std::istringstream lines(collapsed.str());
+    std::string line;
+    bool saw_body = false;
+    while (std::getline(lines, line)) {
+        const auto space = line.rfind(' ');
+        ASSERT_NE(space, std::string::npos) << line;
+        EXPECT_GT(std::stoll(line.substr(space + 1)), 0) << line;
+        EXPECT_EQ(line.rfind("scope@profile.pcl:1", 0), 0u) << line;
+        saw_body |=
+            line.find("while@profile.pcl:2;scope@profile.pcl:2;expr@profile."
+                      "pcl:3") != std::string::npos;
+    }
+    EXPECT_TRUE(saw_body);
+}
+
+TEST(ProfilingInterpreterTest, RuntimeErrorKeepsPartialProfile)
+{
+    ast::ScopeNode root;
+    AtLine(&root, 1);
+    auto print = std::make_unique<ast::PrintNode>(
+        std::make_unique<ast::BinArithOpNode>(
+            ast::bin_arith_op_type::div, Num(1, 1), Num(0, 1)));
+    auto* print_raw = AtLine(print.get(), 1);
+    root.add_statement(std::move(print));
+
+    ast::ProfilingInterpreter interpreter;
+    EXPECT_THROW(root.accept(interpreter), std::runtime_error);
+    const auto& nodes = interpreter.profile().nodes();
+    ASSERT_EQ(nodes.count(print_raw), 1u);
+    EXPECT_EQ(nodes.at(print_raw).visits, 1u);
+}